@@ -0,0 +1,134 @@
+#include "bench/bench.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+struct RegisteredBench {
+    std::string name;
+    BenchFunction function;
+};
+
+std::vector<RegisteredBench> &registry() {
+    static std::vector<RegisteredBench> benches;
+    return benches;
+}
+
+std::ostream &benchCout() {
+    return std::cout << "[Bench] ";
+}
+
+std::ostream &benchCerr() {
+    return std::cerr << "[Bench] ";
+}
+
+std::string formatRate(double perSecond) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    if (perSecond >= 1e9) {
+        out << perSecond * 1e-9 << "G";
+    } else if (perSecond >= 1e6) {
+        out << perSecond * 1e-6 << "M";
+    } else if (perSecond >= 1e3) {
+        out << perSecond * 1e-3 << "k";
+    } else {
+        out << perSecond;
+    }
+    return out.str();
+}
+
+} // namespace
+
+BenchState::BenchState(uint64_t iterations) : iterations_(iterations), remaining_(iterations) {}
+
+bool BenchState::keepRunning() {
+    if (!started_) {
+        started_ = true;
+        begin_ = Clock::now();
+    }
+    if (remaining_ == 0) {
+        end_ = Clock::now();
+        return false;
+    }
+    remaining_--;
+    return true;
+}
+
+uint64_t BenchState::iterations() const {
+    return iterations_;
+}
+
+double BenchState::seconds() const {
+    return std::chrono::duration<double>(end_ - begin_).count();
+}
+
+void BenchState::setThroughput(const std::string &unit, double itemsPerIteration) {
+    for (auto &[existing, items] : throughput_) {
+        if (existing == unit) {
+            items = itemsPerIteration;
+            return;
+        }
+    }
+    throughput_.emplace_back(unit, itemsPerIteration);
+}
+
+const std::vector<std::pair<std::string, double>> &BenchState::throughput() const {
+    return throughput_;
+}
+
+bool registerBench(const char *name, BenchFunction function) {
+    registry().push_back({name, std::move(function)});
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::string filter;
+    double minSeconds = 0.5;
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], "--filter=", 9) == 0) {
+            filter = argv[i] + 9;
+        } else if (std::strncmp(argv[i], "--min-time=", 11) == 0) {
+            minSeconds = std::atof(argv[i] + 11);
+        } else {
+            benchCerr() << "usage: " << argv[0] << " [--filter=substring] [--min-time=seconds]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto &benches = registry();
+    std::sort(benches.begin(), benches.end(),
+              [](const RegisteredBench &a, const RegisteredBench &b) { return a.name < b.name; });
+
+    for (auto &bench : benches) {
+        if (!filter.empty() && bench.name.find(filter) == std::string::npos) continue;
+
+        uint64_t iterations = 1;
+        while (true) {
+            BenchState state(iterations);
+            bench.function(state);
+
+            double seconds = state.seconds();
+            if (seconds < minSeconds && iterations < (1ull << 30)) {
+                // aim a bit past the minimum so the next round is the last one
+                double scale = seconds > 0.0 ? minSeconds * 1.4 / seconds : 10.0;
+                iterations = std::max(iterations + 1, static_cast<uint64_t>(iterations * std::min(scale, 10.0)));
+                continue;
+            }
+
+            std::ostringstream line;
+            line << std::left << std::setw(40) << bench.name << std::right << std::setw(12) << iterations << " it "
+                 << std::fixed << std::setprecision(3) << std::setw(12) << seconds * 1e6 / iterations << " us/it";
+            for (auto &[unit, items] : state.throughput()) {
+                line << "  " << formatRate(items * iterations / seconds) << " " << unit << "/s";
+            }
+            benchCout() << line.str() << std::endl;
+            break;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal in-tree benchmark harness. A case loops on keepRunning(), only that loop is timed, and the runner grows the
+// iteration count until the loop ran for long enough to be measured. Throughput counters are set per iteration and
+// reported per second.
+class BenchState {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit BenchState(uint64_t iterations);
+
+    bool keepRunning();
+
+    uint64_t iterations() const;
+    double seconds() const;
+
+    // e.g. setThroughput("triangles", trianglesPerChunk)
+    void setThroughput(const std::string &unit, double itemsPerIteration);
+    const std::vector<std::pair<std::string, double>> &throughput() const;
+
+  private:
+    uint64_t iterations_;
+    uint64_t remaining_;
+    bool started_ = false;
+    Clock::time_point begin_;
+    Clock::time_point end_;
+    std::vector<std::pair<std::string, double>> throughput_;
+};
+
+using BenchFunction = std::function<void(BenchState &)>;
+
+bool registerBench(const char *name, BenchFunction function);
+
+// keeps the compiler from discarding a result that is otherwise never read
+inline void benchKeep(const void *pointer) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(pointer) : "memory");
+#else
+    static const void *volatile sink;
+    sink = pointer;
+#endif
+}
+
+#define MCVR_BENCH(name)                                                                                               \
+    static void name(BenchState &state);                                                                               \
+    static const bool name##Registered = registerBench(#name, name);                                                   \
+    static void name(BenchState &state)
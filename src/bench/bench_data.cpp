@@ -0,0 +1,197 @@
+#include "bench/bench_data.hpp"
+
+#include "core/render/quad_indices.hpp"
+
+#include <random>
+
+BenchSpriteKind benchSpriteKind(uint32_t sprite) {
+    uint32_t hash = sprite * 2654435761u;
+    uint32_t bucket = (hash >> 16) % 100;
+    if (bucket < 70) return BenchSpriteKind::OPAQUE;
+    if (bucket < 75) return BenchSpriteKind::TRANSPARENT;
+    return BenchSpriteKind::CUTOUT;
+}
+
+Textures::TextureAlphaData makeBenchAtlas() {
+    Textures::TextureAlphaData atlas;
+    atlas.resize(BENCH_ATLAS_SIZE, BENCH_ATLAS_SIZE);
+
+    std::mt19937 rng(7);
+    uint32_t spritesPerRow = BENCH_ATLAS_SIZE / BENCH_SPRITE_SIZE;
+    for (uint32_t sprite = 0; sprite < spritesPerRow * spritesPerRow; sprite++) {
+        auto kind = benchSpriteKind(sprite);
+        if (kind == BenchSpriteKind::OPAQUE) continue;
+
+        uint32_t baseX = sprite % spritesPerRow * BENCH_SPRITE_SIZE;
+        uint32_t baseY = sprite / spritesPerRow * BENCH_SPRITE_SIZE;
+        for (uint32_t y = 0; y < BENCH_SPRITE_SIZE; y++) {
+            for (uint32_t x = 0; x < BENCH_SPRITE_SIZE; x++) {
+                uint8_t alpha = kind == BenchSpriteKind::TRANSPARENT ? 0 : (rng() % 3 == 0 ? 0 : 255);
+                atlas.alpha[(size_t)(baseY + y) * BENCH_ATLAS_SIZE + baseX + x] = alpha;
+            }
+        }
+    }
+    atlas.updateTiles(0, 0, BENCH_ATLAS_SIZE, BENCH_ATLAS_SIZE);
+    return atlas;
+}
+
+std::vector<vk::VertexFormat::PBRTriangle> makeBenchChunkQuads(uint32_t quadCount,
+                                                               uint32_t seed,
+                                                               bool (*spriteFilter)(BenchSpriteKind)) {
+    std::mt19937 rng(seed);
+    uint32_t spritesPerRow = BENCH_ATLAS_SIZE / BENCH_SPRITE_SIZE;
+    float spriteUV = static_cast<float>(BENCH_SPRITE_SIZE) / BENCH_ATLAS_SIZE;
+    // stay half a texel inside the sprite like the baked block models do
+    float inset = 0.5f / BENCH_ATLAS_SIZE;
+
+    std::vector<vk::VertexFormat::PBRTriangle> vertices;
+    vertices.reserve(quadCount * 4);
+    for (uint32_t q = 0; q < quadCount; q++) {
+        uint32_t sprite;
+        do {
+            sprite = rng() % (spritesPerRow * spritesPerRow);
+        } while (spriteFilter != nullptr && !spriteFilter(benchSpriteKind(sprite)));
+
+        float u0 = sprite % spritesPerRow * spriteUV + inset;
+        float v0 = sprite / spritesPerRow * spriteUV + inset;
+        float u1 = u0 + spriteUV - 2.0f * inset;
+        float v1 = v0 + spriteUV - 2.0f * inset;
+
+        glm::vec3 origin{static_cast<float>(rng() % 16), static_cast<float>(rng() % 16), static_cast<float>(rng() % 16)};
+        uint32_t axis = rng() % 3;
+        glm::vec3 du{0.0f}, dv{0.0f}, normal{0.0f};
+        du[(axis + 1) % 3] = 1.0f;
+        dv[(axis + 2) % 3] = 1.0f;
+        normal[axis] = 1.0f;
+
+        glm::vec3 corners[4] = {origin, origin + du, origin + du + dv, origin + dv};
+        glm::vec2 uvs[4] = {{u0, v0}, {u1, v0}, {u1, v1}, {u0, v1}};
+        for (uint32_t k = 0; k < 4; k++) {
+            vk::VertexFormat::PBRTriangle vertex{};
+            vertex.pos = corners[k];
+            vertex.useNorm = 1;
+            vertex.norm = normal;
+            vertex.useColorLayer = 1;
+            vertex.colorLayer = glm::vec4{1.0f};
+            vertex.useTexture = 1;
+            vertex.textureUV = uvs[k];
+            vertex.textureID = BENCH_ATLAS_TEXTURE_ID;
+            vertex.useLight = 1;
+            vertex.lightUV = glm::ivec2{240, 240};
+            vertices.push_back(vertex);
+        }
+    }
+    return vertices;
+}
+
+std::shared_ptr<ChunkBuildData> makeBenchChunk(uint32_t solidQuads, uint32_t transparentQuads, uint32_t seed) {
+    std::vector<World::GeometryTypes> geometryTypes = {World::WORLD_SOLID, World::WORLD_TRANSPARENT};
+    std::vector<std::vector<vk::VertexFormat::PBRTriangle>> vertices;
+    vertices.push_back(makeBenchChunkQuads(solidQuads, seed, [](BenchSpriteKind kind) {
+        return kind == BenchSpriteKind::OPAQUE;
+    }));
+    vertices.push_back(makeBenchChunkQuads(transparentQuads, seed + 1, [](BenchSpriteKind kind) {
+        return kind != BenchSpriteKind::OPAQUE;
+    }));
+
+    std::vector<std::vector<uint32_t>> indices;
+    uint32_t allVertexCount = 0, allIndexCount = 0;
+    for (auto &geometryVertices : vertices) {
+        auto &geometryIndices = indices.emplace_back((geometryVertices.size() + 3) / 4 * 6);
+        fillQuadIndices(geometryIndices.data(), geometryVertices.size());
+        allVertexCount += geometryVertices.size();
+        allIndexCount += geometryIndices.size();
+    }
+
+    return ChunkBuildData::create(0, 0, 0, 0, 0, allVertexCount, allIndexCount, 2, std::move(geometryTypes),
+                                  std::move(vertices), std::move(indices));
+}
+
+BenchAlphaSource::BenchAlphaSource() : atlas_(makeBenchAtlas()) {}
+
+Textures::AlphaClass BenchAlphaSource::alphaClass(uint32_t textureID) const {
+    return textureID == BENCH_ATLAS_TEXTURE_ID ? atlas_.alphaClass() : Textures::AlphaClass::FULLY_OPAQUE;
+}
+
+const Textures::TextureAlphaData *BenchAlphaSource::alphaData(uint32_t textureID) const {
+    return textureID == BENCH_ATLAS_TEXTURE_ID ? &atlas_ : nullptr;
+}
+
+BenchEntityTask::BenchEntityTask(uint32_t entityCount, uint32_t geometriesPerEntity, uint32_t boxesPerGeometry, bool post) {
+    std::mt19937 rng(11);
+    for (uint32_t e = 0; e < entityCount; e++) {
+        hashCodes.push_back(static_cast<int>(e));
+        xs.push_back(rng() % 128);
+        ys.push_back(64.0 + rng() % 16);
+        zs.push_back(rng() % 128);
+        rtFlags.push_back(1);
+        prebuiltBLASs.push_back(0);
+        posts.push_back(post ? 1 : 0);
+        geometryCounts.push_back(static_cast<int>(geometriesPerEntity));
+
+        for (uint32_t g = 0; g < geometriesPerEntity; g++) {
+            auto &geometry = vertexStorage.emplace_back();
+            for (uint32_t b = 0; b < boxesPerGeometry; b++) {
+                glm::vec3 center{(rng() % 100) * 0.01f, (rng() % 100) * 0.01f, (rng() % 100) * 0.01f};
+                for (uint32_t face = 0; face < 6; face++) {
+                    uint32_t axis = face / 2;
+                    float side = face % 2 == 0 ? -0.25f : 0.25f;
+                    glm::vec3 du{0.0f}, dv{0.0f}, normal{0.0f};
+                    du[(axis + 1) % 3] = 0.25f;
+                    dv[(axis + 2) % 3] = 0.25f;
+                    normal[axis] = side > 0.0f ? 1.0f : -1.0f;
+                    glm::vec3 faceCenter = center + normal * 0.25f;
+
+                    glm::vec3 corners[4] = {faceCenter - du - dv, faceCenter + du - dv, faceCenter + du + dv,
+                                            faceCenter - du + dv};
+                    glm::vec2 uvs[4] = {{0.0f, 0.0f}, {0.5f, 0.0f}, {0.5f, 0.5f}, {0.0f, 0.5f}};
+                    uint32_t packedNormal = static_cast<uint8_t>(static_cast<int8_t>(normal.x * 127.0f)) |
+                                            static_cast<uint8_t>(static_cast<int8_t>(normal.y * 127.0f)) << 8 |
+                                            static_cast<uint8_t>(static_cast<int8_t>(normal.z * 127.0f)) << 16;
+                    for (uint32_t k = 0; k < 4; k++) {
+                        vk::VertexFormat::PositionColorTexOverlayLightNormal vertex{};
+                        vertex.position = corners[k];
+                        vertex.color = 0xFFFFFFFFu;
+                        vertex.uv0 = uvs[k];
+                        vertex.uv1 = 0x000A0000u;
+                        vertex.uv2 = 0x00F000F0u;
+                        vertex.normal = packedNormal;
+                        geometry.push_back(vertex);
+                    }
+                }
+            }
+
+            geometryTypes.push_back(World::WORLD_SOLID);
+            geometryTextures.push_back(static_cast<int>(1 + e % 32));
+            vertexFormats.push_back(World::POSITION_COLOR_TEXTURE_OVERLAY_LIGHT_NORMAL);
+            indexFormats.push_back(static_cast<int>(World::DrawMode::QUADS));
+            vertexCounts.push_back(static_cast<int>(geometry.size()));
+            totalVertexCount += geometry.size();
+        }
+    }
+
+    for (auto &geometry : vertexStorage) vertices.push_back(geometry.data());
+}
+
+EntitiesBuildTask BenchEntityTask::task() {
+    return EntitiesBuildTask{
+        .lineWidth = 1.0f,
+        .coordinate = World::CAMERA,
+        .normalOffset = true,
+        .entityCount = static_cast<int>(hashCodes.size()),
+        .entityHashCodes = hashCodes.data(),
+        .entityXs = xs.data(),
+        .entityYs = ys.data(),
+        .entityZs = zs.data(),
+        .entityRTFlags = rtFlags.data(),
+        .entityPrebuiltBLASs = prebuiltBLASs.data(),
+        .entityPosts = posts.data(),
+        .entityGeometryCounts = geometryCounts.data(),
+        .geometryTypes = geometryTypes.data(),
+        .geometryTextures = geometryTextures.data(),
+        .vertexFormats = vertexFormats.data(),
+        .indexFormats = indexFormats.data(),
+        .vertexCounts = vertexCounts.data(),
+        .vertices = vertices.data(),
+    };
+}
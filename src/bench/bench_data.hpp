@@ -0,0 +1,61 @@
+#pragma once
+
+#include "core/render/chunks.hpp"
+#include "core/render/entities.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Deterministic synthetic inputs shaped after a loaded overworld: block quads that sample 16x16 sprites of one
+// 1024x1024 atlas, mostly opaque with a share of cutout sprites (leaves, grass, flowers).
+
+constexpr uint32_t BENCH_ATLAS_SIZE = 1024;
+constexpr uint32_t BENCH_SPRITE_SIZE = 16;
+constexpr uint32_t BENCH_ATLAS_TEXTURE_ID = 0;
+
+enum class BenchSpriteKind { OPAQUE, TRANSPARENT, CUTOUT };
+
+BenchSpriteKind benchSpriteKind(uint32_t sprite);
+
+Textures::TextureAlphaData makeBenchAtlas();
+
+// quadCount quads inside one 16^3 section, spriteFilter restricts the sampled sprites (nullptr for any)
+std::vector<vk::VertexFormat::PBRTriangle> makeBenchChunkQuads(uint32_t quadCount,
+                                                               uint32_t seed,
+                                                               bool (*spriteFilter)(BenchSpriteKind) = nullptr);
+
+std::shared_ptr<ChunkBuildData> makeBenchChunk(uint32_t solidQuads, uint32_t transparentQuads, uint32_t seed);
+
+class BenchAlphaSource : public ChunkAlphaSource {
+  public:
+    BenchAlphaSource();
+
+    Textures::AlphaClass alphaClass(uint32_t textureID) const override;
+    const Textures::TextureAlphaData *alphaData(uint32_t textureID) const override;
+
+  private:
+    Textures::TextureAlphaData atlas_;
+};
+
+// backing storage of an EntitiesBuildTask, every geometry is a textured box made of quads
+struct BenchEntityTask {
+    std::vector<int> hashCodes;
+    std::vector<double> xs, ys, zs;
+    std::vector<int> rtFlags;
+    std::vector<int> prebuiltBLASs;
+    std::vector<int> posts;
+    std::vector<int> geometryCounts;
+    std::vector<int> geometryTypes;
+    std::vector<int> geometryTextures;
+    std::vector<int> vertexFormats;
+    std::vector<int> indexFormats;
+    std::vector<int> vertexCounts;
+    std::vector<std::vector<vk::VertexFormat::PositionColorTexOverlayLightNormal>> vertexStorage;
+    std::vector<void *> vertices;
+
+    uint32_t totalVertexCount = 0;
+
+    BenchEntityTask(uint32_t entityCount, uint32_t geometriesPerEntity, uint32_t boxesPerGeometry, bool post);
+
+    EntitiesBuildTask task();
+};
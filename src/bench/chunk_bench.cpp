@@ -0,0 +1,99 @@
+#include "bench/bench.hpp"
+#include "bench/bench_data.hpp"
+
+#include "core/render/quad_indices.hpp"
+#include "core/render/renderer.hpp"
+#ifdef MCVR_ENABLE_OMM
+#include "core/render/omm_baker.hpp"
+#endif
+
+// a busy overworld section: mostly solid faces, a fifth of them cutout or translucent
+constexpr uint32_t SOLID_QUADS = 3000;
+constexpr uint32_t TRANSPARENT_QUADS = 800;
+
+static void setChunkThroughput(BenchState &state, const ChunkBuildData &chunk) {
+    state.setThroughput("chunks", 1.0);
+    state.setThroughput("vertices", chunk.allVertexCount);
+    state.setThroughput("triangles", chunk.allIndexCount / 3.0);
+}
+
+MCVR_BENCH(ChunkQuadIndices) {
+    constexpr uint32_t vertexCount = (SOLID_QUADS + TRANSPARENT_QUADS) * 4;
+    std::vector<uint32_t> indices(vertexCount / 4 * 6);
+
+    while (state.keepRunning()) {
+        fillQuadIndices(indices.data(), vertexCount);
+        benchKeep(indices.data());
+    }
+    state.setThroughput("chunks", 1.0);
+    state.setThroughput("triangles", indices.size() / 3.0);
+}
+
+// important chunks: special indices from the texture alpha class only
+MCVR_BENCH(ChunkBuildOpacityClassify) {
+    auto chunk = makeBenchChunk(SOLID_QUADS, TRANSPARENT_QUADS, 1);
+    BenchAlphaSource alphaSource;
+
+    while (state.keepRunning()) {
+        chunk->ommGeometryData.clear();
+        chunk->prepareOpacity(true, false, alphaSource);
+        benchKeep(chunk->ommGeometryData.data());
+    }
+    setChunkThroughput(state, *chunk);
+}
+
+// background chunks: tile classification, then per-micro-triangle baking of what is left
+MCVR_BENCH(ChunkBuildOpacityBake) {
+    auto chunk = makeBenchChunk(SOLID_QUADS, TRANSPARENT_QUADS, 1);
+    BenchAlphaSource alphaSource;
+
+    while (state.keepRunning()) {
+        chunk->ommGeometryData.clear();
+        chunk->prepareOpacity(true, true, alphaSource);
+        benchKeep(chunk->ommGeometryData.data());
+    }
+    setChunkThroughput(state, *chunk);
+}
+
+MCVR_BENCH(ChunkBuildNoOMM) {
+    auto chunk = makeBenchChunk(SOLID_QUADS, TRANSPARENT_QUADS, 1);
+    BenchAlphaSource alphaSource;
+
+    while (state.keepRunning()) {
+        chunk->ommGeometryData.clear();
+        chunk->prepareOpacity(false, false, alphaSource);
+        benchKeep(chunk->ommGeometryData.data());
+    }
+    setChunkThroughput(state, *chunk);
+}
+
+#ifdef MCVR_ENABLE_OMM
+// the SDK alone on cutout triangles, what the tile classification could not resolve
+MCVR_BENCH(OMMBakerBake) {
+    auto vertices = makeBenchChunkQuads(TRANSPARENT_QUADS, 2, [](BenchSpriteKind kind) {
+        return kind == BenchSpriteKind::CUTOUT;
+    });
+    std::vector<uint32_t> indices(vertices.size() / 4 * 6);
+    fillQuadIndices(indices.data(), vertices.size());
+    auto atlas = makeBenchAtlas();
+    OMMBaker baker;
+
+    OMMBaker::BakeInput input{};
+    input.alphaData = atlas.alpha.data();
+    input.texWidth = atlas.width;
+    input.texHeight = atlas.height;
+    input.uvData = &vertices[0].textureUV;
+    input.uvStrideBytes = sizeof(vk::VertexFormat::PBRTriangle);
+    input.indexData = indices.data();
+    input.indexCount = static_cast<uint32_t>(indices.size());
+    input.alphaCutoff = 0.05f;
+    input.maxSubdivisionLevel = Renderer::options.ommBakerLevel;
+
+    while (state.keepRunning()) {
+        OMMBaker::BakeResult result;
+        baker.bake(input, result);
+        benchKeep(result.indexBuffer.data());
+    }
+    state.setThroughput("triangles", indices.size() / 3.0);
+}
+#endif
@@ -0,0 +1,35 @@
+#include "bench/bench.hpp"
+#include "bench/bench_data.hpp"
+
+// a crowded scene: 96 mobs of 6 model parts, each part a few boxes
+constexpr uint32_t ENTITY_COUNT = 96;
+constexpr uint32_t GEOMETRIES_PER_ENTITY = 6;
+constexpr uint32_t BOXES_PER_GEOMETRY = 3;
+
+static void runEntityDecode(BenchState &state, bool post) {
+    BenchEntityTask entityTask(ENTITY_COUNT, GEOMETRIES_PER_ENTITY, BOXES_PER_GEOMETRY, post);
+    EntitiesBuildTask task = entityTask.task();
+
+    std::vector<std::shared_ptr<EntityBuildData>> datas;
+    datas.reserve(ENTITY_COUNT);
+    while (state.keepRunning()) {
+        datas.clear();
+        Entities::decodeBuildTask(task, [&datas](std::shared_ptr<EntityBuildData> data, bool) {
+            datas.push_back(std::move(data));
+        });
+        benchKeep(datas.data());
+    }
+    state.setThroughput("entities", ENTITY_COUNT);
+    state.setThroughput("vertices", entityTask.totalVertexCount);
+    state.setThroughput("triangles", entityTask.totalVertexCount / 4 * 2.0);
+}
+
+// quads of raw formats are only copied here, the GPU widens them
+MCVR_BENCH(EntityQueueBuildRaw) {
+    runEntityDecode(state, false);
+}
+
+// post entities take the full cpu widening path
+MCVR_BENCH(EntityQueueBuildWiden) {
+    runEntityDecode(state, true);
+}
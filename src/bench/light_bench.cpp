@@ -0,0 +1,50 @@
+#include "bench/bench.hpp"
+
+#include "core/render/chunks.hpp"
+#include "core/render/lights.hpp"
+
+#include <random>
+
+// 12 chunk render distance around the camera, a handful of torches and lanterns per lit section
+constexpr int RENDER_DISTANCE = 12;
+constexpr uint32_t LIGHTS_PER_SECTION = 6;
+constexpr uint32_t RECORDS_PER_SECTION = 8; // the smallest light slot of Chunks
+
+MCVR_BENCH(ChunkLightRecordPack) {
+    std::mt19937 rng(5);
+    std::vector<std::shared_ptr<Chunk1>> chunks;
+    for (int cx = -RENDER_DISTANCE; cx <= RENDER_DISTANCE; cx++) {
+        for (int cz = -RENDER_DISTANCE; cz <= RENDER_DISTANCE; cz++) {
+            for (int cy = 2; cy < 6; cy++) {
+                auto chunk = Chunk1::create();
+                chunk->x = cx * 16;
+                chunk->y = cy * 16;
+                chunk->z = cz * 16;
+                for (uint32_t l = 0; l < LIGHTS_PER_SECTION; l++) {
+                    chunk->lightSources.push_back({
+                        .worldX = static_cast<float>(chunk->x + rng() % 16) + 0.5f,
+                        .worldY = static_cast<float>(chunk->y + rng() % 16) + 0.5f,
+                        .worldZ = static_cast<float>(chunk->z + rng() % 16) + 0.5f,
+                        .lightTypeId = static_cast<int>(rng() % LIGHT_CANDLE + 1),
+                    });
+                }
+                chunks.push_back(chunk);
+            }
+        }
+    }
+
+    // the worst case of Chunks::uploadLights, every section sent its lights again
+    std::vector<vk::Data::ChunkLightRecord> records(chunks.size() * RECORDS_PER_SECTION);
+    uint32_t lightCount = 0;
+    for (auto &chunk : chunks) lightCount += chunk->lightSources.size();
+
+    while (state.keepRunning()) {
+        for (uint32_t i = 0; i < chunks.size(); i++) {
+            auto slot = std::span(records).subspan(i * RECORDS_PER_SECTION, RECORDS_PER_SECTION);
+            Chunks::packLightRecords(i, chunks[i]->lightSources, slot);
+        }
+        benchKeep(records.data());
+    }
+    state.setThroughput("chunks", chunks.size());
+    state.setThroughput("lights", lightCount);
+}
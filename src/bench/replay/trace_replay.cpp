@@ -0,0 +1,159 @@
+#include "bench/bench_data.hpp"
+#include "core/render/build_trace.hpp"
+#include "core/render/quad_indices.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+// Headless replay of a build trace: the cpu halves of Chunks and Entities run for real, the device is modelled as
+// keeping up with every batch the scheduler launches.
+
+namespace {
+
+std::ostream &replayCout() {
+    return std::cout << "[TraceReplay] ";
+}
+
+std::ostream &replayCerr() {
+    return std::cerr << "[TraceReplay] ";
+}
+
+// traces carry no texture data, every texture samples the synthetic block atlas of the benchmarks instead
+class ReplayAlphaSource : public ChunkAlphaSource {
+  public:
+    Textures::AlphaClass alphaClass(uint32_t) const override {
+        return atlas_.alphaClass(BENCH_ATLAS_TEXTURE_ID);
+    }
+
+    const Textures::TextureAlphaData *alphaData(uint32_t) const override {
+        return atlas_.alphaData(BENCH_ATLAS_TEXTURE_ID);
+    }
+
+  private:
+    BenchAlphaSource atlas_;
+};
+
+class HeadlessBuildTraceTarget : public BuildTraceTarget {
+  public:
+    // same as ChunkBuildDataBatch
+    constexpr static auto TIME_BUDGET = std::chrono::microseconds(4000);
+
+    void resetChunks(uint32_t) override {
+        queued_.clear();
+        ready_.clear();
+    }
+
+    void rebuildChunk(const ChunkBuildTask &task) override {
+        // the heap path of Chunks::queueChunkBuild
+        uint32_t allVertexCount = 0, allIndexCount = 0;
+        std::vector<World::GeometryTypes> geometryTypes;
+        std::vector<std::vector<vk::VertexFormat::PBRTriangle>> vertices;
+        std::vector<std::vector<uint32_t>> indices;
+        for (int i = 0; i < task.geometryCount; i++) {
+            geometryTypes.push_back(static_cast<World::GeometryTypes>(task.geometryTypes[i]));
+
+            auto &geometryVertices = vertices.emplace_back(task.vertices[i], task.vertices[i] + task.vertexCounts[i]);
+            auto &geometryIndices = indices.emplace_back((task.vertexCounts[i] + 3) / 4 * 6);
+            fillQuadIndices(geometryIndices.data(), task.vertexCounts[i]);
+
+            allVertexCount += geometryVertices.size();
+            allIndexCount += geometryIndices.size();
+        }
+
+        auto data = ChunkBuildData::create(task.id, task.x, task.y, task.z, 0, allVertexCount, allIndexCount,
+                                           task.geometryCount, std::move(geometryTypes), std::move(vertices),
+                                           std::move(indices));
+
+        bool useOMM = Renderer::options.ommEnabled;
+        if (task.isImportant) {
+            // important chunks are built inline without OMM, the baked version follows through the queue
+            data->prepareOpacity(false, false, alphaSource_);
+            ready_.insert(task.id);
+            if (!useOMM) return;
+        }
+        queued_[task.id] = data;
+    }
+
+    void invalidateChunk(int64_t id) override {
+        queued_.erase(id);
+        ready_.erase(id);
+    }
+
+    void setChunkLights(int64_t, const std::vector<ChunkLightEntry> &) override {}
+
+    void queueEntities(const EntitiesBuildTask &task) override {
+        Entities::decodeBuildTask(task, [](std::shared_ptr<EntityBuildData>, bool) {});
+    }
+
+    void endFrame(glm::dvec3 cameraPos) override {
+        std::vector<std::pair<double, int64_t>> order;
+        for (auto &[id, data] : queued_) {
+            glm::dvec3 center = glm::dvec3(data->x, data->y, data->z) + 8.0;
+            order.emplace_back(glm::length(center - cameraPos), id);
+        }
+        // the scheduler ranks by Chunk1::buildFactor, which is dominated by the distance to the camera
+        std::sort(order.begin(), order.end());
+
+        bool useOMM = Renderer::options.ommEnabled;
+        size_t next = 0;
+        for (uint32_t batch = 0; batch < Renderer::options.chunkBuildingTotalBatches && next < order.size(); batch++) {
+            auto batchStart = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < Renderer::options.chunkBuildingBatchSize && next < order.size(); i++) {
+                if (i > 0 && std::chrono::steady_clock::now() - batchStart > TIME_BUDGET) break;
+
+                int64_t id = order[next++].second;
+                queued_[id]->prepareOpacity(useOMM, true, alphaSource_);
+                queued_.erase(id);
+                ready_.insert(id);
+            }
+        }
+    }
+
+    bool isChunkReady(int64_t id) override {
+        return ready_.contains(id);
+    }
+
+    size_t queuedChunkCount() override {
+        return queued_.size();
+    }
+
+  private:
+    ReplayAlphaSource alphaSource_;
+    std::unordered_map<int64_t, std::shared_ptr<ChunkBuildData>> queued_;
+    std::unordered_set<int64_t> ready_;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    bool useTraceOptions = true;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--current-options") == 0) {
+            useTraceOptions = false;
+        } else if (path == nullptr && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path = nullptr;
+            break;
+        }
+    }
+    if (path == nullptr) {
+        replayCerr() << "usage: " << argv[0] << " [--current-options] trace.bin" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto replayer = BuildTraceReplayer::create();
+    if (!replayer->open(path)) return EXIT_FAILURE;
+    if (useTraceOptions && replayer->reader().optionsCompatible()) Renderer::options = replayer->reader().options();
+
+    HeadlessBuildTraceTarget target;
+    while (replayer->replayFrame(target)) {}
+
+    replayCout() << "replayed " << path << "\n" << replayer->report().format() << std::flush;
+    return EXIT_SUCCESS;
+}
@@ -26,12 +26,18 @@
 #    define T_INT int
 #    define T_BOOL bool
 #    define T_DVEC4 dvec4
-#    define WORLD_MASK 1
-#    define PLAYER_MASK 2
-#    define FISHING_BOBBER_MASK 4
-#    define HAND_MASK 8
-#    define WEATHER_MASK 16
-#    define PARTICLE_MASK 32
-#    define CLOUD_MASK 64
-#    define BOAT_WATER_MASK 128
-#endif
\ No newline at end of file
+#endif
+
+// TLAS instance masks
+#define WORLD_MASK 1
+#define PLAYER_MASK 2
+#define FISHING_BOBBER_MASK 4
+#define HAND_MASK 8
+#define FAR_WORLD_MASK 16 // chunk sections past Options::tlasFarMaskDistance, deep GI rays skip them
+// the 8-bit instance mask has no free bit left, weather shares the particle bit since every ray traces both or neither
+#define WEATHER_MASK 32
+#define PARTICLE_MASK 32
+#define CLOUD_MASK 64
+#define BOAT_WATER_MASK 128
+// the weather bit entities arrive with from Java, folded into WEATHER_MASK when the TLAS is built
+#define JAVA_WEATHER_FLAG 16
\ No newline at end of file
@@ -10,6 +10,15 @@
 #define INV_TWO_PI 0.15915494309189533
 #define INV_4_PI 0.07957747154594766
 
+// Options::variableRateTracing, one tracing rate per square tile of this many pixels
+#define VARIABLE_RATE_TILE_SIZE 8
+#define TRACING_RATE_FULL 0u
+#define TRACING_RATE_HALF 1u    // checkerboard, flipping every frame
+#define TRACING_RATE_QUARTER 2u // one pixel of every 2x2 block, each of them once in 4 frames
+
+// Options::adaptiveBounces, world.rgen spreads its bounce counters over this many slots
+#define BOUNCE_STAT_SLOTS 64
+
 #ifdef __cplusplus
 namespace vk {
 #endif
@@ -374,6 +383,37 @@ namespace Data {
         T_VEC3 _unused;      // available for future use
         T_FLOAT radius;      // max range in blocks
     }; // 48 bytes, std430 aligned (3 x vec4)
+
+// at most this many area lights are selected per frame, brightest first
+#define MAX_AREA_LIGHTS 512
+#define LIGHT_RECORD_UNUSED 0xFFFFFFFFu
+
+    // a light block of a chunk section, lives in Chunks::lightRecords() until Java sends the section's lights again
+    struct ChunkLightRecord {
+        T_INT blockX; // floor of the world position, kept integer so camera relative positions stay exact
+        T_INT blockY;
+        T_INT blockZ;
+        T_UINT source;   // lightTypeId | chunk index << 8, LIGHT_RECORD_UNUSED for a free slot
+        T_VEC3 offset;   // world position minus the block
+        T_UINT stableId; // for cross-frame light tracking (ReSTIR DI)
+    };
+
+    // LIGHT_DEFS of one LightTypeId with the per-block Options applied
+    struct AreaLightType {
+        T_VEC3 color;
+        T_FLOAT intensity; // 0 for a type switched off
+        T_FLOAT halfExtent;
+        T_FLOAT yOffset;
+        T_FLOAT flickerStrength;
+        T_FLOAT pad0;
+    };
+
+    // one quad of a greedily merged chunk BLAS, covering width x height block quads of a plane
+    struct ChunkMergedQuad {
+        T_UINT firstQuad; // uint index into the remap buffer where the covered original quads are listed
+        T_UINT extent;    // width | height << 8 | axis << 16, the quad spans the two axes following axis
+        T_VEC2 origin;    // lowest corner along those two axes, chunk local
+    };
 #ifdef __cplusplus
 }; // namespace Data
 #endif
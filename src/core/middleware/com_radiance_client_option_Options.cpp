@@ -34,6 +34,32 @@ extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_native
     if (write) Renderer::options.needRecreate = true;
 }
 
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetTransientImageAliasing(
+    JNIEnv *, jclass, jboolean enabled, jboolean write) {
+    Renderer::options.transientImageAliasing = enabled;
+    // only takes effect when the world pipeline is built again
+    if (write) Renderer::options.needRecreate = true;
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetAsyncCompute(JNIEnv *,
+                                                                                     jclass,
+                                                                                     jboolean enabled,
+                                                                                     jboolean write) {
+    Renderer::options.asyncCompute = enabled;
+    // the queue each module records for is decided when the world pipeline is built
+    if (write) Renderer::options.needRecreate = true;
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetFramesInFlight(
+    JNIEnv *, jclass, jint framesInFlight, jboolean write) {
+    Renderer::options.framesInFlight = static_cast<uint32_t>(std::clamp(framesInFlight, 2, 4));
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetLatencyPacing(
+    JNIEnv *, jclass, jboolean enabled, jboolean write) {
+    Renderer::options.latencyPacing = enabled;
+}
+
 extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetChunkBuildingBatchSize(
     JNIEnv *, jclass, jint chunkBuildingBatchSize, jboolean write) {
     Renderer::options.chunkBuildingBatchSize = chunkBuildingBatchSize;
@@ -483,3 +509,152 @@ extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_native
     Renderer::options.restirBounceEnabled = enabled;
 }
 
+// --- TLAS Instance Selection ---
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetTlasCullRadius(
+    JNIEnv *, jclass, jint radius, jboolean write) {
+    Renderer::options.tlasCullRadius = std::max(radius, 0);
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetTlasShellRadius(
+    JNIEnv *, jclass, jint radius, jboolean write) {
+    Renderer::options.tlasShellRadius = std::max(radius, 0);
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetTlasCullBehindCamera(
+    JNIEnv *, jclass, jboolean enabled, jboolean write) {
+    Renderer::options.tlasCullBehindCamera = enabled;
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetTlasFarMaskDistance(
+    JNIEnv *, jclass, jint distance, jboolean write) {
+    Renderer::options.tlasFarMaskDistance = std::max(distance, 0);
+}
+
+// --- Distant Chunk LOD ---
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetChunkLodEnabled(
+    JNIEnv *, jclass, jboolean enabled, jboolean write) {
+    Renderer::options.chunkLodEnabled = enabled;
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetChunkLodDistance(
+    JNIEnv *, jclass, jint distance, jboolean write) {
+    Renderer::options.chunkLodDistance = std::max(distance, 1);
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetChunkLodHysteresis(
+    JNIEnv *, jclass, jint hysteresis, jboolean write) {
+    Renderer::options.chunkLodHysteresis = std::max(hysteresis, 0);
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetChunkLodCellSize(
+    JNIEnv *, jclass, jint cellSize, jboolean write) {
+    // a power of two dividing the 16 block section
+    uint32_t size = 1;
+    while (size < 8 && size * 2 <= static_cast<uint32_t>(std::max(cellSize, 1))) size *= 2;
+    Renderer::options.chunkLodCellSize = size;
+}
+
+// --- Chunk Greedy Merge ---
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetChunkGreedyMerge(
+    JNIEnv *, jclass, jboolean enabled, jboolean write) {
+    Renderer::options.chunkGreedyMerge = enabled;
+}
+
+// --- Chunk Region Merge ---
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetChunkRegionMerge(
+    JNIEnv *, jclass, jboolean enabled, jboolean write) {
+    // regions are dropped by Chunks::updateRegions the next frame
+    Renderer::options.chunkRegionMerge = enabled;
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetChunkRegionDistance(
+    JNIEnv *, jclass, jint distance, jboolean write) {
+    Renderer::options.chunkRegionDistance = std::max(distance, 1);
+}
+
+// --- Sky Cube Map ---
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetSkyFacesPerFrame(
+    JNIEnv *, jclass, jint faces, jboolean write) {
+    Renderer::options.skyFacesPerFrame = static_cast<uint32_t>(std::clamp(faces, 1, 6));
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetSkyFaceBlend(
+    JNIEnv *, jclass, jfloat blend, jboolean write) {
+    Renderer::options.skyFaceBlend = std::clamp(blend, 0.05f, 1.0f);
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetSkyCubeMapLowRes(
+    JNIEnv *, jclass, jboolean enabled, jboolean write) {
+    Renderer::options.skyCubeMapLowRes = enabled;
+    // the cube map is allocated when the world pipeline is built
+    if (write) Renderer::options.needRecreate = true;
+}
+
+// --- Variable Rate Tracing ---
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetVariableRateTracing(
+    JNIEnv *, jclass, jint mode, jboolean write) {
+    Renderer::options.variableRateTracing = static_cast<uint32_t>(std::clamp(mode, 0, 2));
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetVariableRateThreshold(
+    JNIEnv *, jclass, jfloat threshold, jboolean write) {
+    Renderer::options.variableRateThreshold = std::clamp(threshold, 0.0f, 4.0f);
+}
+
+// --- Adaptive Bounces ---
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetAdaptiveBounces(
+    JNIEnv *, jclass, jboolean enabled, jboolean write) {
+    Renderer::options.adaptiveBounces = enabled;
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetBounceTargetMs(
+    JNIEnv *, jclass, jfloat targetMs, jboolean write) {
+    Renderer::options.bounceTargetMs = std::max(targetMs, 0.0f);
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetBounceRayBudget(
+    JNIEnv *, jclass, jfloat raysPerPixel, jboolean write) {
+    Renderer::options.bounceRayBudget = std::max(raysPerPixel, 0.0f);
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetBounceThroughputCutoff(
+    JNIEnv *, jclass, jfloat cutoff, jboolean write) {
+    Renderer::options.bounceThroughputCutoff = std::clamp(cutoff, 0.0f, 1.0f);
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetBounceRoughnessCutoff(
+    JNIEnv *, jclass, jfloat cutoff, jboolean write) {
+    Renderer::options.bounceRoughnessCutoff = std::clamp(cutoff, 0.0f, 1.0f);
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_option_Options_nativeSetRoughPathBounces(
+    JNIEnv *, jclass, jint bounces, jboolean write) {
+    Renderer::options.roughPathBounces = static_cast<uint32_t>(std::max(bounces, 0));
+}
+
+extern "C" JNIEXPORT jint JNICALL Java_com_radiance_client_option_Options_nativeGetBounceLimit(
+    JNIEnv *, jclass) {
+    return static_cast<jint>(Renderer::bounceStats.bounceLimit);
+}
+
+extern "C" JNIEXPORT jfloat JNICALL Java_com_radiance_client_option_Options_nativeGetBounceTraceMs(
+    JNIEnv *, jclass) {
+    return Renderer::bounceStats.traceMs;
+}
+
+extern "C" JNIEXPORT jfloat JNICALL Java_com_radiance_client_option_Options_nativeGetBounceRaysPerPixel(
+    JNIEnv *, jclass) {
+    return Renderer::bounceStats.raysPerPixel;
+}
+
+extern "C" JNIEXPORT jfloat JNICALL Java_com_radiance_client_option_Options_nativeGetBounceCutPathFraction(
+    JNIEnv *, jclass) {
+    return Renderer::bounceStats.cutPathFraction;
+}
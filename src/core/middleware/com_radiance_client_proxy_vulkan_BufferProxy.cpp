@@ -35,6 +35,16 @@ extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_vulkan_BufferPr
     buffers->queueOverlayUpload(reinterpret_cast<uint8_t *>(ptr), dstId);
 }
 
+extern "C" JNIEXPORT jobject JNICALL Java_com_radiance_client_proxy_vulkan_BufferProxy_mappedBuffer(JNIEnv *env,
+                                                                                         jclass,
+                                                                                         jint id) {
+    auto buffers = Renderer::instance().buffers();
+    if (buffers == nullptr) return nullptr;
+    void *mapped = buffers->mappedOverlayBuffer(id);
+    if (mapped == nullptr) return nullptr;
+    return env->NewDirectByteBuffer(mapped, buffers->getBuffer(id).size);
+}
+
 extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_vulkan_BufferProxy_performQueuedUpload(JNIEnv *, jclass) {
     auto buffers = Renderer::instance().buffers();
     if (buffers == nullptr) return;
@@ -2,8 +2,10 @@
 
 #include "core/all_extern.hpp"
 #include "core/render/buffers.hpp"
+#include "core/render/build_trace.hpp"
 #include "core/render/modules/ui_module.hpp"
 #include "core/render/pipeline.hpp"
+#include "core/render/profiler.hpp"
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 #include "core/render/textures.hpp"
@@ -11,6 +13,7 @@
 
 #include <atomic>
 #include <mutex>
+#include <sstream>
 
 #if defined(_WIN32)
 #    include <windows.h>
@@ -183,8 +186,8 @@ extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_vulkan_Renderer
     if (!rendererUsable()) return;
     auto framework = Renderer::instance().framework();
     if (framework == nullptr) return;
-    auto vertexBuffer = Renderer::instance().buffers()->getBuffer(vertexId);
-    auto indexBuffer = Renderer::instance().buffers()->getBuffer(indexId);
+    auto &vertexBuffer = Renderer::instance().buffers()->getBuffer(vertexId);
+    auto &indexBuffer = Renderer::instance().buffers()->getBuffer(indexId);
     auto context = framework->safeAcquireCurrentContext();
     auto pipelineContext = framework->pipeline()->acquirePipelineContext(context);
     pipelineContext->uiModuleContext->drawIndexed(vertexBuffer, indexBuffer,
@@ -257,3 +260,94 @@ extern "C" JNIEXPORT jint JNICALL Java_com_radiance_client_proxy_vulkan_Renderer
         withUI, width, height, reinterpret_cast<void *>(pointer), byteSize);
     return static_cast<jint>(format);
 }
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_radiance_client_proxy_vulkan_RendererProxy_setProfilingEnabled(JNIEnv *, jclass, jboolean enabled) {
+    std::lock_guard<std::recursive_mutex> guard(g_rendererJniMtx);
+    if (!rendererUsable()) return;
+    auto framework = Renderer::instance().framework();
+    if (framework == nullptr) return;
+    framework->profiler()->setEnabled(enabled);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_radiance_client_proxy_vulkan_RendererProxy_setProfilerTraceCapture(JNIEnv *, jclass, jboolean capture) {
+    std::lock_guard<std::recursive_mutex> guard(g_rendererJniMtx);
+    if (!rendererUsable()) return;
+    auto framework = Renderer::instance().framework();
+    if (framework == nullptr) return;
+    framework->profiler()->setTraceCapture(capture);
+}
+
+// one line per scope: name, "gpu" or "cpu", sample count, avg, p95 and p99 in milliseconds, tab separated
+extern "C" JNIEXPORT jstring JNICALL Java_com_radiance_client_proxy_vulkan_RendererProxy_queryProfilerStats(JNIEnv *env,
+                                                                                                          jclass) {
+    std::lock_guard<std::recursive_mutex> guard(g_rendererJniMtx);
+    std::ostringstream out;
+    auto framework = rendererUsable() ? Renderer::instance().framework() : nullptr;
+    if (framework != nullptr) {
+        out.setf(std::ios::fixed);
+        out.precision(3);
+        for (const auto &stat : framework->profiler()->stats()) {
+            out << stat.name << '\t' << (stat.gpu ? "gpu" : "cpu") << '\t' << stat.sampleCount << '\t' << stat.avgMs
+                << '\t' << stat.p95Ms << '\t' << stat.p99Ms << '\n';
+        }
+    }
+    return env->NewStringUTF(out.str().c_str());
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_radiance_client_proxy_vulkan_RendererProxy_dumpProfilerTrace(JNIEnv *env, jclass, jstring path) {
+    std::lock_guard<std::recursive_mutex> guard(g_rendererJniMtx);
+    if (!rendererUsable()) return JNI_FALSE;
+    auto framework = Renderer::instance().framework();
+    if (framework == nullptr) return JNI_FALSE;
+
+    const char *pathChars = env->GetStringUTFChars(path, nullptr);
+    bool written = framework->profiler()->dumpChromeTrace(pathChars);
+    env->ReleaseStringUTFChars(path, pathChars);
+    return written ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_radiance_client_proxy_vulkan_RendererProxy_startBuildTraceRecording(JNIEnv *env, jclass, jstring path) {
+    std::lock_guard<std::recursive_mutex> guard(g_rendererJniMtx);
+    if (!rendererUsable()) return JNI_FALSE;
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return JNI_FALSE;
+
+    const char *pathChars = env->GetStringUTFChars(path, nullptr);
+    bool started = world->buildTraceRecorder()->start(pathChars);
+    env->ReleaseStringUTFChars(path, pathChars);
+    return started ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_vulkan_RendererProxy_stopBuildTraceRecording(JNIEnv *,
+                                                                                                            jclass) {
+    std::lock_guard<std::recursive_mutex> guard(g_rendererJniMtx);
+    if (!rendererUsable()) return;
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return;
+    world->buildTraceRecorder()->stop();
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_radiance_client_proxy_vulkan_RendererProxy_startBuildTraceReplay(JNIEnv *env, jclass, jstring path) {
+    std::lock_guard<std::recursive_mutex> guard(g_rendererJniMtx);
+    if (!rendererUsable()) return JNI_FALSE;
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return JNI_FALSE;
+
+    const char *pathChars = env->GetStringUTFChars(path, nullptr);
+    bool started = world->startBuildTraceReplay(pathChars);
+    env->ReleaseStringUTFChars(path, pathChars);
+    return started ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_radiance_client_proxy_vulkan_RendererProxy_queryBuildTraceReplayReport(JNIEnv *env, jclass) {
+    std::lock_guard<std::recursive_mutex> guard(g_rendererJniMtx);
+    auto world = rendererUsable() ? Renderer::instance().world() : nullptr;
+    std::string report = world != nullptr ? world->buildTraceReplayReport() : std::string();
+    return env->NewStringUTF(report.c_str());
+}
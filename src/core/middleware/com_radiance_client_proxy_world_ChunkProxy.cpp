@@ -1,12 +1,15 @@
 #include "com_radiance_client_proxy_world_ChunkProxy.h"
 
+#include "core/render/build_trace.hpp"
 #include "core/render/chunks.hpp"
 #include "core/render/renderer.hpp"
 
 #include <iostream>
 
 extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_world_ChunkProxy_initNative(JNIEnv *, jclass, jint chunkNum) {
-    Renderer::instance().world()->chunks()->reset(chunkNum);
+    auto world = Renderer::instance().world();
+    if (world->buildTraceRecorder()->recording()) world->buildTraceRecorder()->recordResetChunks(chunkNum);
+    world->chunks()->reset(chunkNum);
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_world_ChunkProxy_rebuildSingle(JNIEnv *,
@@ -24,7 +27,7 @@ extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_world_ChunkProx
                                                                                      jboolean important) {
     auto world = Renderer::instance().world();
     if (world == nullptr) return;
-    world->chunks()->queueChunkBuild(ChunkBuildTask{
+    ChunkBuildTask task{
         .x = originX,
         .y = originY,
         .z = originZ,
@@ -36,7 +39,85 @@ extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_world_ChunkProx
         .vertexCounts = reinterpret_cast<int *>(vertexCounts),
         .vertices = reinterpret_cast<vk::VertexFormat::PBRTriangle **>(vertexAddrs),
         .isImportant = static_cast<bool>(important),
-    });
+    };
+    if (world->buildTraceRecorder()->recording()) world->buildTraceRecorder()->recordChunkRebuild(task);
+    world->chunks()->queueChunkBuild(task);
+}
+
+extern "C" JNIEXPORT jlong JNICALL Java_com_radiance_client_proxy_world_ChunkProxy_allocateStagingSlab(JNIEnv *,
+                                                                                            jclass,
+                                                                                            jlong vertexBytes) {
+    auto world = Renderer::instance().world();
+    if (world == nullptr || vertexBytes <= 0) return -1;
+    return world->chunks()->allocateStagingSlab(vertexBytes);
+}
+
+extern "C" JNIEXPORT jobject JNICALL Java_com_radiance_client_proxy_world_ChunkProxy_stagingSlabBuffer(JNIEnv *env,
+                                                                                           jclass,
+                                                                                           jlong slabId) {
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return nullptr;
+    auto slab = world->chunks()->stagingSlab(slabId);
+    if (slab == nullptr) return nullptr;
+    // only the vertex region is exposed, the index region behind it is filled natively on commit
+    return env->NewDirectByteBuffer(slab->buffer->mappedPtr(), static_cast<jlong>(slab->vertexCapacity));
+}
+
+extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_world_ChunkProxy_releaseStagingSlab(JNIEnv *,
+                                                                                         jclass,
+                                                                                         jlong slabId) {
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return;
+    world->chunks()->releaseStagingSlab(slabId);
+}
+
+// false if the slab was rejected, Java keeps the slab and falls back to rebuildSingle
+extern "C" JNIEXPORT jboolean JNICALL Java_com_radiance_client_proxy_world_ChunkProxy_rebuildSingleFromSlab(JNIEnv *,
+                                                                                            jclass,
+                                                                                            jint originX,
+                                                                                            jint originY,
+                                                                                            jint originZ,
+                                                                                            jlong index,
+                                                                                            jint geometryCount,
+                                                                                            jlong geometryTypes,
+                                                                                            jlong geometryTextures,
+                                                                                            jlong vertexFormats,
+                                                                                            jlong vertexCounts,
+                                                                                            jlong slabId,
+                                                                                            jboolean important) {
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return false;
+    ChunkBuildTask task{
+        .x = originX,
+        .y = originY,
+        .z = originZ,
+        .id = index,
+        .geometryCount = geometryCount,
+        .geometryTypes = reinterpret_cast<int *>(geometryTypes),
+        .geometryTextures = reinterpret_cast<int *>(geometryTextures),
+        .vertexFormats = reinterpret_cast<int *>(vertexFormats),
+        .vertexCounts = reinterpret_cast<int *>(vertexCounts),
+        .vertices = nullptr,
+        .isImportant = static_cast<bool>(important),
+        .stagingSlab = slabId,
+    };
+    if (world->buildTraceRecorder()->recording()) {
+        // traces do not know about slabs, the vertices are recorded as if they came from the heap path. A task that
+        // does not fit its slab is rejected by queueChunkBuild and not recorded
+        auto slab = world->chunks()->stagingSlab(slabId);
+        bool fits = slab != nullptr;
+        size_t vertexBytes = 0;
+        for (int i = 0; fits && i < geometryCount; i++) {
+            fits = task.vertexCounts[i] >= 0;
+            vertexBytes += static_cast<size_t>(task.vertexCounts[i]) * sizeof(vk::VertexFormat::PBRTriangle);
+        }
+        if (fits && vertexBytes <= slab->vertexCapacity) {
+            world->buildTraceRecorder()->recordChunkRebuild(task,
+                                                            static_cast<const uint8_t *>(slab->buffer->mappedPtr()));
+        }
+    }
+    // ownership of the slab moves to the build, Java must not touch its ByteBuffer afterwards unless it was rejected
+    return world->chunks()->queueChunkBuild(task);
 }
 
 extern "C" JNIEXPORT jboolean JNICALL Java_com_radiance_client_proxy_world_ChunkProxy_isChunkReady(JNIEnv *, jclass, jlong id) {
@@ -50,6 +131,7 @@ extern "C" JNIEXPORT jboolean JNICALL Java_com_radiance_client_proxy_world_Chunk
 extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_world_ChunkProxy_invalidateSingle(JNIEnv *, jclass, jlong index) {
     auto world = Renderer::instance().world();
     if (world == nullptr) return;
+    if (world->buildTraceRecorder()->recording()) world->buildTraceRecorder()->recordChunkInvalidate(index);
     world->chunks()->invalidateChunk(index);
 }
 
@@ -71,5 +153,6 @@ extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_world_ChunkProx
             ptr += 16;
         }
     }
+    if (world->buildTraceRecorder()->recording()) world->buildTraceRecorder()->recordChunkLights(chunkIndex, lights);
     world->chunks()->setChunkLights(chunkIndex, lights);
 }
\ No newline at end of file
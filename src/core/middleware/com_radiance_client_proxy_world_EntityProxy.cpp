@@ -1,5 +1,6 @@
 #include "com_radiance_client_proxy_world_EntityProxy.h"
 
+#include "core/render/build_trace.hpp"
 #include "core/render/entities.hpp"
 #include "core/render/renderer.hpp"
 
@@ -25,7 +26,7 @@ extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_world_EntityPro
                                                                                    jlong vertices) {
     auto world = Renderer::instance().world();
     if (world == nullptr) return;
-    world->entities()->queueBuild(EntitiesBuildTask{
+    EntitiesBuildTask task{
         .lineWidth = lineWidth,
         .coordinate = static_cast<World::Coordinates>(coordinate),
         .normalOffset = static_cast<bool>(normalOffset),
@@ -44,7 +45,9 @@ extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_world_EntityPro
         .indexFormats = reinterpret_cast<int *>(indexFormats),
         .vertexCounts = reinterpret_cast<int *>(vertexCounts),
         .vertices = reinterpret_cast<void **>(vertices),
-    });
+    };
+    if (world->buildTraceRecorder()->recording()) world->buildTraceRecorder()->recordEntityBuild(task);
+    world->entities()->queueBuild(task);
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_radiance_client_proxy_world_EntityProxy_build(JNIEnv *, jclass) {
@@ -4,10 +4,13 @@
 #include "common/shared.hpp"
 #include "core/render/modules/ui_module.hpp"
 #include "core/render/pipeline.hpp"
+#include "core/render/quad_indices.hpp"
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 #include "core/render/world.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <random>
 
 std::ostream &buffersCout() {
@@ -21,8 +24,8 @@ std::ostream &buffersCerr() {
 Buffers::Buffers(std::shared_ptr<Framework> framework) {
     uint32_t size = framework->swapchain()->imageCount();
 
-    validOverlayIndex_.resize(size);
-    overlayIndexVertexBuffer_.resize(size);
+    overlayRanges_.resize(size);
+    overlayArenas_.resize(size);
 
     overlayDrawUniformBuffer_.resize(size);
     overlayPostUniformBuffer_.resize(size);
@@ -39,8 +42,31 @@ void Buffers::resetFrame() {
     auto framework = Renderer::instance().framework();
     auto context = framework->safeAcquireCurrentContext();
     auto &gc = framework->gc();
+    auto device = framework->device();
+    auto vma = framework->vma();
+
+    // the arena of this frame index is free again, size it from the peak usage of the recent frames
+    auto &arena = overlayArenas_[context->frameIndex];
+    VkDeviceSize used = 0, capacity = 0;
+    for (auto &block : arena) {
+        used += block.head;
+        capacity += block.buffer->size();
+    }
+    overlayArenaHighWater_[overlayArenaHistoryIndex_] = used;
+    overlayArenaHistoryIndex_ = (overlayArenaHistoryIndex_ + 1) % overlayArenaHistoryFrames;
+
+    VkDeviceSize highWater = *std::max_element(overlayArenaHighWater_.begin(), overlayArenaHighWater_.end());
+    VkDeviceSize target = overlayArenaMinBlockSize;
+    while (target < highWater + highWater / 4) target *= 2;
 
-    validOverlayIndex_[context->frameIndex].clear();
+    if (arena.size() != 1 || capacity < target || capacity > target * 4) {
+        for (auto &block : arena) gc.collect(block.buffer);
+        arena.clear();
+        arena.push_back({vk::DeviceLocalBuffer::create(vma, device, target, overlayArenaUsage), 0});
+    } else {
+        arena[0].head = 0;
+    }
+    overlayRanges_[context->frameIndex].clear();
 
     overlayNextID_ = 0;
 
@@ -57,73 +83,102 @@ void Buffers::resetFrame() {
 uint32_t Buffers::allocateBuffer() {
     auto context = Renderer::instance().framework()->safeAcquireCurrentContext();
 
-    validOverlayIndex_[context->frameIndex].insert(std::make_pair(overlayNextID_, -1));
-    auto it = overlayIndexVertexBuffer_[context->frameIndex].find(overlayNextID_);
-    if (it == overlayIndexVertexBuffer_[context->frameIndex].end()) {
-        overlayIndexVertexBuffer_[context->frameIndex].emplace(std::make_pair(overlayNextID_, nullptr));
-    }
+    overlayRanges_[context->frameIndex].emplace_back();
     return overlayNextID_++;
 }
 
-void Buffers::initializeBuffer(uint32_t id, uint32_t size, VkBufferUsageFlags usageFlags) {
+OverlayBufferRange &Buffers::overlayRange(uint32_t id) {
+    auto context = Renderer::instance().framework()->safeAcquireCurrentContext();
+
+    if (id >= overlayRanges_[context->frameIndex].size()) {
+        buffersCerr() << "The given buffer id: " << id << " is not allocated for buffer" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return overlayRanges_[context->frameIndex][id];
+}
+
+// the arena space is only claimed once data is written, ids turned into quad index buffers never need any
+OverlayBufferRange &Buffers::materializeOverlayRange(uint32_t id) {
     auto framework = Renderer::instance().framework();
     auto context = framework->safeAcquireCurrentContext();
 
-    auto frameIndex = framework->safeAcquireCurrentContext()->frameIndex;
-    auto device = framework->device();
-    auto vma = framework->vma();
+    auto &range = overlayRange(id);
+    if (range.buffer != nullptr || range.size == 0) return range;
 
-    auto bufferIter = overlayIndexVertexBuffer_[context->frameIndex].find(id);
-    if (!validOverlayIndex_[context->frameIndex].contains(id) ||
-        bufferIter == overlayIndexVertexBuffer_[context->frameIndex].end()) {
-        buffersCerr() << "The given buffer id: " << id << " is not allocated for buffer" << std::endl;
-        exit(EXIT_FAILURE);
+    auto &arena = overlayArenas_[context->frameIndex];
+    if (arena.empty()) {
+        arena.push_back({vk::DeviceLocalBuffer::create(framework->vma(), framework->device(), overlayArenaMinBlockSize,
+                                                       overlayArenaUsage),
+                         0});
+    }
+    auto &block = arena.back();
+    VkDeviceSize offset = (block.head + overlayArenaAlignment - 1) & ~(overlayArenaAlignment - 1);
+    if (offset + range.size > block.buffer->size()) {
+        VkDeviceSize blockSize = block.buffer->size() * 2;
+        while (blockSize < range.size) blockSize *= 2;
+        arena.push_back(
+            {vk::DeviceLocalBuffer::create(framework->vma(), framework->device(), blockSize, overlayArenaUsage), 0});
+        offset = 0;
     }
 
-    validOverlayIndex_[context->frameIndex].at(id) = size;
+    auto &target = arena.back();
+    range.buffer = target.buffer;
+    range.offset = offset;
+    target.head = offset + range.size;
+    return range;
+}
 
-    auto buffer = overlayIndexVertexBuffer_[context->frameIndex].contains(id) ?
-                      overlayIndexVertexBuffer_[context->frameIndex].at(id) :
-                      nullptr;
-    uint32_t currentSize = buffer == nullptr ? baseBlockSize : buffer->size();
-    while (currentSize < size) currentSize *= 2;
-    if (buffer == nullptr || currentSize != buffer->size()) {
-        framework->gc().collect(buffer);
-        overlayIndexVertexBuffer_[context->frameIndex].at(id) =
-            vk::DeviceLocalBuffer::create(vma, device, currentSize, usageFlags);
+void Buffers::initializeBuffer(uint32_t id, uint32_t size, VkBufferUsageFlags usageFlags) {
+    Renderer::instance().framework()->safeAcquireCurrentContext();
+
+    if ((usageFlags & ~(overlayArenaUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT)) != 0) {
+        buffersCerr() << "The given usage flags: " << usageFlags << " are not supported by the overlay arena"
+                      << std::endl;
     }
+
+    auto &range = overlayRange(id);
+    range = {.size = size};
 }
 
-void Buffers::buildIndexBuffer(uint32_t dstId, int type, int drawMode, int vertexCount, int expectedIndexCount) {
-    auto buildQuadIndices = [this, dstId, vertexCount, expectedIndexCount]<typename V>() {
-        int indexCount = vertexCount / 4 * 6;
-        if (indexCount != expectedIndexCount) { throw std::runtime_error("index count not match!"); }
-
-        std::vector<V> indices;
-        for (int i = 0; i < vertexCount; i += 4) {
-            indices.push_back(i + 0);
-            indices.push_back(i + 1);
-            indices.push_back(i + 2);
-            indices.push_back(i + 2);
-            indices.push_back(i + 3);
-            indices.push_back(i + 0);
-        }
+void Buffers::ensureQuadIndexBuffer(int type, uint32_t vertexCount) {
+    auto framework = Renderer::instance().framework();
+
+    auto &buffer = quadIndexBuffers_[type];
+    size_t indexSize = type == 0 ? sizeof(uint16_t) : sizeof(uint32_t);
+    size_t capacity = buffer == nullptr ? 0 : buffer->size() / indexSize / 6 * 4;
+    if (capacity >= vertexCount) return;
 
-        queueOverlayUpload(reinterpret_cast<uint8_t *>(indices.data()), dstId);
-    };
+    capacity = std::max<size_t>(capacity, 4096);
+    while (capacity < vertexCount) capacity *= 2;
 
+    framework->gc().collect(buffer);
+    buffer = vk::DeviceLocalBuffer::create(framework->vma(), framework->device(), capacity / 4 * 6 * indexSize,
+                                           VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+    if (type == 0) {
+        fillQuadIndices(static_cast<uint16_t *>(buffer->mappedPtr()), capacity);
+    } else {
+        fillQuadIndices(static_cast<uint32_t *>(buffer->mappedPtr()), capacity);
+    }
+    buffer->flushStagingBuffer();
+    pendingQuadIndexUploads_.push_back(buffer);
+}
+
+void Buffers::buildIndexBuffer(uint32_t dstId, int type, int drawMode, int vertexCount, int expectedIndexCount) {
     switch (drawMode) {
         case 7: {
-            switch (type) {
-                case 0: {
-                    buildQuadIndices.template operator()<uint16_t>();
-                    break;
-                }
-                case 1: {
-                    buildQuadIndices.template operator()<uint32_t>();
-                    break;
-                }
-            }
+            int indexCount = vertexCount / 4 * 6;
+            if (indexCount != expectedIndexCount) { throw std::runtime_error("index count not match!"); }
+            if (type != 0 && type != 1) break;
+
+            // every quad index buffer is a prefix of the same pattern, so all of them share one buffer
+            ensureQuadIndexBuffer(type, vertexCount);
+            overlayRange(dstId) = {
+                .buffer = quadIndexBuffers_[type],
+                .offset = 0,
+                .size = quadIndexBuffers_[type]->size(),
+                .sequentialQuads = true,
+            };
             break;
         }
 
@@ -135,14 +190,18 @@ void Buffers::buildIndexBuffer(uint32_t dstId, int type, int drawMode, int verte
 }
 
 void Buffers::queueOverlayUpload(uint8_t *srcPointer, uint32_t dstId) {
-    auto context = Renderer::instance().framework()->safeAcquireCurrentContext();
-    auto buffer = overlayIndexVertexBuffer_[context->frameIndex].at(dstId);
-    if (validOverlayIndex_[context->frameIndex].contains(dstId) && buffer != nullptr) {
-        auto size = validOverlayIndex_[context->frameIndex].at(dstId);
-        if (size > 0) { buffer->uploadToStagingBuffer(srcPointer, size, 0); }
+    auto &range = materializeOverlayRange(dstId);
+    if (range.buffer != nullptr && !range.sequentialQuads && range.size > 0) {
+        std::memcpy(static_cast<uint8_t *>(range.buffer->mappedPtr()) + range.offset, srcPointer, range.size);
     }
 }
 
+void *Buffers::mappedOverlayBuffer(uint32_t id) {
+    auto &range = materializeOverlayRange(id);
+    if (range.buffer == nullptr || range.sequentialQuads) return nullptr;
+    return static_cast<uint8_t *>(range.buffer->mappedPtr()) + range.offset;
+}
+
 void Buffers::queueImportantWorldUpload(std::shared_ptr<vk::DeviceLocalBuffer> vertexBuffer,
                                         std::shared_ptr<vk::DeviceLocalBuffer> indexBuffer) {
     Renderer::instance().framework()->safeAcquireCurrentContext();
@@ -161,8 +220,14 @@ void Buffers::performQueuedUpload() {
 
     std::vector<vk::CommandBuffer::BufferMemoryBarrier> uploadPreBufferBarriers, uploadPostBufferBarriers;
 
-    for (auto [bufferId, size] : validOverlayIndex_[frameIndex]) {
-        auto buffer = overlayIndexVertexBuffer_[frameIndex].at(bufferId);
+    std::vector<std::pair<std::shared_ptr<vk::DeviceLocalBuffer>, VkDeviceSize>> overlayUploads;
+    for (auto &block : overlayArenas_[frameIndex]) {
+        if (block.head > 0) overlayUploads.emplace_back(block.buffer, block.head);
+    }
+    for (auto &buffer : pendingQuadIndexUploads_) overlayUploads.emplace_back(buffer, buffer->size());
+    pendingQuadIndexUploads_.clear();
+
+    for (auto [buffer, size] : overlayUploads) {
         uploadPreBufferBarriers.push_back({
             .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
             .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
@@ -171,6 +236,7 @@ void Buffers::performQueuedUpload() {
             .srcQueueFamilyIndex = mainQueueIndex,
             .dstQueueFamilyIndex = mainQueueIndex,
             .buffer = buffer,
+            .size = size,
         });
         uploadPostBufferBarriers.push_back({
             .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
@@ -181,6 +247,7 @@ void Buffers::performQueuedUpload() {
             .srcQueueFamilyIndex = mainQueueIndex,
             .dstQueueFamilyIndex = mainQueueIndex,
             .buffer = buffer,
+            .size = size,
         });
     }
 
@@ -210,9 +277,9 @@ void Buffers::performQueuedUpload() {
 
     cmdBuffer->barriersBufferImage(uploadPreBufferBarriers, {});
 
-    for (auto [bufferId, size] : validOverlayIndex_[frameIndex]) {
-        auto buffer = overlayIndexVertexBuffer_[frameIndex].at(bufferId);
-        if (size > 0) { buffer->uploadToBuffer(cmdBuffer, size, 0, 0); }
+    for (auto [buffer, size] : overlayUploads) {
+        buffer->flushStagingBuffer();
+        buffer->uploadToBuffer(cmdBuffer, size, 0, 0);
     }
 
     for (auto buffer : *importantIndexVertexBuffer_) {
@@ -465,17 +532,8 @@ int Buffers::getPostID() {
     return overlayPostUniformQueue_->size() - 1;
 }
 
-std::shared_ptr<vk::DeviceLocalBuffer> Buffers::getBuffer(uint32_t id) {
-    auto context = Renderer::instance().framework()->safeAcquireCurrentContext();
-
-    auto bufferIter = overlayIndexVertexBuffer_[context->frameIndex].find(id);
-    if (!validOverlayIndex_[context->frameIndex].contains(id) ||
-        bufferIter == overlayIndexVertexBuffer_[context->frameIndex].end()) {
-        buffersCerr() << "The given buffer id: " << id << " is not allocated for buffer" << std::endl;
-        exit(EXIT_FAILURE);
-    }
-
-    return bufferIter->second;
+OverlayBufferRange &Buffers::getBuffer(uint32_t id) {
+    return materializeOverlayRange(id);
 }
 
 std::shared_ptr<vk::HostVisibleBuffer> Buffers::overlayDrawUniformBuffer() {
@@ -6,12 +6,26 @@
 #include "core/all_extern.hpp"
 #include "core/vulkan/all_core_vulkan.hpp"
 
+#include <array>
 #include <map>
 #include <set>
 #include <vector>
 
 class Framework;
 
+// an aligned sub-range of a per-frame overlay arena block, or of the shared quad index buffer
+struct OverlayBufferRange {
+    std::shared_ptr<vk::DeviceLocalBuffer> buffer;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    bool sequentialQuads = false; // indices are the shared 0,1,2,2,3,0 quad pattern starting at vertex 0
+};
+
+struct OverlayArenaBlock {
+    std::shared_ptr<vk::DeviceLocalBuffer> buffer;
+    VkDeviceSize head = 0;
+};
+
 class Buffers : public SharedObject<Buffers> {
   public:
     Buffers(std::shared_ptr<Framework> framework);
@@ -21,6 +35,7 @@ class Buffers : public SharedObject<Buffers> {
     void initializeBuffer(uint32_t id, uint32_t size, VkBufferUsageFlags usageFlags);
     void buildIndexBuffer(uint32_t dstId, int type, int drawMode, int vertexCount, int expectedIndexCount);
     void queueOverlayUpload(uint8_t *srcPointer, uint32_t dstId);
+    void *mappedOverlayBuffer(uint32_t id);
     void queueImportantWorldUpload(std::shared_ptr<vk::DeviceLocalBuffer> vertexBuffer,
                                    std::shared_ptr<vk::DeviceLocalBuffer> indexBuffer);
     void performQueuedUpload();
@@ -38,7 +53,7 @@ class Buffers : public SharedObject<Buffers> {
     int getDrawID();
     int getPostID();
 
-    std::shared_ptr<vk::DeviceLocalBuffer> getBuffer(uint32_t id);
+    OverlayBufferRange &getBuffer(uint32_t id);
 
     std::shared_ptr<vk::HostVisibleBuffer> overlayDrawUniformBuffer();
     std::shared_ptr<vk::HostVisibleBuffer> overlayPostUniformBuffer();
@@ -54,9 +69,22 @@ class Buffers : public SharedObject<Buffers> {
 
   private:
     static constexpr uint32_t baseBlockSize = 16 * 1024;
-
-    std::vector<std::map<uint32_t, int32_t>> validOverlayIndex_;
-    std::vector<std::map<uint32_t, std::shared_ptr<vk::DeviceLocalBuffer>>> overlayIndexVertexBuffer_;
+    static constexpr VkDeviceSize overlayArenaAlignment = 16;
+    static constexpr VkDeviceSize overlayArenaMinBlockSize = 1024 * 1024;
+    static constexpr uint32_t overlayArenaHistoryFrames = 16;
+    static constexpr VkBufferUsageFlags overlayArenaUsage =
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+    OverlayBufferRange &overlayRange(uint32_t id);
+    OverlayBufferRange &materializeOverlayRange(uint32_t id);
+    void ensureQuadIndexBuffer(int type, uint32_t vertexCount);
+
+    std::vector<std::vector<OverlayBufferRange>> overlayRanges_; // indexed by buffer id, ids restart every frame
+    std::vector<std::vector<OverlayArenaBlock>> overlayArenas_;
+    std::array<VkDeviceSize, overlayArenaHistoryFrames> overlayArenaHighWater_{};
+    uint32_t overlayArenaHistoryIndex_ = 0;
+    std::array<std::shared_ptr<vk::DeviceLocalBuffer>, 2> quadIndexBuffers_; // uint16 and uint32 quad indices
+    std::vector<std::shared_ptr<vk::DeviceLocalBuffer>> pendingQuadIndexUploads_;
     std::vector<std::shared_ptr<vk::HostVisibleBuffer>> overlayDrawUniformBuffer_;
     std::vector<std::shared_ptr<vk::HostVisibleBuffer>> overlayPostUniformBuffer_;
     uint32_t overlayNextID_;
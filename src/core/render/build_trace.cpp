@@ -0,0 +1,533 @@
+#include "core/render/build_trace.hpp"
+
+#include "core/render/world.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+std::ostream &buildTraceCout() {
+    return std::cout << "[BuildTrace] ";
+}
+
+std::ostream &buildTraceCerr() {
+    return std::cerr << "[BuildTrace] ";
+}
+
+namespace {
+
+double elapsedMs(BuildTraceReplayer::Clock::time_point begin, BuildTraceReplayer::Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+size_t entityGeometryTotal(const int *entityGeometryCounts, int entityCount) {
+    size_t total = 0;
+    for (int i = 0; i < entityCount; i++) total += entityGeometryCounts[i];
+    return total;
+}
+
+} // namespace
+
+ChunkBuildTask BuildTraceRecord::chunkBuildTask() {
+    chunkVertexPointers_.clear();
+    for (auto &vertices : geometryVertices) {
+        chunkVertexPointers_.push_back(reinterpret_cast<vk::VertexFormat::PBRTriangle *>(vertices.data()));
+    }
+
+    return ChunkBuildTask{
+        .x = x,
+        .y = y,
+        .z = z,
+        .id = chunkId,
+        .geometryCount = static_cast<int>(geometryTypes.size()),
+        .geometryTypes = geometryTypes.data(),
+        .geometryTextures = geometryTextures.data(),
+        .vertexFormats = vertexFormats.data(),
+        .vertexCounts = vertexCounts.data(),
+        .vertices = chunkVertexPointers_.data(),
+        .isImportant = important,
+    };
+}
+
+EntitiesBuildTask BuildTraceRecord::entitiesBuildTask() {
+    entityVertexPointers_.clear();
+    for (auto &vertices : geometryVertices) entityVertexPointers_.push_back(vertices.data());
+
+    return EntitiesBuildTask{
+        .lineWidth = lineWidth,
+        .coordinate = coordinate,
+        .normalOffset = normalOffset,
+        .entityCount = static_cast<int>(entityHashCodes.size()),
+        .entityHashCodes = entityHashCodes.data(),
+        .entityXs = entityXs.data(),
+        .entityYs = entityYs.data(),
+        .entityZs = entityZs.data(),
+        .entityRTFlags = entityRTFlags.data(),
+        .entityPrebuiltBLASs = entityPrebuiltBLASs.data(),
+        .entityPosts = entityPosts.data(),
+        .entityGeometryCounts = entityGeometryCounts.data(),
+        .geometryTypes = geometryTypes.data(),
+        .geometryTextures = geometryTextures.data(),
+        .vertexFormats = vertexFormats.data(),
+        .indexFormats = indexFormats.data(),
+        .vertexCounts = vertexCounts.data(),
+        .vertices = entityVertexPointers_.data(),
+    };
+}
+
+bool BuildTraceRecorder::start(const std::string &path) {
+    std::unique_lock<std::mutex> lck(mutex_);
+    if (out_.is_open()) out_.close();
+
+    out_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out_.is_open()) {
+        buildTraceCerr() << "cannot open " << path << " for writing" << std::endl;
+        recording_.store(false, std::memory_order_relaxed);
+        return false;
+    }
+
+    BuildTraceHeader header{};
+    std::memcpy(header.magic, BuildTraceHeader::MAGIC, sizeof(header.magic));
+    header.version = BuildTraceHeader::VERSION;
+    header.optionsSize = sizeof(Options);
+    write(header);
+    write(Renderer::options);
+
+    start_ = Clock::now();
+    recordCount_ = 0;
+    recording_.store(true, std::memory_order_relaxed);
+    buildTraceCout() << "recording to " << path << std::endl;
+    return true;
+}
+
+void BuildTraceRecorder::stop() {
+    std::unique_lock<std::mutex> lck(mutex_);
+    recording_.store(false, std::memory_order_relaxed);
+    if (!out_.is_open()) return;
+
+    out_.close();
+    buildTraceCout() << "recorded " << recordCount_ << " calls" << std::endl;
+}
+
+bool BuildTraceRecorder::recording() {
+    return recording_.load(std::memory_order_relaxed);
+}
+
+void BuildTraceRecorder::beginRecord(BuildTraceRecordType type) {
+    uint64_t timeUs = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start_).count();
+    write(type);
+    write(timeUs);
+    recordCount_++;
+}
+
+void BuildTraceRecorder::writeBytes(const void *data, size_t size) {
+    if (size > 0) out_.write(static_cast<const char *>(data), size);
+}
+
+void BuildTraceRecorder::recordResetChunks(uint32_t chunkCount) {
+    std::unique_lock<std::mutex> lck(mutex_);
+    if (!out_.is_open()) return;
+
+    beginRecord(BuildTraceRecordType::RESET_CHUNKS);
+    write(chunkCount);
+}
+
+void BuildTraceRecorder::recordChunkRebuild(const ChunkBuildTask &task, const uint8_t *slabVertices) {
+    std::unique_lock<std::mutex> lck(mutex_);
+    if (!out_.is_open()) return;
+
+    beginRecord(BuildTraceRecordType::CHUNK_REBUILD);
+    write(task.x);
+    write(task.y);
+    write(task.z);
+    write(task.id);
+    write(static_cast<uint8_t>(task.isImportant));
+    write(task.geometryCount);
+    writeArray(task.geometryTypes, task.geometryCount);
+    writeArray(task.geometryTextures, task.geometryCount);
+    writeArray(task.vertexFormats, task.geometryCount);
+    writeArray(task.vertexCounts, task.geometryCount);
+
+    size_t slabOffset = 0;
+    for (int i = 0; i < task.geometryCount; i++) {
+        size_t size = task.vertexCounts[i] * sizeof(vk::VertexFormat::PBRTriangle);
+        if (slabVertices != nullptr) {
+            writeBytes(slabVertices + slabOffset, size);
+            slabOffset += size;
+        } else {
+            writeBytes(task.vertices[i], size);
+        }
+    }
+}
+
+void BuildTraceRecorder::recordChunkInvalidate(int64_t id) {
+    std::unique_lock<std::mutex> lck(mutex_);
+    if (!out_.is_open()) return;
+
+    beginRecord(BuildTraceRecordType::CHUNK_INVALIDATE);
+    write(id);
+}
+
+void BuildTraceRecorder::recordChunkLights(int64_t id, const std::vector<ChunkLightEntry> &lights) {
+    std::unique_lock<std::mutex> lck(mutex_);
+    if (!out_.is_open()) return;
+
+    beginRecord(BuildTraceRecordType::CHUNK_LIGHTS);
+    write(id);
+    write(static_cast<uint32_t>(lights.size()));
+    writeArray(lights.data(), lights.size());
+}
+
+void BuildTraceRecorder::recordEntityBuild(const EntitiesBuildTask &task) {
+    std::unique_lock<std::mutex> lck(mutex_);
+    if (!out_.is_open()) return;
+
+    beginRecord(BuildTraceRecordType::ENTITY_BUILD);
+    write(task.lineWidth);
+    write(static_cast<int32_t>(task.coordinate));
+    write(static_cast<uint8_t>(task.normalOffset));
+    write(task.entityCount);
+    writeArray(task.entityHashCodes, task.entityCount);
+    writeArray(task.entityXs, task.entityCount);
+    writeArray(task.entityYs, task.entityCount);
+    writeArray(task.entityZs, task.entityCount);
+    writeArray(task.entityRTFlags, task.entityCount);
+    writeArray(task.entityPrebuiltBLASs, task.entityCount);
+    writeArray(task.entityPosts, task.entityCount);
+    writeArray(task.entityGeometryCounts, task.entityCount);
+
+    size_t geometryCount = entityGeometryTotal(task.entityGeometryCounts, task.entityCount);
+    writeArray(task.geometryTypes, geometryCount);
+    writeArray(task.geometryTextures, geometryCount);
+    writeArray(task.vertexFormats, geometryCount);
+    writeArray(task.indexFormats, geometryCount);
+    writeArray(task.vertexCounts, geometryCount);
+
+    for (size_t i = 0; i < geometryCount; i++) {
+        auto vertexFormat = static_cast<World::VertexFormats>(task.vertexFormats[i]);
+        writeBytes(task.vertices[i], task.vertexCounts[i] * Entities::rawVertexStride(vertexFormat));
+    }
+}
+
+void BuildTraceRecorder::recordFrame(glm::dvec3 cameraPos) {
+    std::unique_lock<std::mutex> lck(mutex_);
+    if (!out_.is_open()) return;
+
+    beginRecord(BuildTraceRecordType::FRAME);
+    write(cameraPos.x);
+    write(cameraPos.y);
+    write(cameraPos.z);
+}
+
+bool BuildTraceReader::open(const std::string &path) {
+    in_.open(path, std::ios::in | std::ios::binary);
+    if (!in_.is_open()) {
+        buildTraceCerr() << "cannot open " << path << " for reading" << std::endl;
+        return false;
+    }
+
+    BuildTraceHeader header{};
+    if (!read(header) || std::memcmp(header.magic, BuildTraceHeader::MAGIC, sizeof(header.magic)) != 0) {
+        buildTraceCerr() << path << " is not a build trace" << std::endl;
+        return false;
+    }
+    if (header.version != BuildTraceHeader::VERSION) {
+        buildTraceCerr() << path << " has version " << header.version << ", expected " << BuildTraceHeader::VERSION
+                         << std::endl;
+        return false;
+    }
+
+    optionsCompatible_ = header.optionsSize == sizeof(Options);
+    if (optionsCompatible_) {
+        read(options_);
+    } else {
+        buildTraceCerr() << path << " was recorded with a different Options layout, its options are ignored"
+                         << std::endl;
+        in_.seekg(header.optionsSize, std::ios::cur);
+    }
+    return in_.good();
+}
+
+bool BuildTraceReader::readBytes(void *data, size_t size) {
+    if (size == 0) return true;
+    in_.read(static_cast<char *>(data), size);
+    return static_cast<size_t>(in_.gcount()) == size;
+}
+
+bool BuildTraceReader::next(BuildTraceRecord &record) {
+    record = BuildTraceRecord{};
+    if (!read(record.type) || !read(record.timeUs)) return false;
+
+    switch (record.type) {
+        case BuildTraceRecordType::RESET_CHUNKS: return read(record.chunkCount);
+        case BuildTraceRecordType::CHUNK_REBUILD: {
+            uint8_t important;
+            int geometryCount;
+            if (!read(record.x) || !read(record.y) || !read(record.z) || !read(record.chunkId) || !read(important) ||
+                !read(geometryCount) || geometryCount < 0) {
+                return false;
+            }
+            record.important = important != 0;
+            if (!readVector(record.geometryTypes, geometryCount) ||
+                !readVector(record.geometryTextures, geometryCount) ||
+                !readVector(record.vertexFormats, geometryCount) || !readVector(record.vertexCounts, geometryCount)) {
+                return false;
+            }
+
+            record.geometryVertices.resize(geometryCount);
+            for (int i = 0; i < geometryCount; i++) {
+                if (record.vertexCounts[i] < 0) return false;
+                size_t size = record.vertexCounts[i] * sizeof(vk::VertexFormat::PBRTriangle);
+                if (!readVector(record.geometryVertices[i], size)) return false;
+            }
+            return true;
+        }
+        case BuildTraceRecordType::CHUNK_INVALIDATE: return read(record.chunkId);
+        case BuildTraceRecordType::CHUNK_LIGHTS: {
+            uint32_t lightCount;
+            return read(record.chunkId) && read(lightCount) && readVector(record.lights, lightCount);
+        }
+        case BuildTraceRecordType::ENTITY_BUILD: {
+            int32_t coordinate;
+            uint8_t normalOffset;
+            int entityCount;
+            if (!read(record.lineWidth) || !read(coordinate) || !read(normalOffset) || !read(entityCount) ||
+                entityCount < 0) {
+                return false;
+            }
+            record.coordinate = static_cast<World::Coordinates>(coordinate);
+            record.normalOffset = normalOffset != 0;
+            if (!readVector(record.entityHashCodes, entityCount) || !readVector(record.entityXs, entityCount) ||
+                !readVector(record.entityYs, entityCount) || !readVector(record.entityZs, entityCount) ||
+                !readVector(record.entityRTFlags, entityCount) || !readVector(record.entityPrebuiltBLASs, entityCount) ||
+                !readVector(record.entityPosts, entityCount) || !readVector(record.entityGeometryCounts, entityCount)) {
+                return false;
+            }
+            for (int count : record.entityGeometryCounts) {
+                if (count < 0) return false;
+            }
+
+            size_t geometryCount = entityGeometryTotal(record.entityGeometryCounts.data(), entityCount);
+            if (!readVector(record.geometryTypes, geometryCount) ||
+                !readVector(record.geometryTextures, geometryCount) ||
+                !readVector(record.vertexFormats, geometryCount) || !readVector(record.indexFormats, geometryCount) ||
+                !readVector(record.vertexCounts, geometryCount)) {
+                return false;
+            }
+
+            record.geometryVertices.resize(geometryCount);
+            for (size_t i = 0; i < geometryCount; i++) {
+                if (record.vertexCounts[i] < 0) return false;
+                auto vertexFormat = static_cast<World::VertexFormats>(record.vertexFormats[i]);
+                size_t size = record.vertexCounts[i] * Entities::rawVertexStride(vertexFormat);
+                if (!readVector(record.geometryVertices[i], size)) return false;
+            }
+            return true;
+        }
+        case BuildTraceRecordType::FRAME:
+            return read(record.cameraPos.x) && read(record.cameraPos.y) && read(record.cameraPos.z);
+        default: buildTraceCerr() << "unknown record type " << static_cast<int>(record.type) << std::endl; return false;
+    }
+}
+
+bool BuildTraceReader::optionsCompatible() const {
+    return optionsCompatible_;
+}
+
+const Options &BuildTraceReader::options() const {
+    return options_;
+}
+
+void WorldBuildTraceTarget::resetChunks(uint32_t chunkCount) {
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return;
+    world->chunks()->reset(chunkCount);
+}
+
+void WorldBuildTraceTarget::rebuildChunk(const ChunkBuildTask &task) {
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return;
+    // a trace replayed into a world with fewer chunk slots than it was recorded with drops the extra chunks
+    if (task.id < 0 || task.id >= static_cast<int64_t>(world->chunks()->chunks().size())) return;
+    world->chunks()->queueChunkBuild(task);
+}
+
+void WorldBuildTraceTarget::invalidateChunk(int64_t id) {
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return;
+    if (id < 0 || id >= static_cast<int64_t>(world->chunks()->chunks().size())) return;
+    world->chunks()->invalidateChunk(id);
+}
+
+void WorldBuildTraceTarget::setChunkLights(int64_t id, const std::vector<ChunkLightEntry> &lights) {
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return;
+    world->chunks()->setChunkLights(id, lights);
+}
+
+void WorldBuildTraceTarget::queueEntities(const EntitiesBuildTask &task) {
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return;
+    // Java still calls EntityProxy.build every frame, which picks the replayed entities up together with its own
+    world->entities()->queueBuild(task);
+}
+
+void WorldBuildTraceTarget::endFrame(glm::dvec3) {
+    // the chunk build scheduler runs as part of the live frame, nothing left to drive here
+}
+
+bool WorldBuildTraceTarget::isChunkReady(int64_t id) {
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return false;
+    if (id < 0 || id >= static_cast<int64_t>(world->chunks()->chunks().size())) return false;
+    return world->chunks()->isChunkReady(id);
+}
+
+size_t WorldBuildTraceTarget::queuedChunkCount() {
+    auto world = Renderer::instance().world();
+    if (world == nullptr) return 0;
+    return world->chunks()->queuedChunkCount();
+}
+
+std::string BuildTraceReport::format() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    out << "frames " << frames << ", records " << records << ", chunk builds " << chunkBuilds << ", entity builds "
+        << entityBuilds << "\n";
+    out << "queue depth avg " << avgQueueDepth << ", max " << maxQueueDepth << "\n";
+    out << "time to ready avg " << avgTimeToReadyMs << " ms, p95 " << p95TimeToReadyMs << " ms, max "
+        << maxTimeToReadyMs << " ms, avg " << avgFramesToReady << " frames, max " << maxFramesToReady << " frames ("
+        << chunksReady << " ready, " << chunksNeverReady << " never ready)\n";
+    out << "frame cost avg " << avgFrameCostMs << " ms, max " << maxFrameCostMs << " ms, budget usage avg "
+        << avgBudgetUsage * 100.0 << "%, max " << maxBudgetUsage * 100.0 << "%, " << framesOverBudget
+        << " frames over budget\n";
+    return out.str();
+}
+
+bool BuildTraceReplayer::open(const std::string &path) {
+    return reader_.open(path);
+}
+
+BuildTraceReader &BuildTraceReplayer::reader() {
+    return reader_;
+}
+
+bool BuildTraceReplayer::finished() {
+    return finished_;
+}
+
+void BuildTraceReplayer::feed(BuildTraceTarget &target, BuildTraceRecord &record) {
+    switch (record.type) {
+        case BuildTraceRecordType::RESET_CHUNKS: {
+            pending_.clear();
+            target.resetChunks(record.chunkCount);
+            break;
+        }
+        case BuildTraceRecordType::CHUNK_REBUILD: {
+            // a chunk rebuilt before it became ready keeps counting from its first request
+            pending_.try_emplace(record.chunkId, PendingChunk{Clock::now(), report_.frames});
+            target.rebuildChunk(record.chunkBuildTask());
+            report_.chunkBuilds++;
+            break;
+        }
+        case BuildTraceRecordType::CHUNK_INVALIDATE: {
+            pending_.erase(record.chunkId);
+            target.invalidateChunk(record.chunkId);
+            break;
+        }
+        case BuildTraceRecordType::CHUNK_LIGHTS: {
+            target.setChunkLights(record.chunkId, record.lights);
+            break;
+        }
+        case BuildTraceRecordType::ENTITY_BUILD: {
+            target.queueEntities(record.entitiesBuildTask());
+            report_.entityBuilds++;
+            break;
+        }
+        default: break;
+    }
+}
+
+void BuildTraceReplayer::collectReady(BuildTraceTarget &target) {
+    auto now = Clock::now();
+    for (auto iter = pending_.begin(); iter != pending_.end();) {
+        if (!target.isChunkReady(iter->first)) {
+            ++iter;
+            continue;
+        }
+
+        uint32_t frames = report_.frames - iter->second.frame;
+        timeToReadyMs_.push_back(elapsedMs(iter->second.queued, now));
+        framesToReadySum_ += frames;
+        report_.maxFramesToReady = std::max(report_.maxFramesToReady, frames);
+        iter = pending_.erase(iter);
+    }
+}
+
+bool BuildTraceReplayer::replayFrame(BuildTraceTarget &target) {
+    if (finished_) return false;
+
+    // with a device the builds of the previous frame completed in between
+    collectReady(target);
+
+    auto begin = Clock::now();
+    BuildTraceRecord record;
+    bool frameEnded = false;
+    while (reader_.next(record)) {
+        report_.records++;
+        if (record.type == BuildTraceRecordType::FRAME) {
+            frameEnded = true;
+            break;
+        }
+        feed(target, record);
+    }
+    target.endFrame(record.cameraPos);
+    double costMs = elapsedMs(begin, Clock::now());
+
+    collectReady(target);
+
+    double budgetUs = DEFAULT_FRAME_US;
+    if (frameEnded) {
+        if (hasLastFrame_ && record.timeUs > lastFrameUs_) budgetUs = record.timeUs - lastFrameUs_;
+        lastFrameUs_ = record.timeUs;
+        hasLastFrame_ = true;
+    }
+    double usage = costMs * 1e3 / budgetUs;
+
+    report_.frames++;
+    size_t queueDepth = target.queuedChunkCount();
+    queueDepthSum_ += queueDepth;
+    report_.maxQueueDepth = std::max(report_.maxQueueDepth, queueDepth);
+    frameCostSumMs_ += costMs;
+    report_.maxFrameCostMs = std::max(report_.maxFrameCostMs, costMs);
+    budgetUsageSum_ += usage;
+    report_.maxBudgetUsage = std::max(report_.maxBudgetUsage, usage);
+    if (usage > 1.0) report_.framesOverBudget++;
+
+    if (!frameEnded) finished_ = true;
+    return !finished_;
+}
+
+BuildTraceReport BuildTraceReplayer::report() {
+    BuildTraceReport report = report_;
+    if (report.frames > 0) {
+        report.avgQueueDepth = static_cast<double>(queueDepthSum_) / report.frames;
+        report.avgFrameCostMs = frameCostSumMs_ / report.frames;
+        report.avgBudgetUsage = budgetUsageSum_ / report.frames;
+    }
+
+    report.chunksReady = timeToReadyMs_.size();
+    report.chunksNeverReady = pending_.size();
+    if (!timeToReadyMs_.empty()) {
+        std::vector<double> sorted = timeToReadyMs_;
+        std::sort(sorted.begin(), sorted.end());
+        report.avgTimeToReadyMs = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+        report.p95TimeToReadyMs = sorted[std::min<size_t>(sorted.size() - 1, static_cast<size_t>(0.95 * sorted.size()))];
+        report.maxTimeToReadyMs = sorted.back();
+        report.avgFramesToReady = static_cast<double>(framesToReadySum_) / sorted.size();
+    }
+    return report;
+}
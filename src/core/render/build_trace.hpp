@@ -0,0 +1,241 @@
+#pragma once
+
+#include "core/all_extern.hpp"
+
+#include "core/render/chunks.hpp"
+#include "core/render/entities.hpp"
+#include "core/render/renderer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A build trace is the header below followed by one record per chunk/entity call Java made: a BuildTraceRecordType
+// byte, the microseconds since recording started and the call's payload. Everything is written unpadded in native
+// byte order, traces are meant to be replayed on the machine family they were recorded on.
+struct BuildTraceHeader {
+    constexpr static char MAGIC[8] = {'M', 'C', 'V', 'R', 'B', 'T', 'R', 'C'};
+    constexpr static uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t optionsSize; // sizeof(Options) of the recording build, the options snapshot follows the header
+};
+
+enum class BuildTraceRecordType : uint8_t {
+    RESET_CHUNKS = 0,
+    CHUNK_REBUILD = 1,
+    CHUNK_INVALIDATE = 2,
+    CHUNK_LIGHTS = 3,
+    ENTITY_BUILD = 4,
+    FRAME = 5,
+};
+
+// one decoded record, owns copies of everything the original call pointed at
+struct BuildTraceRecord {
+    BuildTraceRecordType type;
+    uint64_t timeUs;
+
+    uint32_t chunkCount = 0; // RESET_CHUNKS
+
+    // CHUNK_REBUILD, CHUNK_INVALIDATE, CHUNK_LIGHTS
+    int64_t chunkId = 0;
+    int x = 0, y = 0, z = 0;
+    bool important = false;
+    std::vector<ChunkLightEntry> lights;
+
+    // ENTITY_BUILD
+    float lineWidth = 1.0f;
+    World::Coordinates coordinate = World::WORLD;
+    bool normalOffset = false;
+    std::vector<int> entityHashCodes;
+    std::vector<double> entityXs, entityYs, entityZs;
+    std::vector<int> entityRTFlags, entityPrebuiltBLASs, entityPosts, entityGeometryCounts;
+    std::vector<int> indexFormats;
+
+    // shared by CHUNK_REBUILD and ENTITY_BUILD
+    std::vector<int> geometryTypes, geometryTextures, vertexFormats, vertexCounts;
+    std::vector<std::vector<uint8_t>> geometryVertices;
+
+    glm::dvec3 cameraPos = {0, 0, 0}; // FRAME
+
+    // the tasks point into this record and stay valid as long as it is neither modified nor destroyed
+    ChunkBuildTask chunkBuildTask();
+    EntitiesBuildTask entitiesBuildTask();
+
+  private:
+    std::vector<vk::VertexFormat::PBRTriangle *> chunkVertexPointers_;
+    std::vector<void *> entityVertexPointers_;
+};
+
+class BuildTraceRecorder : public SharedObject<BuildTraceRecorder> {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    bool start(const std::string &path);
+    void stop();
+    bool recording();
+
+    void recordResetChunks(uint32_t chunkCount);
+    // for slab builds task.vertices is unused, slabVertices then holds every geometry back to back
+    void recordChunkRebuild(const ChunkBuildTask &task, const uint8_t *slabVertices = nullptr);
+    void recordChunkInvalidate(int64_t id);
+    void recordChunkLights(int64_t id, const std::vector<ChunkLightEntry> &lights);
+    void recordEntityBuild(const EntitiesBuildTask &task);
+    void recordFrame(glm::dvec3 cameraPos);
+
+  private:
+    void beginRecord(BuildTraceRecordType type);
+    void writeBytes(const void *data, size_t size);
+
+    template <typename T>
+    void write(const T &value) {
+        writeBytes(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void writeArray(const T *values, size_t count) {
+        writeBytes(values, count * sizeof(T));
+    }
+
+    std::mutex mutex_;
+    std::ofstream out_;
+    std::atomic<bool> recording_ = false;
+    Clock::time_point start_;
+    uint64_t recordCount_ = 0;
+};
+
+class BuildTraceReader {
+  public:
+    bool open(const std::string &path);
+    // false at the end of the trace or on a truncated record
+    bool next(BuildTraceRecord &record);
+
+    // whether the trace was recorded with the same Options layout, only then options() is meaningful
+    bool optionsCompatible() const;
+    const Options &options() const;
+
+  private:
+    bool readBytes(void *data, size_t size);
+
+    template <typename T>
+    bool read(T &value) {
+        return readBytes(&value, sizeof(T));
+    }
+
+    // no array of a record gets near this, a larger count comes from a corrupt file
+    constexpr static size_t MAX_ARRAY_BYTES = size_t{1} << 28;
+
+    template <typename T>
+    bool readVector(std::vector<T> &values, size_t count) {
+        if (count > MAX_ARRAY_BYTES / sizeof(T)) return false;
+        values.resize(count);
+        return readBytes(values.data(), count * sizeof(T));
+    }
+
+    std::ifstream in_;
+    bool optionsCompatible_ = false;
+    Options options_{};
+};
+
+// where a replay sends the recorded calls, the live Chunks/Entities or a headless model of their cpu halves
+class BuildTraceTarget {
+  public:
+    virtual ~BuildTraceTarget() = default;
+
+    virtual void resetChunks(uint32_t chunkCount) = 0;
+    virtual void rebuildChunk(const ChunkBuildTask &task) = 0;
+    virtual void invalidateChunk(int64_t id) = 0;
+    virtual void setChunkLights(int64_t id, const std::vector<ChunkLightEntry> &lights) = 0;
+    virtual void queueEntities(const EntitiesBuildTask &task) = 0;
+    // called once all records of a replayed frame were fed, with the camera position recorded for that frame
+    virtual void endFrame(glm::dvec3 cameraPos) = 0;
+
+    virtual bool isChunkReady(int64_t id) = 0;
+    virtual size_t queuedChunkCount() = 0;
+};
+
+// forwards into Renderer::instance().world(), pumped once per rendered frame
+class WorldBuildTraceTarget : public BuildTraceTarget {
+  public:
+    void resetChunks(uint32_t chunkCount) override;
+    void rebuildChunk(const ChunkBuildTask &task) override;
+    void invalidateChunk(int64_t id) override;
+    void setChunkLights(int64_t id, const std::vector<ChunkLightEntry> &lights) override;
+    void queueEntities(const EntitiesBuildTask &task) override;
+    void endFrame(glm::dvec3 cameraPos) override;
+
+    bool isChunkReady(int64_t id) override;
+    size_t queuedChunkCount() override;
+};
+
+struct BuildTraceReport {
+    uint32_t frames = 0;
+    uint64_t records = 0;
+    uint64_t chunkBuilds = 0;
+    uint64_t entityBuilds = 0;
+
+    size_t maxQueueDepth = 0;
+    double avgQueueDepth = 0.0;
+
+    // from the rebuild call until isChunkReady() first turns true
+    uint64_t chunksReady = 0;
+    uint64_t chunksNeverReady = 0;
+    double avgTimeToReadyMs = 0.0;
+    double p95TimeToReadyMs = 0.0;
+    double maxTimeToReadyMs = 0.0;
+    double avgFramesToReady = 0.0;
+    uint32_t maxFramesToReady = 0;
+
+    // cpu time spent feeding and building per frame against the frame time of the recording
+    double avgFrameCostMs = 0.0;
+    double maxFrameCostMs = 0.0;
+    double avgBudgetUsage = 0.0;
+    double maxBudgetUsage = 0.0;
+    uint32_t framesOverBudget = 0;
+
+    std::string format() const;
+};
+
+// Replays a trace frame by frame: every call up to the next FRAME record goes to the target, then the target gets to
+// run its frame. Time-to-ready is measured in replay time, not recording time.
+class BuildTraceReplayer : public SharedObject<BuildTraceReplayer> {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    constexpr static double DEFAULT_FRAME_US = 1e6 / 60.0;
+
+    bool open(const std::string &path);
+    // feeds the next recorded frame to target, false once the trace is exhausted
+    bool replayFrame(BuildTraceTarget &target);
+    bool finished();
+    BuildTraceReport report();
+
+    BuildTraceReader &reader();
+
+  private:
+    struct PendingChunk {
+        Clock::time_point queued;
+        uint32_t frame;
+    };
+
+    void feed(BuildTraceTarget &target, BuildTraceRecord &record);
+    void collectReady(BuildTraceTarget &target);
+
+    BuildTraceReader reader_;
+    bool finished_ = false;
+    uint64_t lastFrameUs_ = 0;
+    bool hasLastFrame_ = false;
+
+    std::map<int64_t, PendingChunk> pending_;
+    std::vector<double> timeToReadyMs_;
+    uint64_t framesToReadySum_ = 0;
+    uint64_t queueDepthSum_ = 0;
+    double frameCostSumMs_ = 0.0;
+    double budgetUsageSum_ = 0.0;
+    BuildTraceReport report_;
+};
@@ -0,0 +1,189 @@
+#include "core/render/chunk_greedy.hpp"
+
+#include "core/render/quad_indices.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+namespace {
+
+using Vertex = vk::VertexFormat::PBRTriangle;
+
+constexpr int SECTION_SIZE = 16;
+constexpr float EPSILON = 1e-4f;
+// below this share of saved quads the extra position, index and remap buffers are not worth it
+constexpr float MIN_SAVING = 0.2f;
+
+static_assert(sizeof(vk::Data::ChunkMergedQuad) == 4 * sizeof(uint32_t));
+
+// axis, winding, plane, texture, light: quads sharing all of them may be merged
+using PlaneKey = std::tuple<int, int, float, uint32_t, int, int>;
+
+struct PlaneQuad {
+    int u, v;
+    uint32_t quad;
+};
+
+class MergedQuads {
+  public:
+    void add(int axis, bool positive, float plane, glm::ivec2 lo, glm::ivec2 size, std::vector<uint32_t> &&quads) {
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        glm::vec2 hi = glm::vec2(lo + size);
+
+        // the winding of the block quads is kept, rays cull back faces
+        std::array<glm::vec2, 4> corners;
+        if (positive) {
+            corners = {glm::vec2(lo.x, lo.y), glm::vec2(hi.x, lo.y), glm::vec2(hi.x, hi.y), glm::vec2(lo.x, hi.y)};
+        } else {
+            corners = {glm::vec2(lo.x, lo.y), glm::vec2(lo.x, hi.y), glm::vec2(hi.x, hi.y), glm::vec2(hi.x, lo.y)};
+        }
+        for (auto &corner : corners) {
+            auto &position = positions_.emplace_back();
+            position.position[axis] = plane;
+            position.position[u] = corner.x;
+            position.position[v] = corner.y;
+        }
+
+        entries_.push_back({
+            .firstQuad = static_cast<uint32_t>(quads_.size()),
+            .extent = static_cast<uint32_t>(size.x) | static_cast<uint32_t>(size.y) << 8 |
+                      static_cast<uint32_t>(axis) << 16,
+            .origin = glm::vec2(lo),
+        });
+        quads_.insert(quads_.end(), quads.begin(), quads.end());
+    }
+
+    // a quad that could not be merged keeps its own corners and maps to itself
+    void addOriginal(const Vertex *quad, uint32_t index) {
+        for (int k = 0; k < 4; k++) positions_.push_back({quad[k].pos});
+        entries_.push_back({
+            .firstQuad = static_cast<uint32_t>(quads_.size()),
+            .extent = 1 | 1 << 8,
+            .origin = glm::vec2(0.0f),
+        });
+        quads_.push_back(index);
+    }
+
+    size_t count() const {
+        return entries_.size();
+    }
+
+    void finish(ChunkGreedyGeometry &greedy) {
+        greedy.positions = std::move(positions_);
+        greedy.indices.resize(greedy.positions.size() / 4 * 6);
+        fillQuadIndices(greedy.indices.data(), greedy.positions.size());
+
+        // the covered quads are addressed from the start of the buffer
+        uint32_t quadBase = static_cast<uint32_t>(entries_.size() * 4);
+        greedy.remap.resize(quadBase + quads_.size());
+        for (auto &entry : entries_) entry.firstQuad += quadBase;
+        std::memcpy(greedy.remap.data(), entries_.data(), entries_.size() * sizeof(vk::Data::ChunkMergedQuad));
+        std::memcpy(greedy.remap.data() + quadBase, quads_.data(), quads_.size() * sizeof(uint32_t));
+    }
+
+  private:
+    std::vector<vk::VertexFormat::PositionOnly> positions_;
+    std::vector<vk::Data::ChunkMergedQuad> entries_;
+    std::vector<uint32_t> quads_;
+};
+
+} // namespace
+
+bool buildChunkGreedyGeometry(std::span<const vk::VertexFormat::PBRTriangle> vertices, ChunkGreedyGeometry &greedy) {
+    uint32_t quadCount = static_cast<uint32_t>(vertices.size() / 4);
+    if (quadCount == 0) return false;
+
+    std::map<PlaneKey, std::vector<PlaneQuad>> planes;
+    std::vector<uint32_t> unmerged;
+
+    for (uint32_t q = 0; q < quadCount; q++) {
+        const Vertex *quad = &vertices[q * 4];
+
+        int axis = -1;
+        for (int a = 0; a < 3 && axis < 0; a++) {
+            bool flat = true;
+            for (int k = 1; k < 4; k++) flat = flat && std::abs(quad[k].pos[a] - quad[0].pos[a]) < EPSILON;
+            if (flat) axis = a;
+        }
+        bool sameLight = true;
+        for (int k = 1; k < 4; k++) sameLight = sameLight && quad[k].lightUV == quad[0].lightUV;
+        if (axis < 0 || !sameLight) {
+            unmerged.push_back(q);
+            continue;
+        }
+
+        // only full block faces on the block grid tile a plane without gaps or overlaps
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        glm::vec2 lo(quad[0].pos[u], quad[0].pos[v]), hi = lo;
+        for (int k = 1; k < 4; k++) {
+            lo = glm::min(lo, glm::vec2(quad[k].pos[u], quad[k].pos[v]));
+            hi = glm::max(hi, glm::vec2(quad[k].pos[u], quad[k].pos[v]));
+        }
+        glm::vec2 cell = glm::round(lo);
+        bool blockFace = glm::all(glm::lessThan(glm::abs(hi - lo - 1.0f), glm::vec2(EPSILON))) &&
+                         glm::all(glm::lessThan(glm::abs(lo - cell), glm::vec2(EPSILON))) &&
+                         glm::all(glm::greaterThanEqual(cell, glm::vec2(0.0f))) &&
+                         glm::all(glm::lessThan(cell, glm::vec2(SECTION_SIZE)));
+        if (!blockFace) {
+            unmerged.push_back(q);
+            continue;
+        }
+
+        glm::vec3 normal = glm::cross(quad[1].pos - quad[0].pos, quad[2].pos - quad[0].pos);
+        PlaneKey key = {axis, normal[axis] > 0.0f ? 1 : 0, quad[0].pos[axis], quad[0].textureID, quad[0].lightUV.x,
+                        quad[0].lightUV.y};
+        planes[key].push_back({static_cast<int>(cell.x), static_cast<int>(cell.y), q});
+    }
+
+    MergedQuads merged;
+    for (auto &[key, planeQuads] : planes) {
+        auto [axis, positive, plane, textureID, lightU, lightV] = key;
+
+        std::array<int64_t, SECTION_SIZE * SECTION_SIZE> grid;
+        grid.fill(-1);
+        for (auto &planeQuad : planeQuads) {
+            auto &slot = grid[planeQuad.u * SECTION_SIZE + planeQuad.v];
+            // overlapping faces (z-fighting in the source) are left alone
+            if (slot >= 0) {
+                unmerged.push_back(planeQuad.quad);
+            } else {
+                slot = planeQuad.quad;
+            }
+        }
+
+        for (int i = 0; i < SECTION_SIZE; i++) {
+            for (int j = 0; j < SECTION_SIZE; j++) {
+                if (grid[i * SECTION_SIZE + j] < 0) continue;
+
+                int w = 1;
+                while (i + w < SECTION_SIZE && grid[(i + w) * SECTION_SIZE + j] >= 0) w++;
+                int h = 1;
+                for (; j + h < SECTION_SIZE; h++) {
+                    bool row = true;
+                    for (int di = 0; di < w && row; di++) row = grid[(i + di) * SECTION_SIZE + j + h] >= 0;
+                    if (!row) break;
+                }
+
+                // row-major over the width, the shader indexes the list with i * height + j
+                std::vector<uint32_t> covered;
+                covered.reserve(w * h);
+                for (int di = 0; di < w; di++) {
+                    for (int dj = 0; dj < h; dj++) {
+                        covered.push_back(static_cast<uint32_t>(grid[(i + di) * SECTION_SIZE + j + dj]));
+                        grid[(i + di) * SECTION_SIZE + j + dj] = -1;
+                    }
+                }
+                merged.add(axis, positive != 0, plane, glm::ivec2(i, j), glm::ivec2(w, h), std::move(covered));
+            }
+        }
+    }
+
+    if (merged.count() + unmerged.size() > quadCount * (1.0f - MIN_SAVING)) return false;
+
+    for (uint32_t q : unmerged) merged.addOriginal(&vertices[q * 4], q);
+    merged.finish(greedy);
+    return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "common/shared.hpp"
+#include "core/all_extern.hpp"
+
+#include <span>
+#include <vector>
+
+// Trace-only geometry for WORLD_SOLID chunk quads. Full block faces lying in one plane with the same texture and
+// light are merged greedily into larger quads that only the BLAS sees. The closest hit shader maps a hit on a merged
+// quad back to the block quad under it and shades that one from the original vertex and index buffers.
+struct ChunkGreedyGeometry {
+    std::vector<vk::VertexFormat::PositionOnly> positions;
+    std::vector<uint32_t> indices;
+    // a vk::Data::ChunkMergedQuad per merged quad, followed by the original quads each of them covers
+    std::vector<uint32_t> remap;
+};
+
+// false if merging would not save enough triangles to pay for the extra buffers
+bool buildChunkGreedyGeometry(std::span<const vk::VertexFormat::PBRTriangle> vertices, ChunkGreedyGeometry &greedy);
@@ -0,0 +1,248 @@
+#include "core/render/chunk_lod.hpp"
+
+#include "core/render/quad_indices.hpp"
+
+#include <array>
+#include <map>
+
+namespace {
+
+using Vertex = vk::VertexFormat::PBRTriangle;
+
+constexpr int SECTION_SIZE = 16;
+constexpr int DIRECTION_COUNT = 6; // +x -x +y -y +z -z
+
+int quadDirection(const Vertex *quad) {
+    glm::vec3 normal = quad[0].norm;
+    if (quad[0].useNorm == 0 || glm::dot(normal, normal) < 1e-8f) {
+        normal = glm::cross(quad[1].pos - quad[0].pos, quad[2].pos - quad[0].pos);
+        // the first three corners of a degenerate quad may be collinear
+        if (glm::dot(normal, normal) < 1e-8f) normal = glm::cross(quad[2].pos - quad[0].pos, quad[3].pos - quad[0].pos);
+    }
+
+    glm::vec3 extent = glm::abs(normal);
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    return axis * 2 + (normal[axis] >= 0.0f ? 0 : 1);
+}
+
+bool sameSurface(const Vertex &a, const Vertex &b) {
+    return a.textureID == b.textureID && a.useTexture == b.useTexture && a.colorLayer == b.colorLayer &&
+           a.albedoEmission == b.albedoEmission;
+}
+
+// a quad becomes part of a solid cell only if every texel under its uv rectangle is opaque, judged like the OMM
+// special indices are, so cutout and translucent patches of a texture keep their quads
+bool opaqueQuad(const Vertex *quad, const ChunkAlphaSource &alphaSource) {
+    uint32_t textureID = quad[0].textureID;
+    const auto *alphaData = alphaSource.alphaData(textureID);
+    if (alphaData == nullptr || alphaData->alpha.empty()) {
+        return alphaSource.alphaClass(textureID) == Textures::AlphaClass::FULLY_OPAQUE;
+    }
+
+    glm::vec2 uvMin = quad[0].textureUV, uvMax = quad[0].textureUV;
+    for (int c = 1; c < 4; c++) {
+        uvMin = glm::min(uvMin, quad[c].textureUV);
+        uvMax = glm::max(uvMax, quad[c].textureUV);
+    }
+
+    // the range stays empty while no texel under the quad was uploaded
+    uint8_t minAlpha, maxAlpha;
+    if (!alphaData->uvAlphaRange(uvMin, uvMax, minAlpha, maxAlpha)) return false;
+    return maxAlpha >= minAlpha && minAlpha > Textures::TextureAlphaData::ALPHA_CUTOFF * 255.0f;
+}
+
+class VoxelProxy {
+  public:
+    VoxelProxy(int cellSize)
+        : cellSize_(cellSize),
+          n_(SECTION_SIZE / cellSize),
+          solid_(n_ * n_ * n_, 0),
+          faces_(n_ * n_ * n_ * DIRECTION_COUNT, nullptr) {}
+
+    void addQuad(const Vertex *quad) {
+        int direction = quadDirection(quad);
+        int axis = direction / 2;
+
+        // half a block behind the face lies the block it belongs to
+        glm::vec3 center = (quad[0].pos + quad[1].pos + quad[2].pos + quad[3].pos) * 0.25f;
+        center[axis] -= direction % 2 == 0 ? 0.5f : -0.5f;
+        glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(center / static_cast<float>(cellSize_))), glm::ivec3(0),
+                                     glm::ivec3(n_ - 1));
+
+        int index = cellIndex(cell);
+        solid_[index] = 1;
+        if (faces_[index * DIRECTION_COUNT + direction] == nullptr) faces_[index * DIRECTION_COUNT + direction] = quad;
+    }
+
+    void emit(std::vector<Vertex> &vertices) {
+        std::vector<const Vertex *> mask(n_ * n_);
+        for (int direction = 0; direction < DIRECTION_COUNT; direction++) {
+            int axis = direction / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+            for (int k = 0; k < n_; k++) {
+                for (int i = 0; i < n_; i++) {
+                    for (int j = 0; j < n_; j++) {
+                        glm::ivec3 cell;
+                        cell[axis] = k;
+                        cell[u] = i;
+                        cell[v] = j;
+                        mask[i * n_ + j] = exposedFace(cell, direction);
+                    }
+                }
+
+                for (int i = 0; i < n_; i++) {
+                    for (int j = 0; j < n_; j++) {
+                        const Vertex *face = mask[i * n_ + j];
+                        if (face == nullptr) continue;
+
+                        auto matches = [&](int mi, int mj) {
+                            const Vertex *other = mask[mi * n_ + mj];
+                            return other != nullptr && sameSurface(*other, *face);
+                        };
+
+                        int w = 1;
+                        while (i + w < n_ && matches(i + w, j)) w++;
+                        int h = 1;
+                        for (; j + h < n_; h++) {
+                            bool row = true;
+                            for (int di = 0; di < w && row; di++) row = matches(i + di, j + h);
+                            if (!row) break;
+                        }
+
+                        for (int di = 0; di < w; di++) {
+                            for (int dj = 0; dj < h; dj++) mask[(i + di) * n_ + j + dj] = nullptr;
+                        }
+                        emitRectangle(direction, k, i, j, w, h, face, vertices);
+                    }
+                }
+            }
+        }
+    }
+
+  private:
+    int cellIndex(glm::ivec3 cell) const {
+        return (cell.x * n_ + cell.y) * n_ + cell.z;
+    }
+
+    // the quad a cell face takes its material from, nullptr if the face is hidden
+    const Vertex *exposedFace(glm::ivec3 cell, int direction) const {
+        int index = cellIndex(cell);
+        if (!solid_[index]) return nullptr;
+
+        glm::ivec3 neighbour = cell;
+        neighbour[direction / 2] += direction % 2 == 0 ? 1 : -1;
+        const Vertex *face = faces_[index * DIRECTION_COUNT + direction];
+
+        // across the section border only what Java sent is exposed, the neighbouring section is unknown here
+        bool outside = glm::any(glm::lessThan(neighbour, glm::ivec3(0))) ||
+                       glm::any(glm::greaterThanEqual(neighbour, glm::ivec3(n_)));
+        if (outside) return face;
+        if (solid_[cellIndex(neighbour)]) return nullptr;
+        if (face != nullptr) return face;
+
+        // a coarse cell may expose a side none of its blocks had a quad on
+        for (int other = 0; other < DIRECTION_COUNT; other++) {
+            if (faces_[index * DIRECTION_COUNT + other] != nullptr) return faces_[index * DIRECTION_COUNT + other];
+        }
+        return nullptr;
+    }
+
+    void emitRectangle(int direction, int k, int i, int j, int w, int h, const Vertex *face, std::vector<Vertex> &out) {
+        int axis = direction / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+        bool positive = direction % 2 == 0;
+
+        float plane = static_cast<float>((k + (positive ? 1 : 0)) * cellSize_);
+        glm::vec2 lo = glm::vec2(i, j) * static_cast<float>(cellSize_);
+        glm::vec2 hi = glm::vec2(i + w, j + h) * static_cast<float>(cellSize_);
+
+        // counter-clockwise seen from outside, e_u x e_v = e_axis
+        std::array<glm::vec2, 4> corners;
+        if (positive) {
+            corners = {glm::vec2(lo.x, lo.y), glm::vec2(hi.x, lo.y), glm::vec2(hi.x, hi.y), glm::vec2(lo.x, hi.y)};
+        } else {
+            corners = {glm::vec2(lo.x, lo.y), glm::vec2(lo.x, hi.y), glm::vec2(hi.x, hi.y), glm::vec2(hi.x, lo.y)};
+        }
+
+        glm::vec2 uvMin = face[0].textureUV, uvMax = face[0].textureUV;
+        for (int c = 1; c < 4; c++) {
+            uvMin = glm::min(uvMin, face[c].textureUV);
+            uvMax = glm::max(uvMax, face[c].textureUV);
+        }
+
+        glm::vec3 normal(0.0f);
+        normal[axis] = positive ? 1.0f : -1.0f;
+
+        for (auto &corner : corners) {
+            Vertex vertex = face[0];
+            vertex.pos[axis] = plane;
+            vertex.pos[u] = corner.x;
+            vertex.pos[v] = corner.y;
+            vertex.norm = normal;
+            vertex.useNorm = 1;
+
+            // the texture is stretched over the rectangle, on walls it runs downwards like it does in the atlas
+            glm::vec2 t = (corner - lo) / (hi - lo);
+            if (axis == 0) {
+                t = glm::vec2(t.y, 1.0f - t.x); // u is y
+            } else if (axis == 2) {
+                t = glm::vec2(t.x, 1.0f - t.y); // v is y
+            }
+            vertex.textureUV = glm::mix(uvMin, uvMax, t);
+            out.push_back(vertex);
+        }
+    }
+
+    int cellSize_;
+    int n_;
+    std::vector<uint8_t> solid_;
+    std::vector<const Vertex *> faces_; // first quad facing each direction per cell
+};
+
+} // namespace
+
+bool buildChunkLodGeometry(const ChunkBuildData &source,
+                           uint32_t cellSize,
+                           const ChunkAlphaSource &alphaSource,
+                           ChunkLodGeometry &lod) {
+    VoxelProxy proxy(static_cast<int>(cellSize));
+    bool voxelized = false;
+    std::map<World::GeometryTypes, std::vector<Vertex>> passThrough;
+
+    for (uint32_t i = 0; i < source.geometryCount; i++) {
+        auto type = source.geometryTypes[i];
+        auto &vertexView = source.vertexViews[i];
+
+        for (size_t q = 0; q + 4 <= vertexView.size(); q += 4) {
+            const Vertex *quad = &vertexView[q];
+
+            // an atlas holds opaque, cutout and translucent sprites alike, each quad is judged by its own texels
+            bool solid =
+                type == World::WORLD_SOLID || (type == World::WORLD_TRANSPARENT && opaqueQuad(quad, alphaSource));
+            if (solid) {
+                proxy.addQuad(quad);
+                voxelized = true;
+            } else {
+                passThrough[type].insert(passThrough[type].end(), quad, quad + 4);
+            }
+        }
+    }
+    if (!voxelized) return false;
+
+    std::vector<Vertex> proxyVertices;
+    proxy.emit(proxyVertices);
+
+    auto addGeometry = [&lod](World::GeometryTypes type, std::vector<Vertex> &&vertices) {
+        if (vertices.empty()) return;
+        auto &indices = lod.indices.emplace_back((vertices.size() + 3) / 4 * 6);
+        fillQuadIndices(indices.data(), vertices.size());
+
+        lod.allVertexCount += vertices.size();
+        lod.allIndexCount += indices.size();
+        lod.geometryTypes.push_back(type);
+        lod.vertices.push_back(std::move(vertices));
+    };
+
+    addGeometry(World::WORLD_SOLID, std::move(proxyVertices));
+    for (auto &[type, vertices] : passThrough) addGeometry(type, std::move(vertices));
+    return !lod.geometryTypes.empty();
+}
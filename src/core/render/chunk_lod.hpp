@@ -0,0 +1,23 @@
+#pragma once
+
+#include "core/render/chunks.hpp"
+
+#include <vector>
+
+// Stand-in geometry for chunk sections far from the camera. Solid quads and quads whose texels are all opaque are
+// voxelized into cubic cells of cellSize blocks, only the exposed cell faces are kept and merged greedily into
+// rectangles of one material, each borrowing the texture and tint of a quad it replaced. Cutout, translucent and
+// special quads (leaves, water, glass, portals) are passed through untouched, they need their any-hit shading.
+struct ChunkLodGeometry {
+    uint32_t allVertexCount = 0;
+    uint32_t allIndexCount = 0;
+    std::vector<World::GeometryTypes> geometryTypes;
+    std::vector<std::vector<vk::VertexFormat::PBRTriangle>> vertices;
+    std::vector<std::vector<uint32_t>> indices;
+};
+
+// false if the section has no quad a proxy could replace, cellSize is a power of two dividing the section
+bool buildChunkLodGeometry(const ChunkBuildData &source,
+                           uint32_t cellSize,
+                           const ChunkAlphaSource &alphaSource,
+                           ChunkLodGeometry &lod);
@@ -1,6 +1,10 @@
 #include "core/render/chunks.hpp"
 
 #include "core/render/buffers.hpp"
+#include "core/render/chunk_lod.hpp"
+#include "core/render/lights.hpp"
+#include "core/render/profiler.hpp"
+#include "core/render/quad_indices.hpp"
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 #include "core/render/textures.hpp"
@@ -9,8 +13,22 @@
 #endif
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cmath>
+#include <iostream>
+
+ChunkStagingSlab::ChunkStagingSlab(std::shared_ptr<vk::VMA> vma, std::shared_ptr<vk::Device> device, size_t vertexCapacity)
+    : vertexCapacity((vertexCapacity + 3) & ~size_t(3)) {
+    // room for 6 indices per quad, chunk geometries always consist of whole quads
+    size_t maxVertexCount = this->vertexCapacity / sizeof(vk::VertexFormat::PBRTriangle);
+    indexCapacity = (maxVertexCount + 3) / 4 * 6 * sizeof(uint32_t);
+    // cached memory, the opacity bake, the greedy merge, the LOD voxelizer and the trace recorder all read the
+    // geometry back through the mapping. queueChunkBuild flushes it before the upload
+    buffer = vk::HostVisibleBuffer::create(vma, device, this->vertexCapacity + indexCapacity,
+                                           VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 1,
+                                           VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+}
 
 ChunkBuildData::ChunkBuildData(int64_t id,
                                int x,
@@ -35,7 +53,50 @@ ChunkBuildData::ChunkBuildData(int64_t id,
       vertices(std::move(vertices)),
       indices(std::move(indices)),
       blas(nullptr),
-      blasBuilder(nullptr) {}
+      blasBuilder(nullptr) {
+    for (int i = 0; i < geometryCount; i++) {
+        vertexViews.emplace_back(this->vertices[i]);
+        indexViews.emplace_back(this->indices[i]);
+    }
+}
+
+ChunkBuildData::ChunkBuildData(int64_t id,
+                               int x,
+                               int y,
+                               int z,
+                               int64_t version,
+                               uint32_t allVertexCount,
+                               uint32_t allIndexCount,
+                               uint32_t geometryCount,
+                               std::vector<World::GeometryTypes> &&geometryTypes,
+                               std::shared_ptr<ChunkStagingSlab> stagingSlab,
+                               const std::vector<uint32_t> &vertexCounts,
+                               const std::vector<uint32_t> &indexCounts)
+    : id(id),
+      x(x),
+      y(y),
+      z(z),
+      version(version),
+      allVertexCount(allVertexCount),
+      allIndexCount(allIndexCount),
+      geometryCount(geometryCount),
+      geometryTypes(std::move(geometryTypes)),
+      stagingSlab(stagingSlab),
+      blas(nullptr),
+      blasBuilder(nullptr) {
+    auto base = static_cast<char *>(stagingSlab->buffer->mappedPtr());
+    size_t vertexOffset = 0;
+    size_t indexOffset = stagingSlab->vertexCapacity;
+    for (int i = 0; i < geometryCount; i++) {
+        vertexOffsets.push_back(vertexOffset);
+        indexOffsets.push_back(indexOffset);
+        vertexViews.emplace_back(reinterpret_cast<vk::VertexFormat::PBRTriangle *>(base + vertexOffset),
+                                 vertexCounts[i]);
+        indexViews.emplace_back(reinterpret_cast<uint32_t *>(base + indexOffset), indexCounts[i]);
+        vertexOffset += vertexCounts[i] * sizeof(vk::VertexFormat::PBRTriangle);
+        indexOffset += indexCounts[i] * sizeof(uint32_t);
+    }
+}
 
 ChunkBuildData::~ChunkBuildData() {
     for (auto &gd : ommGeometryData) {
@@ -46,14 +107,93 @@ ChunkBuildData::~ChunkBuildData() {
     }
 }
 
+namespace {
+
+constexpr uint32_t MIN_LIGHT_SLOT = 8;
+constexpr uint32_t INITIAL_LIGHT_RECORDS = 4096;
+
+constexpr int REGION_SHIFT = 6;                              // regions are cubes of 4x4x4 sections, 64 blocks
+constexpr size_t MIN_REGION_MEMBERS = 4;                     // fewer are not worth an extra BLAS
+constexpr size_t MAX_REGION_BUILDS = 4;                      // per submission, sections build on that queue too
+constexpr double REGION_HYSTERESIS = 2.0;                    // chunks, regions split this much closer than they merge
+constexpr auto REGION_STABLE_TIME = std::chrono::seconds(5); // since the last rebuild of a member
+
+constexpr double OPACITY_BAKE_DISTANCE = 48.0; // blocks, sections further away drop their OMM bakes
+
+// blocks, a section with a proxy switches back to full geometry once closer, see Chunks::updateLods
+double chunkLodNearDistance() {
+    double farDistance = Renderer::options.chunkLodDistance * 16.0;
+    return std::max(farDistance - Renderer::options.chunkLodHysteresis * 16.0, 0.0);
+}
+
+// lives for one prepareOpacity, keeps the alpha snapshots it handed out and the classes it looked up
+class TexturesAlphaSource : public ChunkAlphaSource {
+  public:
+    TexturesAlphaSource(std::shared_ptr<Textures> textures) : textures_(textures) {}
+
+    Textures::AlphaClass alphaClass(uint32_t textureID) const override {
+        auto iter = alphaClasses_.find(textureID);
+        if (iter == alphaClasses_.end()) {
+            iter = alphaClasses_.emplace(textureID, textures_->getTextureAlphaClass(textureID)).first;
+        }
+        return iter->second;
+    }
+
+    const Textures::TextureAlphaData *alphaData(uint32_t textureID) const override {
+        auto iter = snapshots_.find(textureID);
+        if (iter == snapshots_.end()) {
+            iter = snapshots_.emplace(textureID, textures_->getTextureAlphaData(textureID)).first;
+        }
+        return iter->second.get();
+    }
+
+  private:
+    std::shared_ptr<Textures> textures_;
+    mutable std::map<uint32_t, Textures::AlphaClass> alphaClasses_;
+    mutable std::map<uint32_t, std::shared_ptr<const Textures::TextureAlphaData>> snapshots_;
+};
+
+// identifies the inputs of a texture group bake, ChunkOpacityBake keeps them to compare on a hit
+uint64_t opacityBakeKey(uint32_t textureID,
+                        uint64_t alphaRevision,
+                        uint32_t subdivisionLevel,
+                        const std::vector<glm::vec2> &uvs) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](uint64_t value) { hash = (hash ^ value) * 0x100000001b3ull; };
+    mix(textureID);
+    mix(alphaRevision);
+    mix(subdivisionLevel);
+    for (auto &uv : uvs) {
+        mix(static_cast<uint64_t>(std::bit_cast<uint32_t>(uv.x)) << 32 | std::bit_cast<uint32_t>(uv.y));
+    }
+    return hash;
+}
+
+int32_t specialOpacityIndex(Textures::AlphaClass alphaClass) {
+    switch (alphaClass) {
+        case Textures::AlphaClass::FULLY_OPAQUE: return VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_OPAQUE_EXT;
+        case Textures::AlphaClass::FULLY_TRANSPARENT:
+            // Translucent textures (e.g. water) have no fully-opaque pixels but ARE
+            // visible. Fall back to AHS instead of marking invisible.
+            return VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT;
+        default: return VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT;
+    }
+}
+
+} // namespace
+
 void ChunkBuildData::build(bool allowMicromapBake, bool skipOMM) {
-    auto framework = Renderer::instance().framework();
-    auto vma = framework->vma();
-    auto device = framework->device();
-    auto physicalDevice = framework->physicalDevice();
+    ProfilerCpuScope profilerScope("ChunkBuildData::build");
+
+    auto device = Renderer::instance().framework()->device();
     auto textures = Renderer::instance().textures();
     bool useOMM = !skipOMM && device->hasOMM() && Renderer::options.ommEnabled && textures != nullptr;
 
+    if (!opacityPrepared) prepareOpacity(useOMM, allowMicromapBake, TexturesAlphaSource(textures));
+    upload();
+}
+
+void ChunkBuildData::prepareOpacity(bool useOMM, bool allowMicromapBake, const ChunkAlphaSource &alphaSource) {
 #ifdef MCVR_ENABLE_OMM
     // Thread-local OMM baker (one per thread, SDK is not thread-safe per instance)
     static thread_local std::unique_ptr<OMMBaker> tlBaker;
@@ -63,308 +203,395 @@ void ChunkBuildData::build(bool allowMicromapBake, bool skipOMM) {
 #endif
 
     ommGeometryData.resize(geometryCount);
+    // only needed while baking, the section keeps the bakes of this build instead
+    auto reusable = std::move(previousBakes);
+    if (!useOMM) return;
 
     for (int i = 0; i < geometryCount; i++) {
-        auto vertexBuffer =
-            vk::DeviceLocalBuffer::create(vma, device, vertices[i].size() * sizeof(vk::VertexFormat::PBRTriangle),
-                                          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-                                              VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
-                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-        vertexBuffer->uploadToStagingBuffer(vertices[i].data());
-        vertexBuffers.push_back(vertexBuffer);
+        auto &gd = ommGeometryData[i];
+        uint32_t numTriangles = static_cast<uint32_t>(indexViews[i].size()) / 3;
 
-        auto indexBuffer =
-            vk::DeviceLocalBuffer::create(vma, device, indices[i].size() * sizeof(uint32_t),
-                                          VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-                                              VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
-                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-        indexBuffer->uploadToStagingBuffer(indices[i].data());
-        indexBuffers.push_back(indexBuffer);
+        if (geometryTypes[i] != World::WORLD_TRANSPARENT) {
+            // the BLAS of merged geometry has fewer triangles than the original
+            if (i < greedyGeometry.size() && !greedyGeometry[i].indices.empty()) {
+                numTriangles = static_cast<uint32_t>(greedyGeometry[i].indices.size()) / 3;
+            }
+
+            // WORLD_SOLID with OMM enabled: all-opaque special indices
+            // When pipeline has VK_PIPELINE_CREATE_RAY_TRACING_OPACITY_MICROMAP_BIT_EXT,
+            // ALL geometries in the BLAS must have OMM pNext attached
+            gd.indices.assign(numTriangles, VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_OPAQUE_EXT);
+            continue;
+        }
 
         // OMM: per-triangle opacity for WORLD_TRANSPARENT geometry
-        if (useOMM && geometryTypes[i] == World::WORLD_TRANSPARENT) {
 #ifdef MCVR_ENABLE_OMM
-            uint32_t numTriangles = static_cast<uint32_t>(indices[i].size()) / 3;
-
-            if (!allowMicromapBake) {
-                // Phase 1 fallback: special indices only (for important/immediate chunks)
-                std::vector<int32_t> ommIndices(numTriangles);
-                for (uint32_t t = 0; t < numTriangles; t++) {
-                    uint32_t vertIdx = indices[i][t * 3];
-                    uint32_t texId = vertices[i][vertIdx].textureID;
-                    auto alphaClass = textures->getTextureAlphaClass(texId);
-                    switch (alphaClass) {
-                        case Textures::AlphaClass::FULLY_OPAQUE:
-                            ommIndices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_OPAQUE_EXT;
-                            break;
-                        case Textures::AlphaClass::FULLY_TRANSPARENT:
-                            // Translucent textures (e.g. water) have no fully-opaque pixels but ARE
-                            // visible. Fall back to AHS instead of marking invisible.
-                            ommIndices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT;
-                            break;
-                        default:
-                            ommIndices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT;
-                            break;
-                    }
-                }
-                auto ommIdxBuffer = vk::DeviceLocalBuffer::create(
-                    vma, device, numTriangles * sizeof(int32_t),
-                    VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-                        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
-                        VK_BUFFER_USAGE_MICROMAP_BUILD_INPUT_READ_ONLY_BIT_EXT);
-                ommIdxBuffer->uploadToStagingBuffer(ommIndices.data());
-                ommIndexBuffers.push_back(ommIdxBuffer);
-            } else {
+        if (!allowMicromapBake) {
+            // Phase 1 fallback: special indices only (for important/immediate chunks)
+            gd.indices.resize(numTriangles);
+            for (uint32_t t = 0; t < numTriangles; t++) {
+                uint32_t vertIdx = indexViews[i][t * 3];
+                gd.indices[t] = specialOpacityIndex(alphaSource.alphaClass(vertexViews[i][vertIdx].textureID));
+            }
+            continue;
+        }
 
-            // Phase 2: full per-micro-triangle baking
-            bool bakingDone = false;
+        // Phase 2: full per-micro-triangle baking
 
-            // Group triangles by textureID to bake each texture group separately
-            std::map<uint32_t, std::vector<uint32_t>> texGroups; // texID -> list of tri indices
-            for (uint32_t t = 0; t < numTriangles; t++) {
-                uint32_t vertIdx = indices[i][t * 3];
-                uint32_t texId = vertices[i][vertIdx].textureID;
-                texGroups[texId].push_back(t);
+        // Group triangles by textureID to bake each texture group separately
+        std::map<uint32_t, std::vector<uint32_t>> texGroups; // texID -> list of tri indices
+        for (uint32_t t = 0; t < numTriangles; t++) {
+            uint32_t vertIdx = indexViews[i][t * 3];
+            uint32_t texId = vertexViews[i][vertIdx].textureID;
+            texGroups[texId].push_back(t);
+        }
+
+        // Per-triangle OMM index buffer (maps each triangle to an OMM block or special index)
+        gd.indices.assign(numTriangles, VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT);
+        // Track usage counts
+        std::map<uint64_t, uint32_t> descHistMap, indexHistMap; // key = (subdiv << 16 | format)
+
+        for (auto &[texId, triList] : texGroups) {
+            auto alphaClass = alphaSource.alphaClass(texId);
+            const auto *alphaData = alphaSource.alphaData(texId);
+            if (!alphaData || alphaData->alpha.empty()) {
+                // No alpha data or animated → fall back to special index
+                // Special indices don't contribute to desc histogram, only index histogram
+                for (uint32_t t : triList) gd.indices[t] = specialOpacityIndex(alphaClass);
+                continue;
             }
 
-            // Per-triangle OMM index buffer (maps each triangle to an OMM block or special index)
-            std::vector<int32_t> ommIndices(numTriangles, VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT);
-            // Merged OMM array data and descriptors across all texture groups
-            std::vector<uint8_t> mergedArrayData;
-            std::vector<VkMicromapTriangleEXT> mergedDescs;
-            // Track usage counts
-            std::map<uint64_t, uint32_t> descHistMap, indexHistMap; // key = (subdiv << 16 | format)
-
-            for (auto &[texId, triList] : texGroups) {
-                const auto *alphaData = textures->getTextureAlphaData(texId);
-                if (!alphaData || alphaData->alpha.empty()) {
-                    // No alpha data or animated → fall back to special index
-                    for (uint32_t t : triList) {
-                        auto alphaClass = textures->getTextureAlphaClass(texId);
-                        switch (alphaClass) {
-                            case Textures::AlphaClass::FULLY_OPAQUE:
-                                ommIndices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_OPAQUE_EXT;
-                                break;
-                            case Textures::AlphaClass::FULLY_TRANSPARENT:
-                                // Translucent textures (e.g. water) have no fully-opaque pixels but ARE
-                                // visible. Fall back to AHS instead of marking invisible.
-                                ommIndices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT;
-                                break;
-                            default:
-                                ommIndices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT;
-                                break;
-                        }
-                    }
-                    // Update index histogram for special indices
-                    for (uint32_t t : triList) {
-                        // Special indices don't contribute to desc histogram, only index histogram
-                        // Vulkan spec: special indices counted with subdivisionLevel=0, format matching
-                    }
-                    continue;
+            // Translucent textures (e.g. water): all alpha < 255 but visible.
+            // The OMM baker would mark them OPAQUE (alpha > cutoff), which
+            // skips AHS and blocks shadow rays. Use UNKNOWN_OPAQUE to force AHS.
+            if (alphaClass == Textures::AlphaClass::FULLY_TRANSPARENT) {
+                for (uint32_t t : triList) {
+                    gd.indices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT;
                 }
+                continue;
+            }
 
-                // Translucent textures (e.g. water): all alpha < 255 but visible.
-                // The OMM baker would mark them OPAQUE (alpha > cutoff), which
-                // skips AHS and blocks shadow rays. Use UNKNOWN_OPAQUE to force AHS.
-                auto alphaClass = textures->getTextureAlphaClass(texId);
-                if (alphaClass == Textures::AlphaClass::FULLY_TRANSPARENT) {
-                    for (uint32_t t : triList) {
-                        ommIndices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT;
-                    }
+            // Triangles whose texels all fall into uniform tiles get a special index without baking
+            constexpr float alphaCutoff = Textures::TextureAlphaData::ALPHA_CUTOFF;
+            std::vector<uint32_t> bakeList;
+            bakeList.reserve(triList.size());
+            for (uint32_t t : triList) {
+                glm::vec2 uvMin(1.0f), uvMax(0.0f);
+                for (uint32_t k = 0; k < 3; k++) {
+                    const auto &uv = vertexViews[i][indexViews[i][t * 3 + k]].textureUV;
+                    uvMin = glm::min(uvMin, uv);
+                    uvMax = glm::max(uvMax, uv);
+                }
+
+                // wrapped or degenerate coordinates are left to the baker
+                uint8_t minAlpha, maxAlpha;
+                if (!alphaData->uvAlphaRange(uvMin, uvMax, minAlpha, maxAlpha)) {
+                    bakeList.push_back(t);
                     continue;
                 }
+                if (minAlpha > alphaCutoff * 255.0f) {
+                    gd.indices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_OPAQUE_EXT;
+                } else if (maxAlpha < alphaCutoff * 255.0f) {
+                    gd.indices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_TRANSPARENT_EXT;
+                } else {
+                    bakeList.push_back(t);
+                }
+            }
+            if (bakeList.empty()) continue;
+
+            // the group is only baked again when its triangles, the texture or the bake level changed
+            std::vector<glm::vec2> uvs;
+            uvs.reserve(bakeList.size() * 3);
+            for (uint32_t t : bakeList) {
+                for (uint32_t k = 0; k < 3; k++) uvs.push_back(vertexViews[i][indexViews[i][t * 3 + k]].textureUV);
+            }
+            uint32_t subdivisionLevel = Renderer::options.ommBakerLevel;
+            uint64_t bakeKey = opacityBakeKey(texId, alphaData->revision, subdivisionLevel, uvs);
+
+            std::shared_ptr<const ChunkOpacityBake> bake;
+            if (reusable != nullptr) {
+                auto iter = reusable->find(bakeKey);
+                if (iter != reusable->end() && iter->second->textureID == texId &&
+                    iter->second->alphaRevision == alphaData->revision &&
+                    iter->second->subdivisionLevel == subdivisionLevel && iter->second->uvs == uvs) {
+                    bake = iter->second;
+                }
+            }
 
+            if (bake == nullptr) {
                 // Build local index buffer for this texture group
                 std::vector<uint32_t> localIndices;
-                localIndices.reserve(triList.size() * 3);
-                for (uint32_t t : triList) {
-                    localIndices.push_back(indices[i][t * 3 + 0]);
-                    localIndices.push_back(indices[i][t * 3 + 1]);
-                    localIndices.push_back(indices[i][t * 3 + 2]);
+                localIndices.reserve(bakeList.size() * 3);
+                for (uint32_t t : bakeList) {
+                    localIndices.push_back(indexViews[i][t * 3 + 0]);
+                    localIndices.push_back(indexViews[i][t * 3 + 1]);
+                    localIndices.push_back(indexViews[i][t * 3 + 2]);
                 }
 
                 OMMBaker::BakeInput input{};
                 input.alphaData = alphaData->alpha.data();
                 input.texWidth = alphaData->width;
                 input.texHeight = alphaData->height;
-                input.uvData = &vertices[i][0].textureUV;
+                input.uvData = &vertexViews[i][0].textureUV;
                 input.uvStrideBytes = sizeof(vk::VertexFormat::PBRTriangle);
                 input.indexData = localIndices.data();
                 input.indexCount = static_cast<uint32_t>(localIndices.size());
-                input.alphaCutoff = 0.05f;
-                input.maxSubdivisionLevel = Renderer::options.ommBakerLevel;
+                input.alphaCutoff = alphaCutoff;
+                input.maxSubdivisionLevel = subdivisionLevel;
 
                 OMMBaker::BakeResult result;
                 if (tlBaker && tlBaker->bake(input, result)) {
-                    bakingDone = true;
-                    uint32_t baseOffset = static_cast<uint32_t>(mergedArrayData.size());
-                    uint32_t baseDescIndex = static_cast<uint32_t>(mergedDescs.size());
-
-                    // Append array data
-                    mergedArrayData.insert(mergedArrayData.end(), result.arrayData.begin(), result.arrayData.end());
-
-                    // Append descriptors with adjusted offsets
+                    auto baked = std::make_shared<ChunkOpacityBake>();
+                    baked->textureID = texId;
+                    baked->alphaRevision = alphaData->revision;
+                    baked->subdivisionLevel = subdivisionLevel;
+                    baked->uvs = std::move(uvs);
+                    baked->arrayData = std::move(result.arrayData);
                     for (uint32_t d = 0; d < result.descArrayCount; d++) {
                         VkMicromapTriangleEXT desc{};
-                        desc.dataOffset = result.descOffsets[d] + baseOffset;
+                        desc.dataOffset = result.descOffsets[d];
                         desc.subdivisionLevel = result.descSubdivisionLevels[d];
                         desc.format = result.descFormats[d];
-                        mergedDescs.push_back(desc);
+                        baked->descs.push_back(desc);
                     }
-
-                    // Map per-triangle indices back to the original triangle positions
-                    // result.indexBuffer has one entry per triangle in triList order
-                    for (uint32_t li = 0; li < triList.size(); li++) {
-                        int32_t idx = result.indexBuffer[li];
-                        if (idx >= 0) {
-                            // Remap to merged desc array
-                            ommIndices[triList[li]] = idx + static_cast<int32_t>(baseDescIndex);
-                        } else {
-                            // Special index, keep as-is
-                            ommIndices[triList[li]] = idx;
-                        }
-                    }
-
-                    // Accumulate desc array histogram
+                    // result.indexBuffer has one entry per triangle in bakeList order
+                    baked->indices.assign(result.indexBuffer.begin(), result.indexBuffer.begin() + bakeList.size());
                     for (auto &uc : result.descArrayHistogram) {
-                        uint64_t key = (static_cast<uint64_t>(uc.subdivisionLevel) << 16) | uc.format;
-                        descHistMap[key] += uc.count;
+                        baked->descHistogram.push_back({uc.count, uc.subdivisionLevel, uc.format});
                     }
-                    // Accumulate index histogram
                     for (auto &uc : result.indexHistogram) {
-                        uint64_t key = (static_cast<uint64_t>(uc.subdivisionLevel) << 16) | uc.format;
-                        indexHistMap[key] += uc.count;
-                    }
-                } else {
-                    // Bake failed → fallback to special indices
-                    for (uint32_t t : triList) {
-                        ommIndices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT;
+                        baked->indexHistogram.push_back({uc.count, uc.subdivisionLevel, uc.format});
                     }
+                    bake = baked;
                 }
             }
 
-            // Upload OMM index buffer (always needed if useOMM)
-            auto ommIdxBuffer = vk::DeviceLocalBuffer::create(
-                vma, device, numTriangles * sizeof(int32_t),
-                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-                    VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
-                    VK_BUFFER_USAGE_MICROMAP_BUILD_INPUT_READ_ONLY_BIT_EXT);
-            ommIdxBuffer->uploadToStagingBuffer(ommIndices.data());
-            ommIndexBuffers.push_back(ommIdxBuffer);
-
-            if (bakingDone && !mergedDescs.empty()) {
-                auto &gd = ommGeometryData[i];
-
-                // Upload OMM array data
-                gd.arrayBuffer = vk::DeviceLocalBuffer::create(
-                    vma, device, mergedArrayData.size(),
-                    VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-                        VK_BUFFER_USAGE_MICROMAP_BUILD_INPUT_READ_ONLY_BIT_EXT);
-                gd.arrayBuffer->uploadToStagingBuffer(mergedArrayData.data());
-
-                // Upload OMM descriptor array (VkMicromapTriangleEXT)
-                gd.descBuffer = vk::DeviceLocalBuffer::create(
-                    vma, device, mergedDescs.size() * sizeof(VkMicromapTriangleEXT),
-                    VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-                        VK_BUFFER_USAGE_MICROMAP_BUILD_INPUT_READ_ONLY_BIT_EXT);
-                gd.descBuffer->uploadToStagingBuffer(mergedDescs.data());
-
-                // Convert histograms
-                for (auto &[key, count] : descHistMap) {
-                    VkMicromapUsageEXT usage{};
-                    usage.count = count;
-                    usage.subdivisionLevel = static_cast<uint32_t>(key >> 16);
-                    usage.format = static_cast<uint32_t>(key & 0xFFFF);
-                    gd.descHistogram.push_back(usage);
-                }
-                for (auto &[key, count] : indexHistMap) {
-                    VkMicromapUsageEXT usage{};
-                    usage.count = count;
-                    usage.subdivisionLevel = static_cast<uint32_t>(key >> 16);
-                    usage.format = static_cast<uint32_t>(key & 0xFFFF);
-                    gd.indexHistogram.push_back(usage);
+            if (bake == nullptr) {
+                // Bake failed → fallback to special indices
+                for (uint32_t t : bakeList) {
+                    gd.indices[t] = VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_UNKNOWN_OPAQUE_EXT;
                 }
+                continue;
+            }
+            if (bakes == nullptr) bakes = std::make_shared<ChunkOpacityBakes>();
+            (*bakes)[bakeKey] = bake;
 
-                // Query micromap build sizes
-                VkMicromapBuildInfoEXT buildInfo{};
-                buildInfo.sType = VK_STRUCTURE_TYPE_MICROMAP_BUILD_INFO_EXT;
-                buildInfo.type = VK_MICROMAP_TYPE_OPACITY_MICROMAP_EXT;
-                buildInfo.mode = VK_BUILD_MICROMAP_MODE_BUILD_EXT;
-                buildInfo.usageCountsCount = static_cast<uint32_t>(gd.descHistogram.size());
-                buildInfo.pUsageCounts = gd.descHistogram.data();
-
-                VkMicromapBuildSizesInfoEXT sizeInfo{};
-                sizeInfo.sType = VK_STRUCTURE_TYPE_MICROMAP_BUILD_SIZES_INFO_EXT;
-                vkGetMicromapBuildSizesEXT(device->vkDevice(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-                                           &buildInfo, &sizeInfo);
-
-                // Allocate micromap buffer and scratch
-                VkDeviceSize micromapSize = (sizeInfo.micromapSize + 255) & ~255ULL; // 256-byte align
-                gd.micromapBuffer = vk::DeviceLocalBuffer::create(
-                    vma, device, micromapSize,
-                    VK_BUFFER_USAGE_MICROMAP_STORAGE_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
-
-                if (sizeInfo.buildScratchSize > 0) {
-                    VkDeviceSize scratchSize = (sizeInfo.buildScratchSize + 255) & ~255ULL;
-                    gd.micromapScratchBuffer = vk::DeviceLocalBuffer::create(
-                        vma, device, scratchSize,
-                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
-                }
+            uint32_t baseOffset = static_cast<uint32_t>(gd.arrayData.size());
+            uint32_t baseDescIndex = static_cast<uint32_t>(gd.descs.size());
+
+            // Append array data and descriptors with adjusted offsets
+            gd.arrayData.insert(gd.arrayData.end(), bake->arrayData.begin(), bake->arrayData.end());
+            for (auto desc : bake->descs) {
+                desc.dataOffset += baseOffset;
+                gd.descs.push_back(desc);
+            }
 
-                // Create VkMicromapEXT
-                VkMicromapCreateInfoEXT createInfo{};
-                createInfo.sType = VK_STRUCTURE_TYPE_MICROMAP_CREATE_INFO_EXT;
-                createInfo.type = VK_MICROMAP_TYPE_OPACITY_MICROMAP_EXT;
-                createInfo.size = sizeInfo.micromapSize;
-                createInfo.buffer = gd.micromapBuffer->vkBuffer();
-                createInfo.offset = 0;
-                vkCreateMicromapEXT(device->vkDevice(), &createInfo, nullptr, &gd.micromap);
-                gd.device = device;
-
-                gd.hasMicromap = true;
+            // Map per-triangle indices back to the original triangle positions, special indices are kept as-is
+            for (uint32_t li = 0; li < bakeList.size(); li++) {
+                int32_t idx = bake->indices[li];
+                gd.indices[bakeList[li]] = idx >= 0 ? idx + static_cast<int32_t>(baseDescIndex) : idx;
             }
 
-            } // end Phase 2 (allowMicromapBake)
+            // Accumulate histograms
+            for (auto &uc : bake->descHistogram) {
+                uint64_t key = (static_cast<uint64_t>(uc.subdivisionLevel) << 16) | uc.format;
+                descHistMap[key] += uc.count;
+            }
+            for (auto &uc : bake->indexHistogram) {
+                uint64_t key = (static_cast<uint64_t>(uc.subdivisionLevel) << 16) | uc.format;
+                indexHistMap[key] += uc.count;
+            }
+        }
+
+        if (gd.descs.empty()) continue;
+
+        // Convert histograms
+        for (auto &[key, count] : descHistMap) {
+            VkMicromapUsageEXT usage{};
+            usage.count = count;
+            usage.subdivisionLevel = static_cast<uint32_t>(key >> 16);
+            usage.format = static_cast<uint32_t>(key & 0xFFFF);
+            gd.descHistogram.push_back(usage);
+        }
+        for (auto &[key, count] : indexHistMap) {
+            VkMicromapUsageEXT usage{};
+            usage.count = count;
+            usage.subdivisionLevel = static_cast<uint32_t>(key >> 16);
+            usage.format = static_cast<uint32_t>(key & 0xFFFF);
+            gd.indexHistogram.push_back(usage);
+        }
 #endif
-        } else if (useOMM) {
-            // WORLD_SOLID with OMM enabled: all-opaque special indices
-            // When pipeline has VK_PIPELINE_CREATE_RAY_TRACING_OPACITY_MICROMAP_BIT_EXT,
-            // ALL geometries in the BLAS must have OMM pNext attached
-            uint32_t numTriangles = static_cast<uint32_t>(indices[i].size()) / 3;
-            std::vector<int32_t> ommIndices(numTriangles, VK_OPACITY_MICROMAP_SPECIAL_INDEX_FULLY_OPAQUE_EXT);
-            auto ommIdxBuffer = vk::DeviceLocalBuffer::create(
-                vma, device, numTriangles * sizeof(int32_t),
+    }
+}
+
+void ChunkBuildData::upload() {
+    auto framework = Renderer::instance().framework();
+    auto vma = framework->vma();
+    auto device = framework->device();
+    auto physicalDevice = framework->physicalDevice();
+
+    for (int i = 0; i < geometryCount; i++) {
+        // with a staging slab the geometry is already in upload memory, copy from there directly
+        bool ownStaging = stagingSlab == nullptr;
+
+        auto vertexBuffer = vk::DeviceLocalBuffer::create(
+            vma, device, ownStaging, vertexViews[i].size() * sizeof(vk::VertexFormat::PBRTriangle),
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        if (ownStaging) {
+            vertexBuffer->uploadToStagingBuffer(vertexViews[i].data());
+        } else {
+            vertexBuffer->bindStagingBuffer(stagingSlab->buffer, vertexOffsets[i]);
+        }
+        vertexBuffers.push_back(vertexBuffer);
+
+        auto indexBuffer = vk::DeviceLocalBuffer::create(
+            vma, device, ownStaging, indexViews[i].size() * sizeof(uint32_t),
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        if (ownStaging) {
+            indexBuffer->uploadToStagingBuffer(indexViews[i].data());
+        } else {
+            indexBuffer->bindStagingBuffer(stagingSlab->buffer, indexOffsets[i]);
+        }
+        indexBuffers.push_back(indexBuffer);
+
+        // merged quads only go into the BLAS, the hit shaders still shade from the buffers above
+        if (i < greedyGeometry.size() && !greedyGeometry[i].positions.empty()) {
+            auto &greedy = greedyGeometry[i];
+
+            auto tracePositionBuffer = vk::DeviceLocalBuffer::create(
+                vma, device, greedy.positions.size() * sizeof(vk::VertexFormat::PositionOnly),
                 VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-                    VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
-                    VK_BUFFER_USAGE_MICROMAP_BUILD_INPUT_READ_ONLY_BIT_EXT);
-            ommIdxBuffer->uploadToStagingBuffer(ommIndices.data());
-            ommIndexBuffers.push_back(ommIdxBuffer);
+                    VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+            tracePositionBuffer->uploadToStagingBuffer(greedy.positions.data());
+            tracePositionBuffers.push_back(tracePositionBuffer);
+
+            auto traceIndexBuffer = vk::DeviceLocalBuffer::create(
+                vma, device, greedy.indices.size() * sizeof(uint32_t),
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                    VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+            traceIndexBuffer->uploadToStagingBuffer(greedy.indices.data());
+            traceIndexBuffers.push_back(traceIndexBuffer);
+
+            auto quadRemapBuffer = vk::DeviceLocalBuffer::create(
+                vma, device, greedy.remap.size() * sizeof(uint32_t),
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+            quadRemapBuffer->uploadToStagingBuffer(greedy.remap.data());
+            quadRemapBuffers.push_back(quadRemapBuffer);
         } else {
+            tracePositionBuffers.push_back(nullptr);
+            traceIndexBuffers.push_back(nullptr);
+            quadRemapBuffers.push_back(nullptr);
+        }
+
+        auto &gd = ommGeometryData[i];
+        if (gd.indices.empty()) {
             ommIndexBuffers.push_back(nullptr);
+            continue;
         }
+
+        // Upload OMM index buffer (always needed if useOMM)
+        auto ommIdxBuffer = vk::DeviceLocalBuffer::create(
+            vma, device, gd.indices.size() * sizeof(int32_t),
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+                VK_BUFFER_USAGE_MICROMAP_BUILD_INPUT_READ_ONLY_BIT_EXT);
+        ommIdxBuffer->uploadToStagingBuffer(gd.indices.data());
+        ommIndexBuffers.push_back(ommIdxBuffer);
+
+#ifdef MCVR_ENABLE_OMM
+        if (!gd.descs.empty()) {
+            // Upload OMM array data
+            gd.arrayBuffer = vk::DeviceLocalBuffer::create(
+                vma, device, gd.arrayData.size(),
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_MICROMAP_BUILD_INPUT_READ_ONLY_BIT_EXT);
+            gd.arrayBuffer->uploadToStagingBuffer(gd.arrayData.data());
+
+            // Upload OMM descriptor array (VkMicromapTriangleEXT)
+            gd.descBuffer = vk::DeviceLocalBuffer::create(
+                vma, device, gd.descs.size() * sizeof(VkMicromapTriangleEXT),
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_MICROMAP_BUILD_INPUT_READ_ONLY_BIT_EXT);
+            gd.descBuffer->uploadToStagingBuffer(gd.descs.data());
+
+            // Query micromap build sizes
+            VkMicromapBuildInfoEXT buildInfo{};
+            buildInfo.sType = VK_STRUCTURE_TYPE_MICROMAP_BUILD_INFO_EXT;
+            buildInfo.type = VK_MICROMAP_TYPE_OPACITY_MICROMAP_EXT;
+            buildInfo.mode = VK_BUILD_MICROMAP_MODE_BUILD_EXT;
+            buildInfo.usageCountsCount = static_cast<uint32_t>(gd.descHistogram.size());
+            buildInfo.pUsageCounts = gd.descHistogram.data();
+
+            VkMicromapBuildSizesInfoEXT sizeInfo{};
+            sizeInfo.sType = VK_STRUCTURE_TYPE_MICROMAP_BUILD_SIZES_INFO_EXT;
+            vkGetMicromapBuildSizesEXT(device->vkDevice(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo,
+                                       &sizeInfo);
+
+            // Allocate micromap buffer and scratch
+            VkDeviceSize micromapSize = (sizeInfo.micromapSize + 255) & ~255ULL; // 256-byte align
+            gd.micromapBuffer = vk::DeviceLocalBuffer::create(
+                vma, device, micromapSize,
+                VK_BUFFER_USAGE_MICROMAP_STORAGE_BIT_EXT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+
+            if (sizeInfo.buildScratchSize > 0) {
+                VkDeviceSize scratchSize = (sizeInfo.buildScratchSize + 255) & ~255ULL;
+                gd.micromapScratchBuffer = vk::DeviceLocalBuffer::create(
+                    vma, device, scratchSize,
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+            }
+
+            // Create VkMicromapEXT
+            VkMicromapCreateInfoEXT createInfo{};
+            createInfo.sType = VK_STRUCTURE_TYPE_MICROMAP_CREATE_INFO_EXT;
+            createInfo.type = VK_MICROMAP_TYPE_OPACITY_MICROMAP_EXT;
+            createInfo.size = sizeInfo.micromapSize;
+            createInfo.buffer = gd.micromapBuffer->vkBuffer();
+            createInfo.offset = 0;
+            vkCreateMicromapEXT(device->vkDevice(), &createInfo, nullptr, &gd.micromap);
+            gd.device = device;
+
+            gd.hasMicromap = true;
+        }
+#endif
+
+        // the staging buffers hold their own copies now
+        gd.indices = {};
+        gd.arrayData = {};
+        gd.descs = {};
     }
 
     blasBuilder = vk::BLASBuilder::create();
     auto blasGeometryBuilder = blasBuilder->beginGeometries();
     for (int i = 0; i < geometryCount; i++) {
         bool isOpaque = geometryTypes[i] == World::WORLD_SOLID;
-        if (ommIndexBuffers[i] != nullptr) {
-            uint32_t numTriangles = static_cast<uint32_t>(indices[i].size()) / 3;
+        if (tracePositionBuffers[i] != nullptr) {
+            // merged geometry is never baked, it is WORLD_SOLID only
+            auto &greedy = greedyGeometry[i];
+            if (ommIndexBuffers[i] != nullptr) {
+                blasGeometryBuilder->defineTriangleGeomrtry<vk::VertexFormat::PositionOnly>(
+                    tracePositionBuffers[i], greedy.positions.size(), traceIndexBuffers[i], greedy.indices.size(),
+                    isOpaque, ommIndexBuffers[i]->bufferAddress(), greedy.indices.size() / 3);
+            } else {
+                blasGeometryBuilder->defineTriangleGeomrtry<vk::VertexFormat::PositionOnly>(
+                    tracePositionBuffers[i], greedy.positions.size(), traceIndexBuffers[i], greedy.indices.size(),
+                    isOpaque);
+            }
+        } else if (ommIndexBuffers[i] != nullptr) {
+            uint32_t numTriangles = static_cast<uint32_t>(indexViews[i].size()) / 3;
             if (ommGeometryData[i].hasMicromap) {
                 blasGeometryBuilder->defineTriangleGeomrtryWithMicromap<vk::VertexFormat::PBRTriangle>(
-                    vertexBuffers[i], vertices[i].size(), indexBuffers[i], indices[i].size(),
+                    vertexBuffers[i], vertexViews[i].size(), indexBuffers[i], indexViews[i].size(),
                     isOpaque, ommIndexBuffers[i]->bufferAddress(), numTriangles,
                     ommGeometryData[i].micromap,
                     ommGeometryData[i].indexHistogram.data(),
                     static_cast<uint32_t>(ommGeometryData[i].indexHistogram.size()));
             } else {
                 blasGeometryBuilder->defineTriangleGeomrtry<vk::VertexFormat::PBRTriangle>(
-                    vertexBuffers[i], vertices[i].size(), indexBuffers[i], indices[i].size(),
+                    vertexBuffers[i], vertexViews[i].size(), indexBuffers[i], indexViews[i].size(),
                     isOpaque, ommIndexBuffers[i]->bufferAddress(), numTriangles);
             }
         } else {
             blasGeometryBuilder->defineTriangleGeomrtry<vk::VertexFormat::PBRTriangle>(
-                vertexBuffers[i], vertices[i].size(), indexBuffers[i], indices[i].size(),
+                vertexBuffers[i], vertexViews[i].size(), indexBuffers[i], indexViews[i].size(),
                 isOpaque);
         }
     }
@@ -375,6 +602,37 @@ void ChunkBuildData::build(bool allowMicromapBake, bool skipOMM) {
                ->build(device);
 }
 
+std::shared_ptr<std::vector<ChunkTraceGeometry>> ChunkBuildData::traceGeometries() {
+    auto geometries = std::make_shared<std::vector<ChunkTraceGeometry>>();
+    for (int i = 0; i < geometryCount; i++) {
+        if (ommGeometryData[i].hasMicromap) return nullptr;
+
+        bool opaque = geometryTypes[i] == World::WORLD_SOLID;
+        if (tracePositionBuffers[i] != nullptr) {
+            geometries->push_back({
+                .vertexBuffer = tracePositionBuffers[i],
+                .indexBuffer = traceIndexBuffers[i],
+                .ommIndexBuffer = ommIndexBuffers[i],
+                .vertexCount = static_cast<uint32_t>(greedyGeometry[i].positions.size()),
+                .indexCount = static_cast<uint32_t>(greedyGeometry[i].indices.size()),
+                .positionOnly = true,
+                .opaque = opaque,
+            });
+        } else {
+            geometries->push_back({
+                .vertexBuffer = vertexBuffers[i],
+                .indexBuffer = indexBuffers[i],
+                .ommIndexBuffer = ommIndexBuffers[i],
+                .vertexCount = static_cast<uint32_t>(vertexViews[i].size()),
+                .indexCount = static_cast<uint32_t>(indexViews[i].size()),
+                .positionOnly = false,
+                .opaque = opaque,
+            });
+        }
+    }
+    return geometries;
+}
+
 ChunkBuildDataBatch::ChunkBuildDataBatch(uint32_t maxBatchSize,
                                          std::set<int64_t> &queuedIndexSet,
                                          std::vector<std::shared_ptr<Chunk1>> &chunks,
@@ -400,9 +658,24 @@ ChunkBuildDataBatch::ChunkBuildDataBatch(uint32_t maxBatchSize,
         auto iter = queuedIndexSet.find(queuedIndices[i]);
         if (iter != queuedIndexSet.end()) { queuedIndexSet.erase(iter); }
 
+        auto &chunk1 = chunks[queuedIndices[i]];
         auto data = chunkBuildDatas[queuedIndices[i]];
+        // a build the worker already baked released the bakes it reused
+        if (!data->opacityPrepared) data->previousBakes = chunk1->opacityBakes;
         data->build();
         batchData.push_back(data);
+
+        glm::vec3 lo(chunk1->x, chunk1->y, chunk1->z);
+        if (data->bakes != nullptr &&
+            glm::length(glm::clamp(cameraPos, lo, lo + 16.0f) - cameraPos) < OPACITY_BAKE_DISTANCE) {
+            chunk1->opacityBakes = data->bakes;
+        }
+
+        // no OMM for the proxy, a special index BLAS without micromap is what the important path avoids as well
+        if (data->lodProxy != nullptr) {
+            data->lodProxy->build(false, true);
+            batchData.push_back(data->lodProxy);
+        }
     }
 }
 
@@ -423,73 +696,80 @@ ChunkBuildScheduler::ChunkBuildScheduler(std::set<int64_t> &queuedIndex,
     auto framework = Renderer::instance().framework();
     auto device = framework->device();
 
-    uint32_t numFences = chunkBuildingTotalBatches_;
-    for (int i = 0; i < numFences; i++) { freeFences_.push(vk::Fence::create(device)); }
+    // batches finish in submission order on the secondary queue, one counter tells which of them did
+    if (device->hasTimelineSemaphore()) timeline_ = vk::Semaphore::create(device, uint64_t{0});
+    for (uint32_t i = 0; i < chunkBuildingTotalBatches_; i++) {
+        freeSlots_.push({
+            .commandBuffer = framework->worldAsyncCommandBuffer(i),
+            .fence = timeline_ == nullptr ? vk::Fence::create(device) : nullptr,
+        });
+    }
 }
 
 void ChunkBuildScheduler::tryCheckBatchesFinish() {
-    auto framework = Renderer::instance().framework();
-    auto device = framework->device();
-
-    std::unique_lock<std::recursive_mutex> lock(mutex_);
-    auto iterFence = buildingFences_.begin();
-    auto iterBatch = buildingBatches_.begin();
-    for (; iterFence != buildingFences_.end() && iterBatch != buildingBatches_.end();) {
-        if (vkWaitForFences(device->vkDevice(), 1, &(*iterFence)->vkFence(), true, 0) == VK_SUCCESS) {
-            vkResetFences(device->vkDevice(), 1, &(*iterFence)->vkFence());
-            freeFences_.push(*iterFence);
-
-            for (auto chunkBuildData : (*iterBatch)->batchData) {
-                chunks_[chunkBuildData->id]->enqueue(chunkBuildData);
-
-                ChunkPackedData data = {
-                    .geometryCount = chunkBuildData->geometryCount,
-                };
-
-                chunkPackedData_->uploadToBuffer(&data, sizeof(ChunkPackedData),
-                                                 chunkBuildData->id * sizeof(ChunkPackedData));
-            }
-
-            iterFence = buildingFences_.erase(iterFence);
-            iterBatch = buildingBatches_.erase(iterBatch);
-        }
-    }
+    finishBatches(false);
 }
 
 void ChunkBuildScheduler::waitAllBatchesFinish() {
+    finishBatches(true);
+}
+
+void ChunkBuildScheduler::finishBatches(bool wait) {
     auto framework = Renderer::instance().framework();
     auto device = framework->device();
 
     std::unique_lock<std::recursive_mutex> lock(mutex_);
-    auto iterFence = buildingFences_.begin();
-    auto iterBatch = buildingBatches_.begin();
-    for (; iterFence != buildingFences_.end() && iterBatch != buildingBatches_.end();) {
-        if (vkWaitForFences(device->vkDevice(), 1, &(*iterFence)->vkFence(), true, UINT64_MAX) == VK_SUCCESS) {
-            vkResetFences(device->vkDevice(), 1, &(*iterFence)->vkFence());
-            freeFences_.push(*iterFence);
+    if (buildingSlots_.empty()) return;
+
+    uint64_t finishedValue = 0;
+    if (timeline_ != nullptr) {
+        if (wait) {
+            VkSemaphoreWaitInfo waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &timeline_->vkSemaphore();
+            waitInfo.pValues = &buildingSlots_.back().timelineValue;
+            vkWaitSemaphores(device->vkDevice(), &waitInfo, UINT64_MAX);
+        }
+        vkGetSemaphoreCounterValue(device->vkDevice(), timeline_->vkSemaphore(), &finishedValue);
+    }
 
-            for (auto chunkBuildData : (*iterBatch)->batchData) {
-                chunks_[chunkBuildData->id]->enqueue(chunkBuildData);
+    auto iterSlot = buildingSlots_.begin();
+    auto iterBatch = buildingBatches_.begin();
+    for (; iterSlot != buildingSlots_.end() && iterBatch != buildingBatches_.end();) {
+        if (timeline_ != nullptr) {
+            if (iterSlot->timelineValue > finishedValue) break;
+        } else {
+            if (vkWaitForFences(device->vkDevice(), 1, &iterSlot->fence->vkFence(), true, wait ? UINT64_MAX : 0) !=
+                VK_SUCCESS) {
+                break;
+            }
+            vkResetFences(device->vkDevice(), 1, &iterSlot->fence->vkFence());
+        }
+        freeSlots_.push(*iterSlot);
 
-                ChunkPackedData data = {
-                    .geometryCount = chunkBuildData->geometryCount,
-                };
+        for (auto chunkBuildData : (*iterBatch)->batchData) {
+            chunks_[chunkBuildData->id]->enqueue(chunkBuildData);
+            if (chunkBuildData->lod) continue;
 
-                chunkPackedData_->uploadToBuffer(&data, sizeof(ChunkPackedData),
-                                                 chunkBuildData->id * sizeof(ChunkPackedData));
-            }
+            ChunkPackedData data = {
+                .geometryCount = chunkBuildData->geometryCount,
+            };
 
-            iterFence = buildingFences_.erase(iterFence);
-            iterBatch = buildingBatches_.erase(iterBatch);
+            chunkPackedData_->uploadToBuffer(&data, sizeof(ChunkPackedData),
+                                             chunkBuildData->id * sizeof(ChunkPackedData));
         }
+
+        iterSlot = buildingSlots_.erase(iterSlot);
+        iterBatch = buildingBatches_.erase(iterBatch);
     }
 }
 
 void ChunkBuildScheduler::tryScheduleBatches(uint32_t maxBatchSize) {
     if (!Renderer::instance().framework()->isRunning()) return;
     std::unique_lock<std::recursive_mutex> lock(mutex_);
-    if (!freeFences_.empty() && !queuedIndex_.empty()) {
-        auto fence = freeFences_.front();
+    if (!freeSlots_.empty() && !queuedIndex_.empty()) {
+        auto slot = freeSlots_.front();
 
         glm::vec3 cameraPos = Renderer::instance().world()->getCameraPos();
         auto chunkBuildDataBatch =
@@ -501,7 +781,7 @@ void ChunkBuildScheduler::tryScheduleBatches(uint32_t maxBatchSize) {
         auto physicalDevice = Renderer::instance().framework()->physicalDevice();
         auto secondaryQueueIndex = physicalDevice->secondaryQueueIndex();
 
-        auto worldAsyncBuffer = framework->worldAsyncCommandBuffer();
+        auto worldAsyncBuffer = slot.commandBuffer;
 
         if (chunkBuildDataBatch->batchData.size() > 0) {
             worldAsyncBuffer->begin();
@@ -511,6 +791,11 @@ void ChunkBuildScheduler::tryScheduleBatches(uint32_t maxBatchSize) {
                 for (int i = 0; i < chunkBuildData->geometryCount; i++) {
                     chunkBuildData->vertexBuffers[i]->uploadToBuffer(worldAsyncBuffer);
                     chunkBuildData->indexBuffers[i]->uploadToBuffer(worldAsyncBuffer);
+                    if (chunkBuildData->tracePositionBuffers[i] != nullptr) {
+                        chunkBuildData->tracePositionBuffers[i]->uploadToBuffer(worldAsyncBuffer);
+                        chunkBuildData->traceIndexBuffers[i]->uploadToBuffer(worldAsyncBuffer);
+                        chunkBuildData->quadRemapBuffers[i]->uploadToBuffer(worldAsyncBuffer);
+                    }
                     if (chunkBuildData->ommIndexBuffers[i] != nullptr) {
                         chunkBuildData->ommIndexBuffers[i]->uploadToBuffer(worldAsyncBuffer);
                     }
@@ -553,6 +838,21 @@ void ChunkBuildScheduler::tryScheduleBatches(uint32_t maxBatchSize) {
                         .buffer = chunkBuildData->indexBuffers[i],
                     });
 
+                    if (chunkBuildData->tracePositionBuffers[i] != nullptr) {
+                        for (auto &traceBuffer :
+                             {chunkBuildData->tracePositionBuffers[i], chunkBuildData->traceIndexBuffers[i]}) {
+                            bufferBarriers.push_back(vk::CommandBuffer::BufferMemoryBarrier{
+                                .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+                                .dstStageMask = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+                                .srcQueueFamilyIndex = secondaryQueueIndex,
+                                .dstQueueFamilyIndex = secondaryQueueIndex,
+                                .buffer = traceBuffer,
+                            });
+                        }
+                    }
+
                     if (chunkBuildData->ommIndexBuffers[i] != nullptr) {
                         bufferBarriers.push_back(vk::CommandBuffer::BufferMemoryBarrier{
                             .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
@@ -641,20 +941,31 @@ void ChunkBuildScheduler::tryScheduleBatches(uint32_t maxBatchSize) {
 
             worldAsyncBuffer->end();
 
-            VkSubmitInfo vkSubmitInfo = {};
-            vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            vkSubmitInfo.waitSemaphoreCount = 0;
-            vkSubmitInfo.pWaitSemaphores = nullptr;
-            vkSubmitInfo.pWaitDstStageMask = nullptr;
-            vkSubmitInfo.commandBufferCount = 1;
-            vkSubmitInfo.pCommandBuffers = &worldAsyncBuffer->vkCommandBuffer();
-            vkSubmitInfo.signalSemaphoreCount = 0;
-            vkSubmitInfo.pSignalSemaphores = nullptr;
+            VkCommandBufferSubmitInfo commandBufferInfo{};
+            commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+            commandBufferInfo.commandBuffer = worldAsyncBuffer->vkCommandBuffer();
+
+            VkSemaphoreSubmitInfo signalInfo{};
+            if (timeline_ != nullptr) {
+                slot.timelineValue = ++timelineValue_;
+                signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+                signalInfo.semaphore = timeline_->vkSemaphore();
+                signalInfo.value = slot.timelineValue;
+                signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            }
+
+            VkSubmitInfo2 submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+            submitInfo.commandBufferInfoCount = 1;
+            submitInfo.pCommandBufferInfos = &commandBufferInfo;
+            submitInfo.signalSemaphoreInfoCount = timeline_ != nullptr ? 1 : 0;
+            submitInfo.pSignalSemaphoreInfos = &signalInfo;
 
-            vkQueueSubmit(device->secondaryQueue(), 1, &vkSubmitInfo, fence->vkFence());
+            vkQueueSubmit2(device->secondaryQueue(), 1, &submitInfo,
+                           slot.fence != nullptr ? slot.fence->vkFence() : VK_NULL_HANDLE);
 
-            freeFences_.pop();
-            buildingFences_.push_back(fence);
+            freeSlots_.pop();
+            buildingSlots_.push_back(slot);
             buildingBatches_.push_back(chunkBuildDataBatch);
         }
     }
@@ -683,6 +994,44 @@ void Chunk1::enqueue(std::shared_ptr<ChunkBuildData> chunkBuildData) {
     auto framework = Renderer::instance().framework();
     auto &gc = framework->gc();
 
+    if (chunkBuildData->lod) {
+        // a proxy is only valid for the geometry it was generated from, not for an older or newer one
+        if (chunkBuildData->version >= blasVersion && chunkBuildData->version > lodBlasVersion) {
+            lodBlasVersion = chunkBuildData->version;
+
+            gc.collect(lodTraceGeometries);
+            lodTraceGeometries = chunkBuildData->traceGeometries();
+
+            gc.collect(lodBlas);
+            lodBlas = chunkBuildData->blas;
+
+            gc.collect(lodVertexBuffers);
+            lodVertexBuffers = std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
+                std::move(chunkBuildData->vertexBuffers));
+
+            gc.collect(lodIndexBuffers);
+            lodIndexBuffers = std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
+                std::move(chunkBuildData->indexBuffers));
+
+            lodGeometryCount = chunkBuildData->geometryCount;
+            lodGeometryTypes =
+                std::make_shared<std::vector<World::GeometryTypes>>(std::move(chunkBuildData->geometryTypes));
+        } else {
+            gc.collect(chunkBuildData->blas);
+
+            gc.collect(std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
+                std::move(chunkBuildData->vertexBuffers)));
+
+            gc.collect(std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
+                std::move(chunkBuildData->indexBuffers)));
+        }
+
+        // the buffers hold the geometry now, the proxy never goes back to the cpu
+        chunkBuildData->vertices = {};
+        chunkBuildData->indices = {};
+        return;
+    }
+
     lastUpdate = std::chrono::steady_clock::now();
     x = chunkBuildData->x;
     y = chunkBuildData->y;
@@ -691,6 +1040,9 @@ void Chunk1::enqueue(std::shared_ptr<ChunkBuildData> chunkBuildData) {
     if (chunkBuildData->version > blasVersion) {
         blasVersion = chunkBuildData->version;
 
+        gc.collect(traceGeometries);
+        traceGeometries = chunkBuildData->traceGeometries();
+
         gc.collect(blas);
         blas = chunkBuildData->blas;
 
@@ -701,6 +1053,20 @@ void Chunk1::enqueue(std::shared_ptr<ChunkBuildData> chunkBuildData) {
         gc.collect(indexBuffers);
         indexBuffers = std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
             std::move(chunkBuildData->indexBuffers));
+
+        gc.collect(quadRemapBuffers);
+        quadRemapBuffers = std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
+            std::move(chunkBuildData->quadRemapBuffers));
+
+        gc.collect(traceBuffers);
+        traceBuffers = std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
+            std::move(chunkBuildData->tracePositionBuffers));
+        traceBuffers->insert(traceBuffers->end(), chunkBuildData->traceIndexBuffers.begin(),
+                             chunkBuildData->traceIndexBuffers.end());
+        chunkBuildData->traceIndexBuffers.clear();
+
+        // without a proxy following in the same batch the current one shows outdated geometry
+        if (chunkBuildData->lodProxy == nullptr) releaseLod();
     } else {
         gc.collect(chunkBuildData->blas);
 
@@ -709,8 +1075,20 @@ void Chunk1::enqueue(std::shared_ptr<ChunkBuildData> chunkBuildData) {
 
         gc.collect(std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
             std::move(chunkBuildData->indexBuffers)));
+
+        gc.collect(std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
+            std::move(chunkBuildData->quadRemapBuffers)));
+
+        gc.collect(std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
+            std::move(chunkBuildData->tracePositionBuffers)));
+
+        gc.collect(std::make_shared<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>>(
+            std::move(chunkBuildData->traceIndexBuffers)));
     }
 
+    // the BLAS is built, the merged quads are on the gpu
+    chunkBuildData->greedyGeometry = {};
+
     allVertexCount = chunkBuildData->allVertexCount;
     allIndexCount = chunkBuildData->allIndexCount;
     geometryCount = chunkBuildData->geometryCount;
@@ -736,6 +1114,40 @@ void Chunk1::invalidate() {
 
     gc.collect(indexBuffers);
     indexBuffers = nullptr;
+
+    gc.collect(quadRemapBuffers);
+    quadRemapBuffers = nullptr;
+
+    gc.collect(traceBuffers);
+    traceBuffers = nullptr;
+
+    gc.collect(traceGeometries);
+    traceGeometries = nullptr;
+
+    releaseLod();
+}
+
+void Chunk1::releaseLod() {
+    auto framework = Renderer::instance().framework();
+    auto &gc = framework->gc();
+
+    lodActive = false;
+    lodBlasVersion = -1;
+
+    gc.collect(lodBlas);
+    lodBlas = nullptr;
+
+    gc.collect(lodVertexBuffers);
+    lodVertexBuffers = nullptr;
+
+    gc.collect(lodIndexBuffers);
+    lodIndexBuffers = nullptr;
+
+    gc.collect(lodTraceGeometries);
+    lodTraceGeometries = nullptr;
+
+    lodGeometryCount = 0;
+    lodGeometryTypes = nullptr;
 }
 
 std::shared_ptr<ChunkRenderData> Chunk1::tryGetValid() {
@@ -782,6 +1194,25 @@ void Chunks::reset(uint32_t numChunks) {
     chunkBuildDatas_.resize(numChunks);
     queuedIndex_.clear();
 
+    lightRecords_ = vk::DeviceLocalBuffer::create(vma, device, false,
+                                                  INITIAL_LIGHT_RECORDS * sizeof(vk::Data::ChunkLightRecord),
+                                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    lightRecordCount_ = 0;
+    lightSlots_.assign(numChunks, {});
+    freeLightSlots_.clear();
+    dirtyLightChunks_.clear();
+
+    // the queues are idle, nothing is left to wait for
+    regions_.clear();
+    chunkRegions_.assign(numChunks, nullptr);
+    buildingRegions_.clear();
+    if (regionCommandBuffer_ == nullptr) {
+        regionCommandBuffer_ = vk::CommandBuffer::create(device, framework->asyncCommandPool());
+        regionFence_ = vk::Fence::create(device);
+    } else {
+        vkResetFences(device->vkDevice(), 1, &regionFence_->vkFence());
+    }
+
     for (int i = 0; i < numChunks; i++) {
         chunks_[i] = Chunk1::create();
         chunkBuildDatas_[i] = nullptr;
@@ -829,47 +1260,122 @@ void Chunks::invalidateChunk(int id) {
 }
 
 // maybe called async
-void Chunks::queueChunkBuild(ChunkBuildTask task) {
+bool Chunks::queueChunkBuild(ChunkBuildTask task) {
+    ProfilerCpuScope profilerScope("Chunks::queueChunkBuild");
+
     uint32_t allVertexCount = 0, allIndexCount = 0;
     std::vector<World::GeometryTypes> geometryTypes;
-    std::vector<std::vector<vk::VertexFormat::PBRTriangle>> vertices;
-    std::vector<std::vector<uint32_t>> indices;
+    std::shared_ptr<ChunkBuildData> chunkBuildData;
+
+    auto framework = Renderer::instance().framework();
+    auto vma = framework->vma();
+    auto device = framework->device();
+    auto physicalDevice = framework->physicalDevice();
 
     for (int i = 0; i < task.geometryCount; i++) {
-        World::GeometryTypes geometryType = static_cast<World::GeometryTypes>(task.geometryTypes[i]);
-        int geometryTexture = task.geometryTextures[i];
-        geometryTypes.push_back(geometryType);
+        geometryTypes.push_back(static_cast<World::GeometryTypes>(task.geometryTypes[i]));
+    }
+
+    if (task.stagingSlab >= 0) {
+        std::vector<uint32_t> vertexCounts, indexCounts;
+        for (int i = 0; i < task.geometryCount; i++) {
+            uint32_t vertexCount = task.vertexCounts[i];
+            uint32_t indexCount = (vertexCount + 3) / 4 * 6;
+            vertexCounts.push_back(vertexCount);
+            indexCounts.push_back(indexCount);
+            allVertexCount += vertexCount;
+            allIndexCount += indexCount;
+        }
 
-        auto &geometryVertices = vertices.emplace_back();
-        auto &geometryIndices = indices.emplace_back();
+        // a rejected slab stays with Java, which builds the section from the heap instead
+        std::shared_ptr<ChunkStagingSlab> slab;
+        {
+            std::unique_lock<std::recursive_mutex> lock(mutex_);
+            auto iter = stagingSlabs_.find(task.stagingSlab);
+            if (iter == stagingSlabs_.end()) {
+                std::cerr << "[Chunks] unknown staging slab " << task.stagingSlab << std::endl;
+                return false;
+            }
+            if (allVertexCount * sizeof(vk::VertexFormat::PBRTriangle) > iter->second->vertexCapacity ||
+                allIndexCount * sizeof(uint32_t) > iter->second->indexCapacity) {
+                std::cerr << "[Chunks] chunk geometry exceeds staging slab " << task.stagingSlab << std::endl;
+                return false;
+            }
+            slab = iter->second;
+            stagingSlabs_.erase(iter);
+        }
 
-        geometryVertices.resize(task.vertexCounts[i]);
-        std::memcpy(geometryVertices.data(), task.vertices[i],
-                    task.vertexCounts[i] * sizeof(vk::VertexFormat::PBRTriangle));
+        chunkBuildData = ChunkBuildData::create(task.id, task.x, task.y, task.z, 0, allVertexCount, allIndexCount,
+                                                task.geometryCount, std::move(geometryTypes), slab, vertexCounts,
+                                                indexCounts);
 
-        for (int j = 0; j < task.vertexCounts[i]; j += 4) {
-            geometryIndices.push_back(j + 0);
-            geometryIndices.push_back(j + 1);
-            geometryIndices.push_back(j + 2);
-            geometryIndices.push_back(j + 2);
-            geometryIndices.push_back(j + 3);
-            geometryIndices.push_back(j + 0);
+        // generate the quad indices in place behind the vertices Java already wrote
+        for (int i = 0; i < task.geometryCount; i++) {
+            fillQuadIndices(chunkBuildData->indexViews[i].data(), vertexCounts[i]);
         }
+        slab->buffer->flush();
+    } else {
+        std::vector<std::vector<vk::VertexFormat::PBRTriangle>> vertices;
+        std::vector<std::vector<uint32_t>> indices;
+
+        for (int i = 0; i < task.geometryCount; i++) {
+            auto &geometryVertices = vertices.emplace_back();
+            auto &geometryIndices = indices.emplace_back();
 
-        allVertexCount += geometryVertices.size();
-        allIndexCount += geometryIndices.size();
+            geometryVertices.resize(task.vertexCounts[i]);
+            std::memcpy(geometryVertices.data(), task.vertices[i],
+                        task.vertexCounts[i] * sizeof(vk::VertexFormat::PBRTriangle));
+
+            geometryIndices.resize((task.vertexCounts[i] + 3) / 4 * 6);
+            fillQuadIndices(geometryIndices.data(), task.vertexCounts[i]);
+
+            allVertexCount += geometryVertices.size();
+            allIndexCount += geometryIndices.size();
+        }
+
+        chunkBuildData =
+            ChunkBuildData::create(task.id, task.x, task.y, task.z, 0, allVertexCount, allIndexCount,
+                                   task.geometryCount, std::move(geometryTypes), std::move(vertices), std::move(indices));
     }
 
-    auto framework = Renderer::instance().framework();
-    auto vma = framework->vma();
-    auto device = framework->device();
-    auto physicalDevice = framework->physicalDevice();
+    if (Renderer::options.chunkGreedyMerge) {
+        ProfilerCpuScope greedyProfilerScope("Chunks::queueChunkBuild::greedy");
+
+        chunkBuildData->greedyGeometry.resize(chunkBuildData->geometryCount);
+        for (int i = 0; i < chunkBuildData->geometryCount; i++) {
+            if (chunkBuildData->geometryTypes[i] != World::WORLD_SOLID) continue;
+            buildChunkGreedyGeometry(chunkBuildData->vertexViews[i], chunkBuildData->greedyGeometry[i]);
+        }
+    }
+
+    // only sections far enough to trace a proxy get one, judged from where updateLods last saw the camera. A section
+    // built closer gets its proxy with the next build after the camera moved away
+    bool lodCandidate = false;
+    if (Renderer::options.chunkLodEnabled) {
+        std::unique_lock<std::recursive_mutex> lock(mutex_);
+        glm::dvec3 lo(task.x, task.y, task.z);
+        lodCandidate = glm::length(glm::clamp(lodCameraPos_, lo, lo + 16.0) - lodCameraPos_) >= chunkLodNearDistance();
+    }
+
+    // the proxy is generated here on the calling build worker, the render thread only uploads it
+    std::shared_ptr<ChunkBuildData> lodProxy;
+    auto textures = Renderer::instance().textures();
+    if (lodCandidate && textures != nullptr) {
+        ProfilerCpuScope lodProfilerScope("Chunks::queueChunkBuild::lod");
+
+        ChunkLodGeometry lod;
+        if (buildChunkLodGeometry(*chunkBuildData, Renderer::options.chunkLodCellSize, TexturesAlphaSource(textures),
+                                  lod)) {
+            lodProxy = ChunkBuildData::create(task.id, task.x, task.y, task.z, 0, lod.allVertexCount,
+                                              lod.allIndexCount, lod.geometryTypes.size(), std::move(lod.geometryTypes),
+                                              std::move(lod.vertices), std::move(lod.indices));
+            lodProxy->lod = true;
+        }
+    }
 
     std::unique_lock<std::recursive_mutex> lock(mutex_);
 
-    std::shared_ptr<ChunkBuildData> chunkBuildData = ChunkBuildData::create(
-        task.id, task.x, task.y, task.z, chunks_[task.id]->latestVersion++, allVertexCount, allIndexCount,
-        task.geometryCount, std::move(geometryTypes), std::move(vertices), std::move(indices));
+    chunkBuildData->version = chunks_[task.id]->latestVersion++;
 
     if (task.isImportant) {
         bool ommEnabled = device->hasOMM() && Renderer::options.ommEnabled;
@@ -880,6 +1386,12 @@ void Chunks::queueChunkBuild(ChunkBuildTask task) {
         for (int i = 0; i < chunkBuildData->geometryCount; i++) {
             Renderer::instance().buffers()->queueImportantWorldUpload(chunkBuildData->vertexBuffers[i],
                                                                       chunkBuildData->indexBuffers[i]);
+            if (chunkBuildData->tracePositionBuffers[i] != nullptr) {
+                Renderer::instance().buffers()->queueImportantWorldUpload(chunkBuildData->tracePositionBuffers[i],
+                                                                          chunkBuildData->traceIndexBuffers[i]);
+                Renderer::instance().buffers()->queueImportantWorldUpload(chunkBuildData->quadRemapBuffers[i],
+                                                                          nullptr);
+            }
             if (chunkBuildData->ommIndexBuffers[i] != nullptr) {
                 Renderer::instance().buffers()->queueImportantWorldUpload(chunkBuildData->ommIndexBuffers[i],
                                                                           nullptr);
@@ -887,24 +1399,55 @@ void Chunks::queueChunkBuild(ChunkBuildTask task) {
         }
         importantBLASBuilders_->push_back(chunkBuildData->blasBuilder);
 
+        // without transparent geometry the baked rebuild would only add all-opaque special indices to opaque
+        // geometry, the special index BLAS stays
+        bool hasTransparent = std::find(chunkBuildData->geometryTypes.begin(), chunkBuildData->geometryTypes.end(),
+                                        World::WORLD_TRANSPARENT) != chunkBuildData->geometryTypes.end();
+
         // Copy geometry data BEFORE enqueue (enqueue moves them out)
         std::shared_ptr<ChunkBuildData> asyncRebuildData;
-        if (ommEnabled) {
-            asyncRebuildData = ChunkBuildData::create(
-                task.id, task.x, task.y, task.z,
-                chunks_[task.id]->latestVersion++, // higher version → will replace Phase 1 BLAS
-                allVertexCount, allIndexCount, task.geometryCount,
-                std::vector<World::GeometryTypes>(chunkBuildData->geometryTypes),
-                std::vector<std::vector<vk::VertexFormat::PBRTriangle>>(chunkBuildData->vertices),
-                std::vector<std::vector<uint32_t>>(chunkBuildData->indices));
+        if (ommEnabled && hasTransparent) {
+            int64_t asyncVersion = chunks_[task.id]->latestVersion++; // higher version → will replace Phase 1 BLAS
+            if (chunkBuildData->stagingSlab != nullptr) {
+                // the slab is never written after commit, so the rebuild can share it instead of copying
+                std::vector<uint32_t> vertexCounts, indexCounts;
+                for (int i = 0; i < chunkBuildData->geometryCount; i++) {
+                    vertexCounts.push_back(chunkBuildData->vertexViews[i].size());
+                    indexCounts.push_back(chunkBuildData->indexViews[i].size());
+                }
+                asyncRebuildData = ChunkBuildData::create(
+                    task.id, task.x, task.y, task.z, asyncVersion, allVertexCount, allIndexCount, task.geometryCount,
+                    std::vector<World::GeometryTypes>(chunkBuildData->geometryTypes), chunkBuildData->stagingSlab,
+                    vertexCounts, indexCounts);
+            } else {
+                asyncRebuildData = ChunkBuildData::create(
+                    task.id, task.x, task.y, task.z, asyncVersion, allVertexCount, allIndexCount, task.geometryCount,
+                    std::vector<World::GeometryTypes>(chunkBuildData->geometryTypes),
+                    std::vector<std::vector<vk::VertexFormat::PBRTriangle>>(chunkBuildData->vertices),
+                    std::vector<std::vector<uint32_t>>(chunkBuildData->indices));
+            }
+            asyncRebuildData->greedyGeometry = chunkBuildData->greedyGeometry;
+            asyncRebuildData->previousBakes = chunks_[task.id]->opacityBakes;
         }
 
         chunks_[task.id]->enqueue(chunkBuildData);
 
-        // Queue async Phase 2 rebuild with full OMM baking
-        if (asyncRebuildData) {
-            queuedIndex_.insert(task.id);
-            chunkBuildDatas_[task.id] = asyncRebuildData;
+        // an older build still queued for the section would only be replaced by the rebuild
+        if (asyncRebuildData) queuedIndex_.erase(task.id);
+
+        // the proxy follows the build that is final, the baked rebuild if there is one
+        if (lodProxy != nullptr && asyncRebuildData) {
+            lodProxy->version = asyncRebuildData->version;
+            asyncRebuildData->lodProxy = lodProxy;
+        } else if (lodProxy != nullptr) {
+            lodProxy->version = chunkBuildData->version;
+            lodProxy->build(false, true);
+            for (int i = 0; i < lodProxy->geometryCount; i++) {
+                Renderer::instance().buffers()->queueImportantWorldUpload(lodProxy->vertexBuffers[i],
+                                                                          lodProxy->indexBuffers[i]);
+            }
+            importantBLASBuilders_->push_back(lodProxy->blasBuilder);
+            chunks_[task.id]->enqueue(lodProxy);
         }
 
         ChunkPackedData data = {
@@ -912,10 +1455,57 @@ void Chunks::queueChunkBuild(ChunkBuildTask task) {
         };
 
         chunkPackedData_->uploadToBuffer(&data, sizeof(ChunkPackedData), chunkBuildData->id * sizeof(ChunkPackedData));
+        if (!asyncRebuildData) return true;
+
+        // Phase 2: bake on this worker while the render thread builds the special index BLAS, the batch only
+        // uploads it and its BLAS replaces the Phase 1 one in the next TLAS build
+        auto chunk1 = chunks_[task.id];
+        lock.unlock();
+        if (textures != nullptr) {
+            ProfilerCpuScope bakeProfilerScope("Chunks::queueChunkBuild::bake");
+            asyncRebuildData->prepareOpacity(true, true, TexturesAlphaSource(textures));
+            asyncRebuildData->opacityPrepared = true;
+        }
+        lock.lock();
+
+        // the world was reset or the section was built again meanwhile
+        if (task.id >= static_cast<int64_t>(chunks_.size()) || chunks_[task.id] != chunk1) return true;
+        if (chunk1->latestVersion > asyncRebuildData->version + 1) return true;
+
+        queuedIndex_.insert(task.id);
+        chunkBuildDatas_[task.id] = asyncRebuildData;
     } else {
+        if (lodProxy != nullptr) {
+            lodProxy->version = chunkBuildData->version;
+            chunkBuildData->lodProxy = lodProxy;
+        }
+
         queuedIndex_.insert(task.id);
         chunkBuildDatas_[task.id] = chunkBuildData;
     }
+    return true;
+}
+
+// maybe called async
+int64_t Chunks::allocateStagingSlab(size_t vertexCapacity) {
+    auto framework = Renderer::instance().framework();
+    auto slab = ChunkStagingSlab::create(framework->vma(), framework->device(), vertexCapacity);
+
+    std::unique_lock<std::recursive_mutex> lock(mutex_);
+    int64_t slabId = nextStagingSlabId_++;
+    stagingSlabs_[slabId] = slab;
+    return slabId;
+}
+
+std::shared_ptr<ChunkStagingSlab> Chunks::stagingSlab(int64_t slabId) {
+    std::unique_lock<std::recursive_mutex> lock(mutex_);
+    auto iter = stagingSlabs_.find(slabId);
+    return iter == stagingSlabs_.end() ? nullptr : iter->second;
+}
+
+void Chunks::releaseStagingSlab(int64_t slabId) {
+    std::unique_lock<std::recursive_mutex> lock(mutex_);
+    stagingSlabs_.erase(slabId);
 }
 
 bool Chunks::isChunkReady(int64_t id) {
@@ -924,13 +1514,395 @@ bool Chunks::isChunkReady(int64_t id) {
     return chunkRenderData->blas != nullptr;
 }
 
+size_t Chunks::queuedChunkCount() {
+    std::unique_lock<std::recursive_mutex> lock(mutex_);
+    return queuedIndex_.size();
+}
+
 void Chunks::setChunkLights(int64_t id, const std::vector<ChunkLightEntry> &lights) {
     std::unique_lock<std::recursive_mutex> lock(mutex_);
     if (id >= 0 && id < static_cast<int64_t>(chunks_.size()) && chunks_[id]) {
         chunks_[id]->lightSources = lights;
+        dirtyLightChunks_.insert(id);
+    }
+}
+
+void Chunks::uploadLights(std::shared_ptr<vk::CommandBuffer> cmdBuffer) {
+    std::unique_lock<std::recursive_mutex> lock(mutex_);
+    if (dirtyLightChunks_.empty()) return;
+
+    auto framework = Renderer::instance().framework();
+    auto vma = framework->vma();
+    auto device = framework->device();
+    auto mainQueueIndex = framework->physicalDevice()->mainQueueIndex();
+    auto &gc = framework->gc();
+
+    struct Write {
+        uint32_t first, capacity;
+        int64_t id; // -1 clears a released slot
+    };
+    std::vector<Write> writes;
+    std::vector<LightSlot> released; // reused only from the next upload on, a copy must not write a range twice
+    uint32_t stagingCount = 0;
+
+    for (int64_t id : dirtyLightChunks_) {
+        auto &slot = lightSlots_[id];
+        uint32_t lightCount = static_cast<uint32_t>(chunks_[id]->lightSources.size());
+
+        bool shrinks = lightCount == 0 || std::max(lightCount, MIN_LIGHT_SLOT) * 2 <= slot.capacity;
+        if (slot.capacity > 0 && (lightCount > slot.capacity || shrinks)) {
+            writes.push_back({slot.first, slot.capacity, -1});
+            released.push_back(slot);
+            slot = {};
+        }
+        if (lightCount > 0 && slot.capacity == 0) slot = allocateLightSlot(lightCount);
+        if (slot.capacity > 0) writes.push_back({slot.first, slot.capacity, id});
+    }
+    dirtyLightChunks_.clear();
+    for (auto &slot : released) freeLightSlots_[slot.capacity].push_back(slot.first);
+    if (writes.empty()) return;
+
+    for (auto &write : writes) stagingCount += write.capacity;
+    auto staging = vk::HostVisibleBuffer::create(vma, device, stagingCount * sizeof(vk::Data::ChunkLightRecord),
+                                                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    auto stagingRecords = static_cast<vk::Data::ChunkLightRecord *>(staging->mappedPtr());
+
+    std::vector<VkBufferCopy> regions;
+    uint32_t stagingOffset = 0;
+    for (auto &write : writes) {
+        std::span<vk::Data::ChunkLightRecord> records(stagingRecords + stagingOffset, write.capacity);
+        if (write.id < 0) {
+            packLightRecords(0, {}, records);
+        } else {
+            packLightRecords(static_cast<uint32_t>(write.id), chunks_[write.id]->lightSources, records);
+        }
+        regions.push_back({
+            .srcOffset = stagingOffset * sizeof(vk::Data::ChunkLightRecord),
+            .dstOffset = write.first * sizeof(vk::Data::ChunkLightRecord),
+            .size = write.capacity * sizeof(vk::Data::ChunkLightRecord),
+        });
+        stagingOffset += write.capacity;
+    }
+    staging->flush();
+
+    // the selection of earlier frames reads the records, an earlier upload may still be writing them
+    cmdBuffer->barriersBufferImage(
+        {{
+            .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .srcQueueFamilyIndex = mainQueueIndex,
+            .dstQueueFamilyIndex = mainQueueIndex,
+            .buffer = lightRecords_,
+        }},
+        {});
+
+    size_t requiredSize = lightRecordCount_ * sizeof(vk::Data::ChunkLightRecord);
+    if (requiredSize > lightRecords_->size()) {
+        size_t grownSize = std::max(requiredSize, lightRecords_->size() * 2);
+        auto grown = vk::DeviceLocalBuffer::create(vma, device, false, grownSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        VkBufferCopy copyRegion{.size = lightRecords_->size()};
+        vkCmdCopyBuffer(cmdBuffer->vkCommandBuffer(), lightRecords_->vkBuffer(), grown->vkBuffer(), 1, &copyRegion);
+        cmdBuffer->barriersBufferImage(
+            {{
+                .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                .srcQueueFamilyIndex = mainQueueIndex,
+                .dstQueueFamilyIndex = mainQueueIndex,
+                .buffer = grown,
+            }},
+            {});
+
+        // frames still in flight select from the old buffer
+        gc.collect(lightRecords_);
+        lightRecords_ = grown;
+    }
+
+    vkCmdCopyBuffer(cmdBuffer->vkCommandBuffer(), staging->vkBuffer(), lightRecords_->vkBuffer(),
+                    static_cast<uint32_t>(regions.size()), regions.data());
+    gc.collect(staging);
+
+    cmdBuffer->barriersBufferImage(
+        {{
+            .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+            .srcQueueFamilyIndex = mainQueueIndex,
+            .dstQueueFamilyIndex = mainQueueIndex,
+            .buffer = lightRecords_,
+        }},
+        {});
+}
+
+Chunks::LightSlot Chunks::allocateLightSlot(uint32_t lightCount) {
+    uint32_t capacity = std::bit_ceil(std::max(lightCount, MIN_LIGHT_SLOT));
+
+    auto &freeSlots = freeLightSlots_[capacity];
+    if (!freeSlots.empty()) {
+        uint32_t first = freeSlots.back();
+        freeSlots.pop_back();
+        return {first, capacity};
+    }
+
+    LightSlot slot{lightRecordCount_, capacity};
+    lightRecordCount_ += capacity;
+    return slot;
+}
+
+void Chunks::packLightRecords(uint32_t chunkIndex,
+                              const std::vector<ChunkLightEntry> &lights,
+                              std::span<vk::Data::ChunkLightRecord> records) {
+    size_t count = 0;
+    for (auto &light : lights) {
+        if (light.lightTypeId < 0 || light.lightTypeId >= LIGHT_TYPE_COUNT || count == records.size()) continue;
+
+        glm::vec3 position(light.worldX, light.worldY, light.worldZ);
+        glm::vec3 block = glm::floor(position);
+
+        // Stable ID for cross-frame light tracking (ReSTIR DI)
+        uint32_t bx = static_cast<uint32_t>(static_cast<int>(light.worldX)) & 0xFFFF;
+        uint32_t by = static_cast<uint32_t>(static_cast<int>(light.worldY)) & 0xFFFF;
+        uint32_t bz = static_cast<uint32_t>(static_cast<int>(light.worldZ)) & 0xFFFF;
+
+        records[count++] = {
+            .blockX = static_cast<int32_t>(block.x),
+            .blockY = static_cast<int32_t>(block.y),
+            .blockZ = static_cast<int32_t>(block.z),
+            .source = static_cast<uint32_t>(light.lightTypeId) | chunkIndex << 8,
+            .offset = position - block,
+            .stableId = (bx | (by << 16)) ^ (bz * 2654435761u),
+        };
+    }
+    for (; count < records.size(); count++) records[count] = {.source = LIGHT_RECORD_UNUSED};
+}
+
+void Chunks::updateLods(glm::dvec3 cameraPos) {
+    std::unique_lock<std::recursive_mutex> lock(mutex_);
+
+    bool enabled = Renderer::options.chunkLodEnabled;
+    double farDistance = Renderer::options.chunkLodDistance * 16.0;
+    double nearDistance = chunkLodNearDistance();
+    lodCameraPos_ = cameraPos;
+
+    for (auto &chunk1 : chunks_) {
+        glm::dvec3 lo(chunk1->x, chunk1->y, chunk1->z);
+        double distance = glm::length(glm::clamp(cameraPos, lo, lo + 16.0) - cameraPos);
+        if (distance > OPACITY_BAKE_DISTANCE) chunk1->opacityBakes = nullptr;
+
+        if (!enabled) {
+            // proxies are only generated while enabled, keeping the old ones around would waste their memory
+            if (chunk1->lodBlas != nullptr) chunk1->releaseLod();
+            continue;
+        }
+        if (chunk1->lodBlas == nullptr) continue;
+
+        // between the two distances a section keeps tracing what it traced last frame
+        if (distance > farDistance) {
+            chunk1->lodActive = true;
+        } else if (distance < nearDistance) {
+            chunk1->lodActive = false;
+        }
     }
 }
 
+bool ChunkRegion::isCurrent(const std::vector<std::shared_ptr<Chunk1>> &chunks) const {
+    for (auto &member : members) {
+        auto &chunk1 = chunks[member.index];
+        if (chunk1->lodActive != member.lod) return false;
+        if ((member.lod ? chunk1->lodBlasVersion : chunk1->blasVersion) != member.version) return false;
+    }
+    return true;
+}
+
+void Chunks::updateRegions(glm::dvec3 cameraPos) {
+    std::unique_lock<std::recursive_mutex> lock(mutex_);
+
+    auto framework = Renderer::instance().framework();
+    auto vma = framework->vma();
+    auto device = framework->device();
+    auto physicalDevice = framework->physicalDevice();
+    auto &gc = framework->gc();
+
+    // one submission at a time, its regions are traced from the frame after it finished
+    if (!buildingRegions_.empty() &&
+        vkWaitForFences(device->vkDevice(), 1, &regionFence_->vkFence(), true, 0) == VK_SUCCESS) {
+        vkResetFences(device->vkDevice(), 1, &regionFence_->vkFence());
+        for (auto &region : buildingRegions_) {
+            region->ready = true;
+            region->blasBuilder = nullptr;
+        }
+        buildingRegions_.clear();
+    }
+
+    bool enabled = Renderer::options.chunkRegionMerge;
+    double mergeDistance = Renderer::options.chunkRegionDistance * 16.0;
+    double splitDistance = std::max(mergeDistance - REGION_HYSTERESIS * 16.0, 0.0);
+    double regionSize = 1 << REGION_SHIFT;
+
+    auto regionDistance = [&](glm::ivec3 origin) {
+        glm::dvec3 lo(origin);
+        return glm::length(glm::clamp(cameraPos, lo, lo + regionSize) - cameraPos);
+    };
+
+    for (auto iter = regions_.begin(); iter != regions_.end();) {
+        auto region = iter->second;
+        // a region still in flight is left alone, once built the next call drops it if it is out of date
+        bool keep = !region->ready || (enabled && regionDistance(region->origin) >= splitDistance &&
+                                       region->isCurrent(chunks_));
+        if (keep) {
+            iter++;
+            continue;
+        }
+
+        // the members are traced by their own instances from this frame on
+        for (auto &member : region->members) chunkRegions_[member.index] = nullptr;
+        gc.collect(region);
+        iter = regions_.erase(iter);
+    }
+
+    if (!enabled || !buildingRegions_.empty()) return;
+
+    // sections rebuilt on the main queue in a recent frame might still be building, the stable time covers them
+    auto currentTime = std::chrono::steady_clock::now();
+    std::map<std::tuple<int, int, int>, std::vector<uint32_t>> candidates;
+    for (uint32_t i = 0; i < chunks_.size(); i++) {
+        auto &chunk1 = chunks_[i];
+        if (chunk1->blas == nullptr || chunkRegions_[i] != nullptr) continue;
+        if (currentTime - chunk1->lastUpdate < REGION_STABLE_TIME) continue;
+
+        auto &traceGeometries = chunk1->lodActive ? chunk1->lodTraceGeometries : chunk1->traceGeometries;
+        if (traceGeometries == nullptr || traceGeometries->empty()) continue;
+
+        std::tuple<int, int, int> key = {chunk1->x >> REGION_SHIFT, chunk1->y >> REGION_SHIFT,
+                                         chunk1->z >> REGION_SHIFT};
+        if (regions_.contains(key)) continue;
+        candidates[key].push_back(i);
+    }
+
+    std::vector<std::shared_ptr<ChunkRegion>> builds;
+    for (auto &[key, members] : candidates) {
+        if (builds.size() >= MAX_REGION_BUILDS) break;
+
+        auto [regionX, regionY, regionZ] = key;
+        glm::ivec3 origin = glm::ivec3(regionX, regionY, regionZ) * (1 << REGION_SHIFT);
+        if (members.size() < MIN_REGION_MEMBERS || regionDistance(origin) <= mergeDistance) continue;
+
+        auto region = ChunkRegion::create();
+        region->origin = origin;
+
+        std::vector<VkTransformMatrixKHR> transforms;
+        for (uint32_t index : members) {
+            auto &chunk1 = chunks_[index];
+            bool lod = chunk1->lodActive;
+
+            auto &member = region->members.emplace_back();
+            member.index = index;
+            member.lod = lod;
+            member.version = lod ? chunk1->lodBlasVersion : chunk1->blasVersion;
+            member.offset = glm::ivec3(chunk1->x, chunk1->y, chunk1->z) - origin;
+            member.geometryCount = lod ? chunk1->lodGeometryCount : chunk1->geometryCount;
+            member.geometryTypes = lod ? chunk1->lodGeometryTypes : chunk1->geometryTypes;
+            member.vertexBuffers = lod ? chunk1->lodVertexBuffers : chunk1->vertexBuffers;
+            member.indexBuffers = lod ? chunk1->lodIndexBuffers : chunk1->indexBuffers;
+            member.quadRemapBuffers = lod ? nullptr : chunk1->quadRemapBuffers;
+            member.traceGeometries = lod ? chunk1->lodTraceGeometries : chunk1->traceGeometries;
+
+            glm::vec3 offset(member.offset);
+            for (size_t j = 0; j < member.traceGeometries->size(); j++) {
+                transforms.push_back({
+                    1, 0, 0, offset.x, //
+                    0, 1, 0, offset.y, //
+                    0, 0, 1, offset.z, //
+                });
+            }
+        }
+
+        region->transformBuffer = vk::DeviceLocalBuffer::create(
+            vma, device, transforms.size() * sizeof(VkTransformMatrixKHR),
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+        region->transformBuffer->uploadToStagingBuffer(transforms.data());
+
+        // the section geometry as it is, the transforms move each one to its section within the region
+        auto blasBuilder = vk::BLASBuilder::create();
+        auto blasGeometryBuilder = blasBuilder->beginGeometries();
+        VkDeviceAddress transformAddress = region->transformBuffer->bufferAddress();
+        for (auto &member : region->members) {
+            for (auto &trace : *member.traceGeometries) {
+                if (trace.positionOnly && trace.ommIndexBuffer != nullptr) {
+                    blasGeometryBuilder->defineTriangleGeomrtry<vk::VertexFormat::PositionOnly>(
+                        trace.vertexBuffer, trace.vertexCount, trace.indexBuffer, trace.indexCount, trace.opaque,
+                        trace.ommIndexBuffer->bufferAddress(), trace.indexCount / 3);
+                } else if (trace.positionOnly) {
+                    blasGeometryBuilder->defineTriangleGeomrtry<vk::VertexFormat::PositionOnly>(
+                        trace.vertexBuffer, trace.vertexCount, trace.indexBuffer, trace.indexCount, trace.opaque);
+                } else if (trace.ommIndexBuffer != nullptr) {
+                    blasGeometryBuilder->defineTriangleGeomrtry<vk::VertexFormat::PBRTriangle>(
+                        trace.vertexBuffer, trace.vertexCount, trace.indexBuffer, trace.indexCount, trace.opaque,
+                        trace.ommIndexBuffer->bufferAddress(), trace.indexCount / 3);
+                } else {
+                    blasGeometryBuilder->defineTriangleGeomrtry<vk::VertexFormat::PBRTriangle>(
+                        trace.vertexBuffer, trace.vertexCount, trace.indexBuffer, trace.indexCount, trace.opaque);
+                }
+                blasGeometryBuilder->defineGeometryTransform(transformAddress);
+                transformAddress += sizeof(VkTransformMatrixKHR);
+            }
+        }
+        blasGeometryBuilder->endGeometries();
+        // built once and traced for as long as the camera stays away
+        region->blas = blasBuilder->defineBuildProperty(VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR)
+                           ->querySizeInfo(device)
+                           ->allocateBuffers(physicalDevice, device, vma)
+                           ->build(device);
+        region->blasBuilder = blasBuilder;
+
+        regions_[key] = region;
+        for (auto &member : region->members) chunkRegions_[member.index] = region;
+        builds.push_back(region);
+    }
+    if (builds.empty()) return;
+
+    auto secondaryQueueIndex = physicalDevice->secondaryQueueIndex();
+    regionCommandBuffer_->begin();
+
+    std::vector<vk::CommandBuffer::BufferMemoryBarrier> bufferBarriers;
+    std::vector<std::shared_ptr<vk::BLASBuilder>> builders;
+    for (auto &region : builds) {
+        region->transformBuffer->uploadToBuffer(regionCommandBuffer_);
+        bufferBarriers.push_back(vk::CommandBuffer::BufferMemoryBarrier{
+            .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+            .dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_2_SHADER_READ_BIT,
+            .srcQueueFamilyIndex = secondaryQueueIndex,
+            .dstQueueFamilyIndex = secondaryQueueIndex,
+            .buffer = region->transformBuffer,
+        });
+        builders.push_back(region->blasBuilder);
+    }
+    regionCommandBuffer_->barriersBufferImage(bufferBarriers, {});
+    vk::BLASBuilder::batchSubmit(builders, regionCommandBuffer_);
+
+    regionCommandBuffer_->end();
+
+    VkSubmitInfo vkSubmitInfo = {};
+    vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    vkSubmitInfo.commandBufferCount = 1;
+    vkSubmitInfo.pCommandBuffers = &regionCommandBuffer_->vkCommandBuffer();
+    vkQueueSubmit(device->secondaryQueue(), 1, &vkSubmitInfo, regionFence_->vkFence());
+
+    buildingRegions_ = std::move(builds);
+}
+
+std::shared_ptr<ChunkRegion> Chunks::chunkRegion(int64_t id) {
+    auto &region = chunkRegions_[id];
+    return region != nullptr && region->ready ? region : nullptr;
+}
+
 void Chunks::close() {
     std::unique_lock<std::recursive_mutex> lock(mutex_);
     queuedIndex_.clear();
@@ -955,4 +1927,12 @@ std::vector<std::shared_ptr<vk::BLASBuilder>> &Chunks::importantBLASBuilders() {
 
 std::shared_ptr<vk::HostVisibleBuffer> Chunks::chunkPackedData() {
     return chunkPackedData_;
+}
+
+std::shared_ptr<vk::DeviceLocalBuffer> Chunks::lightRecords() {
+    return lightRecords_;
+}
+
+uint32_t Chunks::lightRecordCount() {
+    return lightRecordCount_;
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include "core/all_extern.hpp"
 #include "core/vulkan/all_core_vulkan.hpp"
 
+#include "core/render/chunk_greedy.hpp"
+#include "core/render/textures.hpp"
 #include "core/render/world.hpp"
 
 #include <chrono>
@@ -15,6 +17,8 @@
 #include <mutex>
 #include <queue>
 #include <set>
+#include <span>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
@@ -30,8 +34,55 @@ struct ChunkBuildTask {
     int *vertexCounts;
     vk::VertexFormat::PBRTriangle **vertices;
     bool isImportant;
+    int64_t stagingSlab = -1; // if valid, vertices were written directly into this slab and `vertices` is unused
 };
 
+// Persistently mapped upload memory handed to Java as a direct ByteBuffer. Java writes the vertices of all geometries
+// back to back into the first vertexCapacity bytes, the quad indices are generated behind them on commit.
+struct ChunkStagingSlab : public SharedObject<ChunkStagingSlab> {
+    std::shared_ptr<vk::HostVisibleBuffer> buffer;
+    size_t vertexCapacity;
+    size_t indexCapacity;
+
+    ChunkStagingSlab(std::shared_ptr<vk::VMA> vma, std::shared_ptr<vk::Device> device, size_t vertexCapacity);
+};
+
+// texture alpha as seen by the chunk opacity pass, Textures in the renderer, synthetic atlases in the benchmarks
+class ChunkAlphaSource {
+  public:
+    virtual ~ChunkAlphaSource() = default;
+
+    virtual Textures::AlphaClass alphaClass(uint32_t textureID) const = 0;
+    virtual const Textures::TextureAlphaData *alphaData(uint32_t textureID) const = 0;
+};
+
+// one geometry as it went into a section BLAS, Chunks builds region BLASes from the same buffers
+struct ChunkTraceGeometry {
+    std::shared_ptr<vk::DeviceLocalBuffer> vertexBuffer; // PBRTriangle, PositionOnly where greedily merged
+    std::shared_ptr<vk::DeviceLocalBuffer> indexBuffer;
+    std::shared_ptr<vk::DeviceLocalBuffer> ommIndexBuffer; // special indices, nullptr without OMM
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    bool positionOnly;
+    bool opaque;
+};
+
+// the OMM bake of one texture group of a WORLD_TRANSPARENT geometry, descs and indices relative to the group
+struct ChunkOpacityBake {
+    uint32_t textureID;
+    uint64_t alphaRevision; // Textures::TextureAlphaData::revision
+    uint32_t subdivisionLevel;
+    std::vector<glm::vec2> uvs; // three per baked triangle, the bake holds as long as they and the texture do
+    std::vector<uint8_t> arrayData;
+    std::vector<VkMicromapTriangleEXT> descs;
+    std::vector<int32_t> indices; // per baked triangle, desc index or special index
+    std::vector<VkMicromapUsageEXT> descHistogram;
+    std::vector<VkMicromapUsageEXT> indexHistogram;
+};
+
+// the bakes of one build of a section by a hash of their inputs, the next build only bakes the groups that changed
+using ChunkOpacityBakes = std::unordered_map<uint64_t, std::shared_ptr<const ChunkOpacityBake>>;
+
 struct ChunkBuildData : public SharedObject<ChunkBuildData> {
     int64_t id;
     int x, y, z;
@@ -42,9 +93,20 @@ struct ChunkBuildData : public SharedObject<ChunkBuildData> {
     std::vector<World::GeometryTypes> geometryTypes;
     std::vector<std::vector<vk::VertexFormat::PBRTriangle>> vertices;
     std::vector<std::vector<uint32_t>> indices;
+    // geometry as seen by build(), either views of vertices/indices or of the staging slab
+    std::shared_ptr<ChunkStagingSlab> stagingSlab;
+    std::vector<size_t> vertexOffsets;
+    std::vector<size_t> indexOffsets;
+    std::vector<std::span<vk::VertexFormat::PBRTriangle>> vertexViews;
+    std::vector<std::span<uint32_t>> indexViews;
     std::vector<std::shared_ptr<vk::DeviceLocalBuffer>> vertexBuffers;
     std::vector<std::shared_ptr<vk::DeviceLocalBuffer>> indexBuffers;
     std::vector<std::shared_ptr<vk::DeviceLocalBuffer>> ommIndexBuffers; // OMM per-triangle index buffers
+    // greedily merged WORLD_SOLID geometry the BLAS is built from instead, empty or per geometry, see chunk_greedy.hpp
+    std::vector<ChunkGreedyGeometry> greedyGeometry;
+    std::vector<std::shared_ptr<vk::DeviceLocalBuffer>> tracePositionBuffers; // nullptr where not merged
+    std::vector<std::shared_ptr<vk::DeviceLocalBuffer>> traceIndexBuffers;
+    std::vector<std::shared_ptr<vk::DeviceLocalBuffer>> quadRemapBuffers;
     // Phase 2 OMM: micromap data per geometry
     struct OMMGeometryData {
         std::shared_ptr<vk::DeviceLocalBuffer> arrayBuffer;  // raw OMM bit data
@@ -56,10 +118,23 @@ struct ChunkBuildData : public SharedObject<ChunkBuildData> {
         std::shared_ptr<vk::DeviceLocalBuffer> micromapBuffer;
         std::shared_ptr<vk::DeviceLocalBuffer> micromapScratchBuffer;
         bool hasMicromap = false;
+        // cpu side results of prepareOpacity(), released by upload()
+        std::vector<int32_t> indices; // per-triangle desc index or special index, empty without OMM
+        std::vector<uint8_t> arrayData;
+        std::vector<VkMicromapTriangleEXT> descs;
     };
     std::vector<OMMGeometryData> ommGeometryData;
+    // bakes of the previous build of the section, released by prepareOpacity(), and the ones this build used
+    std::shared_ptr<const ChunkOpacityBakes> previousBakes;
+    std::shared_ptr<ChunkOpacityBakes> bakes;
+    // prepareOpacity() already ran on the build worker, build() only uploads
+    bool opacityPrepared = false;
     std::shared_ptr<vk::BLAS> blas;
     std::shared_ptr<vk::BLASBuilder> blasBuilder;
+    // a distant-section proxy from chunk_lod.hpp, enqueued into the LOD slot of its section
+    bool lod = false;
+    // built and uploaded in the same batch, right after this one
+    std::shared_ptr<ChunkBuildData> lodProxy;
 
     ChunkBuildData(int64_t id,
                    int x,
@@ -72,9 +147,27 @@ struct ChunkBuildData : public SharedObject<ChunkBuildData> {
                    std::vector<World::GeometryTypes> &&geometryTypes,
                    std::vector<std::vector<vk::VertexFormat::PBRTriangle>> &&vertices,
                    std::vector<std::vector<uint32_t>> &&indices);
+    ChunkBuildData(int64_t id,
+                   int x,
+                   int y,
+                   int z,
+                   int64_t version,
+                   uint32_t allVertexCount,
+                   uint32_t allIndexCount,
+                   uint32_t geometryCount,
+                   std::vector<World::GeometryTypes> &&geometryTypes,
+                   std::shared_ptr<ChunkStagingSlab> stagingSlab,
+                   const std::vector<uint32_t> &vertexCounts,
+                   const std::vector<uint32_t> &indexCounts);
     ~ChunkBuildData();
 
     void build(bool allowMicromapBake = true, bool skipOMM = false);
+    // cpu half of build(), classifies or bakes per-triangle opacity without touching any vulkan object
+    void prepareOpacity(bool useOMM, bool allowMicromapBake, const ChunkAlphaSource &alphaSource);
+    // gpu half of build(), creates the geometry and opacity buffers, the micromaps and the BLAS
+    void upload();
+    // the BLAS inputs of upload(), nullptr when a geometry references its micromap, which only this build owns
+    std::shared_ptr<std::vector<ChunkTraceGeometry>> traceGeometries();
 };
 
 struct Chunk1;
@@ -107,15 +200,27 @@ class ChunkBuildScheduler : public SharedObject<ChunkBuildScheduler> {
     uint32_t chunkBuildingTotalBatches();
 
   private:
+    // one per batch in flight, its command buffer is only recorded again after the batch finished
+    struct BatchSlot {
+        std::shared_ptr<vk::CommandBuffer> commandBuffer;
+        std::shared_ptr<vk::Fence> fence; // only without timeline semaphores
+        uint64_t timelineValue = 0;       // signalled on timeline_ when the batch finished
+    };
+
+    // enqueues the batches that finished, in submission order
+    void finishBatches(bool wait);
+
     std::set<int64_t> &queuedIndex_;
     std::vector<std::shared_ptr<Chunk1>> &chunks_;
     std::vector<std::shared_ptr<ChunkBuildData>> &chunkBuildDatas_;
     std::recursive_mutex &mutex_;
     std::shared_ptr<vk::HostVisibleBuffer> &chunkPackedData_;
 
-    std::queue<std::shared_ptr<vk::Fence>> freeFences_;
-    std::list<std::shared_ptr<vk::Fence>> buildingFences_;
+    std::queue<BatchSlot> freeSlots_;
+    std::list<BatchSlot> buildingSlots_;
     std::list<std::shared_ptr<ChunkBuildDataBatch>> buildingBatches_;
+    std::shared_ptr<vk::Semaphore> timeline_; // nullptr if the device lacks timeline semaphores
+    uint64_t timelineValue_ = 0;
 
     uint32_t chunkBuildingBatchSize_;
     uint32_t chunkBuildingTotalBatches_;
@@ -155,6 +260,10 @@ struct Chunk1 : public SharedObject<Chunk1> {
     int64_t blasVersion = -1;
     std::shared_ptr<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>> vertexBuffers;
     std::shared_ptr<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>> indexBuffers;
+    // per geometry, nullptr where the BLAS was built from the original quads
+    std::shared_ptr<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>> quadRemapBuffers;
+    std::shared_ptr<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>> traceBuffers; // merged positions and indices
+    std::shared_ptr<std::vector<ChunkTraceGeometry>> traceGeometries;                   // see Chunks::updateRegions
 
     uint32_t allVertexCount;
     uint32_t allIndexCount;
@@ -165,10 +274,24 @@ struct Chunk1 : public SharedObject<Chunk1> {
 
     std::vector<ChunkLightEntry> lightSources;
 
+    // OMM bakes of the last build, kept while the section is close enough to be edited
+    std::shared_ptr<const ChunkOpacityBakes> opacityBakes;
+
+    // the proxy traced instead of the full geometry while lodActive, see Chunks::updateLods
+    std::shared_ptr<vk::BLAS> lodBlas;
+    int64_t lodBlasVersion = -1;
+    std::shared_ptr<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>> lodVertexBuffers;
+    std::shared_ptr<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>> lodIndexBuffers;
+    uint32_t lodGeometryCount = 0;
+    std::shared_ptr<std::vector<World::GeometryTypes>> lodGeometryTypes;
+    std::shared_ptr<std::vector<ChunkTraceGeometry>> lodTraceGeometries;
+    bool lodActive = false;
+
     float buildFactor(std::chrono::steady_clock::time_point currentTime, glm::vec3 cameraPos);
 
     void enqueue(std::shared_ptr<ChunkBuildData> chunkBuildData);
     void invalidate();
+    void releaseLod();
     std::shared_ptr<ChunkRenderData> tryGetValid();
 };
 
@@ -176,6 +299,34 @@ struct ChunkPackedData {
     uint32_t geometryCount;
 };
 
+// a section traced through a region BLAS, with the buffers its geometries were built and are shaded from
+struct ChunkRegionMember {
+    uint32_t index; // into Chunks::chunks()
+    bool lod;
+    int64_t version;   // blasVersion or lodBlasVersion the region was built from
+    glm::ivec3 offset; // section origin in the object space of the region
+    uint32_t geometryCount;
+    std::shared_ptr<std::vector<World::GeometryTypes>> geometryTypes;
+    std::shared_ptr<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>> vertexBuffers;
+    std::shared_ptr<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>> indexBuffers;
+    std::shared_ptr<std::vector<std::shared_ptr<vk::DeviceLocalBuffer>>> quadRemapBuffers; // nullptr for a proxy
+    std::shared_ptr<std::vector<ChunkTraceGeometry>> traceGeometries;
+};
+
+// stable far sections of a cube of 4x4x4 sections traced as one TLAS instance. The geometries of the members follow
+// each other in member order, each moved into place by its own transform in transformBuffer.
+struct ChunkRegion : public SharedObject<ChunkRegion> {
+    glm::ivec3 origin; // lowest block of the region, the object space origin of its BLAS
+    std::vector<ChunkRegionMember> members;
+    std::shared_ptr<vk::BLAS> blas;
+    std::shared_ptr<vk::BLASBuilder> blasBuilder; // scratch of the build in flight
+    std::shared_ptr<vk::DeviceLocalBuffer> transformBuffer;
+    bool ready = false; // the build on the secondary queue has finished
+
+    // every member still traces the geometry the region was built from
+    bool isCurrent(const std::vector<std::shared_ptr<Chunk1>> &chunks) const;
+};
+
 class Chunks : public SharedObject<Chunks> {
     friend World;
 
@@ -186,11 +337,29 @@ class Chunks : public SharedObject<Chunks> {
     void resetScheduler();
     void resetFrame();
     void invalidateChunk(int id);
-    void queueChunkBuild(ChunkBuildTask task);
+    // false if a staging slab task was rejected, the slab then still belongs to the caller
+    bool queueChunkBuild(ChunkBuildTask task);
+
+    int64_t allocateStagingSlab(size_t vertexCapacity);
+    std::shared_ptr<ChunkStagingSlab> stagingSlab(int64_t slabId);
+    void releaseStagingSlab(int64_t slabId);
 
     bool isChunkReady(int64_t id);
+    size_t queuedChunkCount();
 
     void setChunkLights(int64_t id, const std::vector<ChunkLightEntry> &lights);
+    // copies the records of the chunks whose lights changed since the last call into lightRecords()
+    void uploadLights(std::shared_ptr<vk::CommandBuffer> cmdBuffer);
+    // every light record on the device, the selection in WorldPrepareContext scans the first lightRecordCount()
+    std::shared_ptr<vk::DeviceLocalBuffer> lightRecords();
+    uint32_t lightRecordCount();
+    // picks full geometry or proxy per section by distance, with Options::chunkLodHysteresis against flickering
+    void updateLods(glm::dvec3 cameraPos);
+    // merges sections beyond Options::chunkRegionDistance that stopped changing into region BLASes built on the
+    // secondary queue, and splits regions whose sections changed or came closer back into section instances
+    void updateRegions(glm::dvec3 cameraPos);
+    // the built region tracing a section in place of its own BLAS, nullptr if there is none
+    std::shared_ptr<ChunkRegion> chunkRegion(int64_t id);
     void close();
 
     std::recursive_mutex &mutex();
@@ -199,13 +368,43 @@ class Chunks : public SharedObject<Chunks> {
     std::vector<std::shared_ptr<vk::BLASBuilder>> &importantBLASBuilders();
     std::shared_ptr<vk::HostVisibleBuffer> chunkPackedData();
 
+    // records of a chunk's lights, the slots past them are marked LIGHT_RECORD_UNUSED
+    static void packLightRecords(uint32_t chunkIndex,
+                                 const std::vector<ChunkLightEntry> &lights,
+                                 std::span<vk::Data::ChunkLightRecord> records);
+
   private:
+    // a power of two range of records per lit chunk, released ranges are reused by chunks of the same capacity
+    struct LightSlot {
+        uint32_t first = 0;
+        uint32_t capacity = 0;
+    };
+
+    LightSlot allocateLightSlot(uint32_t lightCount);
+
     std::recursive_mutex mutex_;
     std::vector<std::shared_ptr<Chunk1>> chunks_;
     std::shared_ptr<vk::HostVisibleBuffer> chunkPackedData_ = nullptr;
     std::vector<std::shared_ptr<ChunkBuildData>> chunkBuildDatas_;
     std::set<int64_t> queuedIndex_;
     std::shared_ptr<ChunkBuildScheduler> chunkBuildScheduler_;
+    // the camera position of the last updateLods, build workers only generate proxies for sections far from it
+    glm::dvec3 lodCameraPos_ = glm::dvec3(0.0);
+
+    std::unordered_map<int64_t, std::shared_ptr<ChunkStagingSlab>> stagingSlabs_;
+    int64_t nextStagingSlabId_ = 0;
 
     std::shared_ptr<std::vector<std::shared_ptr<vk::BLASBuilder>>> importantBLASBuilders_;
+
+    std::shared_ptr<vk::DeviceLocalBuffer> lightRecords_;
+    uint32_t lightRecordCount_ = 0; // records handed out so far, free slots included
+    std::vector<LightSlot> lightSlots_;
+    std::map<uint32_t, std::vector<uint32_t>> freeLightSlots_; // capacity -> first record
+    std::set<int64_t> dirtyLightChunks_;
+
+    std::map<std::tuple<int, int, int>, std::shared_ptr<ChunkRegion>> regions_;
+    std::vector<std::shared_ptr<ChunkRegion>> chunkRegions_; // per chunk, the region it is a member of
+    std::vector<std::shared_ptr<ChunkRegion>> buildingRegions_;
+    std::shared_ptr<vk::CommandBuffer> regionCommandBuffer_;
+    std::shared_ptr<vk::Fence> regionFence_;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "core/render/entities.hpp"
 
 #include "core/render/buffers.hpp"
+#include "core/render/profiler.hpp"
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 
@@ -15,6 +16,25 @@ using Triangle = std::array<Vertex, 3>;
 using VertexIdentifier = std::array<uint32_t, 2>;
 using TriangleIdentifier = std::array<VertexIdentifier, 3>;
 
+size_t Entities::rawVertexStride(World::VertexFormats vertexFormat) {
+    switch (vertexFormat) {
+        case World::POSITION_COLOR_TEXTURE_LIGHT_NORMAL: return sizeof(vk::VertexFormat::PositionColorTexLightNormal);
+        case World::POSITION_COLOR_TEXTURE_OVERLAY_LIGHT_NORMAL:
+            return sizeof(vk::VertexFormat::PositionColorTexOverlayLightNormal);
+        case World::POSITION_TEXTURE_COLOR_LIGHT: return sizeof(vk::VertexFormat::PositionTexColorLight);
+        case World::POSITION: return sizeof(vk::VertexFormat::PositionOnly);
+        case World::POSITION_COLOR: return sizeof(vk::VertexFormat::PositionColor);
+        case World::LINES: return sizeof(vk::VertexFormat::PositionColorNormal);
+        case World::POSITION_COLOR_LIGHT: return sizeof(vk::VertexFormat::PositionColorLight);
+        case World::POSITION_TEXTURE: return sizeof(vk::VertexFormat::PositionTex);
+        case World::POSITION_TEXTURE_COLOR: return sizeof(vk::VertexFormat::PositionTexColor);
+        case World::POSITION_COLOR_TEXTURE_LIGHT: return sizeof(vk::VertexFormat::PositionColorTexLight);
+        case World::POSITION_TEXTURE_LIGHT_COLOR: return sizeof(vk::VertexFormat::PositionTexLightColor);
+        case World::POSITION_TEXTURE_COLOR_NORMAL: return sizeof(vk::VertexFormat::PositionTexColorNormal);
+        default: return sizeof(vk::VertexFormat::PBRTriangle);
+    }
+}
+
 struct TriangleHash {
     static inline void hash_combine(std::size_t &seed, std::size_t h) noexcept {
         seed ^= h + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
@@ -38,7 +58,9 @@ EntityBuildData::EntityBuildData(int hashCode,
                                  uint32_t geometryCount,
                                  std::vector<World::GeometryTypes> &&geometryTypes,
                                  std::vector<std::vector<vk::VertexFormat::PBRTriangle>> &&vertices,
-                                 std::vector<std::vector<uint32_t>> &&indices)
+                                 std::vector<std::vector<uint32_t>> &&indices,
+                                 std::vector<EntityRawGeometry> &&rawGeometries,
+                                 std::vector<uint8_t> &&rawVertices)
     : hashCode(hashCode),
       x(x),
       y(y),
@@ -50,8 +72,19 @@ EntityBuildData::EntityBuildData(int hashCode,
       geometryTypes(std::move(geometryTypes)),
       vertices(std::move(vertices)),
       indices(std::move(indices)),
+      rawGeometries(std::move(rawGeometries)),
+      rawVertices(std::move(rawVertices)),
       vertexBufferAddresses(),
-      indexBufferAddresses() {}
+      indexBufferAddresses() {
+    for (int i = 0; i < geometryCount; i++) {
+        vertexCounts.push_back(this->vertices[i].size());
+        indexCounts.push_back(this->indices[i].size());
+    }
+    for (auto &raw : this->rawGeometries) {
+        vertexCounts[raw.geometry] = raw.vertexCount;
+        indexCounts[raw.geometry] = raw.vertexCount / 4 * 6;
+    }
+}
 
 void EntityBuildDataBatch::addData(std::shared_ptr<EntityBuildData> data) {
     datas.push_back(data);
@@ -76,8 +109,8 @@ void EntityBuildDataBatch::build() {
             geometryVertexOffsets.push_back(totalVertexCount);
             geometryIndexOffsets.push_back(totalIndexCount);
 
-            totalVertexCount += data->vertices[i].size();
-            totalIndexCount += data->indices[i].size();
+            totalVertexCount += data->vertexCounts[i];
+            totalIndexCount += data->indexCounts[i];
         }
 
         totalGeometryCount += data->geometryCount;
@@ -92,23 +125,61 @@ void EntityBuildDataBatch::build() {
         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
             VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 
+    // raw geometries leave their ranges untouched here, the expansion pass fills them after the upload copy
     vk::VertexFormat::PBRTriangle *vertexPtr = static_cast<vk::VertexFormat::PBRTriangle *>(vertexBuffer->mappedPtr());
     uint32_t *indexPtr = static_cast<uint32_t *>(indexBuffer->mappedPtr());
+    size_t totalRawSize = 0;
     for (auto data : datas) {
         for (int i = 0; i < data->geometryCount; i++) {
-            std::memcpy(vertexPtr, data->vertices[i].data(),
-                        data->vertices[i].size() * sizeof(vk::VertexFormat::PBRTriangle));
-            vertexPtr += data->vertices[i].size();
-
-            std::memcpy(indexPtr, data->indices[i].data(), data->indices[i].size() * sizeof(uint32_t));
-            indexPtr += data->indices[i].size();
+            if (!data->vertices[i].empty()) {
+                std::memcpy(vertexPtr, data->vertices[i].data(),
+                            data->vertices[i].size() * sizeof(vk::VertexFormat::PBRTriangle));
+                std::memcpy(indexPtr, data->indices[i].data(), data->indices[i].size() * sizeof(uint32_t));
+            }
+            vertexPtr += data->vertexCounts[i];
+            indexPtr += data->indexCounts[i];
         }
 
-        totalGeometryCount += data->geometryCount;
+        totalRawSize += data->rawVertices.size();
     }
     vertexBuffer->flushStagingBuffer();
     indexBuffer->flushStagingBuffer();
 
+    if (totalRawSize > 0) {
+        rawVertexBuffer = vk::HostVisibleBuffer::create(
+            vma, device, totalRawSize, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+        std::vector<EntityExpansionTask> tasks;
+        uint8_t *rawPtr = static_cast<uint8_t *>(rawVertexBuffer->mappedPtr());
+        size_t rawAccu = 0;
+        for (int instanceIndex = 0; auto data : datas) {
+            std::memcpy(rawPtr + rawAccu, data->rawVertices.data(), data->rawVertices.size());
+            for (auto &raw : data->rawGeometries) {
+                uint32_t geometry = instanceOffsets[instanceIndex] + raw.geometry;
+                tasks.push_back(EntityExpansionTask{
+                    .srcAddress = rawVertexBuffer->bufferAddress() + rawAccu + raw.rawOffset,
+                    .dstVertexAddress = vertexBuffer->bufferAddress() +
+                                        geometryVertexOffsets[geometry] * sizeof(vk::VertexFormat::PBRTriangle),
+                    .dstIndexAddress = indexBuffer->bufferAddress() + geometryIndexOffsets[geometry] * sizeof(uint32_t),
+                    .vertexCount = raw.vertexCount,
+                    .vertexFormat = static_cast<uint32_t>(raw.vertexFormat),
+                    .textureID = raw.textureID,
+                    .coordinate = static_cast<uint32_t>(data->coordinate),
+                    .normalOffset = data->normalOffset,
+                });
+                maxExpansionVertexCount = std::max(maxExpansionVertexCount, raw.vertexCount);
+            }
+            rawAccu += data->rawVertices.size();
+            instanceIndex++;
+        }
+        rawVertexBuffer->flush();
+
+        expansionTaskCount = tasks.size();
+        expansionTaskBuffer = vk::HostVisibleBuffer::create(vma, device, tasks.size() * sizeof(EntityExpansionTask),
+                                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        expansionTaskBuffer->uploadToBuffer(tasks.data());
+    }
+
     blasBatchBuilder = vk::BLASBatchBuilder::create();
     std::vector<uint32_t> nonPrebuildInstances;
     for (int instanceIndex = 0; auto data : datas) {
@@ -130,7 +201,7 @@ void EntityBuildDataBatch::build() {
             data->indexBufferAddresses.push_back(indexBufferAddress);
             if (data->prebuiltBLAS < 0) {
                 blasGeometryBuilder->defineTriangleGeomrtry<vk::VertexFormat::PBRTriangle>(
-                    vertexBufferAddress, data->vertices[i].size(), indexBufferAddress, data->indices[i].size(),
+                    vertexBufferAddress, data->vertexCounts[i], indexBufferAddress, data->indexCounts[i],
                     data->geometryTypes[i] == World::WORLD_SOLID);
             }
         }
@@ -171,6 +242,8 @@ Entity::Entity(std::shared_ptr<EntityBuildData> chunkBuildData) {
     vertices =
         std::make_shared<std::vector<std::vector<vk::VertexFormat::PBRTriangle>>>(std::move(chunkBuildData->vertices));
     indices = std::make_shared<std::vector<std::vector<uint32_t>>>(std::move(chunkBuildData->indices));
+    vertexCounts = chunkBuildData->vertexCounts;
+    indexCounts = chunkBuildData->indexCounts;
 }
 
 EntityBatch::EntityBatch(std::shared_ptr<EntityBuildDataBatch> entityBuildDataBatch) {
@@ -238,15 +311,27 @@ void Entities::resetFrame() {
 
     gc.collect(blasBatchBuilder_);
     blasBatchBuilder_ = nullptr;
+
+    gc.collect(expansionBatch_);
+    expansionBatch_ = nullptr;
 }
 
 void Entities::queueBuild(EntitiesBuildTask task) {
+    ProfilerCpuScope profilerScope("Entities::queueBuild");
+
     Renderer::instance().framework()->safeAcquireCurrentContext();
-    auto framework = Renderer::instance().framework();
-    auto vma = framework->vma();
-    auto device = framework->device();
-    auto physicalDevice = framework->physicalDevice();
 
+    decodeBuildTask(task, [this](std::shared_ptr<EntityBuildData> data, bool post) {
+        if (post) {
+            entityPostBuildDataBatch_->addData(data);
+        } else {
+            entityBuildDataBatch_->addData(data);
+        }
+    });
+}
+
+void Entities::decodeBuildTask(const EntitiesBuildTask &task,
+                               const std::function<void(std::shared_ptr<EntityBuildData>, bool)> &sink) {
     std::set<int> textureIDs;
 
     uint32_t geometryAccu = 0;
@@ -259,6 +344,8 @@ void Entities::queueBuild(EntitiesBuildTask task) {
         std::vector<World::GeometryTypes> geometryTypes;
         std::vector<std::vector<vk::VertexFormat::PBRTriangle>> vertices;
         std::vector<std::vector<uint32_t>> indices;
+        std::vector<EntityRawGeometry> rawGeometries;
+        std::vector<uint8_t> rawVertices;
         int hashCode = task.entityHashCodes[e];
         double x = task.entityXs[e];
         double y = task.entityYs[e];
@@ -278,6 +365,29 @@ void Entities::queueBuild(EntitiesBuildTask task) {
             auto &geometryVertices = vertices.emplace_back();
             auto &geometryIndices = indices.emplace_back();
 
+            // plain quads of raw formats only need a byte copy here, the GPU decodes and widens them
+            auto vertexFormat = static_cast<World::VertexFormats>(task.vertexFormats[geometryIndex + i]);
+            uint32_t vertexCount = task.vertexCounts[geometryIndex + i];
+            if (!post && vertexFormat != World::PBR_TRIANGLE && vertexCount >= 4 &&
+                static_cast<World::DrawMode>(task.indexFormats[geometryIndex + i]) == World::DrawMode::QUADS) {
+                size_t rawSize = vertexCount * rawVertexStride(vertexFormat);
+                rawGeometries.push_back(EntityRawGeometry{
+                    .geometry = static_cast<uint32_t>(vertices.size() - 1),
+                    .vertexFormat = vertexFormat,
+                    .vertexCount = vertexCount,
+                    .textureID = static_cast<uint32_t>(geometryTexture),
+                    .rawOffset = rawVertices.size(),
+                });
+                uint8_t *src = static_cast<uint8_t *>(task.vertices[geometryIndex + i]);
+                rawVertices.insert(rawVertices.end(), src, src + rawSize);
+                textureIDs.insert(geometryTexture);
+
+                allVertexCount += vertexCount;
+                allIndexCount += vertexCount / 4 * 6;
+                geometryCountWithoutGlint++;
+                continue;
+            }
+
             if (task.vertexFormats[geometryIndex + i] == World::PBR_TRIANGLE) {
                 geometryVertices.resize(task.vertexCounts[geometryIndex + i]);
                 std::memcpy(geometryVertices.data(), task.vertices[geometryIndex + i],
@@ -839,15 +949,12 @@ void Entities::queueBuild(EntitiesBuildTask task) {
 
         if (geometryCountWithoutGlint == 0) { continue; }
 
-        std::shared_ptr<EntityBuildData> chunkBuildData =
-            EntityBuildData::create(hashCode, x, y, z, rtFlag, prebuiltBLAS, coordinate, geometryCountWithoutGlint,
-                                    std::move(geometryTypes), std::move(vertices), std::move(indices));
+        std::shared_ptr<EntityBuildData> chunkBuildData = EntityBuildData::create(
+            hashCode, x, y, z, rtFlag, prebuiltBLAS, coordinate, geometryCountWithoutGlint, std::move(geometryTypes),
+            std::move(vertices), std::move(indices), std::move(rawGeometries), std::move(rawVertices));
+        chunkBuildData->normalOffset = task.normalOffset;
 
-        if (post) {
-            entityPostBuildDataBatch_->addData(chunkBuildData);
-        } else {
-            entityBuildDataBatch_->addData(chunkBuildData);
-        }
+        sink(chunkBuildData, post);
 
         // std::cout << "used texture ids: ";
         // for (auto id : textureIDs) { std::cout << id << " "; }
@@ -867,6 +974,7 @@ void Entities::build() {
     Renderer::instance().buffers()->queueImportantWorldUpload(entityBuildDataBatch_->vertexBuffer,
                                                               entityBuildDataBatch_->indexBuffer);
     blasBatchBuilder_ = entityBuildDataBatch_->blasBatchBuilder;
+    if (entityBuildDataBatch_->expansionTaskCount > 0) { expansionBatch_ = entityBuildDataBatch_; }
 
     entityBatch_ = EntityBatch::create(entityBuildDataBatch_);
     entityPostBatch_ = EntityPostBatch::create(entityPostBuildDataBatch_);
@@ -879,6 +987,91 @@ void Entities::build() {
     }
 }
 
+// records after Buffers::performQueuedUpload, so the expanded ranges are not overwritten by the staging copy
+void Entities::performQueuedExpansion() {
+    if (expansionBatch_ == nullptr) return;
+
+    auto framework = Renderer::instance().framework();
+    auto context = framework->safeAcquireCurrentContext();
+    auto device = framework->device();
+    auto mainQueueIndex = framework->physicalDevice()->mainQueueIndex();
+    auto cmdBuffer = context->uploadCommandBuffer;
+
+    if (expansionPipeline_ == nullptr) {
+        uint32_t size = framework->swapchain()->imageCount();
+        expansionDescriptorTables_.resize(size);
+        for (int i = 0; i < size; i++) {
+            expansionDescriptorTables_[i] = vk::DescriptorTableBuilder{}
+                                                .beginDescriptorLayoutSet()
+                                                .beginDescriptorLayoutSetBinding()
+                                                .defineDescriptorLayoutSetBinding({
+                                                    .binding = 0,
+                                                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                    .descriptorCount = 1,
+                                                    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                                                })
+                                                .endDescriptorLayoutSetBinding()
+                                                .endDescriptorLayoutSet()
+                                                .definePushConstant({
+                                                    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                                                    .offset = 0,
+                                                    .size = sizeof(uint32_t) * 2,
+                                                })
+                                                .build(device);
+        }
+
+        expansionShader_ = vk::Shader::create(
+            device, (Renderer::folderPath / "shaders/world/ingest/expand_entity_vertices_comp.spv").string());
+        expansionPipeline_ = vk::ComputePipelineBuilder{}
+                                 .defineShader(expansionShader_)
+                                 .definePipelineLayout(expansionDescriptorTables_[0])
+                                 .build(device);
+    }
+
+    auto descriptorTable = expansionDescriptorTables_[context->frameIndex];
+    descriptorTable->bindBuffer(expansionBatch_->expansionTaskBuffer, 0, 0);
+
+    struct PushConstants {
+        uint32_t taskCount;
+        uint32_t maxVertexCount;
+    } pushConstants{expansionBatch_->expansionTaskCount, expansionBatch_->maxExpansionVertexCount};
+
+    cmdBuffer->bindDescriptorTable(descriptorTable, VK_PIPELINE_BIND_POINT_COMPUTE)
+        ->bindComputePipeline(expansionPipeline_);
+    vkCmdPushConstants(cmdBuffer->vkCommandBuffer(), descriptorTable->vkPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(cmdBuffer->vkCommandBuffer(), (pushConstants.maxVertexCount + 63) / 64, pushConstants.taskCount, 1);
+
+    cmdBuffer->barriersBufferImage(
+        {
+            {
+                .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR |
+                                VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
+                .srcQueueFamilyIndex = mainQueueIndex,
+                .dstQueueFamilyIndex = mainQueueIndex,
+                .buffer = expansionBatch_->vertexBuffer,
+            },
+            {
+                .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                .srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR |
+                                VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT,
+                .srcQueueFamilyIndex = mainQueueIndex,
+                .dstQueueFamilyIndex = mainQueueIndex,
+                .buffer = expansionBatch_->indexBuffer,
+            },
+        },
+        {});
+
+    // the batch stays referenced through the frame's garbage collector until this command buffer retired
+    framework->gc().collect(expansionBatch_);
+    expansionBatch_ = nullptr;
+}
+
 std::shared_ptr<EntityBatch> Entities::entityBatch() {
     Renderer::instance().framework()->safeAcquireCurrentContext();
 
@@ -10,6 +10,7 @@
 #include <chrono>
 #include <condition_variable>
 #include <deque>
+#include <functional>
 #include <list>
 #include <map>
 #include <mutex>
@@ -41,6 +42,28 @@ struct EntitiesBuildTask {
     void **vertices;
 };
 
+// raw Minecraft vertices of a QUADS geometry, decoded and widened to PBRTriangle on the GPU
+struct EntityRawGeometry {
+    uint32_t geometry; // index of the geometry inside its EntityBuildData
+    World::VertexFormats vertexFormat;
+    uint32_t vertexCount;
+    uint32_t textureID;
+    size_t rawOffset; // bytes into EntityBuildData::rawVertices
+};
+
+// keep in sync with ExpansionTask in expand_entity_vertices.comp
+struct EntityExpansionTask {
+    VkDeviceAddress srcAddress;
+    VkDeviceAddress dstVertexAddress;
+    VkDeviceAddress dstIndexAddress;
+    uint32_t vertexCount;
+    uint32_t vertexFormat;
+    uint32_t textureID;
+    uint32_t coordinate;
+    uint32_t normalOffset;
+    uint32_t pad0;
+};
+
 struct EntityBuildData : public SharedObject<EntityBuildData> {
     int hashCode;
     double x, y, z;
@@ -49,8 +72,13 @@ struct EntityBuildData : public SharedObject<EntityBuildData> {
     World::Coordinates coordinate;
     uint32_t geometryCount;
     std::vector<World::GeometryTypes> geometryTypes;
-    std::vector<std::vector<vk::VertexFormat::PBRTriangle>> vertices;
+    std::vector<std::vector<vk::VertexFormat::PBRTriangle>> vertices; // empty for raw geometries
     std::vector<std::vector<uint32_t>> indices;
+    std::vector<uint32_t> vertexCounts;
+    std::vector<uint32_t> indexCounts;
+    std::vector<EntityRawGeometry> rawGeometries;
+    std::vector<uint8_t> rawVertices;
+    bool normalOffset = false;
     std::vector<VkDeviceAddress> vertexBufferAddresses;
     std::vector<VkDeviceAddress> indexBufferAddresses;
     std::shared_ptr<vk::BLAS> blas;
@@ -65,7 +93,9 @@ struct EntityBuildData : public SharedObject<EntityBuildData> {
                     uint32_t geometryCount,
                     std::vector<World::GeometryTypes> &&geometryTypes,
                     std::vector<std::vector<vk::VertexFormat::PBRTriangle>> &&vertices,
-                    std::vector<std::vector<uint32_t>> &&indices);
+                    std::vector<std::vector<uint32_t>> &&indices,
+                    std::vector<EntityRawGeometry> &&rawGeometries = {},
+                    std::vector<uint8_t> &&rawVertices = {});
 };
 
 struct EntityBuildDataBatch : public SharedObject<EntityBuildDataBatch> {
@@ -75,6 +105,11 @@ struct EntityBuildDataBatch : public SharedObject<EntityBuildDataBatch> {
     std::shared_ptr<vk::DeviceLocalBuffer> indexBuffer;
     std::shared_ptr<vk::BLASBatchBuilder> blasBatchBuilder;
 
+    std::shared_ptr<vk::HostVisibleBuffer> rawVertexBuffer;
+    std::shared_ptr<vk::HostVisibleBuffer> expansionTaskBuffer;
+    uint32_t expansionTaskCount = 0;
+    uint32_t maxExpansionVertexCount = 0;
+
     void addData(std::shared_ptr<EntityBuildData> data);
     void build();
 };
@@ -107,6 +142,8 @@ struct Entity : public SharedObject<Entity> {
     std::shared_ptr<std::vector<World::GeometryTypes>> geometryTypes;
     std::shared_ptr<std::vector<std::vector<vk::VertexFormat::PBRTriangle>>> vertices;
     std::shared_ptr<std::vector<std::vector<uint32_t>>> indices;
+    std::vector<uint32_t> vertexCounts;
+    std::vector<uint32_t> indexCounts;
 
     Entity(std::shared_ptr<EntityBuildData> entityBuildData);
 };
@@ -147,7 +184,13 @@ class Entities : public SharedObject<Entities> {
 
     void resetFrame();
     void queueBuild(EntitiesBuildTask task);
+    // cpu half of queueBuild(), hands every entity that produced geometry to sink together with its post flag
+    static void decodeBuildTask(const EntitiesBuildTask &task,
+                                const std::function<void(std::shared_ptr<EntityBuildData>, bool)> &sink);
+    // bytes per vertex Java hands over for a geometry of this format
+    static size_t rawVertexStride(World::VertexFormats vertexFormat);
     void build();
+    void performQueuedExpansion();
     std::shared_ptr<EntityBatch> entityBatch();
     std::shared_ptr<EntityPostBatch> entityPostBatch();
     std::shared_ptr<vk::BLASBatchBuilder> blasBatchBuilder();
@@ -159,4 +202,9 @@ class Entities : public SharedObject<Entities> {
     std::shared_ptr<EntityPostBuildDataBatch> entityPostBuildDataBatch_;
 
     std::shared_ptr<vk::BLASBatchBuilder> blasBatchBuilder_;
+
+    std::shared_ptr<EntityBuildDataBatch> expansionBatch_;
+    std::vector<std::shared_ptr<vk::DescriptorTable>> expansionDescriptorTables_;
+    std::shared_ptr<vk::Shader> expansionShader_;
+    std::shared_ptr<vk::ComputePipeline> expansionPipeline_;
 };
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "core/render/frame_pacer.hpp"
+
+#include "core/render/renderer.hpp"
+#include "core/render/streamline_context.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+constexpr double AVERAGE_WEIGHT = 0.1;                           // of the newest sample
+constexpr auto WAKE_MARGIN = std::chrono::microseconds(500);     // wake this much before the estimate says
+constexpr auto MAX_PACING_SLEEP = std::chrono::milliseconds(50); // a bad estimate never stalls a frame for long
+
+double average(double current, double sample) {
+    return current == 0.0 ? sample : current + (sample - current) * AVERAGE_WEIGHT;
+}
+
+FramePacer::Clock::duration durationOf(double ms) {
+    return std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+}
+
+} // namespace
+
+FramePacer::FramePacer(std::shared_ptr<vk::Device> device,
+                       std::shared_ptr<vk::PhysicalDevice> physicalDevice,
+                       uint32_t frameNum)
+    : device_(device) {
+    VkPhysicalDeviceProperties properties = physicalDevice->properties();
+    timestampsSupported_ = properties.limits.timestampComputeAndGraphics == VK_TRUE;
+    timestampPeriodNs_ = properties.limits.timestampPeriod;
+
+    if (device_->hasTimelineSemaphore()) timeline_ = vk::Semaphore::create(device_, uint64_t{0});
+
+    recreate(frameNum);
+}
+
+FramePacer::~FramePacer() {
+    destroyQueryPool();
+}
+
+void FramePacer::recreate(uint32_t frameNum) {
+    destroyQueryPool();
+
+    slotWritten_.assign(frameNum, false);
+    currentSlot_ = -1;
+    predictedFinish_ = Clock::time_point{};
+    if (!timestampsSupported_) return;
+
+    VkQueryPoolCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    createInfo.queryCount = frameNum * 2;
+
+    if (vkCreateQueryPool(device_->vkDevice(), &createInfo, nullptr, &queryPool_) != VK_SUCCESS) {
+        std::cerr << "[FramePacer] failed to create timestamp query pool" << std::endl;
+        queryPool_ = VK_NULL_HANDLE;
+    }
+}
+
+void FramePacer::destroyQueryPool() {
+    if (queryPool_ != VK_NULL_HANDLE) vkDestroyQueryPool(device_->vkDevice(), queryPool_, nullptr);
+    queryPool_ = VK_NULL_HANDLE;
+}
+
+void FramePacer::waitFor(uint64_t value) {
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline_->vkSemaphore();
+    waitInfo.pValues = &value;
+    vkWaitSemaphores(device_->vkDevice(), &waitInfo, UINT64_MAX);
+}
+
+void FramePacer::pace() {
+    frameStart_ = Clock::now();
+    if (timeline_ == nullptr || submittedValue_ == 0) return;
+
+    // the frame about to start counts as in flight too
+    uint64_t framesInFlight = std::clamp(Renderer::options.framesInFlight, 2u, 4u);
+    if (submittedValue_ >= framesInFlight) waitFor(submittedValue_ + 1 - framesInFlight);
+
+    bool reflexPacing = StreamlineContext::isReflexAvailable() && Renderer::options.reflexEnabled;
+    if (Renderer::options.latencyPacing && !reflexPacing && gpuFrameMs_ > 0.0) {
+        uint64_t finishedValue = 0;
+        vkGetSemaphoreCounterValue(device_->vkDevice(), timeline_->vkSemaphore(), &finishedValue);
+
+        // recording finishes right when the GPU runs out of work, earlier would only queue the frame
+        if (finishedValue < submittedValue_) {
+            auto now = Clock::now();
+            auto wake = predictedFinish_ - durationOf(cpuFrameMs_) - WAKE_MARGIN;
+            if (wake > now) std::this_thread::sleep_until(std::min(wake, now + MAX_PACING_SLEEP));
+        }
+    }
+
+    frameStart_ = Clock::now();
+}
+
+void FramePacer::beginFrame(uint32_t frameIndex, std::shared_ptr<vk::CommandBuffer> firstCommandBuffer) {
+    currentSlot_ = -1;
+    if (queryPool_ == VK_NULL_HANDLE || frameIndex >= slotWritten_.size()) return;
+
+    if (slotWritten_[frameIndex]) {
+        // value and availability of the begin and end query, the frame fence has signaled so nothing is waited on
+        uint64_t results[4] = {};
+        VkResult result = vkGetQueryPoolResults(device_->vkDevice(), queryPool_, frameIndex * 2, 2, sizeof(results),
+                                                results, 2 * sizeof(uint64_t),
+                                                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result == VK_SUCCESS && results[1] != 0 && results[3] != 0 && results[2] >= results[0]) {
+            gpuFrameMs_ = average(gpuFrameMs_, (results[2] - results[0]) * timestampPeriodNs_ * 1e-6);
+        }
+    }
+
+    vkCmdResetQueryPool(firstCommandBuffer->vkCommandBuffer(), queryPool_, frameIndex * 2, 2);
+    vkCmdWriteTimestamp2(firstCommandBuffer->vkCommandBuffer(), VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, queryPool_,
+                         frameIndex * 2);
+    slotWritten_[frameIndex] = true;
+    currentSlot_ = static_cast<int32_t>(frameIndex);
+}
+
+void FramePacer::endFrame(std::shared_ptr<vk::CommandBuffer> lastCommandBuffer) {
+    if (currentSlot_ < 0) return;
+
+    vkCmdWriteTimestamp2(lastCommandBuffer->vkCommandBuffer(), VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool_,
+                         currentSlot_ * 2 + 1);
+}
+
+std::shared_ptr<vk::Semaphore> FramePacer::timeline() {
+    return timeline_;
+}
+
+uint64_t FramePacer::submitFrame() {
+    auto now = Clock::now();
+    cpuFrameMs_ = average(cpuFrameMs_, std::chrono::duration<double, std::milli>(now - frameStart_).count());
+
+    // the GPU starts on the frame once it finished the previous one
+    predictedFinish_ = std::max(now, predictedFinish_) + durationOf(gpuFrameMs_);
+    return ++submittedValue_;
+}
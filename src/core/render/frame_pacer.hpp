@@ -0,0 +1,56 @@
+#pragma once
+
+#include "core/all_extern.hpp"
+#include "core/vulkan/all_core_vulkan.hpp"
+
+#include <chrono>
+#include <vector>
+
+// Paces the render thread against the GPU on a frame timeline semaphore, the last submission of every frame signals
+// the next value. A frame only starts while fewer than Options::framesInFlight are pending on the GPU. With
+// Options::latencyPacing the render thread also sleeps until the GPU is about to finish the previous frame, estimated
+// from timestamps around each frame's command buffers and from how long recording a frame takes, so a frame is
+// submitted just in time instead of queueing behind the others. Reflex does the latter itself where it is enabled.
+class FramePacer : public SharedObject<FramePacer> {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    FramePacer(std::shared_ptr<vk::Device> device,
+               std::shared_ptr<vk::PhysicalDevice> physicalDevice,
+               uint32_t frameNum);
+    ~FramePacer();
+
+    // the swapchain image count may change on recreate, the caller guarantees the device is idle
+    void recreate(uint32_t frameNum);
+
+    // before the next image is acquired, waits for a free frame and in latency mode for the GPU to nearly catch up
+    void pace();
+    // called once the frame's fence has signaled, collects its GPU time and starts timing the slot again
+    void beginFrame(uint32_t frameIndex, std::shared_ptr<vk::CommandBuffer> firstCommandBuffer);
+    void endFrame(std::shared_ptr<vk::CommandBuffer> lastCommandBuffer);
+
+    // nullptr if the device lacks timeline semaphores, frames are only paced by their fences then
+    std::shared_ptr<vk::Semaphore> timeline();
+    // the value the frame's last submission signals on timeline(), called right before submitting
+    uint64_t submitFrame();
+
+  private:
+    void destroyQueryPool();
+    void waitFor(uint64_t value);
+
+    std::shared_ptr<vk::Device> device_;
+    std::shared_ptr<vk::Semaphore> timeline_;
+    uint64_t submittedValue_ = 0;
+
+    bool timestampsSupported_ = false;
+    double timestampPeriodNs_ = 1.0;
+    VkQueryPool queryPool_ = VK_NULL_HANDLE; // begin and end of every frame slot
+    std::vector<bool> slotWritten_;
+    int32_t currentSlot_ = -1;
+
+    // moving averages, 0 until measured
+    double gpuFrameMs_ = 0.0;
+    double cpuFrameMs_ = 0.0;
+    Clock::time_point frameStart_;      // the render thread was released by pace()
+    Clock::time_point predictedFinish_; // of the last submitted frame on the GPU
+};
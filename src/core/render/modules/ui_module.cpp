@@ -2,10 +2,13 @@
 
 #include "core/render/buffers.hpp"
 #include "core/render/pipeline.hpp"
+#include "core/render/profiler.hpp"
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 #include "core/render/world.hpp"
 
+#include <cstring>
+
 UIModule::UIModule() {}
 
 void UIModule::init(std::shared_ptr<Framework> framework) {
@@ -47,11 +50,15 @@ void UIModule::bindTexture(std::shared_ptr<vk::Sampler> sampler,
 
     uint32_t size = framework->swapchain()->imageCount();
     for (int i = 0; i < size; i++) {
-        overlayDescriptorTables_[i]->bindSamplerImage(sampler, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 0,
-                                                      index);
+        overlayDescriptorTables_[i]->queueSamplerImage(sampler, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 0,
+                                                       index);
     }
 }
 
+void UIModule::flushTextureBindings() {
+    for (auto &table : overlayDescriptorTables_) { table->flushQueuedWrites(); }
+}
+
 void UIModule::initOverlayDescriptorTablesAndFrameSamplers() {
     auto framework = framework_.lock();
 
@@ -275,28 +282,34 @@ void UIModule::initOverlayDrawPipelines() {
         switch (type) {
             case POSITION_TEX: {
                 builder.defineVertexInputState<vk::VertexFormat::PositionTex>();
+                overlayDrawVertexStrides_[type] = sizeof(vk::VertexFormat::PositionTex);
                 break;
             }
             case POSITION_TEX_COLOR: {
                 builder.defineVertexInputState<vk::VertexFormat::PositionTexColor>();
+                overlayDrawVertexStrides_[type] = sizeof(vk::VertexFormat::PositionTexColor);
                 break;
             }
             case POSITION_COLOR: {
                 builder.defineVertexInputState<vk::VertexFormat::PositionColor>();
+                overlayDrawVertexStrides_[type] = sizeof(vk::VertexFormat::PositionColor);
                 break;
             }
             case POSITION_COLOR_TEX_LIGHT: {
                 builder.defineVertexInputState<vk::VertexFormat::PositionColorTexLight>();
+                overlayDrawVertexStrides_[type] = sizeof(vk::VertexFormat::PositionColorTexLight);
                 break;
             }
             case POSITION_COLOR_TEXTURE_OVERLAY_LIGHT_NORMAL_NO_OUTLINE:
             case POSITION_COLOR_TEXTURE_OVERLAY_LIGHT_NORMAL: {
                 builder.defineVertexInputState<vk::VertexFormat::PositionColorTexOverlayLightNormal>();
+                overlayDrawVertexStrides_[type] = sizeof(vk::VertexFormat::PositionColorTexOverlayLightNormal);
                 break;
             }
             case POSITION_END_PORTAL:
             case POSITION: {
                 builder.defineVertexInputState<vk::VertexFormat::PositionOnly>();
+                overlayDrawVertexStrides_[type] = sizeof(vk::VertexFormat::PositionOnly);
                 break;
             }
 
@@ -510,102 +523,198 @@ UIModuleContext::UIModuleContext(std::shared_ptr<FrameworkContext> context, std:
     }
     overlayClearDepth = 1.0;
     overlayClearStencil = 0xffffffff;
+
+    invalidateOverlayEmittedState();
 }
 
+// dynamic state is only recorded lazily right before a draw, see flushOverlayDynamicStates()
 void UIModuleContext::syncToCommandBuffer() {
     auto context = frameworkContext.lock();
     auto framework = context->framework.lock();
 
     if (!framework->isRunning()) return;
 
+    invalidateOverlayEmittedState();
+}
+
+void UIModuleContext::invalidateOverlayEmittedState() {
+    overlayEmittedState = {};
+    overlayStateDirty = true;
+}
+
+template <typename T>
+static bool sameOverlayState(const T &a, const T &b) {
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+void UIModuleContext::flushOverlayDynamicStates() {
+    if (!overlayStateDirty) return;
+
+    auto context = frameworkContext.lock();
+    auto framework = context->framework.lock();
+
     auto commandBuffer = context->overlayCommandBuffer->vkCommandBuffer();
+    auto &emitted = overlayEmittedState;
+    bool all = !emitted.valid;
 
     // ------------ VkPipelineViewportStateCreateInfo ------------
     /* VK_DYNAMIC_STATE_VIEWPORT */
-    vkCmdSetViewport(commandBuffer, 0, 1, &overlayViewport);
+    if (all || !sameOverlayState(emitted.viewport, overlayViewport)) {
+        vkCmdSetViewport(commandBuffer, 0, 1, &overlayViewport);
+        emitted.viewport = overlayViewport;
+    }
 
     /* VK_DYNAMIC_STATE_SCISSOR */
-    if (overlayScissorEnabled)
-        vkCmdSetScissor(commandBuffer, 0, 1, &overlayScissor);
-    else {
-        VkRect2D full_scissor = {
+    VkRect2D scissor = overlayScissor;
+    if (!overlayScissorEnabled) {
+        scissor = {
             .offset = {0, 0},
             .extent = framework->swapchain()->vkExtent(),
         };
-        vkCmdSetScissor(commandBuffer, 0, 1, &full_scissor);
+    }
+    if (all || !sameOverlayState(emitted.scissor, scissor)) {
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        emitted.scissor = scissor;
     }
 
     // ------------ VkPipelineDepthStencilStateCreateInfo ------------
     /* VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE */
-    vkCmdSetDepthTestEnable(commandBuffer, overlayDepthTestEnable);
+    if (all || emitted.depthTestEnable != overlayDepthTestEnable) {
+        vkCmdSetDepthTestEnable(commandBuffer, overlayDepthTestEnable);
+        emitted.depthTestEnable = overlayDepthTestEnable;
+    }
 
     /* VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE */
-    vkCmdSetDepthWriteEnable(commandBuffer, overlayDepthWriteEnable);
+    if (all || emitted.depthWriteEnable != overlayDepthWriteEnable) {
+        vkCmdSetDepthWriteEnable(commandBuffer, overlayDepthWriteEnable);
+        emitted.depthWriteEnable = overlayDepthWriteEnable;
+    }
 
     /* VK_DYNAMIC_STATE_DEPTH_COMPARE_OP */
-    vkCmdSetDepthCompareOp(commandBuffer, overlayDepthCompareOp);
+    if (all || emitted.depthCompareOp != overlayDepthCompareOp) {
+        vkCmdSetDepthCompareOp(commandBuffer, overlayDepthCompareOp);
+        emitted.depthCompareOp = overlayDepthCompareOp;
+    }
 
     /* VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE */
-    vkCmdSetStencilTestEnable(commandBuffer, overlayStencilTestEnable);
+    if (all || emitted.stencilTestEnable != overlayStencilTestEnable) {
+        vkCmdSetStencilTestEnable(commandBuffer, overlayStencilTestEnable);
+        emitted.stencilTestEnable = overlayStencilTestEnable;
+    }
 
-    /* VK_DYNAMIC_STATE_STENCIL_OP */
-    vkCmdSetStencilOp(commandBuffer, VK_STENCIL_FACE_FRONT_BIT, overlayFailOp[0], overlayPassOp[0],
-                      overlayDepthFailOp[0], overlayCompareOp[0]);
-    vkCmdSetStencilOp(commandBuffer, VK_STENCIL_FACE_BACK_BIT, overlayFailOp[1], overlayPassOp[1],
-                      overlayDepthFailOp[1], overlayCompareOp[1]);
+    constexpr VkStencilFaceFlags faces[2] = {VK_STENCIL_FACE_FRONT_BIT, VK_STENCIL_FACE_BACK_BIT};
+    for (int i = 0; i < 2; i++) {
+        /* VK_DYNAMIC_STATE_STENCIL_OP */
+        if (all || emitted.failOp[i] != overlayFailOp[i] || emitted.passOp[i] != overlayPassOp[i] ||
+            emitted.depthFailOp[i] != overlayDepthFailOp[i] || emitted.compareOp[i] != overlayCompareOp[i]) {
+            vkCmdSetStencilOp(commandBuffer, faces[i], overlayFailOp[i], overlayPassOp[i], overlayDepthFailOp[i],
+                              overlayCompareOp[i]);
+            emitted.failOp[i] = overlayFailOp[i];
+            emitted.passOp[i] = overlayPassOp[i];
+            emitted.depthFailOp[i] = overlayDepthFailOp[i];
+            emitted.compareOp[i] = overlayCompareOp[i];
+        }
 
-    /* VK_DYNAMIC_STATE_STENCIL_REFERENCE */
-    vkCmdSetStencilReference(commandBuffer, VK_STENCIL_FACE_FRONT_BIT, overlayReference[0]);
-    vkCmdSetStencilReference(commandBuffer, VK_STENCIL_FACE_BACK_BIT, overlayReference[1]);
+        /* VK_DYNAMIC_STATE_STENCIL_REFERENCE */
+        if (all || emitted.reference[i] != overlayReference[i]) {
+            vkCmdSetStencilReference(commandBuffer, faces[i], overlayReference[i]);
+            emitted.reference[i] = overlayReference[i];
+        }
 
-    /* VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK */
-    vkCmdSetStencilCompareMask(commandBuffer, VK_STENCIL_FACE_FRONT_BIT, overlayCompareMask[0]);
-    vkCmdSetStencilCompareMask(commandBuffer, VK_STENCIL_FACE_BACK_BIT, overlayCompareMask[1]);
+        /* VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK */
+        if (all || emitted.compareMask[i] != overlayCompareMask[i]) {
+            vkCmdSetStencilCompareMask(commandBuffer, faces[i], overlayCompareMask[i]);
+            emitted.compareMask[i] = overlayCompareMask[i];
+        }
 
-    /* VK_DYNAMIC_STATE_STENCIL_WRITE_MASK */
-    vkCmdSetStencilWriteMask(commandBuffer, VK_STENCIL_FACE_FRONT_BIT, overlayWriteMask[0]);
-    vkCmdSetStencilWriteMask(commandBuffer, VK_STENCIL_FACE_BACK_BIT, overlayWriteMask[1]);
+        /* VK_DYNAMIC_STATE_STENCIL_WRITE_MASK */
+        if (all || emitted.writeMask[i] != overlayWriteMask[i]) {
+            vkCmdSetStencilWriteMask(commandBuffer, faces[i], overlayWriteMask[i]);
+            emitted.writeMask[i] = overlayWriteMask[i];
+        }
+    }
 
     // ------------ VkPipelineRasterizationStateCreateInfo ------------
     /* VK_DYNAMIC_STATE_CULL_MODE */
-    vkCmdSetCullMode(commandBuffer, overlayCullMode);
+    if (all || emitted.cullMode != overlayCullMode) {
+        vkCmdSetCullMode(commandBuffer, overlayCullMode);
+        emitted.cullMode = overlayCullMode;
+    }
 
     /* VK_DYNAMIC_STATE_FRONT_FACE */
-    vkCmdSetFrontFace(commandBuffer, overlayFrontFace);
+    if (all || emitted.frontFace != overlayFrontFace) {
+        vkCmdSetFrontFace(commandBuffer, overlayFrontFace);
+        emitted.frontFace = overlayFrontFace;
+    }
 
     /* VK_DYNAMIC_STATE_POLYGON_MODE_EXT */
-    vkCmdSetPolygonModeEXT(commandBuffer, overlayPolygonMode);
+    if (all || emitted.polygonMode != overlayPolygonMode) {
+        vkCmdSetPolygonModeEXT(commandBuffer, overlayPolygonMode);
+        emitted.polygonMode = overlayPolygonMode;
+    }
 
     /* VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE */
-    vkCmdSetDepthBiasEnable(commandBuffer, overlayDepthBiasEnable);
+    if (all || emitted.depthBiasEnable != overlayDepthBiasEnable) {
+        vkCmdSetDepthBiasEnable(commandBuffer, overlayDepthBiasEnable);
+        emitted.depthBiasEnable = overlayDepthBiasEnable;
+    }
 
     /* VK_DYNAMIC_STATE_DEPTH_BIAS */
-    vkCmdSetDepthBias(commandBuffer, overlayDepthBiasConstantFactor[overlayPolygonMode],
-                      overlayDepthBiasClamp[overlayPolygonMode], overlayDepthBiasSlopeFactor[overlayPolygonMode]);
+    std::array<float, 3> depthBias = {overlayDepthBiasConstantFactor[overlayPolygonMode],
+                                      overlayDepthBiasClamp[overlayPolygonMode],
+                                      overlayDepthBiasSlopeFactor[overlayPolygonMode]};
+    if (all || emitted.depthBias != depthBias) {
+        vkCmdSetDepthBias(commandBuffer, depthBias[0], depthBias[1], depthBias[2]);
+        emitted.depthBias = depthBias;
+    }
 
     /* VK_DYNAMIC_STATE_LINE_WIDTH */
-    vkCmdSetLineWidth(commandBuffer, overlayLineWidth);
+    if (all || emitted.lineWidth != overlayLineWidth) {
+        vkCmdSetLineWidth(commandBuffer, overlayLineWidth);
+        emitted.lineWidth = overlayLineWidth;
+    }
 
     // ------------ VkPipelineColorBlendAttachmentState / StateCreateInfo ------------
     /* VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT */
-    vkCmdSetColorBlendEnableEXT(commandBuffer, 0, 1, &overlayBlendEnabled);
+    if (all || emitted.blendEnabled != overlayBlendEnabled) {
+        vkCmdSetColorBlendEnableEXT(commandBuffer, 0, 1, &overlayBlendEnabled);
+        emitted.blendEnabled = overlayBlendEnabled;
+    }
 
     /* VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT */
-    vkCmdSetColorBlendEquationEXT(commandBuffer, 0, 1, &overlayColorBlendEquation);
+    if (all || !sameOverlayState(emitted.colorBlendEquation, overlayColorBlendEquation)) {
+        vkCmdSetColorBlendEquationEXT(commandBuffer, 0, 1, &overlayColorBlendEquation);
+        emitted.colorBlendEquation = overlayColorBlendEquation;
+    }
 
     /* VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT */
-    vkCmdSetColorWriteMaskEXT(commandBuffer, 0, 1, &overlayColorWriteMask);
+    if (all || emitted.colorWriteMask != overlayColorWriteMask) {
+        vkCmdSetColorWriteMaskEXT(commandBuffer, 0, 1, &overlayColorWriteMask);
+        emitted.colorWriteMask = overlayColorWriteMask;
+    }
 
     // ------------ VkPipelineColorBlendStateCreateInfo ------------
     /* VK_DYNAMIC_STATE_LOGIC_OP_EXT and VK_DYNAMIC_STATE_LOGIC_OP_ENABLE_EXT */
     // Only call these if extendedDynamicState2LogicOp feature is enabled
     if (context->device->hasExtendedDynamicState2LogicOp()) {
-        vkCmdSetLogicOpEXT(commandBuffer, overlayColorLogicOp);
-        vkCmdSetLogicOpEnableEXT(commandBuffer, overlayColorLogicOpEnable);
+        if (all || emitted.colorLogicOp != overlayColorLogicOp) {
+            vkCmdSetLogicOpEXT(commandBuffer, overlayColorLogicOp);
+            emitted.colorLogicOp = overlayColorLogicOp;
+        }
+        if (all || emitted.colorLogicOpEnable != overlayColorLogicOpEnable) {
+            vkCmdSetLogicOpEnableEXT(commandBuffer, overlayColorLogicOpEnable);
+            emitted.colorLogicOpEnable = overlayColorLogicOpEnable;
+        }
     }
 
     /* VK_DYNAMIC_STATE_BLEND_CONSTANTS */
-    vkCmdSetBlendConstants(commandBuffer, overlayBlendConstants.data());
+    if (all || emitted.blendConstants != overlayBlendConstants) {
+        vkCmdSetBlendConstants(commandBuffer, overlayBlendConstants.data());
+        emitted.blendConstants = overlayBlendConstants;
+    }
+
+    emitted.valid = true;
+    overlayStateDirty = false;
 }
 
 void UIModuleContext::syncFromContext(std::shared_ptr<UIModuleContext> other) {
@@ -660,15 +769,7 @@ void UIModuleContext::setOverlayScissorEnabled(bool enabled) {
     if (!framework->isRunning()) return;
 
     overlayScissorEnabled = enabled;
-    if (overlayScissorEnabled) {
-        vkCmdSetScissor(context->overlayCommandBuffer->vkCommandBuffer(), 0, 1, &overlayScissor);
-    } else {
-        VkRect2D full_scissor = {
-            .offset = {0, 0},
-            .extent = framework->swapchain()->vkExtent(),
-        };
-        vkCmdSetScissor(context->overlayCommandBuffer->vkCommandBuffer(), 0, 1, &full_scissor);
-    }
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayScissor(int x, int y, int width, int height) {
@@ -690,7 +791,7 @@ void UIModuleContext::setOverlayScissor(int x, int y, int width, int height) {
     overlayScissor.offset.y = y;
     overlayScissor.extent.width = width;
     overlayScissor.extent.height = height;
-    setOverlayScissorEnabled(overlayScissorEnabled);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayViewport(int x, int y, int width, int height) {
@@ -703,7 +804,7 @@ void UIModuleContext::setOverlayViewport(int x, int y, int width, int height) {
     overlayViewport.y = y;
     overlayViewport.width = width;
     overlayViewport.height = height;
-    vkCmdSetViewport(context->overlayCommandBuffer->vkCommandBuffer(), 0, 1, &overlayViewport);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayBlendEnable(bool enable) {
@@ -713,7 +814,7 @@ void UIModuleContext::setOverlayBlendEnable(bool enable) {
     if (!framework->isRunning()) return;
 
     overlayBlendEnabled = enable;
-    vkCmdSetColorBlendEnableEXT(context->overlayCommandBuffer->vkCommandBuffer(), 0, 1, &overlayBlendEnabled);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayColorBlendConstants(float const1, float const2, float const3, float const4) {
@@ -726,7 +827,7 @@ void UIModuleContext::setOverlayColorBlendConstants(float const1, float const2,
     overlayBlendConstants[1] = const2;
     overlayBlendConstants[2] = const3;
     overlayBlendConstants[3] = const4;
-    vkCmdSetBlendConstants(context->overlayCommandBuffer->vkCommandBuffer(), overlayBlendConstants.data());
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayColorLogicOpEnable(bool enable) {
@@ -736,9 +837,7 @@ void UIModuleContext::setOverlayColorLogicOpEnable(bool enable) {
     if (!framework->isRunning()) return;
 
     overlayColorLogicOpEnable = enable;
-    if (context->device->hasExtendedDynamicState2LogicOp()) {
-        vkCmdSetLogicOpEnableEXT(context->overlayCommandBuffer->vkCommandBuffer(), overlayColorLogicOpEnable);
-    }
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayBlendFuncSeparate(int srcColorBlendFactor,
@@ -754,7 +853,7 @@ void UIModuleContext::setOverlayBlendFuncSeparate(int srcColorBlendFactor,
     overlayColorBlendEquation.srcAlphaBlendFactor = static_cast<VkBlendFactor>(srcAlphaBlendFactor);
     overlayColorBlendEquation.dstColorBlendFactor = static_cast<VkBlendFactor>(dstColorBlendFactor);
     overlayColorBlendEquation.dstAlphaBlendFactor = static_cast<VkBlendFactor>(dstAlphaBlendFactor);
-    vkCmdSetColorBlendEquationEXT(context->overlayCommandBuffer->vkCommandBuffer(), 0, 1, &overlayColorBlendEquation);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayBlendOpSeparate(int colorBlendOp, int alphaBlendOp) {
@@ -765,7 +864,7 @@ void UIModuleContext::setOverlayBlendOpSeparate(int colorBlendOp, int alphaBlend
 
     overlayColorBlendEquation.colorBlendOp = static_cast<VkBlendOp>(colorBlendOp);
     overlayColorBlendEquation.alphaBlendOp = static_cast<VkBlendOp>(alphaBlendOp);
-    vkCmdSetColorBlendEquationEXT(context->overlayCommandBuffer->vkCommandBuffer(), 0, 1, &overlayColorBlendEquation);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayColorWriteMask(int colorWriteMask) {
@@ -777,7 +876,7 @@ void UIModuleContext::setOverlayColorWriteMask(int colorWriteMask) {
     // Keep alpha writes enabled in SDR as well.
     // The final composite pass samples overlay alpha to blend UI over the world.
     overlayColorWriteMask = colorWriteMask;
-    vkCmdSetColorWriteMaskEXT(context->overlayCommandBuffer->vkCommandBuffer(), 0, 1, &overlayColorWriteMask);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayColorLogicOp(int colorLogicOp) {
@@ -787,9 +886,7 @@ void UIModuleContext::setOverlayColorLogicOp(int colorLogicOp) {
     if (!framework->isRunning()) return;
 
     overlayColorLogicOp = static_cast<VkLogicOp>(colorLogicOp);
-    if (context->device->hasExtendedDynamicState2LogicOp()) {
-        vkCmdSetLogicOpEXT(context->overlayCommandBuffer->vkCommandBuffer(), overlayColorLogicOp);
-    }
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayDepthTestEnable(bool enable) {
@@ -799,7 +896,7 @@ void UIModuleContext::setOverlayDepthTestEnable(bool enable) {
     if (!framework->isRunning()) return;
 
     overlayDepthTestEnable = enable;
-    vkCmdSetDepthTestEnable(context->overlayCommandBuffer->vkCommandBuffer(), overlayDepthTestEnable);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayDepthWriteEnable(bool enable) {
@@ -809,7 +906,7 @@ void UIModuleContext::setOverlayDepthWriteEnable(bool enable) {
     if (!framework->isRunning()) return;
 
     overlayDepthWriteEnable = enable;
-    vkCmdSetDepthWriteEnable(context->overlayCommandBuffer->vkCommandBuffer(), overlayDepthWriteEnable);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayStencilTestEnable(bool enable) {
@@ -819,7 +916,7 @@ void UIModuleContext::setOverlayStencilTestEnable(bool enable) {
     if (!framework->isRunning()) return;
 
     overlayStencilTestEnable = enable;
-    vkCmdSetStencilTestEnable(context->overlayCommandBuffer->vkCommandBuffer(), overlayStencilTestEnable);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayDepthCompareOp(int depthCompareOp) {
@@ -829,7 +926,7 @@ void UIModuleContext::setOverlayDepthCompareOp(int depthCompareOp) {
     if (!framework->isRunning()) return;
 
     overlayDepthCompareOp = static_cast<VkCompareOp>(depthCompareOp);
-    vkCmdSetDepthCompareOp(context->overlayCommandBuffer->vkCommandBuffer(), overlayDepthCompareOp);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayStencilFrontFunc(int compareOp, int reference, int compareMask) {
@@ -841,12 +938,7 @@ void UIModuleContext::setOverlayStencilFrontFunc(int compareOp, int reference, i
     overlayCompareOp[0] = static_cast<VkCompareOp>(compareOp);
     overlayReference[0] = reference;
     overlayCompareMask[0] = compareMask;
-    vkCmdSetStencilOp(context->overlayCommandBuffer->vkCommandBuffer(), VK_STENCIL_FACE_FRONT_BIT, overlayFailOp[0],
-                      overlayPassOp[0], overlayDepthFailOp[0], overlayCompareOp[0]);
-    vkCmdSetStencilReference(context->overlayCommandBuffer->vkCommandBuffer(), VK_STENCIL_FACE_FRONT_BIT,
-                             overlayReference[0]);
-    vkCmdSetStencilCompareMask(context->overlayCommandBuffer->vkCommandBuffer(), VK_STENCIL_FACE_FRONT_BIT,
-                               overlayCompareMask[0]);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayStencilBackFunc(int compareOp, int reference, int compareMask) {
@@ -858,12 +950,7 @@ void UIModuleContext::setOverlayStencilBackFunc(int compareOp, int reference, in
     overlayCompareOp[1] = static_cast<VkCompareOp>(compareOp);
     overlayReference[1] = reference;
     overlayCompareMask[1] = compareMask;
-    vkCmdSetStencilOp(context->overlayCommandBuffer->vkCommandBuffer(), VK_STENCIL_FACE_BACK_BIT, overlayFailOp[1],
-                      overlayPassOp[1], overlayDepthFailOp[1], overlayCompareOp[1]);
-    vkCmdSetStencilReference(context->overlayCommandBuffer->vkCommandBuffer(), VK_STENCIL_FACE_BACK_BIT,
-                             overlayReference[1]);
-    vkCmdSetStencilCompareMask(context->overlayCommandBuffer->vkCommandBuffer(), VK_STENCIL_FACE_BACK_BIT,
-                               overlayCompareMask[1]);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayStencilFrontOp(int failOp, int depthFailOp, int passOp) {
@@ -875,8 +962,7 @@ void UIModuleContext::setOverlayStencilFrontOp(int failOp, int depthFailOp, int
     overlayFailOp[0] = static_cast<VkStencilOp>(failOp);
     overlayDepthFailOp[0] = static_cast<VkStencilOp>(depthFailOp);
     overlayPassOp[0] = static_cast<VkStencilOp>(passOp);
-    vkCmdSetStencilOp(context->overlayCommandBuffer->vkCommandBuffer(), VK_STENCIL_FACE_FRONT_BIT, overlayFailOp[0],
-                      overlayPassOp[0], overlayDepthFailOp[0], overlayCompareOp[0]);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayStencilBackOp(int failOp, int depthFailOp, int passOp) {
@@ -888,8 +974,7 @@ void UIModuleContext::setOverlayStencilBackOp(int failOp, int depthFailOp, int p
     overlayFailOp[1] = static_cast<VkStencilOp>(failOp);
     overlayDepthFailOp[1] = static_cast<VkStencilOp>(depthFailOp);
     overlayPassOp[1] = static_cast<VkStencilOp>(passOp);
-    vkCmdSetStencilOp(context->overlayCommandBuffer->vkCommandBuffer(), VK_STENCIL_FACE_BACK_BIT, overlayFailOp[1],
-                      overlayPassOp[1], overlayDepthFailOp[1], overlayCompareOp[1]);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayStencilFrontWriteMask(int writeMask) {
@@ -899,8 +984,7 @@ void UIModuleContext::setOverlayStencilFrontWriteMask(int writeMask) {
     if (!framework->isRunning()) return;
 
     overlayWriteMask[0] = writeMask;
-    vkCmdSetStencilWriteMask(context->overlayCommandBuffer->vkCommandBuffer(), VK_STENCIL_FACE_FRONT_BIT,
-                             overlayWriteMask[0]);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayStencilBackWriteMask(int writeMask) {
@@ -910,8 +994,7 @@ void UIModuleContext::setOverlayStencilBackWriteMask(int writeMask) {
     if (!framework->isRunning()) return;
 
     overlayWriteMask[1] = writeMask;
-    vkCmdSetStencilWriteMask(context->overlayCommandBuffer->vkCommandBuffer(), VK_STENCIL_FACE_BACK_BIT,
-                             overlayWriteMask[1]);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayLineWidth(float lineWidth) {
@@ -921,7 +1004,7 @@ void UIModuleContext::setOverlayLineWidth(float lineWidth) {
     if (!framework->isRunning()) return;
 
     overlayLineWidth = lineWidth;
-    vkCmdSetLineWidth(context->overlayCommandBuffer->vkCommandBuffer(), overlayLineWidth);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayPolygonMode(int polygonMode) {
@@ -931,8 +1014,7 @@ void UIModuleContext::setOverlayPolygonMode(int polygonMode) {
     if (!framework->isRunning()) return;
 
     overlayPolygonMode = static_cast<VkPolygonMode>(polygonMode);
-    vkCmdSetPolygonModeEXT(context->overlayCommandBuffer->vkCommandBuffer(), overlayPolygonMode);
-    setOverlayDepthBiasEnable(overlayPolygonMode, overlayDepthBiasEnable);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayCullMode(int cullMode) {
@@ -942,7 +1024,7 @@ void UIModuleContext::setOverlayCullMode(int cullMode) {
     if (!framework->isRunning()) return;
 
     overlayCullMode = cullMode;
-    vkCmdSetCullMode(context->overlayCommandBuffer->vkCommandBuffer(), overlayCullMode);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayFrontFace(int frontFace) {
@@ -952,7 +1034,7 @@ void UIModuleContext::setOverlayFrontFace(int frontFace) {
     if (!framework->isRunning()) return;
 
     overlayFrontFace = static_cast<VkFrontFace>(frontFace);
-    vkCmdSetFrontFace(context->overlayCommandBuffer->vkCommandBuffer(), overlayFrontFace);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayDepthBiasEnable(int polygonMode, bool enable) {
@@ -962,11 +1044,7 @@ void UIModuleContext::setOverlayDepthBiasEnable(int polygonMode, bool enable) {
     if (!framework->isRunning()) return;
 
     overlayDepthBiasEnable = enable;
-    if (overlayDepthBiasEnable)
-        vkCmdSetDepthBias(context->overlayCommandBuffer->vkCommandBuffer(),
-                          overlayDepthBiasConstantFactor[overlayPolygonMode], overlayDepthBiasClamp[overlayPolygonMode],
-                          overlayDepthBiasSlopeFactor[overlayPolygonMode]);
-    vkCmdSetDepthBiasEnable(context->overlayCommandBuffer->vkCommandBuffer(), overlayDepthBiasEnable);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayDepthBias(float depthBiasSlopeFactor, float depthBiasConstantFactor) {
@@ -977,7 +1055,7 @@ void UIModuleContext::setOverlayDepthBias(float depthBiasSlopeFactor, float dept
 
     overlayDepthBiasSlopeFactor[overlayPolygonMode] = depthBiasSlopeFactor;
     overlayDepthBiasConstantFactor[overlayPolygonMode] = depthBiasConstantFactor;
-    setOverlayDepthBiasEnable(overlayPolygonMode, overlayDepthBiasEnable);
+    overlayStateDirty = true;
 }
 
 void UIModuleContext::setOverlayClearColor(float red, float green, float blue, float alpha) {
@@ -1099,6 +1177,8 @@ void UIModuleContext::switchOverlayPost() {
 
     if (!framework->isRunning()) return;
 
+    flushPendingOverlayDraw();
+
     auto mainQueueIndex = context->physicalDevice->mainQueueIndex();
 
     if (overlayMode == DRAW) {
@@ -1167,6 +1247,8 @@ void UIModuleContext::clearOverlayEntireColorAttachment() {
 
     if (!framework->isRunning()) return;
 
+    flushPendingOverlayDraw();
+
     switchOverlayDraw();
 
     VkClearAttachment clearAttachment{};
@@ -1194,6 +1276,8 @@ void UIModuleContext::clearOverlayEntireDepthStencilAttachment(int aspectMask) {
 
     if (!framework->isRunning()) return;
 
+    flushPendingOverlayDraw();
+
     switchOverlayDraw();
 
     VkClearAttachment clearAttachment{};
@@ -1210,8 +1294,8 @@ void UIModuleContext::clearOverlayEntireDepthStencilAttachment(int aspectMask) {
     vkCmdClearAttachments(context->overlayCommandBuffer->vkCommandBuffer(), 1, &clearAttachment, 1, &clearRect);
 }
 
-void UIModuleContext::drawIndexed(std::shared_ptr<vk::DeviceLocalBuffer> vertexBuffer,
-                                  std::shared_ptr<vk::DeviceLocalBuffer> indexBuffer,
+void UIModuleContext::drawIndexed(const OverlayBufferRange &vertexRange,
+                                  const OverlayBufferRange &indexRange,
                                   OverlayDrawPipelineType pipelineType,
                                   uint32_t indexCount,
                                   VkIndexType indexType) {
@@ -1220,20 +1304,81 @@ void UIModuleContext::drawIndexed(std::shared_ptr<vk::DeviceLocalBuffer> vertexB
     auto module = uiModule.lock();
 
     if (!framework->isRunning()) return;
+    if (vertexRange.buffer == nullptr || indexRange.buffer == nullptr) return;
 
     switchOverlayDraw();
 
-    vkCmdBindPipeline(context->overlayCommandBuffer->vkCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      module->overlayDrawPipelines_[pipelineType]->vkPipeline());
-
-    auto pipelineLayout = overlayDescriptorTable->vkPipelineLayout();
+    VkPipeline pipeline = module->overlayDrawPipelines_[pipelineType]->vkPipeline();
     int drawID = Renderer::instance().buffers()->getDrawID();
-    vkCmdPushConstants(context->overlayCommandBuffer->vkCommandBuffer(), pipelineLayout, VK_SHADER_STAGE_ALL, 0,
-                       sizeof(int), &drawID);
+    VkDeviceSize stride = module->overlayDrawVertexStrides_[pipelineType];
+    VkDeviceSize indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    // quads sharing the quad index pattern whose vertices follow each other in the arena are one longer quad list
+    auto &pending = pendingOverlayDraw;
+    if (pending.indexCount > 0 && !overlayStateDirty && pending.pipeline == pipeline && pending.drawID == drawID &&
+        pending.indexType == indexType && pending.sequentialQuads && indexRange.sequentialQuads &&
+        pending.indexBuffer == indexRange.buffer && pending.vertexBuffer == vertexRange.buffer &&
+        pending.indexCount % 6 == 0 &&
+        vertexRange.offset == pending.vertexOffset + pending.indexCount / 6 * 4 * stride &&
+        (pending.indexCount + indexCount) * indexSize <= indexRange.size) {
+        pending.indexCount += indexCount;
+        return;
+    }
 
-    context->overlayCommandBuffer->bindVertexBuffers(vertexBuffer)
-        ->bindIndexBuffer(indexBuffer, indexType)
-        ->drawIndexed(indexCount, 1);
+    flushPendingOverlayDraw();
+    flushOverlayDynamicStates();
+
+    pending = {
+        .pipeline = pipeline,
+        .drawID = drawID,
+        .vertexBuffer = vertexRange.buffer,
+        .vertexOffset = vertexRange.offset,
+        .indexBuffer = indexRange.buffer,
+        .indexOffset = indexRange.offset,
+        .indexType = indexType,
+        .indexCount = indexCount,
+        .sequentialQuads = indexRange.sequentialQuads,
+    };
+}
+
+void UIModuleContext::flushPendingOverlayDraw() {
+    auto &pending = pendingOverlayDraw;
+    if (pending.indexCount == 0) return;
+
+    auto context = frameworkContext.lock();
+    auto commandBuffer = context->overlayCommandBuffer->vkCommandBuffer();
+
+    // consecutive overlay draws mostly share pipeline and buffers, only record what actually changed
+    auto &emitted = overlayEmittedState;
+
+    if (emitted.pipeline != pending.pipeline) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pending.pipeline);
+        emitted.pipeline = pending.pipeline;
+    }
+
+    if (!emitted.drawIDValid || emitted.drawID != pending.drawID) {
+        auto pipelineLayout = overlayDescriptorTable->vkPipelineLayout();
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(int), &pending.drawID);
+        emitted.drawID = pending.drawID;
+        emitted.drawIDValid = true;
+    }
+
+    if (emitted.vertexBuffer != pending.vertexBuffer->vkBuffer() || emitted.vertexOffset != pending.vertexOffset) {
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &pending.vertexBuffer->vkBuffer(), &pending.vertexOffset);
+        emitted.vertexBuffer = pending.vertexBuffer->vkBuffer();
+        emitted.vertexOffset = pending.vertexOffset;
+    }
+
+    if (emitted.indexBuffer != pending.indexBuffer->vkBuffer() || emitted.indexOffset != pending.indexOffset ||
+        emitted.indexType != pending.indexType) {
+        vkCmdBindIndexBuffer(commandBuffer, pending.indexBuffer->vkBuffer(), pending.indexOffset, pending.indexType);
+        emitted.indexBuffer = pending.indexBuffer->vkBuffer();
+        emitted.indexOffset = pending.indexOffset;
+        emitted.indexType = pending.indexType;
+    }
+
+    context->overlayCommandBuffer->drawIndexed(pending.indexCount, 1);
+    pending = {};
 }
 
 void UIModuleContext::postBlur(int times) {
@@ -1257,6 +1402,7 @@ void UIModuleContext::postBlur(int times) {
                            sizeof(int), &i);
 
         context->overlayCommandBuffer->draw(3, 1);
+        invalidateOverlayEmittedState();
 
         context->overlayCommandBuffer->endRenderPass();
 #ifdef USE_AMD
@@ -1365,6 +1511,9 @@ void UIModuleContext::begin(std::shared_ptr<UIModuleContext> lastContext) {
 
     overlayMode = NONE;
 
+    // spans the whole overlay command buffer, closed in end()
+    overlayProfilerScope = framework->profiler()->beginGpuScope(context->overlayCommandBuffer, "ui");
+
     context->overlayCommandBuffer->bindDescriptorTable(overlayDescriptorTable, VK_PIPELINE_BIND_POINT_GRAPHICS);
 
     if (lastContext != nullptr)
@@ -1379,6 +1528,8 @@ void UIModuleContext::end() {
 
     if (!framework->isRunning()) return;
 
+    flushPendingOverlayDraw();
+
     if (overlayMode == DRAW) {
         context->overlayCommandBuffer->endRenderPass();
 #ifdef USE_AMD
@@ -1415,4 +1566,9 @@ void UIModuleContext::end() {
     }
 
     overlayMode = NONE;
+
+    if (overlayProfilerScope != Profiler::INVALID_SCOPE) {
+        framework->profiler()->endGpuScope(context->overlayCommandBuffer, overlayProfilerScope);
+        overlayProfilerScope = Profiler::INVALID_SCOPE;
+    }
 }
@@ -2,6 +2,7 @@
 
 #include "common/shared.hpp"
 #include "common/singleton.hpp"
+#include "core/render/buffers.hpp"
 #include "core/all_extern.hpp"
 #include "core/vulkan/all_core_vulkan.hpp"
 
@@ -45,6 +46,62 @@ enum OverlayMode {
     POST,
 };
 
+// last dynamic state and bindings recorded into the overlay command buffer, valid == false forces a full re-emit
+struct OverlayEmittedState {
+    bool valid = false;
+
+    VkViewport viewport{};
+    VkRect2D scissor{};
+
+    VkBool32 blendEnabled = VK_FALSE;
+    VkColorBlendEquationEXT colorBlendEquation{};
+    VkColorComponentFlags colorWriteMask = 0;
+    bool colorLogicOpEnable = false;
+    VkLogicOp colorLogicOp = VK_LOGIC_OP_COPY;
+    std::array<float, 4> blendConstants{};
+
+    bool depthTestEnable = false;
+    bool depthWriteEnable = false;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_NEVER;
+    bool stencilTestEnable = false;
+    std::array<VkStencilOp, 2> failOp{};
+    std::array<VkStencilOp, 2> passOp{};
+    std::array<VkStencilOp, 2> depthFailOp{};
+    std::array<VkCompareOp, 2> compareOp{};
+    std::array<uint32_t, 2> reference{};
+    std::array<uint32_t, 2> compareMask{};
+    std::array<uint32_t, 2> writeMask{};
+
+    VkCullModeFlags cullMode = 0;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    bool depthBiasEnable = false;
+    std::array<float, 3> depthBias{}; // constant factor, clamp, slope factor
+    float lineWidth = 0.0f;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkDeviceSize vertexOffset = 0;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkDeviceSize indexOffset = 0;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    bool drawIDValid = false;
+    int drawID = 0;
+};
+
+// an overlay draw held back so that following draws over adjacent vertices can be appended to it
+struct PendingOverlayDraw {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    int drawID = 0;
+    std::shared_ptr<vk::DeviceLocalBuffer> vertexBuffer;
+    VkDeviceSize vertexOffset = 0;
+    std::shared_ptr<vk::DeviceLocalBuffer> indexBuffer;
+    VkDeviceSize indexOffset = 0;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    uint32_t indexCount = 0;
+    bool sequentialQuads = false;
+};
+
 class UIModuleContext;
 
 class UIModule : public SharedObject<UIModule> {
@@ -58,6 +115,7 @@ class UIModule : public SharedObject<UIModule> {
     std::vector<std::shared_ptr<vk::DescriptorTable>> &overlayDescriptorTables();
 
     void bindTexture(std::shared_ptr<vk::Sampler> sampler, std::shared_ptr<vk::DeviceLocalImage> image, int index);
+    void flushTextureBindings();
 
   private:
     void initOverlayDescriptorTablesAndFrameSamplers();
@@ -85,6 +143,7 @@ class UIModule : public SharedObject<UIModule> {
     std::map<OverlayDrawPipelineType, GraphicsPipelineShaderInfo> overlayDrawPipelineInfos_;
     std::map<OverlayDrawPipelineType, GraphicsPipelineShaders> overlayDrawPipelineShaders_;
     std::map<OverlayDrawPipelineType, std::shared_ptr<vk::DynamicGraphicsPipeline>> overlayDrawPipelines_;
+    std::map<OverlayDrawPipelineType, uint32_t> overlayDrawVertexStrides_;
 
     std::vector<std::shared_ptr<vk::DeviceLocalImage>> overlayPostColorImages_;
     std::vector<std::shared_ptr<vk::Sampler>> overlayDrawColorImageSamplers_;
@@ -139,6 +198,11 @@ struct UIModuleContext : public SharedObject<UIModuleContext> {
 
     OverlayMode overlayMode;
 
+    bool overlayStateDirty;
+    OverlayEmittedState overlayEmittedState;
+    PendingOverlayDraw pendingOverlayDraw;
+    uint32_t overlayProfilerScope = ~0u;
+
     std::shared_ptr<vk::DescriptorTable> overlayDescriptorTable;
     std::shared_ptr<vk::DeviceLocalImage> overlayDrawColorImage;
     std::shared_ptr<vk::DeviceLocalImage> overlayDrawDepthStencilImage;
@@ -150,6 +214,8 @@ struct UIModuleContext : public SharedObject<UIModuleContext> {
     UIModuleContext(std::shared_ptr<FrameworkContext> context, std::shared_ptr<UIModule> uiModule);
 
     void syncToCommandBuffer();
+    void invalidateOverlayEmittedState();
+    void flushOverlayDynamicStates();
     void syncFromContext(std::shared_ptr<UIModuleContext> other);
 
     void setOverlayScissorEnabled(bool enabled);
@@ -195,11 +261,12 @@ struct UIModuleContext : public SharedObject<UIModuleContext> {
     void clearOverlayEntireColorAttachment();
     void clearOverlayEntireDepthStencilAttachment(int aspectMask);
 
-    void drawIndexed(std::shared_ptr<vk::DeviceLocalBuffer> vertexBuffer,
-                     std::shared_ptr<vk::DeviceLocalBuffer> indexBuffer,
+    void drawIndexed(const OverlayBufferRange &vertexRange,
+                     const OverlayBufferRange &indexRange,
                      OverlayDrawPipelineType pipelineType,
                      uint32_t indexCount,
                      VkIndexType indexType);
+    void flushPendingOverlayDraw();
 
     void postBlur(int times = 1);
 
@@ -174,6 +174,15 @@ void NrdModule::preClose() {
     preparePipeline_.reset();
 }
 
+bool NrdModule::asyncComputeCapable() {
+    // prepare, the NRD dispatches and compose are all compute
+    return true;
+}
+
+void NrdModule::asyncComputeBuffers(uint32_t, std::vector<std::shared_ptr<vk::Buffer>> &buffers) {
+    buffers.push_back(Renderer::instance().buffers()->worldUniformBuffer());
+}
+
 NrdModuleContext::NrdModuleContext(std::shared_ptr<FrameworkContext> frameworkContext,
                                    std::shared_ptr<WorldPipelineContext> worldPipelineContext,
                                    std::shared_ptr<NrdModule> nrdModule)
@@ -32,6 +32,8 @@ class NrdModule : public WorldModule, public SharedObject<NrdModule> {
     void
     bindTexture(std::shared_ptr<vk::Sampler> sampler, std::shared_ptr<vk::DeviceLocalImage> image, int index) override;
     void preClose() override;
+    bool asyncComputeCapable() override;
+    void asyncComputeBuffers(uint32_t frameIndex, std::vector<std::shared_ptr<vk::Buffer>> &buffers) override;
 
     std::shared_ptr<NrdWrapper> wrapper() {
         return m_wrapper;
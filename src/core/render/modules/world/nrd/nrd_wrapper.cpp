@@ -116,6 +116,17 @@ static VkFormat NrdToVkFormat(nrd::Format format) {
     return g_NRDFormatToVkFormat[index];
 }
 
+static VkAccessFlags chooseSrcAccess(VkImageLayout oldLayout) {
+    switch (oldLayout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED: return 0;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return VK_ACCESS_SHADER_READ_BIT;
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return VK_ACCESS_TRANSFER_WRITE_BIT;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return VK_ACCESS_TRANSFER_READ_BIT;
+        case VK_IMAGE_LAYOUT_GENERAL:
+        default: return VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    }
+}
+
 NrdWrapper::NrdWrapper() = default;
 
 NrdWrapper::~NrdWrapper() {
@@ -128,6 +139,8 @@ NrdWrapper::~NrdWrapper() {
             vkDestroyPipelineLayout(device, pipeline.pipelineLayout, nullptr);
         if (pipeline.resourceSetLayout != VK_NULL_HANDLE)
             vkDestroyDescriptorSetLayout(device, pipeline.resourceSetLayout, nullptr);
+        if (pipeline.updateTemplate != VK_NULL_HANDLE)
+            vkDestroyDescriptorUpdateTemplate(device, pipeline.updateTemplate, nullptr);
     }
 
     for (auto sampler : m_samplers) {
@@ -138,7 +151,7 @@ NrdWrapper::~NrdWrapper() {
         vkDestroyDescriptorSetLayout(device, m_samplerConstSetLayout, nullptr);
     if (m_samplerConstDescriptorPool != VK_NULL_HANDLE)
         vkDestroyDescriptorPool(device, m_samplerConstDescriptorPool, nullptr);
-    if (m_resourceDescriptorPool != VK_NULL_HANDLE) vkDestroyDescriptorPool(device, m_resourceDescriptorPool, nullptr);
+    for (auto pool : m_resourceDescriptorPools) vkDestroyDescriptorPool(device, pool, nullptr);
 
     if (m_nrdInstance) nrd::DestroyInstance(*m_nrdInstance);
 }
@@ -261,9 +274,10 @@ bool NrdWrapper::init(std::shared_ptr<vk::Device> device,
         vkQueueWaitIdle(m_device->mainVkQueue());
     }
 
-    m_constantBuffer =
-        vk::DeviceLocalBuffer::create(m_vma, m_device, iDesc->constantBufferMaxDataSize,
-                                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    VkDeviceSize uniformAlignment = m_physicalDevice->properties().limits.minUniformBufferOffsetAlignment;
+    m_constantStride = uint32_t((iDesc->constantBufferMaxDataSize + uniformAlignment - 1) / uniformAlignment *
+                                uniformAlignment);
+    createConstantBuffer(std::max(1u, iDesc->descriptorPoolDesc.setsMaxNum));
 
     if (!createSamplers()) return false;
     createPipelines();
@@ -271,6 +285,34 @@ bool NrdWrapper::init(std::shared_ptr<vk::Device> device,
     return true;
 }
 
+void NrdWrapper::createConstantBuffer(uint32_t slicesPerFrame) {
+    m_constantSlicesPerFrame = slicesPerFrame;
+    m_constantBuffer = vk::HostVisibleBuffer::create(
+        m_vma, m_device, size_t(m_constantStride) * m_constantSlicesPerFrame * std::max(1u, m_contextCount),
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+}
+
+void NrdWrapper::growConstantBuffer(uint32_t slicesPerFrame) {
+    std::cout << "[NrdWrapper] " << slicesPerFrame << " dispatches with constants, the ring held "
+              << m_constantSlicesPerFrame << ", growing it" << std::endl;
+
+    // frames in flight read the old ring through sets that are about to point at the new one
+    vkDeviceWaitIdle(m_device->vkDevice());
+    createConstantBuffer(slicesPerFrame);
+
+    if (m_useSeparateSets) {
+        writeConstantDescriptor();
+    } else if (!m_usePushDescriptors) {
+        // the cached resource sets hold the constant buffer as well, they are written again on their next use
+        VkDevice device = m_device->vkDevice();
+        for (auto pool : m_resourceDescriptorPools) vkDestroyDescriptorPool(device, pool, nullptr);
+        m_resourceDescriptorPools = {createResourceDescriptorPool()};
+        for (auto &frameSets : m_resourceDescriptorSets) {
+            for (auto &sets : frameSets) sets.clear();
+        }
+    }
+}
+
 void NrdWrapper::updateSettings(const nrd::CommonSettings &commonSettings, const nrd::ReblurSettings &reblurSettings) {
     if (!m_nrdInstance) return;
     nrd::SetCommonSettings(*m_nrdInstance, commonSettings);
@@ -282,13 +324,99 @@ void NrdWrapper::denoise(VkCommandBuffer cmd,
                          const std::map<nrd::ResourceType, std::shared_ptr<vk::DeviceLocalImage>> &userTextures) {
     if (!m_nrdInstance) return;
 
-    m_userTexturePool = userTextures;
+    m_userTexturePool.fill(nullptr);
+    for (auto &[type, image] : userTextures) m_userTexturePool[size_t(type)] = image;
+    m_constantCursor = 0;
 
     const nrd::DispatchDesc *dispatchDescs = nullptr;
     uint32_t dispatchDescsNum = 0;
     nrd::GetComputeDispatches(*m_nrdInstance, &m_denoiserIdentifier, 1, dispatchDescs, dispatchDescsNum);
 
+    // every dispatch of the frame needs its own slice, wrapping around would overwrite constants not yet read
+    uint32_t constantDispatches = 0;
+    for (uint32_t i = 0; i < dispatchDescsNum; ++i) {
+        if (dispatchDescs[i].constantBufferDataSize > 0) constantDispatches++;
+    }
+    if (constantDispatches > m_constantSlicesPerFrame) growConstantBuffer(constantDispatches);
+
+    // everything NRD touches goes to GENERAL once per frame and stays there, transient contents do not outlive it
+    std::vector<VkImageMemoryBarrier> barriers;
+    auto toGeneral = [&](const std::shared_ptr<vk::DeviceLocalImage> &img, bool discard) {
+        if (!img) return;
+        VkImageLayout oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : img->imageLayout();
+        if (oldLayout == VK_IMAGE_LAYOUT_GENERAL) return;
+        barriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                            nullptr,
+                            chooseSrcAccess(oldLayout),
+                            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                            oldLayout,
+                            VK_IMAGE_LAYOUT_GENERAL,
+                            VK_QUEUE_FAMILY_IGNORED,
+                            VK_QUEUE_FAMILY_IGNORED,
+                            img->vkImage(),
+                            {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}});
+        img->imageLayout() = VK_IMAGE_LAYOUT_GENERAL;
+    };
+    for (auto &img : m_permanentTextures) toGeneral(img, false);
+    for (auto &img : m_transientTextures) toGeneral(img, true);
+    for (auto &img : m_userTexturePool) toGeneral(img, false);
+
+    VkMemoryBarrier memoryBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_MEMORY_WRITE_BIT,
+                                     VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                                         VK_ACCESS_TRANSFER_WRITE_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier,
+                         0, nullptr, (uint32_t)barriers.size(), barriers.data());
+    m_unsyncedWrites.clear();
+    m_unsyncedReads.clear();
+
     for (uint32_t i = 0; i < dispatchDescsNum; ++i) { dispatch(cmd, dispatchDescs[i], frameIndex); }
+
+    m_constantBuffer->flush();
+}
+
+std::shared_ptr<vk::DeviceLocalImage> NrdWrapper::resolveResource(const nrd::ResourceDesc &resource) {
+    if (resource.type == nrd::ResourceType::PERMANENT_POOL) return m_permanentTextures[resource.indexInPool];
+    if (resource.type == nrd::ResourceType::TRANSIENT_POOL) return m_transientTextures[resource.indexInPool];
+    return m_userTexturePool[size_t(resource.type)];
+}
+
+VkDescriptorPool NrdWrapper::createResourceDescriptorPool() {
+    const nrd::InstanceDesc *iDesc = nrd::GetInstanceDesc(*m_nrdInstance);
+
+    // room for every pipeline of every frame with its resources ping-ponged between two permutations
+    uint32_t setCount = iDesc->pipelinesNum * std::max(1u, m_contextCount) * 2;
+    std::vector<VkDescriptorPoolSize> poolSizes = {
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, setCount * iDesc->descriptorPoolDesc.perSetTexturesMaxNum},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount * iDesc->descriptorPoolDesc.perSetStorageTexturesMaxNum}};
+    if (!m_useSeparateSets) {
+        poolSizes.push_back({VK_DESCRIPTOR_TYPE_SAMPLER, setCount * iDesc->samplersNum});
+        poolSizes.push_back({VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, setCount});
+    }
+    VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+                                           nullptr,
+                                           0,
+                                           setCount,
+                                           (uint32_t)poolSizes.size(),
+                                           poolSizes.data()};
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateDescriptorPool(m_device->vkDevice(), &poolInfo, nullptr, &pool));
+    return pool;
+}
+
+VkDescriptorSet NrdWrapper::allocateResourceDescriptorSet(const NRDPipeline &nrdPipeline) {
+    VkDescriptorSetAllocateInfo allocInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr, VK_NULL_HANDLE, 1,
+                                             &nrdPipeline.resourceSetLayout};
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    if (!m_resourceDescriptorPools.empty()) {
+        allocInfo.descriptorPool = m_resourceDescriptorPools.back();
+        if (vkAllocateDescriptorSets(m_device->vkDevice(), &allocInfo, &set) == VK_SUCCESS) return set;
+    }
+
+    m_resourceDescriptorPools.push_back(createResourceDescriptorPool());
+    allocInfo.descriptorPool = m_resourceDescriptorPools.back();
+    VK_CHECK(vkAllocateDescriptorSets(m_device->vkDevice(), &allocInfo, &set));
+    return set;
 }
 
 std::shared_ptr<vk::DeviceLocalImage>
@@ -324,7 +452,7 @@ bool NrdWrapper::createSamplers() {
                                    VK_DESCRIPTOR_TYPE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, &m_samplers[i]});
     }
     samplerBindings.push_back({lDesc->spirvBindingOffsets.constantBufferOffset + iDesc->constantBufferRegisterIndex,
-                               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr});
+                               VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr});
 
     VkDescriptorSetLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
     layoutInfo.bindingCount = (uint32_t)samplerBindings.size();
@@ -332,7 +460,7 @@ bool NrdWrapper::createSamplers() {
     VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_samplerConstSetLayout));
 
     VkDescriptorPoolSize poolSizes[] = {{VK_DESCRIPTOR_TYPE_SAMPLER, iDesc->samplersNum},
-                                        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1}};
+                                        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1}};
     VkDescriptorPoolCreateInfo poolInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0, 1, 2, poolSizes};
     VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_samplerConstDescriptorPool));
 
@@ -340,7 +468,16 @@ bool NrdWrapper::createSamplers() {
                                              m_samplerConstDescriptorPool, 1, &m_samplerConstSetLayout};
     VK_CHECK(vkAllocateDescriptorSets(device, &allocInfo, &m_samplerConstDescriptorSet));
 
-    VkDescriptorBufferInfo bufferInfo = {m_constantBuffer->vkBuffer(), 0, VK_WHOLE_SIZE};
+    writeConstantDescriptor();
+
+    return true;
+}
+
+void NrdWrapper::writeConstantDescriptor() {
+    const nrd::InstanceDesc *iDesc = nrd::GetInstanceDesc(*m_nrdInstance);
+    const nrd::LibraryDesc *lDesc = nrd::GetLibraryDesc();
+
+    VkDescriptorBufferInfo bufferInfo = {m_constantBuffer->vkBuffer(), 0, m_constantStride};
     VkWriteDescriptorSet cbWrite = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
                                     nullptr,
                                     m_samplerConstDescriptorSet,
@@ -348,13 +485,11 @@ bool NrdWrapper::createSamplers() {
                                         iDesc->constantBufferRegisterIndex,
                                     0,
                                     1,
-                                    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                                    VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                                     nullptr,
                                     &bufferInfo,
                                     nullptr};
-    vkUpdateDescriptorSets(device, 1, &cbWrite, 0, nullptr);
-
-    return true;
+    vkUpdateDescriptorSets(m_device->vkDevice(), 1, &cbWrite, 0, nullptr);
 }
 
 void NrdWrapper::createPipelines() {
@@ -365,15 +500,13 @@ void NrdWrapper::createPipelines() {
     m_pipelines.resize(iDesc->pipelinesNum);
 
     if (!m_usePushDescriptors) {
-        uint32_t setCount = iDesc->pipelinesNum * std::max(1u, m_contextCount);
-        VkDescriptorPoolSize poolSizes[] = {
-            {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, setCount * iDesc->descriptorPoolDesc.perSetTexturesMaxNum},
-            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount * iDesc->descriptorPoolDesc.perSetStorageTexturesMaxNum}};
-        VkDescriptorPoolCreateInfo poolInfo = {
-            VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr, 0, setCount, 2, poolSizes};
-        VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_resourceDescriptorPool));
+        m_resourceDescriptorPools.push_back(createResourceDescriptorPool());
         m_resourceDescriptorSets.resize(iDesc->pipelinesNum);
+        for (auto &frameSets : m_resourceDescriptorSets) frameSets.resize(std::max(1u, m_contextCount));
     }
+    // constants move with every dispatch: a dynamic offset into bound sets, the offset itself when pushed
+    VkDescriptorType constantBufferType =
+        m_usePushDescriptors ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 
     for (uint32_t i = 0; i < iDesc->pipelinesNum; ++i) {
         const nrd::PipelineDesc &pDesc = iDesc->pipelines[i];
@@ -396,7 +529,7 @@ void NrdWrapper::createPipelines() {
                                        VK_DESCRIPTOR_TYPE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, &m_samplers[s]});
             }
             allBindings.push_back({lDesc->spirvBindingOffsets.constantBufferOffset + iDesc->constantBufferRegisterIndex,
-                                   VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr});
+                                   constantBufferType, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr});
         }
 
         VkDescriptorSetLayoutCreateInfo layoutInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
@@ -425,15 +558,37 @@ void NrdWrapper::createPipelines() {
                                              nullptr};
         VK_CHECK(vkCreatePipelineLayout(device, &plInfo, nullptr, &nrdPipeline.pipelineLayout));
 
-        if (!m_usePushDescriptors) {
-            m_resourceDescriptorSets[i].resize(std::max(1u, m_contextCount));
-            std::vector<VkDescriptorSetLayout> layouts(m_resourceDescriptorSets[i].size(),
-                                                       nrdPipeline.resourceSetLayout);
-            VkDescriptorSetAllocateInfo resAllocInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
-                                                        m_resourceDescriptorPool, (uint32_t)layouts.size(),
-                                                        layouts.data()};
-            VK_CHECK(vkAllocateDescriptorSets(device, &resAllocInfo, m_resourceDescriptorSets[i].data()));
+        // the descriptors of a dispatch come in NRD's resource order, the template maps each to its binding
+        std::vector<VkDescriptorUpdateTemplateEntry> templateEntries;
+        for (uint32_t r = 0; r < pDesc.resourceRangesNum; ++r) {
+            const nrd::ResourceRangeDesc &range = pDesc.resourceRanges[r];
+            bool storage = range.descriptorType != nrd::DescriptorType::TEXTURE;
+            for (uint32_t b = 0; b < range.descriptorsNum; ++b) {
+                uint32_t binding = (storage ? lDesc->spirvBindingOffsets.storageTextureAndBufferOffset :
+                                              lDesc->spirvBindingOffsets.textureOffset) +
+                                   iDesc->resourcesBaseRegisterIndex + b;
+                VkDescriptorType type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+                templateEntries.push_back({binding, 0, 1, type, templateEntries.size() * sizeof(DescriptorInfo),
+                                           sizeof(DescriptorInfo)});
+                nrdPipeline.resourceWritten.push_back(storage);
+            }
         }
+        if (!m_useSeparateSets) {
+            templateEntries.push_back(
+                {lDesc->spirvBindingOffsets.constantBufferOffset + iDesc->constantBufferRegisterIndex, 0, 1,
+                 constantBufferType, templateEntries.size() * sizeof(DescriptorInfo), sizeof(DescriptorInfo)});
+        }
+
+        VkDescriptorUpdateTemplateCreateInfo templateInfo = {VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO};
+        templateInfo.descriptorUpdateEntryCount = (uint32_t)templateEntries.size();
+        templateInfo.pDescriptorUpdateEntries = templateEntries.data();
+        templateInfo.templateType = m_usePushDescriptors ? VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR :
+                                                           VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = nrdPipeline.resourceSetLayout;
+        templateInfo.pipelineBindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+        templateInfo.pipelineLayout = nrdPipeline.pipelineLayout;
+        templateInfo.set = m_useSeparateSets ? m_resourcesSpaceIndex : 0;
+        VK_CHECK(vkCreateDescriptorUpdateTemplate(device, &templateInfo, nullptr, &nrdPipeline.updateTemplate));
 
         VkShaderModuleCreateInfo smInfo = {VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, nullptr, 0,
                                            pDesc.computeShaderSPIRV.size,
@@ -458,215 +613,106 @@ void NrdWrapper::createPipelines() {
 
 void NrdWrapper::dispatch(VkCommandBuffer cmd, const nrd::DispatchDesc &dispatchDesc, uint32_t frameIndex) {
     const nrd::InstanceDesc *iDesc = nrd::GetInstanceDesc(*m_nrdInstance);
-    const nrd::LibraryDesc *lDesc = nrd::GetLibraryDesc();
     const nrd::PipelineDesc &pDesc = iDesc->pipelines[dispatchDesc.pipelineIndex];
     NRDPipeline &nrdPipeline = m_pipelines[dispatchDesc.pipelineIndex];
 
-    if (dispatchDesc.name && std::strstr(dispatchDesc.name, "Clear") != nullptr) {
-        std::vector<VkImageMemoryBarrier> barriers;
-        VkClearColorValue clearValue{};
-
-        auto addBarrier = [&](const std::shared_ptr<vk::DeviceLocalImage> &img) {
-            if (!img) return;
-            VkAccessFlags srcAccess = 0;
-            VkImageLayout oldLayout = img->imageLayout();
-            if (oldLayout == VK_IMAGE_LAYOUT_GENERAL) {
-                srcAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-            } else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-                srcAccess = VK_ACCESS_SHADER_READ_BIT;
-            }
-            barriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                                nullptr,
-                                srcAccess,
-                                VK_ACCESS_TRANSFER_WRITE_BIT,
-                                oldLayout,
-                                VK_IMAGE_LAYOUT_GENERAL,
-                                VK_QUEUE_FAMILY_IGNORED,
-                                VK_QUEUE_FAMILY_IGNORED,
-                                img->vkImage(),
-                                {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}});
-        };
-
-        uint32_t resIdx = 0;
-        for (uint32_t r = 0; r < pDesc.resourceRangesNum; ++r) {
-            const nrd::ResourceRangeDesc &range = pDesc.resourceRanges[r];
-            for (uint32_t b = 0; b < range.descriptorsNum; ++b) {
-                const nrd::ResourceDesc &res = dispatchDesc.resources[resIdx++];
-                std::shared_ptr<vk::DeviceLocalImage> image =
-                    (res.type == nrd::ResourceType::PERMANENT_POOL) ? m_permanentTextures[res.indexInPool] :
-                    (res.type == nrd::ResourceType::TRANSIENT_POOL) ? m_transientTextures[res.indexInPool] :
-                                                                      m_userTexturePool[res.type];
-                addBarrier(image);
-            }
-        }
-
-        if (!barriers.empty()) {
-            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
-                                 nullptr, 0, nullptr, (uint32_t)barriers.size(), barriers.data());
-        }
-
-        resIdx = 0;
-        for (uint32_t r = 0; r < pDesc.resourceRangesNum; ++r) {
-            const nrd::ResourceRangeDesc &range = pDesc.resourceRanges[r];
-            for (uint32_t b = 0; b < range.descriptorsNum; ++b) {
-                const nrd::ResourceDesc &res = dispatchDesc.resources[resIdx++];
-                std::shared_ptr<vk::DeviceLocalImage> image =
-                    (res.type == nrd::ResourceType::PERMANENT_POOL) ? m_permanentTextures[res.indexInPool] :
-                    (res.type == nrd::ResourceType::TRANSIENT_POOL) ? m_transientTextures[res.indexInPool] :
-                                                                      m_userTexturePool[res.type];
-                if (!image) continue;
-                VkImageSubresourceRange rangeVk{};
-                rangeVk.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                rangeVk.baseMipLevel = 0;
-                rangeVk.levelCount = 1;
-                rangeVk.baseArrayLayer = 0;
-                rangeVk.layerCount = 1;
-                vkCmdClearColorImage(cmd, image->vkImage(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &rangeVk);
-                image->imageLayout() = VK_IMAGE_LAYOUT_GENERAL;
-            }
-        }
-        return;
+    if (nrdPipeline.clear < 0) {
+        nrdPipeline.clear = (dispatchDesc.name && std::strstr(dispatchDesc.name, "Clear") != nullptr) ? 1 : 0;
     }
 
-    if (dispatchDesc.constantBufferDataSize > 0) {
-        m_constantBuffer->uploadToStagingBuffer((void *)dispatchDesc.constantBufferData,
-                                                dispatchDesc.constantBufferDataSize, 0);
-        m_constantBuffer->uploadToBuffer(cmd, dispatchDesc.constantBufferDataSize, 0, 0);
-        VkBufferMemoryBarrier barrier = {VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-                                         nullptr,
-                                         VK_ACCESS_TRANSFER_WRITE_BIT,
-                                         VK_ACCESS_UNIFORM_READ_BIT,
-                                         VK_QUEUE_FAMILY_IGNORED,
-                                         VK_QUEUE_FAMILY_IGNORED,
-                                         m_constantBuffer->vkBuffer(),
-                                         0,
-                                         dispatchDesc.constantBufferDataSize};
-        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
-                             1, &barrier, 0, nullptr);
+    // only wait for earlier dispatches if this one reads what they wrote or writes what they touched
+    uint32_t resourceCount = (uint32_t)nrdPipeline.resourceWritten.size();
+    bool hazard = false;
+    for (uint32_t i = 0; i < resourceCount; ++i) {
+        auto image = resolveResource(dispatchDesc.resources[i]);
+        if (!image) continue;
+        bool written = nrdPipeline.clear || nrdPipeline.resourceWritten[i];
+        hazard = hazard || m_unsyncedWrites.count(image->vkImage()) > 0 ||
+                 (written && m_unsyncedReads.count(image->vkImage()) > 0);
     }
-
-    std::vector<VkImageMemoryBarrier> barriers;
-    auto chooseSrcAccess = [&](VkImageLayout oldLayout) -> VkAccessFlags {
-        switch (oldLayout) {
-            case VK_IMAGE_LAYOUT_UNDEFINED: return 0;
-            case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return VK_ACCESS_SHADER_READ_BIT;
-            case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return VK_ACCESS_TRANSFER_WRITE_BIT;
-            case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return VK_ACCESS_TRANSFER_READ_BIT;
-            case VK_IMAGE_LAYOUT_GENERAL:
-            default: return VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-        }
-    };
-    auto pushBarrier = [&](const std::shared_ptr<vk::DeviceLocalImage> &img, VkImageLayout oldLayout) {
-        if (!img) return;
-        VkAccessFlags srcAccess = chooseSrcAccess(oldLayout);
-        barriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                            nullptr,
-                            srcAccess,
-                            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
-                            oldLayout,
-                            VK_IMAGE_LAYOUT_GENERAL,
-                            VK_QUEUE_FAMILY_IGNORED,
-                            VK_QUEUE_FAMILY_IGNORED,
-                            img->vkImage(),
-                            {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}});
-    };
-    auto addPoolBarriers = [&](const std::vector<std::shared_ptr<vk::DeviceLocalImage>> &pool, bool discard = false) {
-        for (auto &img : pool) {
-            if (!img) continue;
-            VkImageLayout oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : img->imageLayout();
-            pushBarrier(img, oldLayout);
-        }
-    };
-    addPoolBarriers(m_permanentTextures, false);
-    addPoolBarriers(m_transientTextures, true);
-    for (auto &pair : m_userTexturePool) {
-        if (!pair.second) continue;
-        VkImageLayout oldLayout = pair.second->imageLayout();
-        pushBarrier(pair.second, oldLayout);
+    if (hazard) {
+        VkMemoryBarrier barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+                                   VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                                   VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+                                       VK_ACCESS_TRANSFER_WRITE_BIT};
+        VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        vkCmdPipelineBarrier(cmd, stages, stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        m_unsyncedWrites.clear();
+        m_unsyncedReads.clear();
+    }
+    for (uint32_t i = 0; i < resourceCount; ++i) {
+        auto image = resolveResource(dispatchDesc.resources[i]);
+        if (!image) continue;
+        bool written = nrdPipeline.clear || nrdPipeline.resourceWritten[i];
+        (written ? m_unsyncedWrites : m_unsyncedReads).insert(image->vkImage());
     }
 
-    if (!barriers.empty()) {
-        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
-                             nullptr, 0, nullptr, (uint32_t)barriers.size(), barriers.data());
+    if (nrdPipeline.clear) {
+        VkClearColorValue clearValue{};
+        VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        for (uint32_t i = 0; i < resourceCount; ++i) {
+            auto image = resolveResource(dispatchDesc.resources[i]);
+            if (!image) continue;
+            vkCmdClearColorImage(cmd, image->vkImage(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &range);
+        }
+        return;
     }
 
-    for (auto &img : m_permanentTextures)
-        if (img) img->imageLayout() = VK_IMAGE_LAYOUT_GENERAL;
-    for (auto &img : m_transientTextures)
-        if (img) img->imageLayout() = VK_IMAGE_LAYOUT_GENERAL;
-    for (auto &pair : m_userTexturePool) {
-        if (pair.second) pair.second->imageLayout() = VK_IMAGE_LAYOUT_GENERAL;
+    uint32_t constantOffset = 0;
+    if (dispatchDesc.constantBufferDataSize > 0) {
+        // denoise() sized the ring for every dispatch of the frame
+        constantOffset = (frameIndex * m_constantSlicesPerFrame + m_constantCursor++) * m_constantStride;
+        std::memcpy(static_cast<uint8_t *>(m_constantBuffer->mappedPtr()) + constantOffset,
+                    dispatchDesc.constantBufferData, dispatchDesc.constantBufferDataSize);
     }
 
     vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, nrdPipeline.pipeline);
 
-    std::vector<VkWriteDescriptorSet> writes;
-    std::vector<VkDescriptorImageInfo> imgInfos;
-    std::vector<VkDescriptorBufferInfo> bufInfos;
-
-    imgInfos.reserve(nrdPipeline.numBindings);
-    writes.reserve(nrdPipeline.numBindings + 1);
-
     if (m_useSeparateSets) {
         vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, nrdPipeline.pipelineLayout, m_samplersSpaceIndex,
-                                1, &m_samplerConstDescriptorSet, 0, nullptr);
-    } else if (dispatchDesc.constantBufferDataSize > 0) {
-        bufInfos.push_back({m_constantBuffer->vkBuffer(), 0, dispatchDesc.constantBufferDataSize});
-        writes.push_back({VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, VK_NULL_HANDLE,
-                          lDesc->spirvBindingOffsets.constantBufferOffset + iDesc->constantBufferRegisterIndex, 0, 1,
-                          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, nullptr, &bufInfos.back(), nullptr});
+                                1, &m_samplerConstDescriptorSet, 1, &constantOffset);
     }
 
-    uint32_t resIdx = 0;
-    for (uint32_t r = 0; r < pDesc.resourceRangesNum; ++r) {
-        const nrd::ResourceRangeDesc &range = pDesc.resourceRanges[r];
-        for (uint32_t b = 0; b < range.descriptorsNum; ++b) {
-            const nrd::ResourceDesc &res = dispatchDesc.resources[resIdx++];
-            std::shared_ptr<vk::DeviceLocalImage> image =
-                (res.type == nrd::ResourceType::PERMANENT_POOL) ? m_permanentTextures[res.indexInPool] :
-                (res.type == nrd::ResourceType::TRANSIENT_POOL) ? m_transientTextures[res.indexInPool] :
-                                                                  m_userTexturePool[res.type];
-            if (!image) continue;
-            imgInfos.push_back({VK_NULL_HANDLE, image->vkImageView(0), VK_IMAGE_LAYOUT_GENERAL});
-            writes.push_back({VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, VK_NULL_HANDLE,
-                              ((range.descriptorType == nrd::DescriptorType::TEXTURE) ?
-                                   lDesc->spirvBindingOffsets.textureOffset :
-                                   lDesc->spirvBindingOffsets.storageTextureAndBufferOffset) +
-                                  iDesc->resourcesBaseRegisterIndex + b,
-                              0, 1,
-                              (range.descriptorType == nrd::DescriptorType::TEXTURE) ?
-                                  VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE :
-                                  VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-                              &imgInfos.back(), nullptr, nullptr});
-        }
+    m_descriptorInfos.resize(resourceCount + (m_useSeparateSets ? 0 : 1));
+    m_descriptorViews.resize(resourceCount);
+    for (uint32_t i = 0; i < resourceCount; ++i) {
+        auto image = resolveResource(dispatchDesc.resources[i]);
+        m_descriptorViews[i] = image ? image->vkImageView(0) : VK_NULL_HANDLE;
+        m_descriptorInfos[i].image = {VK_NULL_HANDLE, m_descriptorViews[i], VK_IMAGE_LAYOUT_GENERAL};
+    }
+    if (!m_useSeparateSets) {
+        m_descriptorInfos[resourceCount].buffer = {m_constantBuffer->vkBuffer(),
+                                                   m_usePushDescriptors ? constantOffset : 0, m_constantStride};
     }
 
+    uint32_t setIndex = m_useSeparateSets ? m_resourcesSpaceIndex : 0;
     if (m_usePushDescriptors) {
-        // vkCmdPushDescriptorSetKHR is loaded by volk
-        // std::cout << "[NrdWrapper] Dispatching pipeline " << dispatchDesc.pipelineIndex << " with Push Descriptors"
-        // << std::endl;
-        uint32_t setIndex = m_useSeparateSets ? m_resourcesSpaceIndex : 0;
-        vkCmdPushDescriptorSetKHR(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
-                                  m_pipelines[dispatchDesc.pipelineIndex].pipelineLayout, setIndex,
-                                  (uint32_t)writes.size(), writes.data());
+        // vkCmdPushDescriptorSetWithTemplateKHR is loaded by volk
+        vkCmdPushDescriptorSetWithTemplateKHR(cmd, nrdPipeline.updateTemplate, nrdPipeline.pipelineLayout, setIndex,
+                                              m_descriptorInfos.data());
     } else {
-        // std::cout << "[NrdWrapper] Dispatching pipeline " << dispatchDesc.pipelineIndex << " with Descriptor Sets" <<
-        // std::endl;
         if (dispatchDesc.pipelineIndex >= m_resourceDescriptorSets.size() ||
             frameIndex >= m_resourceDescriptorSets[dispatchDesc.pipelineIndex].size()) {
             std::cerr << "[NrdWrapper] Error: Invalid pipeline/frame index for descriptor sets" << std::endl;
             return;
         }
-        VkDescriptorSet resSet = m_resourceDescriptorSets[dispatchDesc.pipelineIndex][frameIndex];
-        if (resSet == VK_NULL_HANDLE) {
-            std::cerr << "[NrdWrapper] Error: Descriptor set is NULL for pipeline " << dispatchDesc.pipelineIndex
-                      << " frame " << frameIndex << std::endl;
-            return;
+
+        // a set is written once for its views and reused by every later frame with the same ones
+        auto &sets = m_resourceDescriptorSets[dispatchDesc.pipelineIndex][frameIndex];
+        auto it = sets.find(m_descriptorViews);
+        if (it == sets.end()) {
+            VkDescriptorSet resSet = allocateResourceDescriptorSet(nrdPipeline);
+            if (resSet == VK_NULL_HANDLE) {
+                std::cerr << "[NrdWrapper] Error: Descriptor set is NULL for pipeline " << dispatchDesc.pipelineIndex
+                          << " frame " << frameIndex << std::endl;
+                return;
+            }
+            vkUpdateDescriptorSetWithTemplate(m_device->vkDevice(), resSet, nrdPipeline.updateTemplate,
+                                              m_descriptorInfos.data());
+            it = sets.emplace(m_descriptorViews, resSet).first;
         }
-        for (auto &w : writes) w.dstSet = resSet;
-        vkUpdateDescriptorSets(m_device->vkDevice(), (uint32_t)writes.size(), writes.data(), 0, nullptr);
-        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, nrdPipeline.pipelineLayout, m_resourcesSpaceIndex,
-                                1, &resSet, 0, nullptr);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, nrdPipeline.pipelineLayout, setIndex, 1,
+                                &it->second, m_useSeparateSets ? 0 : 1, &constantOffset);
     }
 
     vkCmdDispatch(cmd, dispatchDesc.gridWidth, dispatchDesc.gridHeight, 1);
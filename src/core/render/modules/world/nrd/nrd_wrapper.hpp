@@ -41,9 +41,11 @@
 #pragma once
 
 #include <NRD.h>
+#include <array>
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
 #include <volk.h>
 
@@ -70,18 +72,36 @@ class NrdWrapper {
                  const std::map<nrd::ResourceType, std::shared_ptr<vk::DeviceLocalImage>> &userTextures);
 
   private:
+    // one descriptor of a dispatch as a descriptor update template reads it
+    union DescriptorInfo {
+        VkDescriptorImageInfo image;
+        VkDescriptorBufferInfo buffer;
+    };
+
     struct NRDPipeline {
         VkPipeline pipeline = VK_NULL_HANDLE;
         VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
         VkDescriptorSetLayout resourceSetLayout = VK_NULL_HANDLE;
+        VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
         uint32_t numBindings = 0;
+        // per resource of a dispatch in NRD order, whether the pipeline writes it
+        std::vector<bool> resourceWritten;
+        int clear = -1; // dispatches of this pipeline clear their resources, known from the first one
     };
 
     void createPipelines();
     bool createSamplers();
+    // the sampler and constant set of separate sets, written again whenever the constant ring is replaced
+    void writeConstantDescriptor();
+    void createConstantBuffer(uint32_t slicesPerFrame);
+    // replaces the ring with one holding slicesPerFrame slices per frame, waits for the device to go idle first
+    void growConstantBuffer(uint32_t slicesPerFrame);
     std::shared_ptr<vk::DeviceLocalImage>
     createInternalTexture(const nrd::TextureDesc &tDesc, uint32_t width, uint32_t height);
     void dispatch(VkCommandBuffer cmd, const nrd::DispatchDesc &dispatchDesc, uint32_t frameIndex);
+    std::shared_ptr<vk::DeviceLocalImage> resolveResource(const nrd::ResourceDesc &resource);
+    VkDescriptorPool createResourceDescriptorPool();
+    VkDescriptorSet allocateResourceDescriptorSet(const NRDPipeline &nrdPipeline);
 
     nrd::Instance *m_nrdInstance = nullptr;
     nrd::Identifier m_denoiserIdentifier = (nrd::Identifier)nrd::Denoiser::REBLUR_DIFFUSE_SPECULAR;
@@ -96,13 +116,23 @@ class NrdWrapper {
 
     std::vector<std::shared_ptr<vk::DeviceLocalImage>> m_permanentTextures;
     std::vector<std::shared_ptr<vk::DeviceLocalImage>> m_transientTextures;
-    std::shared_ptr<vk::DeviceLocalBuffer> m_constantBuffer;
+    // a slice per dispatch of every frame, so constants of separate dispatches never alias. Grows when a frame has
+    // more dispatches than NRD announced
+    std::shared_ptr<vk::HostVisibleBuffer> m_constantBuffer;
+    uint32_t m_constantStride = 0;
+    uint32_t m_constantSlicesPerFrame = 0;
+    uint32_t m_constantCursor = 0;
 
     std::vector<VkSampler> m_samplers;
 
     std::vector<NRDPipeline> m_pipelines;
 
-    std::map<nrd::ResourceType, std::shared_ptr<vk::DeviceLocalImage>> m_userTexturePool;
+    std::array<std::shared_ptr<vk::DeviceLocalImage>, size_t(nrd::ResourceType::MAX_NUM)> m_userTexturePool;
+    std::vector<DescriptorInfo> m_descriptorInfos;
+    std::vector<VkImageView> m_descriptorViews;
+    // images written or read by dispatches since the last barrier
+    std::unordered_set<VkImage> m_unsyncedWrites;
+    std::unordered_set<VkImage> m_unsyncedReads;
 
     uint32_t m_resourcesSpaceIndex = 0;
     uint32_t m_samplersSpaceIndex = 1;
@@ -114,6 +144,7 @@ class NrdWrapper {
     VkDescriptorPool m_samplerConstDescriptorPool = VK_NULL_HANDLE;
     VkDescriptorSet m_samplerConstDescriptorSet = VK_NULL_HANDLE;
 
-    VkDescriptorPool m_resourceDescriptorPool = VK_NULL_HANDLE;
-    std::vector<std::vector<VkDescriptorSet>> m_resourceDescriptorSets;
+    std::vector<VkDescriptorPool> m_resourceDescriptorPools;
+    // per pipeline and frame, a set for every permutation of image views seen so far
+    std::vector<std::vector<std::map<std::vector<VkImageView>, VkDescriptorSet>>> m_resourceDescriptorSets;
 };
@@ -128,8 +128,14 @@ void PostRenderModule::bindTexture(std::shared_ptr<vk::Sampler> sampler,
     uint32_t size = framework->swapchain()->imageCount();
     for (int i = 0; i < size; i++) {
         if (descriptorTables_[i] != nullptr)
-            descriptorTables_[i]->bindSamplerImage(sampler, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 0,
-                                                   index);
+            descriptorTables_[i]->queueSamplerImage(sampler, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, 0,
+                                                    index);
+    }
+}
+
+void PostRenderModule::flushTextureBindings() {
+    for (auto &table : descriptorTables_) {
+        if (table != nullptr) table->flushQueuedWrites();
     }
 }
 
@@ -781,112 +787,44 @@ void PostRenderModuleContext::render() {
 
     auto buffers = Renderer::instance().buffers();
 
-    auto chooseSrc = [](VkImageLayout oldLayout,
-                        VkPipelineStageFlags2 fallbackStage,
-                        VkAccessFlags2 fallbackAccess,
-                        VkPipelineStageFlags2 &outStage,
-                        VkAccessFlags2 &outAccess) {
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
-            outStage = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
-            outAccess = 0;
-        } else {
-            outStage = fallbackStage;
-            outAccess = fallbackAccess;
-        }
-    };
-
-    // Force init for postRenderedImage on first use (layout tracking can be stale)
-    if (module && module->postRenderedInitialized_.size() > context->frameIndex &&
-        module->postRenderedInitialized_[context->frameIndex] == 0) {
-        VkImageLayout targetLayout =
 #ifdef USE_AMD
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkImageLayout postRenderedLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 #else
-            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    VkImageLayout postRenderedLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 #endif
-        VkPipelineStageFlags2 dstStage =
-#ifdef USE_AMD
-            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-#else
-            VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT;
-#endif
-        VkAccessFlags2 dstAccess =
-#ifdef USE_AMD
-            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
-#else
-            VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
-#endif
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{.srcStageMask = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-                  .srcAccessMask = 0,
-                  .dstStageMask = dstStage,
-                  .dstAccessMask = dstAccess,
-                  .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                  .newLayout = targetLayout,
-                  .srcQueueFamilyIndex = mainQueueIndex,
-                  .dstQueueFamilyIndex = mainQueueIndex,
-                  .image = postRenderedImage,
-                  .subresourceRange = vk::wholeColorSubresourceRange}});
-        postRenderedImage->imageLayout() = targetLayout;
+
+    // the tracked layout of a new output image can be stale, its first use starts over from undefined
+    if (module && module->postRenderedInitialized_.size() > context->frameIndex &&
+        module->postRenderedInitialized_[context->frameIndex] == 0) {
+        postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_UNDEFINED;
         module->postRenderedInitialized_[context->frameIndex] = 1;
     }
 
-    auto ensureLayout = [&](const std::shared_ptr<vk::DeviceLocalImage> &img,
-                            VkImageLayout targetLayout,
-                            VkPipelineStageFlags2 dstStage,
-                            VkAccessFlags2 dstAccess) {
-        if (!img || img->imageLayout() == targetLayout) return;
-        VkPipelineStageFlags2 srcStage = 0;
-        VkAccessFlags2 srcAccess = 0;
-        chooseSrc(img->imageLayout(), VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT, srcStage, srcAccess);
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{.srcStageMask = srcStage,
-                  .srcAccessMask = srcAccess,
-                  .dstStageMask = dstStage,
-                  .dstAccessMask = dstAccess,
-                  .oldLayout = img->imageLayout(),
-                  .newLayout = targetLayout,
-                  .srcQueueFamilyIndex = mainQueueIndex,
-                  .dstQueueFamilyIndex = mainQueueIndex,
-                  .image = img,
-                  .subresourceRange = vk::wholeColorSubresourceRange}});
-        img->imageLayout() = targetLayout;
-    };
-
-    // Preflight: make sure first-use layouts are valid
-    ensureLayout(postRenderedImage,
-#ifdef USE_AMD
-                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-#else
-                 VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-#endif
-                 VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                 VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
-    ensureLayout(worldLightMapImage, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-                 VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                 VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
-    ensureLayout(firstHitDepthImage, VK_IMAGE_LAYOUT_GENERAL,
-                 VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                 VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT);
-    if (worldPostDepthImage && worldPostDepthImage->imageLayout() != VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        VkPipelineStageFlags2 srcStage = 0;
-        VkAccessFlags2 srcAccess = 0;
-        chooseSrc(worldPostDepthImage->imageLayout(), VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT, srcStage, srcAccess);
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{.srcStageMask = srcStage,
-                  .srcAccessMask = srcAccess,
-                  .dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT,
-                  .dstAccessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-                  .oldLayout = worldPostDepthImage->imageLayout(),
-                  .newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                  .srcQueueFamilyIndex = mainQueueIndex,
-                  .dstQueueFamilyIndex = mainQueueIndex,
-                  .image = worldPostDepthImage,
-                  .subresourceRange = vk::wholeDepthSubresourceRange}});
-        worldPostDepthImage->imageLayout() = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-    }
+    vk::BarrierTracker barriers(worldCommandBuffer, mainQueueIndex);
+    // ldr and the first hit depth come from the modules before, the output went to the modules after last frame. The
+    // light map and the depth image are only drawn here, the light map is sampled by the ray tracing before
+    barriers
+        .external(ldrImage,
+                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                  VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+                      VK_ACCESS_2_TRANSFER_WRITE_BIT)
+        .external(firstHitDepthImage,
+                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                  VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT)
+        .external(postRenderedImage,
+                  VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+                      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                  VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+                      VK_ACCESS_2_TRANSFER_WRITE_BIT)
+        .external(worldLightMapImage,
+                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                      VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                  VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT)
+        .external(worldPostDepthImage,
+                  VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                  VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
 
     descriptorTable->bindBuffer(buffers->worldUniformBuffer(), 1, 0);
     descriptorTable->bindBuffer(buffers->skyUniformBuffer(), 1, 1);
@@ -894,28 +832,13 @@ void PostRenderModuleContext::render() {
     descriptorTable->bindBuffer(Renderer::instance().buffers()->textureMappingBuffer(), 2, 0);
 
     // render light map
-    {
-        VkPipelineStageFlags2 srcStage = 0;
-        VkAccessFlags2 srcAccess = 0;
-        chooseSrc(worldLightMapImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStage, srcAccess);
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{
-                    .srcStageMask = srcStage,
-                    .srcAccessMask = srcAccess,
-                    .dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                    .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                    .oldLayout = worldLightMapImage->imageLayout(),
-                    .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-                    .srcQueueFamilyIndex = mainQueueIndex,
-                    .dstQueueFamilyIndex = mainQueueIndex,
-                    .image = worldLightMapImage,
-                    .subresourceRange = vk::wholeColorSubresourceRange,
-                }});
-    }
-    worldLightMapImage->imageLayout() = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    barriers
+        .use(worldLightMapImage, {
+                                     .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                     .accessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                                     .layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                 })
+        .flush();
 
     worldCommandBuffer->beginRenderPass({
         .renderPass = module->worldLightMapRenderPass_,
@@ -932,49 +855,22 @@ void PostRenderModuleContext::render() {
     worldLightMapImage->imageLayout() = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     // cast linear depth from color to depth format
-    {
-        VkPipelineStageFlags2 srcStageDepth = 0;
-        VkAccessFlags2 srcAccessDepth = 0;
-        chooseSrc(worldPostDepthImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStageDepth, srcAccessDepth);
-
-        VkPipelineStageFlags2 srcStageFirstHit = 0;
-        VkAccessFlags2 srcAccessFirstHit = 0;
-        chooseSrc(firstHitDepthImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStageFirstHit, srcAccessFirstHit);
-
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{
-                     .srcStageMask = srcStageDepth,
-                     .srcAccessMask = srcAccessDepth,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                     .oldLayout = worldPostDepthImage->imageLayout(),
-                     .newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = worldPostDepthImage,
-                     .subresourceRange = vk::wholeDepthSubresourceRange,
-                 },
-                 {
-                     .srcStageMask = srcStageFirstHit,
-                     .srcAccessMask = srcAccessFirstHit,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                     .oldLayout = firstHitDepthImage->imageLayout(),
-                     .newLayout = VK_IMAGE_LAYOUT_GENERAL,
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = firstHitDepthImage,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 }});
-    }
-    worldPostDepthImage->imageLayout() = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-    firstHitDepthImage->imageLayout() = VK_IMAGE_LAYOUT_GENERAL;
+    barriers
+        .use(worldPostDepthImage,
+             {
+                 .stageMask =
+                     VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                 .accessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                               VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                 .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+             },
+             vk::wholeDepthSubresourceRange)
+        .use(firstHitDepthImage, {
+                                     .stageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+                                     .accessMask = VK_ACCESS_2_SHADER_READ_BIT,
+                                     .layout = VK_IMAGE_LAYOUT_GENERAL,
+                                 })
+        .flush();
 
     worldCommandBuffer->beginRenderPass({
         .renderPass = module->worldPostColorToDepthRenderPass_,
@@ -992,48 +888,18 @@ void PostRenderModuleContext::render() {
 
     // copy input to output (or apply CAS)
     if (Renderer::options.casEnabled) {
-        VkPipelineStageFlags2 srcStageLdr = 0;
-        VkAccessFlags2 srcAccessLdr = 0;
-        chooseSrc(ldrImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
-                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStageLdr, srcAccessLdr);
-
-        VkPipelineStageFlags2 srcStagePost = 0;
-        VkAccessFlags2 srcAccessPost = 0;
-        chooseSrc(postRenderedImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStagePost, srcAccessPost);
-
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{
-                     .srcStageMask = srcStageLdr,
-                     .srcAccessMask = srcAccessLdr,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
-                     .oldLayout = ldrImage->imageLayout(),
-                     .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = ldrImage,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 },
-                 {
-                     .srcStageMask = srcStagePost,
-                     .srcAccessMask = srcAccessPost,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT,
-                     .oldLayout = postRenderedImage->imageLayout(),
-                     .newLayout = VK_IMAGE_LAYOUT_GENERAL,
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = postRenderedImage,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 }});
-        ldrImage->imageLayout() = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_GENERAL;
+        barriers
+            .use(ldrImage, {
+                               .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                               .accessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                               .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                           })
+            .use(postRenderedImage, {
+                                        .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                        .accessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                        .layout = VK_IMAGE_LAYOUT_GENERAL,
+                                    })
+            .flush();
 
         auto casTable = module->casDescriptorTables_[context->frameIndex];
         casTable->bindSamplerImageForShader(module->casSampler_, ldrImage, 0, 0);
@@ -1059,49 +925,18 @@ void PostRenderModuleContext::render() {
         uint32_t groupY = (postRenderedImage->height() + 15) / 16;
         vkCmdDispatch(worldCommandBuffer->vkCommandBuffer(), groupX, groupY, 1);
     } else {
-        VkPipelineStageFlags2 srcStageLdr = 0;
-        VkAccessFlags2 srcAccessLdr = 0;
-        chooseSrc(ldrImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
-                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStageLdr, srcAccessLdr);
-
-        VkPipelineStageFlags2 srcStagePost = 0;
-        VkAccessFlags2 srcAccessPost = 0;
-        chooseSrc(postRenderedImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStagePost, srcAccessPost);
-
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{
-                     .srcStageMask = srcStageLdr,
-                     .srcAccessMask = srcAccessLdr,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
-                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                     .oldLayout = ldrImage->imageLayout(),
-                     .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = ldrImage,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 },
-                 {
-                     .srcStageMask = srcStagePost,
-                     .srcAccessMask = srcAccessPost,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                     .oldLayout = postRenderedImage->imageLayout(),
-                     .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = postRenderedImage,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 }});
-        ldrImage->imageLayout() = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers
+            .use(ldrImage, {
+                               .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                               .accessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+                               .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           })
+            .use(postRenderedImage, {
+                                        .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                        .accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                        .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    })
+            .flush();
 
         VkImageBlit imageBlit{};
         imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -1122,58 +957,35 @@ void PostRenderModuleContext::render() {
                        postRenderedImage->vkImage(), postRenderedImage->imageLayout(), 1, &imageBlit, VK_FILTER_LINEAR);
     }
 
-    // post render
-    {
-        VkPipelineStageFlags2 srcStagePost = 0;
-        VkAccessFlags2 srcAccessPost = 0;
-        chooseSrc(postRenderedImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStagePost, srcAccessPost);
-
-        VkPipelineStageFlags2 srcStageLight = 0;
-        VkAccessFlags2 srcAccessLight = 0;
-        chooseSrc(worldLightMapImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStageLight, srcAccessLight);
-
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{
-                     .srcStageMask = srcStagePost,
-                     .srcAccessMask = srcAccessPost,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                     .oldLayout = postRenderedImage->imageLayout(),
-#ifdef USE_AMD
-                     .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-#else
-                     .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-#endif
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = postRenderedImage,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 },
+    // post render and star field draw over the output with the depth cast above, the light map tints the vertices
+    auto useAttachments = [&]() {
+        barriers
+            .use(postRenderedImage, {
+                                        .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                        .accessMask = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+                                                      VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                                        .layout = postRenderedLayout,
+                                    })
+            .use(worldPostDepthImage,
                  {
-                     .srcStageMask = srcStageLight,
-                     .srcAccessMask = srcAccessLight,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                     .oldLayout = worldLightMapImage->imageLayout(),
-                     .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = worldLightMapImage,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 }});
-    }
-#ifdef USE_AMD
-    postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-#else
-    postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-#endif
-    worldLightMapImage->imageLayout() = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                     .stageMask =
+                         VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                     .accessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                   VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                     .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                 },
+                 vk::wholeDepthSubresourceRange)
+            .use(worldLightMapImage, {
+                                         .stageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                                                      VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+                                         .accessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                                         .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                     })
+            .flush();
+    };
+
+    // post render
+    useAttachments();
 
     worldCommandBuffer->beginRenderPass({
         .renderPass = module->worldPostRenderPass_,
@@ -1205,65 +1017,11 @@ void PostRenderModuleContext::render() {
     }
 
     worldCommandBuffer->endRenderPass();
-#ifdef USE_AMD
-    postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-#else
-    postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-#endif
+    postRenderedImage->imageLayout() = postRenderedLayout;
     worldPostDepthImage->imageLayout() = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     // render post star field
-    {
-        VkPipelineStageFlags2 srcStagePost = 0;
-        VkAccessFlags2 srcAccessPost = 0;
-        chooseSrc(postRenderedImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStagePost, srcAccessPost);
-
-        VkPipelineStageFlags2 srcStageLight = 0;
-        VkAccessFlags2 srcAccessLight = 0;
-        chooseSrc(worldLightMapImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  srcStageLight, srcAccessLight);
-
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{
-                     .srcStageMask = srcStagePost,
-                     .srcAccessMask = srcAccessPost,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                     .oldLayout = postRenderedImage->imageLayout(),
-#ifdef USE_AMD
-                     .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-#else
-                     .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-#endif
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = postRenderedImage,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 },
-                 {
-                     .srcStageMask = srcStageLight,
-                     .srcAccessMask = srcAccessLight,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                     .oldLayout = worldLightMapImage->imageLayout(),
-                     .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = worldLightMapImage,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 }});
-    }
-#ifdef USE_AMD
-    postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-#else
-    postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-#endif
-    worldLightMapImage->imageLayout() = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    useAttachments();
 
     worldCommandBuffer->beginRenderPass({
         .renderPass = module->worldPostRenderPass_,
@@ -1281,10 +1039,6 @@ void PostRenderModuleContext::render() {
         ->draw(module->starFieldVertexBuffer->size() / sizeof(vk::VertexFormat::PBRTriangle), 1);
 
     worldCommandBuffer->endRenderPass();
-#ifdef USE_AMD
-    postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-#else
-    postRenderedImage->imageLayout() = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-#endif
+    postRenderedImage->imageLayout() = postRenderedLayout;
     worldPostDepthImage->imageLayout() = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 }
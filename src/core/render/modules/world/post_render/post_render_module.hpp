@@ -42,6 +42,7 @@ class PostRenderModule : public WorldModule, public SharedObject<PostRenderModul
 
     void
     bindTexture(std::shared_ptr<vk::Sampler> sampler, std::shared_ptr<vk::DeviceLocalImage> image, int index) override;
+    void flushTextureBindings() override;
 
     void preClose() override;
 
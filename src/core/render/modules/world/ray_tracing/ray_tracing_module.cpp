@@ -4,9 +4,26 @@
 #include "core/render/modules/world/ray_tracing/submodules/atmosphere.hpp"
 #include "core/render/modules/world/ray_tracing/submodules/world_prepare.hpp"
 #include "core/render/pipeline.hpp"
+#include "core/render/profiler.hpp"
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 
+#include <algorithm>
+
+namespace {
+
+constexpr uint32_t MIN_ADAPTIVE_BOUNCES = 2;
+constexpr uint32_t BOUNCE_LIMIT_SETTLE_FRAMES = 12; // the averages trail a change by the frames in flight and more
+constexpr double OVER_TARGET = 1.05;                // of a target, the limit drops above it
+constexpr double UNDER_TARGET = 0.85;               // and may climb back below it
+constexpr double AVERAGE_WEIGHT = 0.1;              // of the newest sample
+
+double average(double current, double sample) {
+    return current == 0.0 ? sample : current + (sample - current) * AVERAGE_WEIGHT;
+}
+
+} // namespace
+
 RayTracingModule::RayTracingModule() {}
 
 void RayTracingModule::init(std::shared_ptr<Framework> framework, std::shared_ptr<WorldPipeline> worldPipeline) {
@@ -104,6 +121,14 @@ bool RayTracingModule::setOrCreateOutputImages(std::vector<std::shared_ptr<vk::D
         }
     }
 
+    // Variable rate tracing: one rate per tile, written at the end of a frame for the next one
+    if (!tracingRateImage_) {
+        uint32_t tilesX = (width + VARIABLE_RATE_TILE_SIZE - 1) / VARIABLE_RATE_TILE_SIZE;
+        uint32_t tilesY = (height + VARIABLE_RATE_TILE_SIZE - 1) / VARIABLE_RATE_TILE_SIZE;
+        tracingRateImage_ = vk::DeviceLocalImage::create(framework->device(), framework->vma(), false, tilesX, tilesY,
+                                                         1, VK_FORMAT_R8_UINT, VK_IMAGE_USAGE_STORAGE_BIT);
+    }
+
     return true;
 }
 
@@ -141,6 +166,8 @@ void RayTracingModule::build() {
     initSBT();
     initSpatialPipeline();
     initClusterPipeline();
+    initVariableRatePipelines();
+    initBounceStats();
 
     for (int i = 0; i < size; i++) {
         contexts_[i] =
@@ -166,8 +193,14 @@ void RayTracingModule::bindTexture(std::shared_ptr<vk::Sampler> sampler,
     uint32_t size = framework->swapchain()->imageCount();
     for (int i = 0; i < size; i++) {
         if (rayTracingDescriptorTables_[i] != nullptr)
-            rayTracingDescriptorTables_[i]->bindSamplerImage(sampler, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                                                             0, 0, index);
+            rayTracingDescriptorTables_[i]->queueSamplerImage(sampler, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                              0, 0, index);
+    }
+}
+
+void RayTracingModule::flushTextureBindings() {
+    for (auto &table : rayTracingDescriptorTables_) {
+        if (table != nullptr) table->flushQueuedWrites();
     }
 }
 
@@ -183,6 +216,8 @@ void RayTracingModule::preClose() {
         if (clusterPipelineLayout_ != VK_NULL_HANDLE) vkDestroyPipelineLayout(dev, clusterPipelineLayout_, nullptr);
         if (clusterDescSetLayout_ != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(dev, clusterDescSetLayout_, nullptr);
         if (clusterDescPool_ != VK_NULL_HANDLE) vkDestroyDescriptorPool(dev, clusterDescPool_, nullptr);
+        if (bounceQueryPool_ != VK_NULL_HANDLE) vkDestroyQueryPool(dev, bounceQueryPool_, nullptr);
+        bounceQueryPool_ = VK_NULL_HANDLE;
     }
 }
 
@@ -293,6 +328,24 @@ void RayTracingModule::initDescriptorTables() {
                     .descriptorCount = 1,
                     .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
                 })
+                .defineDescriptorLayoutSetBinding({
+                    .binding = 10, // binding 10: merged quad remap addrs
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .descriptorCount = 1,
+                    .stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
+                })
+                .defineDescriptorLayoutSetBinding({
+                    .binding = 11, // binding 11: geometry origins in region BLASes
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .descriptorCount = 1,
+                    .stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
+                })
+                .defineDescriptorLayoutSetBinding({
+                    .binding = 12, // binding 12: bounce stats (adaptive bounces)
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .descriptorCount = 1,
+                    .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+                })
                 .endDescriptorLayoutSetBinding()
                 .endDescriptorLayoutSet()
                 .beginDescriptorLayoutSet() // set 2
@@ -474,6 +527,12 @@ void RayTracingModule::initDescriptorTables() {
                     .descriptorCount = 1,
                     .stageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
                 })
+                .defineDescriptorLayoutSetBinding({
+                    .binding = 21, // binding 21: tracingRateImage (variable rate tracing)
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                    .descriptorCount = 1,
+                    .stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
+                })
                 .endDescriptorLayoutSetBinding()
                 .endDescriptorLayoutSet()
                 .definePushConstant({
@@ -495,8 +554,8 @@ void RayTracingModule::initImages() {
     for (int i = 0; i < size; i++) {
         rayTracingDescriptorTables_[i]->bindSamplerImageForShader(atmosphere_->atmLUTImageSampler_,
                                                                   atmosphere_->atmLUTImage_, 0, 1);
-        rayTracingDescriptorTables_[i]->bindSamplerImageForShader(atmosphere_->atmCubeMapImageSamplers_[i],
-                                                                  atmosphere_->atmCubeMapImages_[i], 0, 2, 7);
+        rayTracingDescriptorTables_[i]->bindSamplerImageForShader(atmosphere_->atmCubeMapImageSampler_,
+                                                                  atmosphere_->atmCubeMapImage_, 0, 2, 7);
 
         rayTracingDescriptorTables_[i]->bindImage(hdrNoisyOutputImages_[i], VK_IMAGE_LAYOUT_GENERAL, 3, 0);
         rayTracingDescriptorTables_[i]->bindImage(diffuseAlbedoImages_[i], VK_IMAGE_LAYOUT_GENERAL, 3, 1);
@@ -515,6 +574,7 @@ void RayTracingModule::initImages() {
         rayTracingDescriptorTables_[i]->bindImage(directLightDepthImages_[i], VK_IMAGE_LAYOUT_GENERAL, 3, 13);
         rayTracingDescriptorTables_[i]->bindImage(diffuseRayDirHitDistImages_[i], VK_IMAGE_LAYOUT_GENERAL, 3, 16);
         rayTracingDescriptorTables_[i]->bindImage(specularRayDirHitDistImages_[i], VK_IMAGE_LAYOUT_GENERAL, 3, 17);
+        rayTracingDescriptorTables_[i]->bindImage(tracingRateImage_, VK_IMAGE_LAYOUT_GENERAL, 3, 21);
 
         // ReSTIR DI reservoir images (initial binding, rebound each frame in render)
         if (reservoirImages_[0]) {
@@ -720,7 +780,7 @@ void RayTracingModule::initClusterPipeline() {
     layoutInfo.pBindings = bindings.data();
     vkCreateDescriptorSetLayout(dev, &layoutInfo, nullptr, &clusterDescSetLayout_);
 
-    // Pipeline layout with push constant (width, height, lightCount, maxPerTile, mat4 vpCameraRel)
+    // Pipeline layout with push constant (width, height, maxPerTile, pad, mat4 vpCameraRel)
     VkPushConstantRange pushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, 80}; // 16 bytes ints + 64 bytes mat4
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
     pipelineLayoutInfo.setLayoutCount = 1;
@@ -766,6 +826,203 @@ void RayTracingModule::initClusterPipeline() {
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 }
 
+void RayTracingModule::initVariableRatePipelines() {
+    auto framework = framework_.lock();
+    auto device = framework->device();
+    uint32_t size = framework->swapchain()->imageCount();
+
+    variableRateDescriptorTables_.resize(size);
+    for (int i = 0; i < size; i++) {
+        vk::DescriptorTableBuilder builder;
+        auto &bindings = builder.beginDescriptorLayoutSet().beginDescriptorLayoutSetBinding();
+        // the outputs, then the tracing rate image and the reservoirs the closest-hit shaders write
+        for (uint32_t binding = 0; binding <= outputImageNum + 1; binding++) {
+            bindings.defineDescriptorLayoutSetBinding({
+                .binding = binding,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            });
+        }
+        variableRateDescriptorTables_[i] = bindings.endDescriptorLayoutSetBinding()
+                                               .endDescriptorLayoutSet()
+                                               .definePushConstant(VkPushConstantRange{
+                                                   .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                                                   .offset = 0,
+                                                   .size = sizeof(VariableRatePushConstant),
+                                               })
+                                               .build(device);
+
+        auto outputs = outputImages(i);
+        for (uint32_t binding = 0; binding < outputImageNum; binding++) {
+            variableRateDescriptorTables_[i]->bindImage(outputs[binding], VK_IMAGE_LAYOUT_GENERAL, 0, binding);
+        }
+        variableRateDescriptorTables_[i]->bindImage(tracingRateImage_, VK_IMAGE_LAYOUT_GENERAL, 0, outputImageNum);
+        variableRateDescriptorTables_[i]->bindImage(reservoirImages_[0], VK_IMAGE_LAYOUT_GENERAL, 0,
+                                                    outputImageNum + 1);
+    }
+
+    std::filesystem::path shaderPath = Renderer::folderPath / "shaders";
+    reconstructShader_ =
+        vk::Shader::create(device, (shaderPath / "world/ray_tracing/vrt_reconstruct_comp.spv").string());
+    tracingRateShader_ = vk::Shader::create(device, (shaderPath / "world/ray_tracing/vrt_rate_comp.spv").string());
+    reconstructPipeline_ = vk::ComputePipelineBuilder{}
+                               .defineShader(reconstructShader_)
+                               .definePipelineLayout(variableRateDescriptorTables_[0])
+                               .build(device);
+    tracingRatePipeline_ = vk::ComputePipelineBuilder{}
+                               .defineShader(tracingRateShader_)
+                               .definePipelineLayout(variableRateDescriptorTables_[0])
+                               .build(device);
+}
+
+void RayTracingModule::initBounceStats() {
+    auto framework = framework_.lock();
+    auto vma = framework->vma();
+    auto device = framework->device();
+    uint32_t size = framework->swapchain()->imageCount();
+
+    size_t statsSize = BOUNCE_STAT_SLOTS * 4 * sizeof(uint32_t);
+    bounceStatsBuffers_.resize(size);
+    bounceStatsReadbacks_.resize(size);
+    bounceStatsWritten_.assign(size, false);
+    for (int i = 0; i < size; i++) {
+        bounceStatsBuffers_[i] =
+            vk::DeviceLocalBuffer::create(vma, device, statsSize,
+                                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        // read back by the CPU, cached memory keeps the reads fast
+        bounceStatsReadbacks_[i] =
+            vk::HostVisibleBuffer::create(vma, device, statsSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, 1,
+                                          VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+        rayTracingDescriptorTables_[i]->bindBuffer(bounceStatsBuffers_[i], 1, 12);
+    }
+
+    if (bounceQueryPool_ != VK_NULL_HANDLE) vkDestroyQueryPool(device->vkDevice(), bounceQueryPool_, nullptr);
+    bounceQueryPool_ = VK_NULL_HANDLE;
+
+    // without timestamps only the ray budget steers the bounce limit
+    VkPhysicalDeviceProperties properties = framework->physicalDevice()->properties();
+    timestampPeriodNs_ = properties.limits.timestampPeriod;
+    if (properties.limits.timestampComputeAndGraphics != VK_TRUE) return;
+
+    VkQueryPoolCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    createInfo.queryCount = size * 2;
+
+    if (vkCreateQueryPool(device->vkDevice(), &createInfo, nullptr, &bounceQueryPool_) != VK_SUCCESS) {
+        std::cerr << "[RayTracing] failed to create bounce timestamp query pool" << std::endl;
+        bounceQueryPool_ = VK_NULL_HANDLE;
+    }
+}
+
+void RayTracingModule::readBounceStats(uint32_t frameIndex, uint32_t pixelCount) {
+    // slots still pending from before a toggle measured the other setting, and adapting starts from every bounce
+    if (Renderer::options.adaptiveBounces != adaptiveBounces_) {
+        adaptiveBounces_ = Renderer::options.adaptiveBounces;
+        bounceStatsWritten_.assign(bounceStatsWritten_.size(), false);
+        bounceLimit_ = Renderer::options.rayBounces;
+        bounceLimitCooldown_ = 0;
+        traceMs_ = bounceRaysPerPixel_ = cutPathFraction_ = 0.0;
+    }
+
+    if (frameIndex >= bounceStatsWritten_.size() || !bounceStatsWritten_[frameIndex]) return;
+    bounceStatsWritten_[frameIndex] = false;
+
+    // the frame fence has signaled, the copy and the timestamps are done. The memory may not be coherent
+    bounceStatsReadbacks_[frameIndex]->downloadFromBuffer();
+    auto slots = static_cast<const uint32_t *>(bounceStatsReadbacks_[frameIndex]->mappedPtr());
+    if (slots != nullptr && pixelCount > 0) {
+        uint64_t rays = 0;
+        uint64_t cutPaths = 0;
+        uint64_t tracedPixels = 0;
+        for (int i = 0; i < BOUNCE_STAT_SLOTS; i++) {
+            rays += slots[i * 4];
+            cutPaths += slots[i * 4 + 1];
+            tracedPixels += slots[i * 4 + 2];
+        }
+        // only counted while variable rate tracing skips pixels, the skipped ones trace no rays
+        double perPixel = 1.0 / (tracedPixels > 0 ? tracedPixels : pixelCount);
+        bounceRaysPerPixel_ = average(bounceRaysPerPixel_, rays * perPixel);
+        cutPathFraction_ = average(cutPathFraction_, cutPaths * perPixel);
+    }
+
+    if (bounceQueryPool_ != VK_NULL_HANDLE) {
+        uint64_t results[4] = {};
+        VkResult result = vkGetQueryPoolResults(framework_.lock()->device()->vkDevice(), bounceQueryPool_,
+                                                frameIndex * 2, 2, sizeof(results), results, 2 * sizeof(uint64_t),
+                                                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result == VK_SUCCESS && results[1] != 0 && results[3] != 0 && results[2] >= results[0]) {
+            traceMs_ = average(traceMs_, (results[2] - results[0]) * timestampPeriodNs_ * 1e-6);
+        }
+    }
+}
+
+uint32_t RayTracingModule::adaptBounceLimit() {
+    auto &options = Renderer::options;
+    uint32_t maxBounces = options.rayBounces;
+
+    if (!options.adaptiveBounces) {
+        bounceLimit_ = maxBounces;
+        bounceLimitCooldown_ = 0;
+        traceMs_ = bounceRaysPerPixel_ = cutPathFraction_ = 0.0;
+        Renderer::bounceStats = {.bounceLimit = maxBounces};
+        return maxBounces;
+    }
+
+    bounceLimit_ = std::clamp(bounceLimit_, std::min(MIN_ADAPTIVE_BOUNCES, maxBounces), maxBounces);
+    if (bounceLimitCooldown_ > 0) {
+        bounceLimitCooldown_--;
+    } else {
+        // a target that is not set is never over and always has room
+        bool hasTime = options.bounceTargetMs > 0.0f && traceMs_ > 0.0;
+        bool hasBudget = options.bounceRayBudget > 0.0f && bounceRaysPerPixel_ > 0.0;
+        bool over = (hasTime && traceMs_ > options.bounceTargetMs * OVER_TARGET) ||
+                    (hasBudget && bounceRaysPerPixel_ > options.bounceRayBudget);
+        // the next bounce adds at most as many rays as the average bounce so far
+        double raysNextLimit = bounceRaysPerPixel_ * (bounceLimit_ + 1) / std::max(bounceLimit_, 1u);
+        bool room = (!hasTime || traceMs_ < options.bounceTargetMs * UNDER_TARGET) &&
+                    (!hasBudget || raysNextLimit < options.bounceRayBudget * UNDER_TARGET);
+
+        if (over && bounceLimit_ > MIN_ADAPTIVE_BOUNCES) {
+            bounceLimit_--;
+            bounceLimitCooldown_ = BOUNCE_LIMIT_SETTLE_FRAMES;
+        } else if (!over && room && bounceLimit_ < maxBounces) {
+            bounceLimit_++;
+            bounceLimitCooldown_ = BOUNCE_LIMIT_SETTLE_FRAMES;
+        }
+    }
+
+    Renderer::bounceStats = {
+        .bounceLimit = bounceLimit_,
+        .traceMs = static_cast<float>(traceMs_),
+        .raysPerPixel = static_cast<float>(bounceRaysPerPixel_),
+        .cutPathFraction = static_cast<float>(cutPathFraction_),
+    };
+    return bounceLimit_;
+}
+
+std::vector<std::shared_ptr<vk::DeviceLocalImage>> RayTracingModule::outputImages(uint32_t frameIndex) {
+    return {
+        hdrNoisyOutputImages_[frameIndex],
+        diffuseAlbedoImages_[frameIndex],
+        specularAlbedoImages_[frameIndex],
+        normalRoughnessImages_[frameIndex],
+        motionVectorImages_[frameIndex],
+        linearDepthImages_[frameIndex],
+        specularHitDepthImages_[frameIndex],
+        firstHitDepthImages_[frameIndex],
+        firstHitDiffuseDirectLightImages_[frameIndex],
+        firstHitDiffuseIndirectLightImages_[frameIndex],
+        firstHitSpecularImages_[frameIndex],
+        firstHitClearImages_[frameIndex],
+        firstHitBaseEmissionImages_[frameIndex],
+        directLightDepthImages_[frameIndex],
+        diffuseRayDirHitDistImages_[frameIndex],
+        specularRayDirHitDistImages_[frameIndex],
+    };
+}
+
 RayTracingModuleContext::RayTracingModuleContext(std::shared_ptr<FrameworkContext> frameworkContext,
                                                  std::shared_ptr<WorldPipelineContext> worldPipelineContext,
                                                  std::shared_ptr<RayTracingModule> rayTracingModule)
@@ -773,6 +1030,7 @@ RayTracingModuleContext::RayTracingModuleContext(std::shared_ptr<FrameworkContex
       rayTracingModule(rayTracingModule),
       rayTracingDescriptorTable(rayTracingModule->rayTracingDescriptorTables_[frameworkContext->frameIndex]),
       sbt(rayTracingModule->sbts_[frameworkContext->frameIndex]),
+      variableRateDescriptorTable(rayTracingModule->variableRateDescriptorTables_[frameworkContext->frameIndex]),
       hdrNoisyOutputImage(rayTracingModule->hdrNoisyOutputImages_[frameworkContext->frameIndex]),
       diffuseAlbedoImage(rayTracingModule->diffuseAlbedoImages_[frameworkContext->frameIndex]),
       specularAlbedoImage(rayTracingModule->specularAlbedoImages_[frameworkContext->frameIndex]),
@@ -795,19 +1053,25 @@ RayTracingModuleContext::RayTracingModuleContext(std::shared_ptr<FrameworkContex
       worldPrepareContext(rayTracingModule->worldPrepare_->contexts_[frameworkContext->frameIndex]) {}
 
 void RayTracingModuleContext::render() {
-    atmosphereContext->render();
-    worldPrepareContext->render();
+    auto context = frameworkContext.lock();
+    auto framework = context->framework.lock();
+    auto worldCommandBuffer = context->worldCommandBuffer;
+    auto mainQueueIndex = framework->physicalDevice()->mainQueueIndex();
+
+    {
+        ProfilerGpuScope profilerScope(worldCommandBuffer, "ray_tracing/atmosphere");
+        atmosphereContext->render();
+    }
+    {
+        ProfilerGpuScope profilerScope(worldCommandBuffer, "ray_tracing/world_prepare");
+        worldPrepareContext->render();
+    }
 
     if (worldPrepareContext->tlas == nullptr) {
         std::cout << "tlas is nullptr" << std::endl;
         return;
     }
 
-    auto context = frameworkContext.lock();
-    auto framework = context->framework.lock();
-    auto worldCommandBuffer = context->worldCommandBuffer;
-    auto mainQueueIndex = framework->physicalDevice()->mainQueueIndex();
-
     auto module = rayTracingModule.lock();
 
     rayTracingDescriptorTable->bindAS(worldPrepareContext->tlas, 1, 0);
@@ -817,6 +1081,8 @@ void RayTracingModuleContext::render() {
     rayTracingDescriptorTable->bindBuffer(worldPrepareContext->lastVertexBufferAddr, 1, 4);
     rayTracingDescriptorTable->bindBuffer(worldPrepareContext->lastIndexBufferAddr, 1, 5);
     rayTracingDescriptorTable->bindBuffer(worldPrepareContext->lastObjToWorldMat, 1, 6);
+    rayTracingDescriptorTable->bindBuffer(worldPrepareContext->quadRemapAddr, 1, 10);
+    rayTracingDescriptorTable->bindBuffer(worldPrepareContext->geometryOriginBuffer, 1, 11);
 
     auto buffers = Renderer::instance().buffers();
     auto worldBuffer = buffers->worldUniformBuffer();
@@ -849,14 +1115,24 @@ void RayTracingModuleContext::render() {
         }
     }
 
+    // the tile rates come from the last frame, a frame without them traces every pixel and derives them
+    bool variableRate = Renderer::options.variableRateTracing != 0 && module->tracingRatePipeline_ != nullptr;
+    if (!variableRate) module->variableRateHistory_ = false;
+    uint32_t variableRateFrame = module->variableRateFrame_++ & 3;
+
+    uint32_t frameIndex = context->frameIndex;
+    uint32_t pixelCount = hdrNoisyOutputImage->width() * hdrNoisyOutputImage->height();
+    module->readBounceStats(frameIndex, pixelCount);
+    bool bounceStats = Renderer::options.adaptiveBounces;
+
     RayTracingPushConstant pushConstant{};
-    pushConstant.numRayBounces = static_cast<int>(Renderer::options.rayBounces);
+    pushConstant.numRayBounces = static_cast<int>(module->adaptBounceLimit());
     pushConstant.flags = (Renderer::options.simplifiedIndirect ? 1 : 0)
                        | (Renderer::options.areaLightsEnabled ? 2 : 0)
                        | (Renderer::options.restirEnabled ? 4 : 0)
                        | (Renderer::options.restirSimplifiedBRDF ? 8 : 0)
-                       | (Renderer::options.restirBounceEnabled ? 16 : 0);
-    pushConstant.areaLightCount = worldPrepareContext->areaLightCount;
+                       | (Renderer::options.restirBounceEnabled ? 16 : 0)
+                       | (bounceStats ? 32 : 0);
     pushConstant.shadowSoftness = Renderer::options.shadowSoftness;
     pushConstant.risCandidates = Renderer::options.restirCandidates;
     pushConstant.temporalMClamp = Renderer::options.restirTemporalMClamp;
@@ -864,6 +1140,10 @@ void RayTracingModuleContext::render() {
     // Only apply pre-exposure when DLSS-RR is active (it undoes it via InExposureScale).
     // When DLSS-RR is off, tone mapper would see double exposure (preExposure × autoExposure).
     pushConstant.preExposure = (Renderer::options.denoiserMode == 1) ? Renderer::preExposure : 1.0f;
+    pushConstant.variableRateFrame = module->variableRateHistory_ ? 1 + static_cast<int>(variableRateFrame) : 0;
+    pushConstant.throughputCutoff = Renderer::options.bounceThroughputCutoff;
+    pushConstant.roughnessCutoff = Renderer::options.bounceRoughnessCutoff;
+    pushConstant.roughPathBounces = static_cast<int>(Renderer::options.roughPathBounces);
 
     vkCmdPushConstants(worldCommandBuffer->vkCommandBuffer(), rayTracingDescriptorTable->vkPipelineLayout(),
                        VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR |
@@ -932,8 +1212,7 @@ void RayTracingModuleContext::render() {
     // Light clustering compute pass — DISABLED: contribution-sorted global list replaces tile clustering.
     // Tile buffer stays allocated (descriptor layout unchanged); CHS reads tileCount=0 → global fallback.
     if (false && Renderer::options.restirEnabled && Renderer::options.areaLightsEnabled
-        && module->clusterPipeline_ != VK_NULL_HANDLE && module->tileLightBuffer_
-        && worldPrepareContext->areaLightCount > 0) {
+        && module->clusterPipeline_ != VK_NULL_HANDLE && module->tileLightBuffer_) {
         VkCommandBuffer cmd = worldCommandBuffer->vkCommandBuffer();
         uint32_t frameIdx = context->frameIndex;
 
@@ -976,9 +1255,9 @@ void RayTracingModuleContext::render() {
         glm::mat4 vpCameraRel = worldUBO->cameraProjMat * viewRot;
 
         struct {
-            int32_t width, height, lightCount, maxPerTile;
+            int32_t width, height, maxPerTile, pad0;
             glm::mat4 vpCameraRel;
-        } clusterPC = {w, h, worldPrepareContext->areaLightCount, RayTracingModule::MAX_LIGHTS_PER_TILE, vpCameraRel};
+        } clusterPC = {w, h, RayTracingModule::MAX_LIGHTS_PER_TILE, 0, vpCameraRel};
 
         vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, module->clusterPipeline_);
         vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, module->clusterPipelineLayout_,
@@ -997,12 +1276,94 @@ void RayTracingModuleContext::render() {
             0, 1, &clusterBarrier, 0, nullptr, 0, nullptr);
     }
 
-    worldCommandBuffer->bindDescriptorTable(rayTracingDescriptorTable, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR)
-        ->bindRTPipeline(module->rayTracingPipeline_)
-        ->raytracing(sbt, hdrNoisyOutputImage->width(), hdrNoisyOutputImage->height(), 1);
+    // only this frame slot touches its counters and readback, the last time round finished behind its fence
+    auto statsBuffer = module->bounceStatsBuffers_[frameIndex];
+    auto statsReadback = module->bounceStatsReadbacks_[frameIndex];
+    VkQueryPool queryPool = bounceStats ? module->bounceQueryPool_ : VK_NULL_HANDLE;
+    if (bounceStats) {
+        vk::BarrierTracker barriers(worldCommandBuffer, mainQueueIndex);
+        barriers.external(statsBuffer, 0, 0)
+            .use(statsBuffer, {
+                                  .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                  .accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                              })
+            .flush();
+        vkCmdFillBuffer(worldCommandBuffer->vkCommandBuffer(), statsBuffer->vkBuffer(), 0, VK_WHOLE_SIZE, 0);
+        barriers
+            .use(statsBuffer, {
+                                  .stageMask = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                  .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                                                VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                              })
+            .flush();
+
+        if (queryPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(worldCommandBuffer->vkCommandBuffer(), queryPool, frameIndex * 2, 2);
+        }
+    }
+
+    {
+        ProfilerGpuScope profilerScope(worldCommandBuffer, "ray_tracing/trace");
+        if (queryPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp2(worldCommandBuffer->vkCommandBuffer(), VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, queryPool,
+                                 frameIndex * 2);
+        }
+        worldCommandBuffer->bindDescriptorTable(rayTracingDescriptorTable, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR)
+            ->bindRTPipeline(module->rayTracingPipeline_)
+            ->raytracing(sbt, hdrNoisyOutputImage->width(), hdrNoisyOutputImage->height(), 1);
+        if (queryPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp2(worldCommandBuffer->vkCommandBuffer(), VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                 queryPool, frameIndex * 2 + 1);
+        }
+    }
+
+    if (bounceStats) {
+        vk::BarrierTracker barriers(worldCommandBuffer, mainQueueIndex);
+        barriers
+            .external(statsBuffer, VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                      VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+            .external(statsReadback, 0, 0)
+            .use(statsBuffer, {
+                                  .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                  .accessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+                              })
+            .use(statsReadback, {
+                                    .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                    .accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                })
+            .flush();
+
+        VkBufferCopy statsCopy{.srcOffset = 0, .dstOffset = 0, .size = statsBuffer->size()};
+        vkCmdCopyBuffer(worldCommandBuffer->vkCommandBuffer(), statsBuffer->vkBuffer(), statsReadback->vkBuffer(), 1,
+                        &statsCopy);
+
+        barriers
+            .use(statsReadback, {
+                                    .stageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+                                    .accessMask = VK_ACCESS_2_HOST_READ_BIT,
+                                })
+            .flush();
+        module->bounceStatsWritten_[frameIndex] = true;
+    }
+
+    if (variableRate) {
+        ProfilerGpuScope profilerScope(worldCommandBuffer, "ray_tracing/variable_rate");
+        reconstructVariableRate({
+            .width = static_cast<int32_t>(hdrNoisyOutputImage->width()),
+            .height = static_cast<int32_t>(hdrNoisyOutputImage->height()),
+            .frame = variableRateFrame,
+            .maxRate = std::min(Renderer::options.variableRateTracing, TRACING_RATE_QUARTER),
+            .threshold = Renderer::options.variableRateThreshold,
+            .history = module->variableRateHistory_ ? 1u : 0u,
+        });
+        module->variableRateHistory_ = true;
+    }
 
     // Spatial reuse compute pass (when ReSTIR and spatial reuse are both enabled)
+    // It stays on the main queue with the trace: async compute moves whole modules, the pass reads the reservoirs the
+    // closest-hit shaders just wrote and its output is what the next frame's trace reads at binding 15
     if (Renderer::options.restirEnabled && Renderer::options.restirSpatialEnabled && module->spatialPipeline_ != VK_NULL_HANDLE) {
+        ProfilerGpuScope profilerScope(worldCommandBuffer, "ray_tracing/restir_spatial");
         VkCommandBuffer cmd = worldCommandBuffer->vkCommandBuffer();
 
         // Barrier: RT shader writes → compute shader reads
@@ -1070,3 +1431,75 @@ void RayTracingModuleContext::render() {
             0, 1, &postSpatialBarrier, 0, nullptr, 0, nullptr);
     }
 }
+
+void RayTracingModuleContext::reconstructVariableRate(const VariableRatePushConstant &pushConstant) {
+    auto context = frameworkContext.lock();
+    auto framework = context->framework.lock();
+    auto module = rayTracingModule.lock();
+    auto worldCommandBuffer = context->worldCommandBuffer;
+    VkCommandBuffer cmd = worldCommandBuffer->vkCommandBuffer();
+
+    auto outputs = module->outputImages(context->frameIndex);
+    auto rateImage = module->tracingRateImage_;
+    auto reservoirImage = module->reservoirImages_[0];
+
+    vk::BarrierTracker barriers(worldCommandBuffer, framework->physicalDevice()->mainQueueIndex());
+    for (auto &image : outputs) {
+        barriers.external(image, VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    }
+    barriers.external(reservoirImage, VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                      VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    constexpr vk::ResourceAccess computeRead = {
+        .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+        .layout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+    constexpr vk::ResourceAccess computeReadWrite = {
+        .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .layout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+
+    worldCommandBuffer->bindDescriptorTable(variableRateDescriptorTable, VK_PIPELINE_BIND_POINT_COMPUTE);
+    vkCmdPushConstants(cmd, variableRateDescriptorTable->vkPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(VariableRatePushConstant), &pushConstant);
+
+    // without last frame's rates world.rgen traced every pixel
+    if (pushConstant.history != 0) {
+        for (auto &image : outputs) barriers.use(image, computeReadWrite);
+        barriers.use(reservoirImage, computeReadWrite).use(rateImage, computeRead).flush();
+
+        worldCommandBuffer->bindComputePipeline(module->reconstructPipeline_);
+        vkCmdDispatch(cmd, (pushConstant.width + 7) / 8, (pushConstant.height + 7) / 8, 1);
+    }
+
+    barriers.use(outputs[0], computeRead).use(outputs[4], computeRead).use(outputs[5], computeRead);
+    barriers.use(rateImage, computeReadWrite).flush();
+
+    worldCommandBuffer->bindComputePipeline(module->tracingRatePipeline_);
+    vkCmdDispatch(cmd, rateImage->width(), rateImage->height(), 1);
+
+    // the modules downstream expect the outputs written by ray tracing, next frame's world.rgen reads the rates and
+    // the spatial pass or next frame's closest-hit shaders the reservoirs
+    for (auto &image : outputs) {
+        barriers.use(image, {
+                                .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                .accessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+                                .layout = VK_IMAGE_LAYOUT_GENERAL,
+                            });
+    }
+    barriers
+        .use(rateImage, {
+                            .stageMask = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                            .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                            .layout = VK_IMAGE_LAYOUT_GENERAL,
+                        })
+        .use(reservoirImage, {
+                                 .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                                              VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                 .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                                               VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                 .layout = VK_IMAGE_LAYOUT_GENERAL,
+                             })
+        .flush();
+}
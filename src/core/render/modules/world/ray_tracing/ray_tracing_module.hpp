@@ -21,14 +21,27 @@ class WorldPrepareContext;
 
 struct RayTracingPushConstant {
     int numRayBounces;
-    int flags;           // bit 0: simplified indirect, bit 1: area lights enabled
-                         // bit 2: restir, bit 3: simplified BRDF, bit 4: restir bounce
-    int areaLightCount;  // number of active area lights this frame
+    int flags;              // bit 0: simplified indirect, bit 1: area lights enabled
+                            // bit 2: restir, bit 3: simplified BRDF, bit 4: restir bounce, bit 5: bounce stats
     float shadowSoftness;
-    int risCandidates;   // total RIS candidates per pixel
-    int temporalMClamp;  // temporal reservoir M clamp (used as float in shader)
-    int wClamp;          // importance weight W clamp (used as float in shader)
-    float preExposure;   // pre-exposure multiplier for DLSS-RR normalization
+    int risCandidates;      // total RIS candidates per pixel
+    int temporalMClamp;     // temporal reservoir M clamp (used as float in shader)
+    int wClamp;             // importance weight W clamp (used as float in shader)
+    float preExposure;      // pre-exposure multiplier for DLSS-RR normalization
+    int variableRateFrame;  // 0 traces every pixel, else 1 + the frame counter picking the pixels of sparse tiles
+    float throughputCutoff; // Options::bounceThroughputCutoff
+    float roughnessCutoff;  // Options::bounceRoughnessCutoff
+    int roughPathBounces;   // Options::roughPathBounces
+};
+
+// vrt_reconstruct.comp and vrt_rate.comp
+struct VariableRatePushConstant {
+    int32_t width;
+    int32_t height;
+    uint32_t frame;   // sample pattern world.rgen traced this frame
+    uint32_t maxRate; // Options::variableRateTracing
+    float threshold;  // Options::variableRateThreshold
+    uint32_t history; // the rate image holds last frame's rates
 };
 
 class RayTracingModule : public WorldModule, public SharedObject<RayTracingModule> {
@@ -60,6 +73,7 @@ class RayTracingModule : public WorldModule, public SharedObject<RayTracingModul
 
     void
     bindTexture(std::shared_ptr<vk::Sampler> sampler, std::shared_ptr<vk::DeviceLocalImage> image, int index) override;
+    void flushTextureBindings() override;
 
     void preClose() override;
 
@@ -70,6 +84,16 @@ class RayTracingModule : public WorldModule, public SharedObject<RayTracingModul
     void initSBT();
     void initSpatialPipeline();
     void initClusterPipeline();
+    void initVariableRatePipelines();
+    void initBounceStats();
+
+    // folds in what the frame slot measured the last time round, called before it records again
+    void readBounceStats(uint32_t frameIndex, uint32_t pixelCount);
+    // Options::adaptiveBounces, the bounce limit this frame traces with
+    uint32_t adaptBounceLimit();
+
+    // in the order of setOrCreateOutputImages
+    std::vector<std::shared_ptr<vk::DeviceLocalImage>> outputImages(uint32_t frameIndex);
 
   private:
     // input
@@ -166,6 +190,30 @@ class RayTracingModule : public WorldModule, public SharedObject<RayTracingModul
     static constexpr int TILE_SIZE = 16;
     static constexpr int MAX_LIGHTS_PER_TILE = 512;
 
+    // Options::variableRateTracing, the rates are derived at the end of a frame for the next one
+    std::shared_ptr<vk::DeviceLocalImage> tracingRateImage_; // TRACING_RATE_* per tile, shared across frames
+    std::vector<std::shared_ptr<vk::DescriptorTable>> variableRateDescriptorTables_;
+    std::shared_ptr<vk::Shader> reconstructShader_;
+    std::shared_ptr<vk::Shader> tracingRateShader_;
+    std::shared_ptr<vk::ComputePipeline> reconstructPipeline_;
+    std::shared_ptr<vk::ComputePipeline> tracingRatePipeline_;
+    uint32_t variableRateFrame_ = 0;
+    bool variableRateHistory_ = false; // tracingRateImage_ holds rates written by the last frame
+
+    // Options::adaptiveBounces, a frame slot's counters and trace timestamps are read when the slot comes round again
+    std::vector<std::shared_ptr<vk::DeviceLocalBuffer>> bounceStatsBuffers_; // uvec4 per BOUNCE_STAT_SLOTS
+    std::vector<std::shared_ptr<vk::HostVisibleBuffer>> bounceStatsReadbacks_;
+    std::vector<bool> bounceStatsWritten_;
+    VkQueryPool bounceQueryPool_ = VK_NULL_HANDLE; // begin and end of the trace per frame slot
+    double timestampPeriodNs_ = 1.0;
+    bool adaptiveBounces_ = false; // the option as of the last frame, a toggle drops pending measurements
+    uint32_t bounceLimit_ = 0;
+    uint32_t bounceLimitCooldown_ = 0; // frames until the measurements caught up with the last change
+    // moving averages, 0 until measured
+    double traceMs_ = 0.0;
+    double bounceRaysPerPixel_ = 0.0;
+    double cutPathFraction_ = 0.0;
+
     // submodules
     std::shared_ptr<Atmosphere> atmosphere_;
     std::shared_ptr<WorldPrepare> worldPrepare_;
@@ -182,6 +230,7 @@ struct RayTracingModuleContext : public WorldModuleContext, SharedObject<RayTrac
     // ray tracing
     std::shared_ptr<vk::DescriptorTable> rayTracingDescriptorTable;
     std::shared_ptr<vk::SBT> sbt;
+    std::shared_ptr<vk::DescriptorTable> variableRateDescriptorTable;
 
     // output
     std::shared_ptr<vk::DeviceLocalImage> hdrNoisyOutputImage;
@@ -210,4 +259,8 @@ struct RayTracingModuleContext : public WorldModuleContext, SharedObject<RayTrac
                             std::shared_ptr<RayTracingModule> rayTracingModule);
 
     void render() override;
+
+  private:
+    // fills the pixels skipped this frame and derives the tile rates of the next one
+    void reconstructVariableRate(const VariableRatePushConstant &pushConstant);
 };
\ No newline at end of file
@@ -5,8 +5,65 @@
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <filesystem>
 
+namespace {
+
+struct SkyCubePushConstant {
+    int face;
+    float blend;
+};
+
+// share of a blended face still showing older skies below which its next refresh replaces it, blending alone only
+// approaches the current sky
+constexpr float SKY_FACE_REPLACE_RESIDUAL = 1.0f / 64.0f;
+
+enum class SkyChange {
+    NONE,
+    DRIFT, // a face may lag behind for a few frames
+    JUMP,  // every face has to follow at once
+};
+
+SkyChange compareDirection(glm::vec3 a, glm::vec3 b) {
+    if (glm::dot(a, a) == 0.0f || glm::dot(b, b) == 0.0f) return a == b ? SkyChange::NONE : SkyChange::JUMP;
+    float distance = glm::length(glm::normalize(a) - glm::normalize(b));
+    if (distance > 0.1f) return SkyChange::JUMP;         // ~6 degrees, time set
+    if (distance > 1e-3f) return SkyChange::DRIFT;       // ~0.06 degrees, a few seconds of sun movement
+    return SkyChange::NONE;
+}
+
+SkyChange compareRadiance(glm::vec3 a, glm::vec3 b) {
+    glm::vec3 peak = glm::max(a, b), delta = glm::abs(a - b);
+    float scale = std::max({peak.x, peak.y, peak.z, 1e-6f});
+    float difference = std::max({delta.x, delta.y, delta.z}) / scale;
+    if (difference > 0.25f) return SkyChange::JUMP;
+    if (difference > 2e-3f) return SkyChange::DRIFT;
+    return SkyChange::NONE;
+}
+
+SkyChange compareSky(const vk::Data::SkyUBO &a, float aHeight, const vk::Data::SkyUBO &b, float bHeight) {
+    // the medium only changes with the dimension or the options
+    bool sameMedium = a.Rg == b.Rg && a.Rt == b.Rt && a.Hr == b.Hr && a.Hm == b.Hm && a.betaR == b.betaR &&
+                      a.betaM == b.betaM && a.mieG == b.mieG && a.minViewCos == b.minViewCos;
+    if (!sameMedium) return SkyChange::JUMP;
+
+    float height = std::abs(aHeight - bHeight);
+    SkyChange change = height > 256.0f ? SkyChange::JUMP : (height > 16.0f ? SkyChange::DRIFT : SkyChange::NONE);
+    for (SkyChange other : {
+             compareDirection(a.sunDirection, b.sunDirection),
+             compareDirection(a.moonDirection, b.moonDirection),
+             compareRadiance(a.sunRadiance * a.envCelestial.z, b.sunRadiance * b.envCelestial.z),
+             compareRadiance(a.moonRadiance * a.envCelestial.w, b.moonRadiance * b.envCelestial.w),
+         }) {
+        change = std::max(change, other);
+    }
+    return change;
+}
+
+} // namespace
+
 Atmosphere::Atmosphere() {}
 
 void Atmosphere::init(std::shared_ptr<Framework> framework, std::shared_ptr<RayTracingModule> rayTracingModule) {
@@ -40,9 +97,11 @@ void Atmosphere::initDescriptorTables() {
     atmLUTImageSampler_ = vk::Sampler::create(framework->device(), VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR,
                                               VK_SAMPLER_ADDRESS_MODE_REPEAT);
 
+    atmCubeMapImageSampler_ = vk::Sampler::create(framework->device(), VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR,
+                                                  VK_SAMPLER_ADDRESS_MODE_REPEAT);
+
     uint32_t size = framework->swapchain()->imageCount();
     atmDescriptorTables_.resize(size);
-    atmCubeMapImageSamplers_.resize(size);
 
     for (int i = 0; i < size; i++) {
         atmDescriptorTables_[i] =
@@ -83,12 +142,9 @@ void Atmosphere::initDescriptorTables() {
                 .definePushConstant(VkPushConstantRange{
                     .stageFlags = VK_SHADER_STAGE_ALL,
                     .offset = 0,
-                    .size = sizeof(int),
+                    .size = sizeof(SkyCubePushConstant),
                 })
                 .build(framework->device());
-
-        atmCubeMapImageSamplers_[i] = vk::Sampler::create(
-            framework->device(), VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
     }
 }
 
@@ -100,66 +156,71 @@ void Atmosphere::initImages() {
                                                 VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
 
     uint32_t size = framework->swapchain()->imageCount();
-    atmCubeMapImages_.resize(size);
-
     for (int i = 0; i < size; i++) {
         atmDescriptorTables_[i]->bindSamplerImageForShader(atmLUTImageSampler_, atmLUTImage_, 0, 0);
+    }
 
-        {
-            atmCubeMapImages_[i] = vk::DeviceLocalImage::create(
-                framework->device(), framework->vma(), false, 512, 512, 6, VK_FORMAT_R16G16B16A16_SFLOAT,
-                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 0,
-                VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
-
-            // 1...6
-            for (int faceIndex = 0; faceIndex < 6; faceIndex++) {
-                atmCubeMapImages_[i]->addImageView(VkImageViewCreateInfo{
-                    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-                    .image = atmCubeMapImages_[i]->vkImage(),
-                    .viewType = VK_IMAGE_VIEW_TYPE_2D,
-                    .format = atmCubeMapImages_[i]->vkFormat(),
-                    .components =
-                        {
-                            .r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                            .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                            .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                            .a = VK_COMPONENT_SWIZZLE_IDENTITY,
-                        },
-                    .subresourceRange =
-                        {
-                            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                            .baseMipLevel = 0,
-                            .levelCount = 1,
-                            .baseArrayLayer = static_cast<uint32_t>(faceIndex),
-                            .layerCount = 1,
-                        },
-                });
-            }
-
-            // 7
-            atmCubeMapImages_[i]->addImageView(VkImageViewCreateInfo{
-                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-                .image = atmCubeMapImages_[i]->vkImage(),
-                .viewType = VK_IMAGE_VIEW_TYPE_CUBE,
-                .format = atmCubeMapImages_[i]->vkFormat(),
-                .components =
-                    {
-                        .r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                        .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                        .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                        .a = VK_COMPONENT_SWIZZLE_IDENTITY,
-                    },
-                .subresourceRange =
-                    {
-                        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                        .baseMipLevel = 0,
-                        .levelCount = 1,
-                        .baseArrayLayer = 0,
-                        .layerCount = 6,
-                    },
-            });
-        }
+    // the low resolution cube gets mips down to 4x4, rough reflections sample them by ray cone
+    uint32_t faceSize = Renderer::options.skyCubeMapLowRes ? 128 : 512;
+    atmCubeMapMipLevels_ = Renderer::options.skyCubeMapLowRes ? static_cast<uint32_t>(std::log2(faceSize)) - 1 : 1;
+
+    VkImageUsageFlags cubeUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (atmCubeMapMipLevels_ > 1) cubeUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    atmCubeMapImage_ = vk::DeviceLocalImage::create(framework->device(), framework->vma(), false, atmCubeMapMipLevels_,
+                                                    faceSize, faceSize, 6, VK_FORMAT_R16G16B16A16_SFLOAT, cubeUsage, 0,
+                                                    VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+                                                    VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
+
+    // 1...6
+    for (int faceIndex = 0; faceIndex < 6; faceIndex++) {
+        atmCubeMapImage_->addImageView(VkImageViewCreateInfo{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = atmCubeMapImage_->vkImage(),
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = atmCubeMapImage_->vkFormat(),
+            .components =
+                {
+                    .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+                },
+            .subresourceRange =
+                {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = static_cast<uint32_t>(faceIndex),
+                    .layerCount = 1,
+                },
+        });
     }
+
+    // 7
+    atmCubeMapImage_->addImageView(VkImageViewCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = atmCubeMapImage_->vkImage(),
+        .viewType = VK_IMAGE_VIEW_TYPE_CUBE,
+        .format = atmCubeMapImage_->vkFormat(),
+        .components =
+            {
+                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+            },
+        .subresourceRange =
+            {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = atmCubeMapMipLevels_,
+                .baseArrayLayer = 0,
+                .layerCount = 6,
+            },
+    });
+
+    cubeFaceRendered_.fill(false);
+    cubeFaceResidual_.fill(0.0f);
 }
 
 void Atmosphere::initAtmLUTRenderPass() {
@@ -193,33 +254,42 @@ void Atmosphere::initAtmLUTRenderPass() {
 }
 
 void Atmosphere::initAtmCubeMapRenderPass() {
-    atmCubeMapRenderPass_ = vk::RenderPassBuilder{}
-                                .beginAttachmentDescription()
-                                .defineAttachmentDescription({
-                                    // color
-                                    .format = atmCubeMapImages_[0]->vkFormat(),
-                                    .samples = VK_SAMPLE_COUNT_1_BIT,
-                                    .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                                    .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-                                    .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                                    .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                                    .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                    .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                })
-                                .endAttachmentDescription()
-                                .beginAttachmentReference()
-                                .defineAttachmentReference({
-                                    .attachment = 0,
-                                    .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                                })
-                                .endAttachmentReference()
-                                .beginSubpassDescription()
-                                .defineSubpassDescription({
-                                    .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    .colorAttachmentIndices = {0},
-                                })
-                                .endSubpassDescription()
-                                .build(framework_.lock()->device());
+    // the blend pass keeps what a face held so a drifting sky can be blended over it
+    for (VkAttachmentLoadOp loadOp : {VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_LOAD}) {
+        auto renderPass = vk::RenderPassBuilder{}
+                              .beginAttachmentDescription()
+                              .defineAttachmentDescription({
+                                  // color
+                                  .format = atmCubeMapImage_->vkFormat(),
+                                  .samples = VK_SAMPLE_COUNT_1_BIT,
+                                  .loadOp = loadOp,
+                                  .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                                  .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                                  .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                                  .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                  .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                              })
+                              .endAttachmentDescription()
+                              .beginAttachmentReference()
+                              .defineAttachmentReference({
+                                  .attachment = 0,
+                                  .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                              })
+                              .endAttachmentReference()
+                              .beginSubpassDescription()
+                              .defineSubpassDescription({
+                                  .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                  .colorAttachmentIndices = {0},
+                              })
+                              .endSubpassDescription()
+                              .build(framework_.lock()->device());
+
+        if (loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+            atmCubeMapBlendRenderPass_ = renderPass;
+        } else {
+            atmCubeMapRenderPass_ = renderPass;
+        }
+    }
 }
 
 void Atmosphere::initFrameBuffers() {
@@ -232,17 +302,13 @@ void Atmosphere::initFrameBuffers() {
                              .endAttachment()
                              .build(framework->device(), atmLUTRenderPass_);
 
-    uint32_t size = framework->swapchain()->imageCount();
-    atmCubeMapFramebuffers_.resize(size);
-
-    for (int i = 0; i < size; i++) {
-        for (int faceIndex = 0; faceIndex < 6; faceIndex++) {
-            atmCubeMapFramebuffers_[i][faceIndex] = vk::FramebufferBuilder{}
-                                                        .beginAttachment()
-                                                        .defineAttachment(atmCubeMapImages_[i], faceIndex + 1)
-                                                        .endAttachment()
-                                                        .build(framework->device(), atmCubeMapRenderPass_);
-        }
+    // compatible with both cube map render passes, they only differ in the load op
+    for (int faceIndex = 0; faceIndex < 6; faceIndex++) {
+        atmCubeMapFramebuffers_[faceIndex] = vk::FramebufferBuilder{}
+                                                 .beginAttachment()
+                                                 .defineAttachment(atmCubeMapImage_, faceIndex + 1)
+                                                 .endAttachment()
+                                                 .build(framework->device(), atmCubeMapRenderPass_);
     }
 }
 
@@ -296,6 +362,27 @@ void Atmosphere::initAtmCubeMapPipeline() {
     atmCubeMapFragShader_ = vk::Shader::create(framework->device(),
                                                (shaderPath / "world/ray_tracing/atmosphere/skycube_frag.spv").string());
 
+    vk::GraphicsPipelineBuilder::ViewPortAndScissor viewportScissor = {
+        .viewport =
+            {
+                .x = 0,
+                .y = 0,
+                .width = static_cast<float>(atmCubeMapImage_->width()),
+                .height = static_cast<float>(atmCubeMapImage_->height()),
+                .minDepth = 0.0,
+                .maxDepth = 1.0,
+            },
+        .scissor =
+            {
+                .offset = {.x = 0, .y = 0},
+                .extent =
+                    {
+                        .width = atmCubeMapImage_->width(),
+                        .height = atmCubeMapImage_->height(),
+                    },
+            },
+    };
+
     atmCubeMapPipeline_ = vk::GraphicsPipelineBuilder{}
                               .defineRenderPass(atmCubeMapRenderPass_, 0)
                               .beginShaderStage()
@@ -303,31 +390,80 @@ void Atmosphere::initAtmCubeMapPipeline() {
                               .defineShaderStage(atmCubeMapFragShader_, VK_SHADER_STAGE_FRAGMENT_BIT)
                               .endShaderStage()
                               .defineVertexInputState<void>()
-                              .defineViewportScissorState({
-                                  .viewport =
-                                      {
-                                          .x = 0,
-                                          .y = 0,
-                                          .width = static_cast<float>(atmCubeMapImages_[0]->width()),
-                                          .height = static_cast<float>(atmCubeMapImages_[0]->height()),
-                                          .minDepth = 0.0,
-                                          .maxDepth = 1.0,
-                                      },
-                                  .scissor =
-                                      {
-                                          .offset = {.x = 0, .y = 0},
-                                          .extent =
-                                              {
-                                                  .width = atmCubeMapImages_[0]->width(),
-                                                  .height = atmCubeMapImages_[0]->height(),
-                                              },
-                                      },
-                              })
+                              .defineViewportScissorState(viewportScissor)
                               .beginColorBlendAttachmentState()
                               .defineDefaultColorBlendAttachmentState() // color
                               .endColorBlendAttachmentState()
                               .definePipelineLayout(atmDescriptorTables_[0])
                               .build(framework->device());
+
+    // the shader writes the blend weight to alpha, the alpha channel itself stays as it was
+    VkPipelineColorBlendAttachmentState blendAttachmentState = {
+        .blendEnable = VK_TRUE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .alphaBlendOp = VK_BLEND_OP_ADD,
+        .colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+
+    atmCubeMapBlendPipeline_ = vk::GraphicsPipelineBuilder{}
+                                   .defineRenderPass(atmCubeMapBlendRenderPass_, 0)
+                                   .beginShaderStage()
+                                   .defineShaderStage(atmCubeMapVertShader_, VK_SHADER_STAGE_VERTEX_BIT)
+                                   .defineShaderStage(atmCubeMapFragShader_, VK_SHADER_STAGE_FRAGMENT_BIT)
+                                   .endShaderStage()
+                                   .defineVertexInputState<void>()
+                                   .defineViewportScissorState(viewportScissor)
+                                   .beginColorBlendAttachmentState()
+                                   .defineColorBlendAttachmentState(blendAttachmentState) // color
+                                   .endColorBlendAttachmentState()
+                                   .definePipelineLayout(atmDescriptorTables_[0])
+                                   .build(framework->device());
+}
+
+std::vector<Atmosphere::SkyCubeFace> Atmosphere::selectCubeFaces(const SkyCubeInputs &current) {
+    std::array<SkyChange, 6> changes;
+    bool jump = false;
+    for (uint32_t face = 0; face < 6; face++) {
+        auto &rendered = cubeFaceInputs_[face];
+        changes[face] = cubeFaceRendered_[face]
+                            ? compareSky(rendered.sky, rendered.cameraHeight, current.sky, current.cameraHeight)
+                            : SkyChange::JUMP;
+        jump = jump || changes[face] == SkyChange::JUMP;
+    }
+
+    std::vector<SkyCubeFace> faces;
+    if (jump) {
+        for (uint32_t face = 0; face < 6; face++) faces.push_back({face, 1.0f});
+    } else {
+        uint32_t budget = std::clamp(Renderer::options.skyFacesPerFrame, 1u, 6u);
+        for (uint32_t i = 0; i < 6 && faces.size() < budget; i++) {
+            uint32_t face = (nextCubeFace_ + i) % 6;
+            // a blended face keeps being refreshed after the sky stopped until it shows the current one
+            if (changes[face] == SkyChange::NONE && cubeFaceResidual_[face] == 0.0f) continue;
+            faces.push_back({face, Renderer::options.skyFaceBlend});
+        }
+        if (!faces.empty()) nextCubeFace_ = (faces.back().face + 1) % 6;
+    }
+
+    for (auto &face : faces) {
+        // what was drawn before is the sky of cubeFaceInputs_ only up to the residual of its own blends
+        float residual = 1.0f - face.blend;
+        if (changes[face.face] == SkyChange::NONE) residual *= cubeFaceResidual_[face.face];
+        if (residual < SKY_FACE_REPLACE_RESIDUAL) {
+            face.blend = 1.0f;
+            residual = 0.0f;
+        }
+
+        cubeFaceInputs_[face.face] = current;
+        cubeFaceResidual_[face.face] = residual;
+        cubeFaceRendered_[face.face] = true;
+    }
+    return faces;
 }
 
 AtmosphereContext::AtmosphereContext(std::shared_ptr<FrameworkContext> frameworkContext,
@@ -337,8 +473,8 @@ AtmosphereContext::AtmosphereContext(std::shared_ptr<FrameworkContext> framework
       atmDescriptorTable(atmosphere->atmDescriptorTables_[frameworkContext->frameIndex]),
       atmLUTImage(atmosphere->atmLUTImage_),
       atmLUTFramebuffer(atmosphere->atmLUTFramebuffer_),
-      atmCubeMapImage(atmosphere->atmCubeMapImages_[frameworkContext->frameIndex]),
-      atmCubeMapFramebuffer(atmosphere->atmCubeMapFramebuffers_[frameworkContext->frameIndex]) {}
+      atmCubeMapImage(atmosphere->atmCubeMapImage_),
+      atmCubeMapFramebuffer(atmosphere->atmCubeMapFramebuffers_) {}
 
 void AtmosphereContext::render() {
     auto buffers = Renderer::instance().buffers();
@@ -353,42 +489,27 @@ void AtmosphereContext::render() {
 
     auto module = atmosphere.lock();
 
-    auto chooseSrc = [](VkImageLayout oldLayout,
-                        VkPipelineStageFlags2 fallbackStage,
-                        VkAccessFlags2 fallbackAccess,
-                        VkPipelineStageFlags2 &outStage,
-                        VkAccessFlags2 &outAccess) {
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
-            outStage = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
-            outAccess = 0;
-        } else {
-            outStage = fallbackStage;
-            outAccess = fallbackAccess;
-        }
-    };
+    vk::BarrierTracker barriers(worldCommandBuffer, mainQueueIndex);
+    // the LUT is written once and only sampled after that. The cube is shared by all frames in flight, an older
+    // frame may still trace against it while its faces are refreshed here
+    bool lutReady = atmLUTImage->imageLayout() == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkPipelineStageFlags2 lutStages =
+        lutReady ? 0 : VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    barriers.external(atmLUTImage, lutStages, lutReady ? 0 : VK_ACCESS_2_MEMORY_WRITE_BIT)
+        .external(atmCubeMapImage,
+                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+                      VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                  VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
 
     // render atmosphere transmit LUT only once
     if (!module->lutRendered_) {
-        VkPipelineStageFlags2 lutSrcStage = 0;
-        VkAccessFlags2 lutSrcAccess = 0;
-        chooseSrc(atmLUTImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  lutSrcStage, lutSrcAccess);
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{
-                    .srcStageMask = lutSrcStage,
-                    .srcAccessMask = lutSrcAccess,
-                    .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                    .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                    .oldLayout = atmLUTImage->imageLayout(),
-                    .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                    .srcQueueFamilyIndex = mainQueueIndex,
-                    .dstQueueFamilyIndex = mainQueueIndex,
-                    .image = atmLUTImage,
-                    .subresourceRange = vk::wholeColorSubresourceRange,
-                }});
-        atmLUTImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barriers
+            .use(atmLUTImage, {
+                                  .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                  .accessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                                  .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                              })
+            .flush();
 
         worldCommandBuffer->beginRenderPass({
             .renderPass = module->atmLUTRenderPass_,
@@ -403,71 +524,128 @@ void AtmosphereContext::render() {
             ->draw(3, 1)
             ->endRenderPass();
         atmLUTImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        barriers.external(atmLUTImage, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                          VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
 
         module->lutRendered_ = true;
     }
 
-    // render atmosphere cube map
+    // render the atmosphere cube map faces the sky has moved on from, nothing at all while it stands still
+    auto worldUBO = static_cast<vk::Data::WorldUBO *>(buffers->worldUniformBuffer()->mappedPtr());
+    auto skyUBO = static_cast<vk::Data::SkyUBO *>(buffers->skyUniformBuffer()->mappedPtr());
+    std::vector<Atmosphere::SkyCubeFace> faces;
+    if (worldUBO != nullptr && skyUBO != nullptr) {
+        faces = module->selectCubeFaces({
+            .sky = *skyUBO,
+            .cameraHeight = worldUBO->cameraViewMatInv[3].y,
+        });
+    }
+    if (faces.empty() && module->atmLUTImage_->imageLayout() == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) return;
+
     {
-        VkPipelineStageFlags2 cubeSrcStage = 0;
-        VkAccessFlags2 cubeSrcAccess = 0;
-        chooseSrc(atmCubeMapImage->imageLayout(),
-                  VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  cubeSrcStage, cubeSrcAccess);
-
-        VkPipelineStageFlags2 lutSrcStage = 0;
-        VkAccessFlags2 lutSrcAccess = 0;
-        chooseSrc(module->atmLUTImage_->imageLayout(),
-                  VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                  VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                  lutSrcStage, lutSrcAccess);
-        worldCommandBuffer->barriersBufferImage(
-            {}, {{
-                     .srcStageMask = cubeSrcStage,
-                     .srcAccessMask = cubeSrcAccess,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                     .oldLayout = atmCubeMapImage->imageLayout(),
-                     .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-                     .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = atmCubeMapImage,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 },
-                 {
-                     .srcStageMask = lutSrcStage,
-                     .srcAccessMask = lutSrcAccess,
-                     .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                     .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                     .oldLayout = module->atmLUTImage_->imageLayout(),
-                    .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                    .srcQueueFamilyIndex = mainQueueIndex,
-                     .dstQueueFamilyIndex = mainQueueIndex,
-                     .image = module->atmLUTImage_,
-                     .subresourceRange = vk::wholeColorSubresourceRange,
-                 }});
-        atmCubeMapImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        module->atmLUTImage_->imageLayout() = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-        for (int faceIndex = 0; faceIndex < 6; faceIndex++) {
+        barriers.use(atmLUTImage, {
+                                      .stageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+                                      .accessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                                      .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                  });
+        if (!faces.empty()) {
+            // blended faces read what they are drawn over
+            barriers.use(atmCubeMapImage, {
+                                              .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                              .accessMask = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+                                                            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                                              .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                          });
+        }
+        barriers.flush();
+
+        for (auto &face : faces) {
+            bool blend = face.blend < 1.0f;
             worldCommandBuffer->beginRenderPass({
-                .renderPass = module->atmCubeMapRenderPass_,
-                .framebuffer = atmCubeMapFramebuffer[faceIndex],
+                .renderPass = blend ? module->atmCubeMapBlendRenderPass_ : module->atmCubeMapRenderPass_,
+                .framebuffer = atmCubeMapFramebuffer[face.face],
                 .renderAreaExtent = {atmCubeMapImage->width(), atmCubeMapImage->height()},
                 .clearValues = {},
             });
             atmCubeMapImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-            worldCommandBuffer->bindGraphicsPipeline(module->atmCubeMapPipeline_)
+            auto pipeline = blend ? module->atmCubeMapBlendPipeline_ : module->atmCubeMapPipeline_;
+            worldCommandBuffer->bindGraphicsPipeline(pipeline)
                 ->bindDescriptorTable(atmDescriptorTable, VK_PIPELINE_BIND_POINT_GRAPHICS);
 
-            int pushConst = faceIndex;
+            SkyCubePushConstant pushConst = {
+                .face = static_cast<int>(face.face),
+                .blend = face.blend,
+            };
             vkCmdPushConstants(worldCommandBuffer->vkCommandBuffer(), atmDescriptorTable->vkPipelineLayout(),
-                               VK_SHADER_STAGE_ALL, 0, sizeof(int), &pushConst);
+                               VK_SHADER_STAGE_ALL, 0, sizeof(SkyCubePushConstant), &pushConst);
 
             worldCommandBuffer->draw(3, 1)->endRenderPass();
             atmCubeMapImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
         }
     }
+
+    if (!faces.empty() && module->atmCubeMapMipLevels_ > 1) generateCubeMapMips();
+}
+
+void AtmosphereContext::generateCubeMapMips() {
+    auto frameworkContextPtr = frameworkContext.lock();
+    auto worldCommandBuffer = frameworkContextPtr->worldCommandBuffer;
+    auto mainQueueIndex = frameworkContextPtr->physicalDevice->mainQueueIndex();
+    auto module = atmosphere.lock();
+
+    auto levelBarrier = [&](uint32_t level, VkPipelineStageFlags2 srcStage, VkImageLayout oldLayout,
+                            VkImageLayout newLayout) -> vk::CommandBuffer::ImageMemoryBarrier {
+        return {
+            .srcStageMask = srcStage,
+            .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+            .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+            .oldLayout = oldLayout,
+            .newLayout = newLayout,
+            .srcQueueFamilyIndex = mainQueueIndex,
+            .dstQueueFamilyIndex = mainQueueIndex,
+            .image = atmCubeMapImage,
+            .subresourceRange =
+                {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = level,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 6,
+                },
+        };
+    };
+
+    // every level is a color attachment here, each one is blitted from the one above it in turn
+    uint32_t levels = module->atmCubeMapMipLevels_;
+    int32_t size = static_cast<int32_t>(atmCubeMapImage->width());
+    for (uint32_t level = 1; level < levels; level++) {
+        worldCommandBuffer->barriersBufferImage(
+            {}, {levelBarrier(level - 1,
+                              level == 1 ? VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+                                         : VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                              level == 1 ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+                                         : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
+                 levelBarrier(level, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                              VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)});
+
+        int32_t srcSize = std::max(size >> (level - 1), 1), dstSize = std::max(size >> level, 1);
+        VkImageBlit blit = {
+            .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 6},
+            .srcOffsets = {{0, 0, 0}, {srcSize, srcSize, 1}},
+            .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 6},
+            .dstOffsets = {{0, 0, 0}, {dstSize, dstSize, 1}},
+        };
+        vkCmdBlitImage(worldCommandBuffer->vkCommandBuffer(), atmCubeMapImage->vkImage(),
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, atmCubeMapImage->vkImage(),
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+    }
+
+    // leave the whole image in one layout, the ray tracing module moves it on to shader read
+    worldCommandBuffer->barriersBufferImage(
+        {}, {levelBarrier(levels - 1, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)});
+    atmCubeMapImage->imageLayout() = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 }
@@ -35,9 +35,30 @@ class Atmosphere : public SharedObject<Atmosphere> {
     void initAtmLUTPipeline();
     void initAtmCubeMapPipeline();
 
+    // what skycube.frag renders a face from
+    struct SkyCubeInputs {
+        vk::Data::SkyUBO sky;
+        float cameraHeight;
+    };
+
+    struct SkyCubeFace {
+        uint32_t face;
+        float blend; // 1 replaces the face, below blends the new sky over it
+    };
+
+    // faces whose sky has moved on since they were rendered or that a blend left short of it, all of them at once
+    // after a jump (teleport, time set, dimension change), otherwise Options::skyFacesPerFrame in turn
+    std::vector<SkyCubeFace> selectCubeFaces(const SkyCubeInputs &current);
+
   private:
     bool lutRendered_ = false;
 
+    std::array<SkyCubeInputs, 6> cubeFaceInputs_;
+    std::array<bool, 6> cubeFaceRendered_{};
+    // share of each face still showing skies older than cubeFaceInputs_, left over from blending
+    std::array<float, 6> cubeFaceResidual_{};
+    uint32_t nextCubeFace_ = 0;
+
     std::weak_ptr<Framework> framework_;
     std::weak_ptr<RayTracingModule> rayTracingModule_;
 
@@ -53,11 +74,15 @@ class Atmosphere : public SharedObject<Atmosphere> {
 
     std::shared_ptr<vk::Shader> atmCubeMapVertShader_;
     std::shared_ptr<vk::Shader> atmCubeMapFragShader_;
-    std::vector<std::shared_ptr<vk::DeviceLocalImage>> atmCubeMapImages_;
-    std::vector<std::shared_ptr<vk::Sampler>> atmCubeMapImageSamplers_;
+    // one cube shared by every frame in flight, it only changes with the sky
+    std::shared_ptr<vk::DeviceLocalImage> atmCubeMapImage_;
+    uint32_t atmCubeMapMipLevels_ = 1;
+    std::shared_ptr<vk::Sampler> atmCubeMapImageSampler_;
     std::shared_ptr<vk::RenderPass> atmCubeMapRenderPass_;
-    std::vector<std::array<std::shared_ptr<vk::Framebuffer>, 6>> atmCubeMapFramebuffers_;
+    std::shared_ptr<vk::RenderPass> atmCubeMapBlendRenderPass_;
+    std::array<std::shared_ptr<vk::Framebuffer>, 6> atmCubeMapFramebuffers_;
     std::shared_ptr<vk::GraphicsPipeline> atmCubeMapPipeline_;
+    std::shared_ptr<vk::GraphicsPipeline> atmCubeMapBlendPipeline_;
 
     std::vector<std::shared_ptr<AtmosphereContext>> contexts_;
 };
@@ -78,4 +103,7 @@ struct AtmosphereContext : public SharedObject<AtmosphereContext> {
     AtmosphereContext(std::shared_ptr<FrameworkContext> frameworkContext, std::shared_ptr<Atmosphere> atmosphere);
 
     void render();
+
+  private:
+    void generateCubeMapMips();
 };
\ No newline at end of file
@@ -5,14 +5,15 @@
 #include "core/render/entities.hpp"
 #include "core/render/lights.hpp"
 #include "core/render/modules/world/ray_tracing/ray_tracing_module.hpp"
+#include "core/render/profiler.hpp"
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 #include "core/render/world.hpp"
 
-#include <algorithm>
-#include <cstring>
 #include <filesystem>
 #include <glm/gtc/type_ptr.hpp>
+#include <limits>
+#include <unordered_map>
 
 WorldPrepare::WorldPrepare() {}
 
@@ -30,7 +31,40 @@ void WorldPrepare::build() {
 
     for (int i = 0; i < size; i++) {
         contexts_[i] = WorldPrepareContext::create(framework->contexts()[i], shared_from_this());
+        contexts_[i]->lightSelectDescriptorTable = createLightSelectDescriptorTable();
     }
+
+    std::filesystem::path shaderPath = Renderer::folderPath / "shaders";
+    lightSelectShader_ =
+        vk::Shader::create(framework->device(), (shaderPath / "world/ray_tracing/light_select_comp.spv").string());
+    lightSelectPipeline_ = vk::ComputePipelineBuilder{}
+                               .defineShader(lightSelectShader_)
+                               .definePipelineLayout(contexts_[0]->lightSelectDescriptorTable)
+                               .build(framework->device());
+}
+
+std::shared_ptr<vk::DescriptorTable> WorldPrepare::createLightSelectDescriptorTable() {
+    auto framework = framework_.lock();
+
+    vk::DescriptorTableBuilder builder;
+    auto &bindings = builder.beginDescriptorLayoutSet().beginDescriptorLayoutSetBinding();
+    // light records, chunk packed data, light types, select state, selected lights
+    for (uint32_t binding = 0; binding < 5; binding++) {
+        bindings.defineDescriptorLayoutSetBinding({
+            .binding = binding,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        });
+    }
+    return bindings.endDescriptorLayoutSetBinding()
+        .endDescriptorLayoutSet()
+        .definePushConstant(VkPushConstantRange{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(AreaLightSelectPushConstant),
+        })
+        .build(framework->device());
 }
 
 WorldPrepareContext::WorldPrepareContext(std::shared_ptr<FrameworkContext> frameworkContext,
@@ -42,7 +76,9 @@ void WorldPrepareContext::uploadBuffer(std::vector<uint32_t> &blasOffsets,
                                        std::vector<uint64_t> &indexBufferAddrs,
                                        std::vector<uint64_t> &lastVertexBufferAddrs,
                                        std::vector<uint64_t> &lastIndexBufferAddrs,
-                                       std::vector<glm::mat4> &lastObjToWorldMats) {
+                                       std::vector<glm::mat4> &lastObjToWorldMats,
+                                       std::vector<uint64_t> &quadRemapAddrs,
+                                       std::vector<glm::vec4> &geometryOrigins) {
     auto context = frameworkContext.lock();
     auto framework = context->framework.lock();
     auto vma = framework->vma();
@@ -87,6 +123,16 @@ void WorldPrepareContext::uploadBuffer(std::vector<uint32_t> &blasOffsets,
             VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
     lastObjToWorldMat->uploadToStagingBuffer(lastObjToWorldMats.data());
 
+    quadRemapAddr = vk::DeviceLocalBuffer::create(
+        vma, device, quadRemapAddrs.size() * sizeof(uint64_t),
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    quadRemapAddr->uploadToStagingBuffer(quadRemapAddrs.data());
+
+    geometryOriginBuffer = vk::DeviceLocalBuffer::create(
+        vma, device, geometryOrigins.size() * sizeof(glm::vec4),
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    geometryOriginBuffer->uploadToStagingBuffer(geometryOrigins.data());
+
     std::vector<std::shared_ptr<vk::DeviceLocalBuffer>> rayTracingMetaData{{
         blasOffsetsBuffer,
         vertexBufferAddr,
@@ -94,7 +140,8 @@ void WorldPrepareContext::uploadBuffer(std::vector<uint32_t> &blasOffsets,
         lastVertexBufferAddr,
         lastIndexBufferAddr,
         lastObjToWorldMat,
-        areaLightBuffer,
+        quadRemapAddr,
+        geometryOriginBuffer,
     }};
 
     std::vector<vk::CommandBuffer::BufferMemoryBarrier> uploadPreBufferBarriers, uploadPostBufferBarriers;
@@ -132,6 +179,8 @@ void WorldPrepareContext::uploadBuffer(std::vector<uint32_t> &blasOffsets,
 }
 
 void WorldPrepareContext::render() {
+    ProfilerCpuScope profilerScope("WorldPrepareContext::render");
+
     auto module = worldPrepare.lock();
 
     std::shared_ptr<Framework> framework = Renderer::instance().framework();
@@ -152,6 +201,8 @@ void WorldPrepareContext::render() {
         chunks->chunkBuildScheduler()->tryScheduleBatches(
             Renderer::instance().world()->chunks()->chunkBuildScheduler()->chunkBuildingBatchSize());
     }
+    chunks->updateLods(cameraPos);
+    chunks->updateRegions(cameraPos);
 
     if (chunks->importantBLASBuilders().size() > 0) {
         vk::BLASBuilder::batchSubmit(chunks->importantBLASBuilders(), worldCommandBuffer);
@@ -173,11 +224,135 @@ void WorldPrepareContext::render() {
     std::vector<uint64_t> vertexBufferAddrs, indexBufferAddrs;
     std::vector<uint64_t> lastVertexBufferAddrs, lastIndexBufferAddrs;
     std::vector<glm::mat4> lastObjToWorldMats;
+    std::vector<uint64_t> quadRemapAddrs;   // 0 where the BLAS holds the shaded triangles themselves
+    std::vector<glm::vec4> geometryOrigins; // where a region BLAS placed the geometry, 0 for everything else
+
+    auto worldUniformBuffer = Renderer::instance().buffers()->worldUniformBuffer();
+    auto ubo = static_cast<vk::Data::WorldUBO *>(worldUniformBuffer->mappedPtr());
+
+    // the ray through the screen center, zero (no behind-camera culling) without a camera yet
+    glm::vec3 viewDir(0.0f);
+    if (ubo) {
+        glm::vec4 viewCenter = ubo->cameraProjMatInv * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        glm::vec3 dir = glm::mat3(ubo->cameraViewMatInv) * (glm::vec3(viewCenter) / viewCenter.w);
+        if (glm::length(dir) > 0.0f) viewDir = glm::normalize(dir);
+    }
 
     tlasBuilder = vk::TLASBuilder::create();
     auto &instanceBuilder = tlasBuilder->beginInstanceBuilder();
     int blasIndex = 0;
 
+    // Chunk, first and in chunk order so their instance indices do not move with the entity count
+    {
+        auto &chunk1s = chunks->chunks();
+        // sections of a built region are traced through its instance, which goes after the sections on their own
+        std::vector<std::pair<std::shared_ptr<ChunkRegion>, uint32_t>> selectedRegions;
+        std::unordered_map<ChunkRegion *, size_t> selectedRegionSlots;
+
+        for (auto &selected : selectChunkInstances(chunk1s, cameraPos, viewDir)) {
+            auto &chunk1 = chunk1s[selected.index];
+
+            if (auto region = chunks->chunkRegion(selected.index)) {
+                // a region is as visible as its most visible selected section
+                auto [slot, inserted] = selectedRegionSlots.try_emplace(region.get(), selectedRegions.size());
+                if (inserted) {
+                    selectedRegions.push_back({region, selected.mask});
+                } else if (selected.mask == WORLD_MASK) {
+                    selectedRegions[slot->second].second = WORLD_MASK;
+                }
+                continue;
+            }
+
+            // far sections trace their proxy, Chunks::updateLods decides which
+            bool lod = chunk1->lodActive;
+            auto &blas = lod ? chunk1->lodBlas : chunk1->blas;
+            uint32_t geometryCount = lod ? chunk1->lodGeometryCount : chunk1->geometryCount;
+            auto &chunkGeometryTypes = lod ? chunk1->lodGeometryTypes : chunk1->geometryTypes;
+            auto &chunkVertexBuffers = lod ? chunk1->lodVertexBuffers : chunk1->vertexBuffers;
+            auto &chunkIndexBuffers = lod ? chunk1->lodIndexBuffers : chunk1->indexBuffers;
+            auto chunkQuadRemapBuffers = lod ? nullptr : chunk1->quadRemapBuffers;
+
+            VkTransformMatrixKHR transform = {
+                1, 0, 0, static_cast<float>(static_cast<double>(chunk1->x) - cameraPos.x), //
+                0, 1, 0, static_cast<float>(static_cast<double>(chunk1->y) - cameraPos.y), //
+                0, 0, 1, static_cast<float>(static_cast<double>(chunk1->z) - cameraPos.z), //
+            };
+
+            instanceBuilder.defineInstance(transform, blasIndex, selected.mask, blasGroupAccu, 0, blas);
+
+            geometryTypes.push_back(World::GeometryTypes::SHADOW);
+            geometryTypes.insert(geometryTypes.end(), chunkGeometryTypes->begin(), chunkGeometryTypes->end());
+
+            for (int j = 0; j < geometryCount; j++) {
+                vertexBufferAddrs.push_back((*chunkVertexBuffers)[j]->bufferAddress());
+                indexBufferAddrs.push_back((*chunkIndexBuffers)[j]->bufferAddress());
+                lastVertexBufferAddrs.push_back(0);
+                lastIndexBufferAddrs.push_back(0);
+
+                bool merged = chunkQuadRemapBuffers != nullptr && (*chunkQuadRemapBuffers)[j] != nullptr;
+                quadRemapAddrs.push_back(merged ? (*chunkQuadRemapBuffers)[j]->bufferAddress() : 0);
+                geometryOrigins.push_back(glm::vec4(0.0f));
+            }
+
+            // read (fake, since chunk is not moving) previous render data
+            {
+                glm::mat4 lastObjToWorldMat = glm::transpose(glm::mat4(
+                    glm::vec4(1.0f, 0.0f, 0.0f, static_cast<float>(static_cast<double>(chunk1->x) - cameraPos.x)), //
+                    glm::vec4(0.0f, 1.0f, 0.0f, static_cast<float>(static_cast<double>(chunk1->y) - cameraPos.y)), //
+                    glm::vec4(0.0f, 0.0f, 1.0f, static_cast<float>(static_cast<double>(chunk1->z) - cameraPos.z)), //
+                    glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+                lastObjToWorldMats.push_back(lastObjToWorldMat);
+            }
+
+            blasOffset.push_back(blasAccu);
+            blasAccu += geometryCount;
+            blasGroupAccu += geometryCount + 1; // shadow
+
+            blasIndex++;
+        }
+
+        for (auto &[region, mask] : selectedRegions) {
+            glm::vec3 origin = glm::vec3(glm::dvec3(region->origin) - cameraPos);
+            VkTransformMatrixKHR transform = {
+                1, 0, 0, origin.x, //
+                0, 1, 0, origin.y, //
+                0, 0, 1, origin.z, //
+            };
+
+            instanceBuilder.defineInstance(transform, blasIndex, mask, blasGroupAccu, 0, region->blas);
+
+            // the vertex buffers stay section local, the hit shaders add the origin of the section in the region
+            uint32_t geometryCount = 0;
+            geometryTypes.push_back(World::GeometryTypes::SHADOW);
+            for (auto &member : region->members) {
+                geometryTypes.insert(geometryTypes.end(), member.geometryTypes->begin(), member.geometryTypes->end());
+
+                for (int j = 0; j < member.geometryCount; j++) {
+                    vertexBufferAddrs.push_back((*member.vertexBuffers)[j]->bufferAddress());
+                    indexBufferAddrs.push_back((*member.indexBuffers)[j]->bufferAddress());
+                    lastVertexBufferAddrs.push_back(0);
+                    lastIndexBufferAddrs.push_back(0);
+
+                    bool merged = member.quadRemapBuffers != nullptr && (*member.quadRemapBuffers)[j] != nullptr;
+                    quadRemapAddrs.push_back(merged ? (*member.quadRemapBuffers)[j]->bufferAddress() : 0);
+                    geometryOrigins.push_back(glm::vec4(glm::vec3(member.offset), 0.0f));
+                }
+                geometryCount += member.geometryCount;
+            }
+
+            lastObjToWorldMats.push_back(glm::transpose(glm::mat4(glm::vec4(1.0f, 0.0f, 0.0f, origin.x), //
+                                                                  glm::vec4(0.0f, 1.0f, 0.0f, origin.y), //
+                                                                  glm::vec4(0.0f, 0.0f, 1.0f, origin.z), //
+                                                                  glm::vec4(0.0f, 0.0f, 0.0f, 1.0f))));
+
+            blasOffset.push_back(blasAccu);
+            blasAccu += geometryCount;
+            blasGroupAccu += geometryCount + 1; // shadow
+
+            blasIndex++;
+        }
+    }
+
     // Entity
     {
         auto entityBatch = entities->entityBatch();
@@ -194,9 +369,6 @@ void WorldPrepareContext::render() {
             std::map<int, std::pair<std::shared_ptr<Entity>, VkTransformMatrixKHR>> &currentEntityRenderDataBatch =
                 previousEntityRenderDataBatches.emplace();
 
-            auto worldUniformBuffer = Renderer::instance().buffers()->worldUniformBuffer();
-            auto ubo = static_cast<vk::Data::WorldUBO *>(worldUniformBuffer->mappedPtr());
-
             auto &entities1 = entityBatch->entities;
             for (int i = 0; i < entities1.size(); i++) {
                 VkGeometryInstanceFlagsKHR flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
@@ -227,7 +399,9 @@ void WorldPrepareContext::render() {
                         };
                     }
 
-                    instanceBuilder.defineInstance(transform, blasIndex, entities1[i]->rtFlag, blasGroupAccu, flags,
+                    uint32_t mask = entities1[i]->rtFlag;
+                    if (mask & JAVA_WEATHER_FLAG) mask = (mask & ~JAVA_WEATHER_FLAG) | WEATHER_MASK;
+                    instanceBuilder.defineInstance(transform, blasIndex, mask, blasGroupAccu, flags,
                                                    entities1[i]->blas);
                 } else {
                     // auto &prebuiltBLAS =
@@ -247,6 +421,8 @@ void WorldPrepareContext::render() {
                 for (int j = 0; j < entities1[i]->geometryCount; j++) {
                     vertexBufferAddrs.push_back((*entities1[i]->vertexBufferAddresses)[j]);
                     indexBufferAddrs.push_back((*entities1[i]->indexBufferAddresses)[j]);
+                    quadRemapAddrs.push_back(0);
+                    geometryOrigins.push_back(glm::vec4(0.0f));
                 }
 
                 // store current render data
@@ -265,10 +441,8 @@ void WorldPrepareContext::render() {
                         auto &previousEntityRenderData = (*iter).second.first;
                         if (previousEntityRenderData->geometryCount == entities1[i]->geometryCount) {
                             for (int j = 0; j < entities1[i]->geometryCount; j++) {
-                                if ((*previousEntityRenderData->vertices)[j].size() ==
-                                        (*entities1[i]->vertices)[j].size() &&
-                                    (*previousEntityRenderData->indices)[j].size() ==
-                                        (*entities1[i]->indices)[j].size()) {
+                                if (previousEntityRenderData->vertexCounts[j] == entities1[i]->vertexCounts[j] &&
+                                    previousEntityRenderData->indexCounts[j] == entities1[i]->indexCounts[j]) {
                                     lastVertexBufferAddrs.push_back(
                                         (*previousEntityRenderData->vertexBufferAddresses)[j]);
                                     lastIndexBufferAddrs.push_back(
@@ -308,159 +482,12 @@ void WorldPrepareContext::render() {
         }
     }
 
-    // Chunk
-    {
-        auto &chunk1s = chunks->chunks();
-        for (int i = 0; i < chunk1s.size(); i++) {
-            auto &chunk1 = chunk1s[i];
-            if (chunk1->blas == nullptr) continue;
-
-            VkTransformMatrixKHR transform = {
-                1, 0, 0, static_cast<float>(static_cast<double>(chunk1->x) - cameraPos.x), //
-                0, 1, 0, static_cast<float>(static_cast<double>(chunk1->y) - cameraPos.y), //
-                0, 0, 1, static_cast<float>(static_cast<double>(chunk1->z) - cameraPos.z), //
-            };
-
-            instanceBuilder.defineInstance(transform, blasIndex, 0x01, blasGroupAccu, 0, chunk1->blas);
-
-            geometryTypes.push_back(World::GeometryTypes::SHADOW);
-            geometryTypes.insert(geometryTypes.end(), chunk1->geometryTypes->begin(), chunk1->geometryTypes->end());
-
-            for (int j = 0; j < chunk1->geometryCount; j++) {
-                vertexBufferAddrs.push_back((*chunk1->vertexBuffers)[j]->bufferAddress());
-                indexBufferAddrs.push_back((*chunk1->indexBuffers)[j]->bufferAddress());
-                lastVertexBufferAddrs.push_back(0);
-                lastIndexBufferAddrs.push_back(0);
-            }
-
-            // read (fake, since chunk is not moving) previous render data
-            {
-                glm::mat4 lastObjToWorldMat = glm::transpose(glm::mat4(
-                    glm::vec4(1.0f, 0.0f, 0.0f, static_cast<float>(static_cast<double>(chunk1->x) - cameraPos.x)), //
-                    glm::vec4(0.0f, 1.0f, 0.0f, static_cast<float>(static_cast<double>(chunk1->y) - cameraPos.y)), //
-                    glm::vec4(0.0f, 0.0f, 1.0f, static_cast<float>(static_cast<double>(chunk1->z) - cameraPos.z)), //
-                    glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
-                lastObjToWorldMats.push_back(lastObjToWorldMat);
-            }
-
-            blasOffset.push_back(blasAccu);
-            blasAccu += chunk1->geometryCount;
-            blasGroupAccu += chunk1->geometryCount + 1; // shadow
-
-            blasIndex++;
-        }
-    }
-
-    // Area light gathering: collect from loaded chunks, cull by vertical range + distance
+    // Area lights: only the records of chunks whose lights changed are uploaded, the selection runs on the GPU
     // NOTE: No frustum culling — lights behind the camera still contribute via bounced
     // illumination and removing them causes visible pop-in when rotating the camera.
     // Vertical culling is safe because deep underground lights are behind solid rock.
-    {
-        constexpr int MAX_AREA_LIGHTS = 512;
-        constexpr float VERTICAL_CULL_BELOW = 48.0f; // skip lights more than N blocks below camera
-        struct LightWithDist {
-            vk::Data::AreaLight light;
-            float dist2;
-            float contribution; // effectiveIntensity / max(dist2, 1.0)
-        };
-        std::vector<LightWithDist> gatheredLights;
-
-        auto &chunk1s = chunks->chunks();
-        for (int i = 0; i < chunk1s.size(); i++) {
-            auto &chunk1 = chunk1s[i];
-            if (chunk1->blas == nullptr) continue;
-            if (chunk1->lightSources.empty()) continue;
-
-            // Chunk-level vertical early out: skip entire chunk if too far below camera
-            float chunkTopY = static_cast<float>(static_cast<double>(chunk1->y) + 16.0 - cameraPos.y);
-            if (-chunkTopY > VERTICAL_CULL_BELOW) continue;
-
-            for (auto &src : chunk1->lightSources) {
-                if (src.lightTypeId < 0 || src.lightTypeId >= LIGHT_TYPE_COUNT) continue;
-                auto &def = LIGHT_DEFS[src.lightTypeId];
-
-                // Camera-relative position
-                float rx = static_cast<float>(static_cast<double>(src.worldX) - cameraPos.x);
-                float ry = static_cast<float>(static_cast<double>(src.worldY) - cameraPos.y);
-                float rz = static_cast<float>(static_cast<double>(src.worldZ) - cameraPos.z);
-
-                // Per-light vertical cull: skip lights too far below camera (sealed caves)
-                if (-ry > VERTICAL_CULL_BELOW) continue;
-
-                float d2 = rx * rx + ry * ry + rz * rz;
-
-                float perBlock = Renderer::options.perBlockIntensity[src.lightTypeId];
-                if (perBlock < 0.001f) continue;  // Skip disabled lights
-
-                // CPU-side distance cull: skip lights beyond their defined radius
-                float effectiveIntensity = def.intensity * Renderer::options.areaLightIntensity * perBlock;
-                float maxRange = Renderer::options.areaLightRange;
-                if (d2 > maxRange * maxRange) continue;
-
-                float contribution = effectiveIntensity / std::max(d2, 1.0f);
-
-                vk::Data::AreaLight al{};
-                auto &opts = Renderer::options;
-                int tid = src.lightTypeId;
-                al.position = glm::vec3(rx, ry + def.yOffset + opts.perBlockYOffset[tid], rz);
-                al.halfExtent = def.halfExtent * opts.perBlockScale[tid];
-                al.color = glm::vec3(
-                    opts.perBlockColorR[tid] >= 0 ? opts.perBlockColorR[tid] : def.color.r,
-                    opts.perBlockColorG[tid] >= 0 ? opts.perBlockColorG[tid] : def.color.g,
-                    opts.perBlockColorB[tid] >= 0 ? opts.perBlockColorB[tid] : def.color.b);
-                al.intensity = effectiveIntensity;
-                al.radius = maxRange;
-
-                // Stable ID for cross-frame light tracking (ReSTIR DI)
-                uint32_t bx = static_cast<uint32_t>(static_cast<int>(src.worldX)) & 0xFFFF;
-                uint32_t by = static_cast<uint32_t>(static_cast<int>(src.worldY)) & 0xFFFF;
-                uint32_t bz = static_cast<uint32_t>(static_cast<int>(src.worldZ)) & 0xFFFF;
-                uint32_t stableId = (bx | (by << 16)) ^ (bz * 2654435761u);
-                std::memcpy(&al._unused.x, &stableId, sizeof(float));
-                al._unused.y = LIGHT_DEFS[src.lightTypeId].flickerStrength;
-
-                gatheredLights.push_back({al, d2, contribution});
-            }
-        }
-
-        // Sort by contribution (brightest/nearest first)
-        std::sort(gatheredLights.begin(), gatheredLights.end(),
-                  [](const LightWithDist &a, const LightWithDist &b) { return a.contribution > b.contribution; });
-
-        // Clamp to max
-        if (gatheredLights.size() > MAX_AREA_LIGHTS) {
-            gatheredLights.resize(MAX_AREA_LIGHTS);
-        }
-
-        // Compute per-light effective radius based on intensity
-        for (auto &lwd : gatheredLights) {
-            float maxR = Renderer::options.areaLightRange;
-            float effectiveRadius = std::min(maxR, std::sqrt(lwd.light.intensity / 0.001f));
-            lwd.light.radius = std::max(effectiveRadius, 4.0f);
-        }
-
-        areaLightCount = static_cast<int>(gatheredLights.size());
-
-        if (areaLightCount > 0) {
-            std::vector<vk::Data::AreaLight> lightData;
-            lightData.reserve(areaLightCount);
-            for (auto &lwd : gatheredLights) {
-                lightData.push_back(lwd.light);
-            }
-
-            areaLightBuffer = vk::DeviceLocalBuffer::create(
-                vma, device, lightData.size() * sizeof(vk::Data::AreaLight),
-                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-            areaLightBuffer->uploadToStagingBuffer(lightData.data());
-        } else {
-            // Ensure a valid buffer exists even with 0 lights (for descriptor binding)
-            vk::Data::AreaLight dummy{};
-            areaLightBuffer = vk::DeviceLocalBuffer::create(
-                vma, device, sizeof(vk::Data::AreaLight),
-                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-            areaLightBuffer->uploadToStagingBuffer(&dummy);
-        }
-    }
+    chunks->uploadLights(worldCommandBuffer);
+    selectAreaLights(cameraPos);
 
     if (instanceBuilder.instances.empty()) {
         tlas = nullptr;
@@ -483,5 +510,213 @@ void WorldPrepareContext::render() {
     rayTracingModuleContext.lock()->sbt->setupHitSBT(geometryTypes);
 
     uploadBuffer(blasOffset, vertexBufferAddrs, indexBufferAddrs, lastVertexBufferAddrs, lastIndexBufferAddrs,
-                 lastObjToWorldMats);
-}
\ No newline at end of file
+                 lastObjToWorldMats, quadRemapAddrs, geometryOrigins);
+}
+
+std::vector<WorldPrepareContext::ChunkInstance>
+WorldPrepareContext::selectChunkInstances(const std::vector<std::shared_ptr<Chunk1>> &chunks,
+                                          glm::dvec3 cameraPos,
+                                          glm::vec3 viewDir) {
+    constexpr float CHUNK_SIZE = 16.0f;
+    constexpr int REGION_SHIFT = 6; // regions are columns of 4x4 chunks
+
+    auto &options = Renderer::options;
+    float cullRadius = options.tlasCullRadius * CHUNK_SIZE;
+    float shellRadius = options.tlasShellRadius * CHUNK_SIZE;
+    float farMaskDistance = options.tlasFarMaskDistance * CHUNK_SIZE;
+    bool cullBehind = options.tlasCullBehindCamera && glm::length(viewDir) > 0.0f;
+
+    enum class Verdict { KEEP, CULL, SPLIT };
+
+    // boxes are camera relative, SPLIT when the box straddles a boundary and its parts have to be tested one by one
+    auto classify = [&](glm::vec3 lo, glm::vec3 hi) {
+        float nearest = glm::length(glm::clamp(glm::vec3(0.0f), lo, hi));
+        float farthest = glm::length(glm::max(glm::abs(lo), glm::abs(hi)));
+        if (cullRadius > 0.0f && nearest > cullRadius) return Verdict::CULL;
+        if (farthest <= shellRadius) return Verdict::KEEP;
+
+        bool inRadius = cullRadius <= 0.0f || farthest <= cullRadius;
+        if (!cullBehind) return inRadius ? Verdict::KEEP : Verdict::SPLIT;
+
+        glm::vec3 center = (lo + hi) * 0.5f;
+        float reach = glm::dot((hi - lo) * 0.5f, glm::abs(viewDir));
+        float depth = glm::dot(center, viewDir);
+        if (depth + reach < 0.0f && nearest > shellRadius) return Verdict::CULL;
+        return inRadius && depth - reach >= 0.0f ? Verdict::KEEP : Verdict::SPLIT;
+    };
+
+    auto sectionBounds = [&](const Chunk1 &chunk1, glm::vec3 &lo, glm::vec3 &hi) {
+        lo = glm::vec3(glm::dvec3(chunk1.x, chunk1.y, chunk1.z) - cameraPos);
+        hi = lo + CHUNK_SIZE;
+    };
+    auto regionKey = [](const Chunk1 &chunk1) {
+        return (static_cast<int64_t>(chunk1.x >> REGION_SHIFT) << 32) ^
+               static_cast<uint32_t>(chunk1.z >> REGION_SHIFT);
+    };
+
+    struct Region {
+        glm::vec3 lo = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 hi = glm::vec3(-std::numeric_limits<float>::max());
+        Verdict verdict = Verdict::SPLIT;
+    };
+    std::unordered_map<int64_t, Region> regions;
+
+    bool culling = cullRadius > 0.0f || cullBehind;
+    if (culling) {
+        for (auto &chunk1 : chunks) {
+            if (chunk1->blas == nullptr) continue;
+            glm::vec3 lo, hi;
+            sectionBounds(*chunk1, lo, hi);
+            Region &region = regions[regionKey(*chunk1)];
+            region.lo = glm::min(region.lo, lo);
+            region.hi = glm::max(region.hi, hi);
+        }
+        for (auto &[key, region] : regions) region.verdict = classify(region.lo, region.hi);
+    }
+
+    std::vector<ChunkInstance> selected;
+    for (uint32_t i = 0; i < chunks.size(); i++) {
+        auto &chunk1 = chunks[i];
+        if (chunk1->blas == nullptr) continue;
+
+        glm::vec3 lo, hi;
+        sectionBounds(*chunk1, lo, hi);
+        if (culling) {
+            Verdict verdict = regions[regionKey(*chunk1)].verdict;
+            // a section straddling a boundary is kept, the shell and radius are conservative already
+            if (verdict == Verdict::SPLIT) verdict = classify(lo, hi);
+            if (verdict == Verdict::CULL) continue;
+        }
+
+        uint32_t mask = WORLD_MASK;
+        if (farMaskDistance > 0.0f && glm::length(glm::clamp(glm::vec3(0.0f), lo, hi)) > farMaskDistance) {
+            mask = FAR_WORLD_MASK;
+        }
+        selected.push_back({i, mask});
+    }
+    return selected;
+}
+
+void WorldPrepareContext::selectAreaLights(glm::dvec3 cameraPos) {
+    auto module = worldPrepare.lock();
+    auto context = frameworkContext.lock();
+    auto framework = context->framework.lock();
+    auto vma = framework->vma();
+    auto device = framework->device();
+    auto &gc = framework->gc();
+    auto worldCommandBuffer = context->worldCommandBuffer;
+    VkCommandBuffer cmd = worldCommandBuffer->vkCommandBuffer();
+    auto chunks = Renderer::instance().world()->chunks();
+    auto &options = Renderer::options;
+
+    if (areaLightBuffer == nullptr) {
+        areaLightBuffer = vk::DeviceLocalBuffer::create(
+            vma, device, false, AREA_LIGHT_LIST_OFFSET + MAX_AREA_LIGHTS * sizeof(vk::Data::AreaLight),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        lightTypeBuffer = vk::HostVisibleBuffer::create(
+            vma, device, LIGHT_TYPE_COUNT * sizeof(vk::Data::AreaLightType), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    }
+
+    vk::BarrierTracker barriers(worldCommandBuffer, framework->physicalDevice()->mainQueueIndex());
+    constexpr vk::ResourceAccess selectAccess = {
+        .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    };
+    // ray tracing and the (disabled) light clustering read the selected lights
+    constexpr vk::ResourceAccess lightReadAccess = {
+        .stageMask = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+    };
+
+    uint32_t recordCount = chunks->lightRecordCount();
+    if (!options.areaLightsEnabled || recordCount == 0) {
+        barriers
+            .use(areaLightBuffer, {
+                                      .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                      .accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                  })
+            .flush();
+        vkCmdFillBuffer(cmd, areaLightBuffer->vkBuffer(), 0, sizeof(int32_t), 0);
+        barriers.use(areaLightBuffer, lightReadAccess).flush();
+        return;
+    }
+
+    size_t selectSize = LIGHT_SELECT_KEYS_OFFSET + recordCount * sizeof(uint32_t);
+    if (lightSelectBuffer == nullptr || lightSelectBuffer->size() < selectSize) {
+        gc.collect(lightSelectBuffer);
+        // room for the records to grow a while before the next resize
+        lightSelectBuffer = vk::DeviceLocalBuffer::create(vma, device, false, selectSize + selectSize / 2,
+                                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    }
+
+    auto types = static_cast<vk::Data::AreaLightType *>(lightTypeBuffer->mappedPtr());
+    for (int tid = 0; tid < LIGHT_TYPE_COUNT; tid++) types[tid] = areaLightType(tid);
+    lightTypeBuffer->flush();
+
+    lightSelectDescriptorTable->bindBuffer(chunks->lightRecords(), 0, 0);
+    lightSelectDescriptorTable->bindBuffer(chunks->chunkPackedData(), 0, 1);
+    lightSelectDescriptorTable->bindBuffer(lightTypeBuffer, 0, 2);
+    lightSelectDescriptorTable->bindBuffer(lightSelectBuffer, 0, 3);
+    lightSelectDescriptorTable->bindBuffer(areaLightBuffer, 0, 4);
+
+    barriers
+        .use(lightSelectBuffer, {
+                                    .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                    .accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                })
+        .flush();
+    vkCmdFillBuffer(cmd, lightSelectBuffer->vkBuffer(), 0, LIGHT_SELECT_STATE_SIZE, 0);
+
+    worldCommandBuffer->bindDescriptorTable(lightSelectDescriptorTable, VK_PIPELINE_BIND_POINT_COMPUTE)
+        ->bindComputePipeline(module->lightSelectPipeline_);
+
+    glm::dvec3 cameraBlock = glm::floor(cameraPos);
+    AreaLightSelectPushConstant pc{
+        .cameraBlock = glm::ivec3(cameraBlock),
+        .cameraOffset = glm::vec3(cameraPos - cameraBlock),
+        .recordCount = recordCount,
+        .range = options.areaLightRange,
+        .verticalCullBelow = VERTICAL_CULL_BELOW,
+    };
+    uint32_t recordGroups = (recordCount + 255) / 256;
+
+    auto dispatch = [&](AreaLightSelectPhase phase, uint32_t digit, uint32_t groupCount) {
+        barriers.use(lightSelectBuffer, selectAccess);
+        if (phase == AreaLightSelectPhase::SORT) barriers.use(areaLightBuffer, selectAccess);
+        barriers.flush();
+
+        pc.phase = phase;
+        pc.digit = digit;
+        vkCmdPushConstants(cmd, lightSelectDescriptorTable->vkPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(AreaLightSelectPushConstant), &pc);
+        vkCmdDispatch(cmd, groupCount, 1, 1);
+    };
+
+    // radix select over the 4 bytes of the contribution keys, then the selected lights brightest first
+    dispatch(AreaLightSelectPhase::SCORE, 0, recordGroups);
+    for (uint32_t digit = 0; digit < 4; digit++) {
+        if (digit > 0) dispatch(AreaLightSelectPhase::HISTOGRAM, digit, recordGroups);
+        dispatch(AreaLightSelectPhase::SELECT, digit, 1);
+    }
+    dispatch(AreaLightSelectPhase::COMPACT, 0, recordGroups);
+    dispatch(AreaLightSelectPhase::SORT, 0, 1);
+
+    barriers.use(areaLightBuffer, lightReadAccess).flush();
+}
+
+vk::Data::AreaLightType WorldPrepareContext::areaLightType(int lightTypeId) {
+    auto &def = LIGHT_DEFS[lightTypeId];
+    auto &opts = Renderer::options;
+
+    float perBlock = opts.perBlockIntensity[lightTypeId];
+    return {
+        .color = glm::vec3(opts.perBlockColorR[lightTypeId] >= 0 ? opts.perBlockColorR[lightTypeId] : def.color.r,
+                           opts.perBlockColorG[lightTypeId] >= 0 ? opts.perBlockColorG[lightTypeId] : def.color.g,
+                           opts.perBlockColorB[lightTypeId] >= 0 ? opts.perBlockColorB[lightTypeId] : def.color.b),
+        // disabled below 0.001
+        .intensity = perBlock < 0.001f ? 0.0f : def.intensity * opts.areaLightIntensity * perBlock,
+        .halfExtent = def.halfExtent * opts.perBlockScale[lightTypeId],
+        .yOffset = def.yOffset + opts.perBlockYOffset[lightTypeId],
+        .flickerStrength = def.flickerStrength,
+    };
+}
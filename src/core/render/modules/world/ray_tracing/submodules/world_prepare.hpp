@@ -7,11 +7,31 @@
 
 class Framework;
 class FrameworkContext;
+struct Chunk1;
 class RayTracingModule;
 struct RayTracingModuleContext;
 
 struct WorldPrepareContext;
 
+// phases of world/ray_tracing/light_select.comp
+enum class AreaLightSelectPhase : uint32_t {
+    SCORE = 0,
+    SELECT = 1,
+    HISTOGRAM = 2,
+    COMPACT = 3,
+    SORT = 4,
+};
+
+struct AreaLightSelectPushConstant {
+    glm::ivec3 cameraBlock;
+    AreaLightSelectPhase phase;
+    glm::vec3 cameraOffset;
+    uint32_t recordCount;
+    float range;
+    float verticalCullBelow;
+    uint32_t digit;
+};
+
 class WorldPrepare : public SharedObject<WorldPrepare> {
     friend RayTracingModule;
     friend RayTracingModuleContext;
@@ -25,13 +45,25 @@ class WorldPrepare : public SharedObject<WorldPrepare> {
     void build();
 
   private:
+    std::shared_ptr<vk::DescriptorTable> createLightSelectDescriptorTable();
+
     std::weak_ptr<Framework> framework_;
     std::weak_ptr<RayTracingModule> rayTracingModule_;
 
     std::vector<std::shared_ptr<WorldPrepareContext>> contexts_;
+
+    std::shared_ptr<vk::Shader> lightSelectShader_;
+    std::shared_ptr<vk::ComputePipeline> lightSelectPipeline_;
 };
 
 struct WorldPrepareContext : public SharedObject<WorldPrepareContext> {
+    // the selected lights follow an int count in areaLightBuffer, at the alignment of AreaLight
+    constexpr static size_t AREA_LIGHT_LIST_OFFSET = 16;
+    // histogram and select state in lightSelectBuffer, cleared every frame, then the candidates and a key per record
+    constexpr static size_t LIGHT_SELECT_STATE_SIZE = (256 + 8) * sizeof(uint32_t);
+    constexpr static size_t LIGHT_SELECT_KEYS_OFFSET = LIGHT_SELECT_STATE_SIZE + MAX_AREA_LIGHTS * 2 * sizeof(uint32_t);
+    constexpr static float VERTICAL_CULL_BELOW = 48.0f; // lights further below the camera are behind rock
+
     std::weak_ptr<FrameworkContext> frameworkContext;
     std::weak_ptr<RayTracingModuleContext> rayTracingModuleContext;
     std::weak_ptr<WorldPrepare> worldPrepare;
@@ -45,8 +77,13 @@ struct WorldPrepareContext : public SharedObject<WorldPrepareContext> {
     std::shared_ptr<vk::DeviceLocalBuffer> lastVertexBufferAddr;
     std::shared_ptr<vk::DeviceLocalBuffer> lastIndexBufferAddr;
     std::shared_ptr<vk::DeviceLocalBuffer> lastObjToWorldMat;
+    std::shared_ptr<vk::DeviceLocalBuffer> quadRemapAddr;
+    std::shared_ptr<vk::DeviceLocalBuffer> geometryOriginBuffer;
     std::shared_ptr<vk::DeviceLocalBuffer> areaLightBuffer;
-    int areaLightCount = 0;
+
+    std::shared_ptr<vk::HostVisibleBuffer> lightTypeBuffer;
+    std::shared_ptr<vk::DeviceLocalBuffer> lightSelectBuffer;
+    std::shared_ptr<vk::DescriptorTable> lightSelectDescriptorTable;
 
     WorldPrepareContext(std::shared_ptr<FrameworkContext> frameworkContext, std::shared_ptr<WorldPrepare> worldprepare);
 
@@ -55,6 +92,26 @@ struct WorldPrepareContext : public SharedObject<WorldPrepareContext> {
                       std::vector<uint64_t> &indexBufferAddrs,
                       std::vector<uint64_t> &lastVertexBufferAddrs,
                       std::vector<uint64_t> &lastIndexBufferAddrs,
-                      std::vector<glm::mat4> &lastObjToWorldMats);
+                      std::vector<glm::mat4> &lastObjToWorldMats,
+                      std::vector<uint64_t> &quadRemapAddrs,
+                      std::vector<glm::vec4> &geometryOrigins);
     void render();
+
+    struct ChunkInstance {
+        uint32_t index; // into Chunks::chunks()
+        uint32_t mask;
+    };
+
+    // the ready chunk sections worth a TLAS instance in chunk order, culled by Options::tlasCullRadius and behind the
+    // camera outside Options::tlasShellRadius, first per region of chunk columns and then per section
+    static std::vector<ChunkInstance> selectChunkInstances(const std::vector<std::shared_ptr<Chunk1>> &chunks,
+                                                           glm::dvec3 cameraPos,
+                                                           glm::vec3 viewDir);
+
+    // the brightest chunk lights for the camera into areaLightBuffer, scored and ranked on the GPU from
+    // Chunks::lightRecords()
+    void selectAreaLights(glm::dvec3 cameraPos);
+
+    // LIGHT_DEFS of a LightTypeId with the per-block Options applied, intensity 0 when the type is switched off
+    static vk::Data::AreaLightType areaLightType(int lightTypeId);
 };
\ No newline at end of file
@@ -330,95 +330,57 @@ void ToneMappingModuleContext::render() {
     }
     Renderer::preExposure = module->computedExposure_;
 
-    auto chooseSrc = [](VkImageLayout oldLayout,
-                        VkPipelineStageFlags2 fallbackStage,
-                        VkAccessFlags2 fallbackAccess,
-                        VkPipelineStageFlags2 &outStage,
-                        VkAccessFlags2 &outAccess) {
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED) {
-            outStage = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
-            outAccess = 0;
-        } else {
-            outStage = fallbackStage;
-            outAccess = fallbackAccess;
-        }
-    };
-
-    VkPipelineStageFlags2 hdrSrcStage = 0;
-    VkAccessFlags2 hdrSrcAccess = 0;
-    chooseSrc(hdrImage->imageLayout(),
-              VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
-                  VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-              VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-              hdrSrcStage, hdrSrcAccess);
-
-    VkPipelineStageFlags2 ldrSrcStage = 0;
-    VkAccessFlags2 ldrSrcAccess = 0;
-    chooseSrc(ldrImage->imageLayout(),
-              VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-              VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-              ldrSrcStage, ldrSrcAccess);
-
-    worldCommandBuffer->barriersBufferImage(
-        {{
-            .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-            .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
-                            VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            .srcQueueFamilyIndex = mainQueueIndex,
-            .dstQueueFamilyIndex = mainQueueIndex,
-            .buffer = histBuffer,
-        }},
-        {{
-             .srcStageMask = hdrSrcStage,
-             .srcAccessMask = hdrSrcAccess,
-             .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
-                             VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-             .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-             .oldLayout = hdrImage->imageLayout(),
-             .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-             .srcQueueFamilyIndex = mainQueueIndex,
-             .dstQueueFamilyIndex = mainQueueIndex,
-             .image = hdrImage,
-             .subresourceRange = vk::wholeColorSubresourceRange,
-         },
-         {
-             .srcStageMask = ldrSrcStage,
-             .srcAccessMask = ldrSrcAccess,
-             .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-             .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-             .oldLayout = ldrImage->imageLayout(),
-#ifdef USE_AMD
-                 .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-#else
-                 .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-#endif
-             .srcQueueFamilyIndex = mainQueueIndex,
-             .dstQueueFamilyIndex = mainQueueIndex,
-             .image = ldrImage,
-             .subresourceRange = vk::wholeColorSubresourceRange,
-         }});
-    hdrImage->imageLayout() = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 #ifdef USE_AMD
-    ldrImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkImageLayout ldrLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 #else
-    ldrImage->imageLayout() = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    VkImageLayout ldrLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 #endif
 
+    vk::BarrierTracker barriers(worldCommandBuffer, mainQueueIndex);
+    // hdr comes from the modules before, ldr went to those after last frame, the buffers are only touched here and
+    // the host read the readback behind a fence
+    barriers
+        .external(hdrImage,
+                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                  VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT)
+        .external(ldrImage,
+                  VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                      VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                  VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT)
+        .external(histBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+        .external(module->exposureData_,
+                  VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+                      VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                  VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+        .external(module->exposureReadback_, 0, 0);
+
+    barriers
+        .use(hdrImage, {
+                           .stageMask =
+                               VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+                           .accessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                           .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                       })
+        .use(ldrImage, {
+                           .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                           .accessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                           .layout = ldrLayout,
+                       })
+        .use(histBuffer, {
+                             .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                             .accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                         })
+        .flush();
+
     vkCmdFillBuffer(worldCommandBuffer->vkCommandBuffer(), histBuffer->vkBuffer(), 0, VK_WHOLE_SIZE, 0);
 
-    worldCommandBuffer->barriersBufferImage(
-        {{
-            .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-            .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
-                            VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-            .srcQueueFamilyIndex = mainQueueIndex,
-            .dstQueueFamilyIndex = mainQueueIndex,
-            .buffer = histBuffer,
-        }},
-        {});
+    barriers
+        .use(histBuffer, {
+                             .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                             .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                         })
+        .flush();
 
     std::chrono::time_point<std::chrono::high_resolution_clock> currentTimePoint =
         std::chrono::high_resolution_clock::now();
@@ -487,34 +449,33 @@ void ToneMappingModuleContext::render() {
     uint32_t groupY = (module->height_ + 16 - 1) / 16;
     vkCmdDispatch(worldCommandBuffer->vkCommandBuffer(), groupX, groupY, 1);
 
-    worldCommandBuffer->barriersBufferImage(
-        {{
-            .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-            .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
-                            VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-            .srcQueueFamilyIndex = mainQueueIndex,
-            .dstQueueFamilyIndex = mainQueueIndex,
-            .buffer = histBuffer,
-        }},
-        {});
+    barriers
+        .use(histBuffer, {
+                             .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                             .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                         })
+        .use(module->exposureData_, {
+                                        .stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                                        .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                                                      VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                    })
+        .flush();
 
     worldCommandBuffer->bindComputePipeline(module->exposurePipeline_);
     vkCmdDispatch(worldCommandBuffer->vkCommandBuffer(), 1, 1, 1);
 
-    worldCommandBuffer->barriersBufferImage(
-        {{
-            .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-            .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
-                            VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-            .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-            .srcQueueFamilyIndex = mainQueueIndex,
-            .dstQueueFamilyIndex = mainQueueIndex,
-            .buffer = module->exposureData_,
-        }},
-        {});
+    barriers
+        .use(module->exposureData_, {
+                                        .stageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+                                                     VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                        .accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                                                      VK_ACCESS_2_TRANSFER_READ_BIT,
+                                    })
+        .use(module->exposureReadback_, {
+                                            .stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                            .accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                        })
+        .flush();
 
     // Copy computed exposure float to staging buffer for CPU readback next frame
     VkBufferCopy exposureCopy{.srcOffset = 0, .dstOffset = 0, .size = sizeof(float)};
@@ -523,6 +484,13 @@ void ToneMappingModuleContext::render() {
                     module->exposureReadback_->vkBuffer(),
                     1, &exposureCopy);
 
+    barriers
+        .use(module->exposureReadback_, {
+                                            .stageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+                                            .accessMask = VK_ACCESS_2_HOST_READ_BIT,
+                                        })
+        .flush();
+
     worldCommandBuffer->beginRenderPass({
         .renderPass = module->renderPass_,
         .framebuffer = framebuffer,
@@ -535,9 +503,5 @@ void ToneMappingModuleContext::render() {
         ->bindDescriptorTable(descriptorTable, VK_PIPELINE_BIND_POINT_GRAPHICS)
         ->draw(3, 1)
         ->endRenderPass();
-#ifdef USE_AMD
-    ldrImage->imageLayout() = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-#else
-    ldrImage->imageLayout() = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-#endif
+    ldrImage->imageLayout() = ldrLayout;
 }
@@ -10,6 +10,14 @@ void WorldModule::init(std::shared_ptr<Framework> framework, std::shared_ptr<Wor
     worldPipeline_ = worldPipeline;
 }
 
+void WorldModule::flushTextureBindings() {}
+
+bool WorldModule::asyncComputeCapable() {
+    return false;
+}
+
+void WorldModule::asyncComputeBuffers(uint32_t, std::vector<std::shared_ptr<vk::Buffer>> &) {}
+
 WorldModuleContext::WorldModuleContext(std::shared_ptr<FrameworkContext> frameworkContext,
                                        std::shared_ptr<WorldPipelineContext> worldPipelineContext)
     : frameworkContext(frameworkContext), worldPipelineContext(worldPipelineContext) {}
\ No newline at end of file
@@ -34,6 +34,14 @@ class WorldModule {
 
     virtual void
     bindTexture(std::shared_ptr<vk::Sampler> sampler, std::shared_ptr<vk::DeviceLocalImage> image, int index) = 0;
+    // submit texture bindings queued by bindTexture, modules without a texture table keep the default
+    virtual void flushTextureBindings();
+
+    // modules recording nothing but compute, transfer and clear commands may run on the secondary queue when
+    // Renderer::options.asyncCompute is set, their shared images change queue family around them
+    virtual bool asyncComputeCapable();
+    // buffers besides the shared images that main queue work also uses, they follow the module to the secondary queue
+    virtual void asyncComputeBuffers(uint32_t frameIndex, std::vector<std::shared_ptr<vk::Buffer>> &buffers);
 
     // release resources that must be released before deconstruction
     virtual void preClose() = 0;
@@ -1,6 +1,7 @@
 #include "core/render/pipeline.hpp"
 
 #include "core/render/hdr_composite_pass.hpp"
+#include "core/render/profiler.hpp"
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 
@@ -14,10 +15,37 @@
 #include "core/render/modules/world/temporal_accumulation/temporal_accumulation_module.hpp"
 #include "core/render/modules/world/tone_mapping/tone_mapping_module.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <iomanip>
 #include <set>
 
+static bool isDepthStencilFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_S8_UINT:
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT: return true;
+        default: return false;
+    }
+}
+
+static VkImageSubresourceRange wholeSubresourceRange(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT: return vk::wholeDepthSubresourceRange;
+        case VK_FORMAT_S8_UINT: return vk::wholeStencilSubresourceRange;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT: return vk::wholeDepthStencilSubresourceRange;
+        default: return vk::wholeColorSubresourceRange;
+    }
+}
+
 WorldPipelineBlueprint::WorldPipelineBlueprint(WorldPipelineBuildParams *params) {
     std::set<uint32_t> imageIndices;
     auto framework = Renderer::instance().framework();
@@ -75,6 +103,16 @@ void WorldPipeline::init(std::shared_ptr<Framework> framework, std::shared_ptr<P
     uint32_t frameNum = framework->swapchain()->imageCount();
 
     worldModules_.resize(blueprint->moduleNames_.size());
+
+    // "render_pipeline.module.nrd.name" is profiled as "nrd"
+    worldModuleProfilerNames_.clear();
+    for (const auto &moduleName : blueprint->moduleNames_) {
+        std::string name = moduleName;
+        constexpr std::string_view prefix = "render_pipeline.module.", suffix = ".name";
+        if (name.starts_with(prefix)) name.erase(0, prefix.size());
+        if (name.ends_with(suffix)) name.erase(name.size() - suffix.size());
+        worldModuleProfilerNames_.push_back(name);
+    }
     sharedImages_.resize(frameNum,
                          std::vector<std::shared_ptr<vk::DeviceLocalImage>>(blueprint->imageFormats_.size(), nullptr));
     contexts_.resize(frameNum);
@@ -104,6 +142,10 @@ void WorldPipeline::init(std::shared_ptr<Framework> framework, std::shared_ptr<P
     }
 
 
+    for (int i = blueprint->moduleNames_.size() - 1; i >= 0; i--) {
+        worldModules_[i] = Pipeline::worldModuleConstructors[blueprint->moduleNames_[i]](framework, shared_from_this());
+    }
+
     for (int frameIndex = 0; frameIndex < frameNum; frameIndex++) {
         // Keep the primary output at display resolution
         sharedImages_[frameIndex][0] = vk::DeviceLocalImage::create(
@@ -113,6 +155,10 @@ void WorldPipeline::init(std::shared_ptr<Framework> framework, std::shared_ptr<P
         );
     }
 
+    // every image the modules create until their outputs and inputs are wired stays unbound, so the transient ones
+    // can share memory once all lifetimes are known
+    vk::DeferredImageMemory deferredMemory(framework->vma());
+
     // Pre-create outputs for modules before upscaler at render resolution
     if (upscalerIndex != std::numeric_limits<size_t>::max() &&
         (renderWidth != extent.width || renderHeight != extent.height)) {
@@ -137,8 +183,6 @@ void WorldPipeline::init(std::shared_ptr<Framework> framework, std::shared_ptr<P
     }
 
     for (int i = blueprint->moduleNames_.size() - 1; i >= 0; i--) {
-        worldModules_[i] = Pipeline::worldModuleConstructors[blueprint->moduleNames_[i]](framework, shared_from_this());
-
         auto &moduleInputIndices = blueprint->modulesInputIndices_[i];
         auto &moduleOutputIndices = blueprint->modulesOutputIndices_[i];
 
@@ -174,17 +218,112 @@ void WorldPipeline::init(std::shared_ptr<Framework> framework, std::shared_ptr<P
                 }
             }
         }
+    }
+
+    transientImageAcquires_.assign(frameNum, std::vector<std::vector<std::shared_ptr<vk::DeviceLocalImage>>>(
+                                                 blueprint->moduleNames_.size()));
+    if (Renderer::options.transientImageAliasing) aliasTransientImages(blueprint, deferredMemory);
+    deferredMemory.finish();
+    if (deferredMemory.savedBytes() > 0) {
+        std::cout << "[WorldPipeline] transient image aliasing saved " << (deferredMemory.savedBytes() >> 20)
+                  << " MiB" << std::endl;
+    }
 
+    for (int i = blueprint->moduleNames_.size() - 1; i >= 0; i--) {
         worldModules_[i]->setAttributes(blueprint->attributeCounts_[i], blueprint->attributeKVs_[i]);
 
         worldModules_[i]->build();
     }
 
+    scheduleAsyncCompute(framework, blueprint);
+
     for (int i = 0; i < framework->swapchain()->imageCount(); i++) {
         contexts_[i] = WorldPipelineContext::create(framework->contexts()[i], shared_from_this());
     }
 }
 
+void WorldPipeline::aliasTransientImages(std::shared_ptr<WorldPipelineBlueprint> blueprint,
+                                         vk::DeferredImageMemory &memory) {
+    struct Lifetime {
+        std::shared_ptr<vk::DeviceLocalImage> image;
+        int first = -1;
+        int last = -1;
+        bool readFirst = false; // the first module reads what an earlier frame left behind
+        VkMemoryRequirements requirements;
+    };
+
+    struct Slot {
+        int last;
+        uint32_t memoryTypeBits;
+        VkDeviceSize size;
+    };
+
+    uint32_t group = 0;
+    for (size_t frameIndex = 0; frameIndex < sharedImages_.size(); frameIndex++) {
+        std::map<vk::DeviceLocalImage *, Lifetime> lifetimes;
+        for (int i = 0; i < blueprint->moduleNames_.size(); i++) {
+            auto touch = [&](uint32_t idx, bool read) {
+                // the primary output outlives the world pipeline, it is composited and presented afterwards
+                if (idx == 0) return;
+                auto &image = sharedImages_[frameIndex][idx];
+                if (image == nullptr) return;
+
+                Lifetime &lifetime = lifetimes[image.get()];
+                lifetime.image = image;
+                if (lifetime.first < 0) lifetime.first = i;
+                if (lifetime.first == i && read) lifetime.readFirst = true;
+                lifetime.last = i;
+            };
+            for (uint32_t idx : blueprint->modulesInputIndices_[i]) touch(idx, true);
+            for (uint32_t idx : blueprint->modulesOutputIndices_[i]) touch(idx, false);
+        }
+        // never alias the primary output under another name
+        lifetimes.erase(sharedImages_[frameIndex][0].get());
+
+        std::vector<Lifetime> transients;
+        for (auto &[ptr, lifetime] : lifetimes) {
+            if (lifetime.readFirst || !memory.deferred(lifetime.image)) continue;
+            // the discard barrier below only covers color aspects
+            if (isDepthStencilFormat(lifetime.image->vkFormat())) continue;
+            lifetime.requirements = lifetime.image->memoryRequirements();
+            transients.push_back(lifetime);
+        }
+        // largest first within a module, so smaller images fill slots sized by larger ones
+        std::sort(transients.begin(), transients.end(), [](const Lifetime &a, const Lifetime &b) {
+            if (a.first != b.first) return a.first < b.first;
+            return a.requirements.size > b.requirements.size;
+        });
+
+        std::vector<Slot> slots;
+        std::vector<uint32_t> slotGroups;
+        for (auto &lifetime : transients) {
+            int best = -1;
+            for (int s = 0; s < slots.size(); s++) {
+                if (slots[s].last >= lifetime.first) continue;
+                if ((slots[s].memoryTypeBits & lifetime.requirements.memoryTypeBits) == 0) continue;
+                // prefer the slot whose size wastes the least
+                auto waste = [&](const Slot &slot) {
+                    return std::max(slot.size, lifetime.requirements.size) -
+                           std::min(slot.size, lifetime.requirements.size);
+                };
+                if (best < 0 || waste(slots[s]) < waste(slots[best])) best = s;
+            }
+            if (best < 0) {
+                best = slots.size();
+                slots.push_back({lifetime.last, lifetime.requirements.memoryTypeBits, lifetime.requirements.size});
+                slotGroups.push_back(group++);
+            } else {
+                slots[best].last = lifetime.last;
+                slots[best].memoryTypeBits &= lifetime.requirements.memoryTypeBits;
+                slots[best].size = std::max(slots[best].size, lifetime.requirements.size);
+            }
+
+            memory.alias(lifetime.image, slotGroups[best]);
+            transientImageAcquires_[frameIndex][lifetime.first].push_back(lifetime.image);
+        }
+    }
+}
+
 std::vector<std::shared_ptr<WorldModule>> &WorldPipeline::worldModules() {
     return worldModules_;
 }
@@ -193,12 +332,58 @@ std::vector<std::shared_ptr<WorldPipelineContext>> &WorldPipeline::contexts() {
     return contexts_;
 }
 
+void WorldPipeline::scheduleAsyncCompute(std::shared_ptr<Framework> framework,
+                                         std::shared_ptr<WorldPipelineBlueprint> blueprint) {
+    asyncComputeBegin_ = 0;
+    asyncComputeEnd_ = 0;
+    asyncComputeImages_.assign(sharedImages_.size(), {});
+    if (!Renderer::options.asyncCompute) return;
+    if (framework->worldComputeTimeline() == nullptr) {
+        std::cout << "[WorldPipeline] async compute needs timeline semaphores, every module stays on the main queue"
+                  << std::endl;
+        return;
+    }
+
+    uint32_t runBegin = 0;
+    for (uint32_t i = 0; i <= worldModules_.size(); i++) {
+        if (i < worldModules_.size() && worldModules_[i]->asyncComputeCapable()) continue;
+        if (i - runBegin > asyncComputeEnd_ - asyncComputeBegin_) {
+            asyncComputeBegin_ = runBegin;
+            asyncComputeEnd_ = i;
+        }
+        runBegin = i + 1;
+    }
+    if (asyncComputeBegin_ == asyncComputeEnd_) return;
+
+    for (uint32_t frameIndex = 0; frameIndex < sharedImages_.size(); frameIndex++) {
+        auto &images = asyncComputeImages_[frameIndex];
+        auto addImages = [&](const std::vector<uint32_t> &indices) {
+            for (uint32_t index : indices) {
+                auto &image = sharedImages_[frameIndex][index];
+                if (std::find(images.begin(), images.end(), image) == images.end()) images.push_back(image);
+            }
+        };
+        for (uint32_t i = asyncComputeBegin_; i < asyncComputeEnd_; i++) {
+            addImages(blueprint->modulesInputIndices_[i]);
+            addImages(blueprint->modulesOutputIndices_[i]);
+        }
+    }
+
+    std::cout << "[WorldPipeline] " << worldModuleProfilerNames_[asyncComputeBegin_];
+    if (asyncComputeEnd_ - asyncComputeBegin_ > 1) std::cout << " to " << worldModuleProfilerNames_[asyncComputeEnd_ - 1];
+    std::cout << " run on the secondary queue" << std::endl;
+}
+
 void WorldPipeline::bindTexture(std::shared_ptr<vk::Sampler> sampler,
                                 std::shared_ptr<vk::DeviceLocalImage> image,
                                 int index) {
     for (int i = 0; i < worldModules_.size(); i++) { worldModules_[i]->bindTexture(sampler, image, index); }
 }
 
+void WorldPipeline::flushTextureBindings() {
+    for (int i = 0; i < worldModules_.size(); i++) { worldModules_[i]->flushTextureBindings(); }
+}
+
 WorldPipelineContext::WorldPipelineContext(std::shared_ptr<FrameworkContext> frameworkContext,
                                            std::shared_ptr<WorldPipeline> worldPipeline)
     : frameworkContext(frameworkContext),
@@ -251,7 +436,58 @@ void WorldPipelineContext::render() {
         outputImage->imageLayout() = targetLayout;
     }
 
-    for (int i = 0; i < worldModuleContexts.size(); i++) { worldModuleContexts[i]->render(); }
+    auto worldPipelineShared = worldPipeline.lock();
+    auto &moduleNames = worldPipelineShared->worldModuleProfilerNames_;
+    auto &transientImageAcquires = worldPipelineShared->transientImageAcquires_[context->frameIndex];
+
+    // modules record into context->worldCommandBuffer, around the async modules it points at the secondary queue's
+    // buffer and then at the main queue's tail buffer, see Framework::submitWithWorldCompute
+    auto headCommandBuffer = context->worldCommandBuffer;
+    auto computeQueueIndex = framework->physicalDevice()->secondaryQueueIndex();
+    uint32_t asyncComputeBegin = worldPipelineShared->asyncComputeBegin_;
+    uint32_t asyncComputeEnd = worldPipelineShared->asyncComputeEnd_;
+    auto switchCommandBuffer = [&](std::shared_ptr<vk::CommandBuffer> commandBuffer, uint32_t srcQueueFamilyIndex,
+                                   uint32_t dstQueueFamilyIndex) {
+        transferAsyncComputeOwnership(worldCommandBuffer, commandBuffer, srcQueueFamilyIndex, dstQueueFamilyIndex);
+        context->worldCommandBuffer = commandBuffer;
+        worldCommandBuffer = commandBuffer;
+    };
+
+    for (int i = 0; i < worldModuleContexts.size(); i++) {
+        if (asyncComputeBegin < asyncComputeEnd && i == asyncComputeBegin) {
+            switchCommandBuffer(context->worldComputeCommandBuffer, mainQueueIndex, computeQueueIndex);
+            context->worldComputeRecorded = true;
+        } else if (asyncComputeBegin < asyncComputeEnd && i == asyncComputeEnd) {
+            switchCommandBuffer(context->worldTailCommandBuffer, computeQueueIndex, mainQueueIndex);
+        }
+
+        ProfilerGpuScope profilerScope(worldCommandBuffer, moduleNames[i]);
+
+        // the memory of an aliased image was last used by another image of this frame, wait for that use to finish
+        // and drop the old contents
+        std::vector<vk::CommandBuffer::ImageMemoryBarrier> aliasBarriers;
+        for (auto &image : transientImageAcquires[i]) {
+            aliasBarriers.push_back({
+                .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+                .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+                .srcQueueFamilyIndex = mainQueueIndex,
+                .dstQueueFamilyIndex = mainQueueIndex,
+                .image = image,
+                .subresourceRange = vk::wholeColorSubresourceRange,
+            });
+            image->imageLayout() = VK_IMAGE_LAYOUT_GENERAL;
+        }
+        if (!aliasBarriers.empty()) worldCommandBuffer->barriersBufferImage({}, aliasBarriers);
+
+        worldModuleContexts[i]->render();
+    }
+    if (asyncComputeBegin < asyncComputeEnd && asyncComputeEnd == worldModuleContexts.size()) {
+        switchCommandBuffer(context->worldTailCommandBuffer, computeQueueIndex, mainQueueIndex);
+    }
 
     worldCommandBuffer->barriersBufferImage(
         {}, {{
@@ -277,6 +513,95 @@ void WorldPipelineContext::render() {
 #else
     outputImage->imageLayout() = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 #endif
+
+    context->worldCommandBuffer = headCommandBuffer;
+}
+
+void WorldPipelineContext::transferAsyncComputeOwnership(std::shared_ptr<vk::CommandBuffer> releaseCommandBuffer,
+                                                         std::shared_ptr<vk::CommandBuffer> acquireCommandBuffer,
+                                                         uint32_t srcQueueFamilyIndex,
+                                                         uint32_t dstQueueFamilyIndex) {
+    // within one family the timeline semaphore between the queues is all the synchronization needed
+    if (srcQueueFamilyIndex == dstQueueFamilyIndex) return;
+
+    auto context = frameworkContext.lock();
+    auto worldPipelineShared = worldPipeline.lock();
+
+    std::vector<std::shared_ptr<vk::Buffer>> buffers;
+    for (uint32_t i = worldPipelineShared->asyncComputeBegin_; i < worldPipelineShared->asyncComputeEnd_; i++) {
+        worldPipelineShared->worldModules_[i]->asyncComputeBuffers(context->frameIndex, buffers);
+    }
+    std::sort(buffers.begin(), buffers.end());
+    buffers.erase(std::unique(buffers.begin(), buffers.end()), buffers.end());
+
+    // the release half only needs the source scope, the acquire half only the destination scope
+    std::vector<vk::CommandBuffer::BufferMemoryBarrier> releaseBuffers, acquireBuffers;
+    for (auto &buffer : buffers) {
+        releaseBuffers.push_back({
+            .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+            .dstAccessMask = 0,
+            .srcQueueFamilyIndex = srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = dstQueueFamilyIndex,
+            .buffer = buffer,
+        });
+        acquireBuffers.push_back({
+            .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+            .srcAccessMask = 0,
+            .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+            .srcQueueFamilyIndex = srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = dstQueueFamilyIndex,
+            .buffer = buffer,
+        });
+    }
+
+    // aliased images the async modules acquire are discarded there, until then their memory belongs to another image
+    std::vector<std::shared_ptr<vk::DeviceLocalImage>> discarded;
+    if (srcQueueFamilyIndex == context->physicalDevice->mainQueueIndex()) {
+        auto &transientImageAcquires = worldPipelineShared->transientImageAcquires_[context->frameIndex];
+        for (uint32_t i = worldPipelineShared->asyncComputeBegin_; i < worldPipelineShared->asyncComputeEnd_; i++) {
+            discarded.insert(discarded.end(), transientImageAcquires[i].begin(), transientImageAcquires[i].end());
+        }
+    }
+
+    std::vector<vk::CommandBuffer::ImageMemoryBarrier> releaseImages, acquireImages;
+    for (auto &image : worldPipelineShared->asyncComputeImages_[context->frameIndex]) {
+        // an image that was never written has no contents to hand over, its first use takes ownership
+        if (image->imageLayout() == VK_IMAGE_LAYOUT_UNDEFINED) continue;
+        if (std::find(discarded.begin(), discarded.end(), image) != discarded.end()) continue;
+
+        VkImageSubresourceRange range = wholeSubresourceRange(image->vkFormat());
+        releaseImages.push_back({
+            .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+            .dstAccessMask = 0,
+            .oldLayout = image->imageLayout(),
+            .newLayout = image->imageLayout(),
+            .srcQueueFamilyIndex = srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = dstQueueFamilyIndex,
+            .image = image,
+            .subresourceRange = range,
+        });
+        acquireImages.push_back({
+            .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+            .srcAccessMask = 0,
+            .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+            .oldLayout = image->imageLayout(),
+            .newLayout = image->imageLayout(),
+            .srcQueueFamilyIndex = srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = dstQueueFamilyIndex,
+            .image = image,
+            .subresourceRange = range,
+        });
+    }
+
+    if (releaseBuffers.empty() && releaseImages.empty()) return;
+    releaseCommandBuffer->barriersBufferImage(releaseBuffers, releaseImages);
+    acquireCommandBuffer->barriersBufferImage(acquireBuffers, acquireImages);
 }
 
 std::map<std::string,
@@ -458,6 +783,11 @@ void Pipeline::bindTexture(std::shared_ptr<vk::Sampler> sampler,
     uiModule_->bindTexture(sampler, image, index);
 }
 
+void Pipeline::flushTextureBindings() {
+    if (worldPipeline_ != nullptr) worldPipeline_->flushTextureBindings();
+    uiModule_->flushTextureBindings();
+}
+
 std::shared_ptr<UIModule> Pipeline::uiModule() {
     return uiModule_;
 }
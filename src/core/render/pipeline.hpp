@@ -61,12 +61,26 @@ class WorldPipeline : public SharedObject<WorldPipeline> {
     std::vector<std::shared_ptr<WorldPipelineContext>> &contexts();
 
     void bindTexture(std::shared_ptr<vk::Sampler> sampler, std::shared_ptr<vk::DeviceLocalImage> image, int index);
+    void flushTextureBindings();
 
   private:
     void dumpSharedImages(const char *label) const;
+    // places shared images that are written before they are read and live between two modules of one frame into
+    // common memory, see vk::DeferredImageMemory
+    void aliasTransientImages(std::shared_ptr<WorldPipelineBlueprint> blueprint, vk::DeferredImageMemory &memory);
+    // moves the longest run of asyncComputeCapable modules to the secondary queue
+    void scheduleAsyncCompute(std::shared_ptr<Framework> framework, std::shared_ptr<WorldPipelineBlueprint> blueprint);
 
     std::vector<std::shared_ptr<WorldModule>> worldModules_;
+    std::vector<std::string> worldModuleProfilerNames_;
     std::vector<std::vector<std::shared_ptr<vk::DeviceLocalImage>>> sharedImages_;
+    // [frame][module], aliased images whose contents are discarded right before the module first touches them
+    std::vector<std::vector<std::vector<std::shared_ptr<vk::DeviceLocalImage>>>> transientImageAcquires_;
+    // modules [asyncComputeBegin_, asyncComputeEnd_) record into FrameworkContext::worldComputeCommandBuffer
+    uint32_t asyncComputeBegin_ = 0;
+    uint32_t asyncComputeEnd_ = 0;
+    // [frame], shared images the async modules read or write
+    std::vector<std::vector<std::shared_ptr<vk::DeviceLocalImage>>> asyncComputeImages_;
 
     std::vector<std::shared_ptr<WorldPipelineContext>> contexts_;
 };
@@ -82,6 +96,13 @@ struct WorldPipelineContext : public SharedObject<WorldPipelineContext> {
                          std::shared_ptr<WorldPipeline> worldPipeline);
 
     void render();
+
+  private:
+    // hands the resources of the async modules from one queue family to the other, nothing to do within one family
+    void transferAsyncComputeOwnership(std::shared_ptr<vk::CommandBuffer> releaseCommandBuffer,
+                                       std::shared_ptr<vk::CommandBuffer> acquireCommandBuffer,
+                                       uint32_t srcQueueFamilyIndex,
+                                       uint32_t dstQueueFamilyIndex);
 };
 
 class Pipeline : public SharedObject<Pipeline> {
@@ -108,6 +129,7 @@ class Pipeline : public SharedObject<Pipeline> {
     std::shared_ptr<PipelineContext> acquirePipelineContext(std::shared_ptr<FrameworkContext> context);
     std::vector<std::shared_ptr<PipelineContext>> &contexts();
     void bindTexture(std::shared_ptr<vk::Sampler> sampler, std::shared_ptr<vk::DeviceLocalImage> image, int index);
+    void flushTextureBindings();
 
     std::shared_ptr<UIModule> uiModule();
     std::shared_ptr<WorldPipeline> worldPipeline();
@@ -0,0 +1,261 @@
+#include "core/render/profiler.hpp"
+
+#include "core/render/render_framework.hpp"
+#include "core/render/renderer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+std::ostream &profilerCout() {
+    return std::cout << "[Profiler] ";
+}
+
+std::ostream &profilerCerr() {
+    return std::cerr << "[Profiler] ";
+}
+
+Profiler::Profiler(std::shared_ptr<vk::Device> device,
+                   std::shared_ptr<vk::PhysicalDevice> physicalDevice,
+                   uint32_t frameNum)
+    : device_(device), epoch_(Clock::now()) {
+    VkPhysicalDeviceProperties properties = physicalDevice->properties();
+    timestampsSupported_ = properties.limits.timestampComputeAndGraphics == VK_TRUE;
+    timestampPeriodNs_ = properties.limits.timestampPeriod;
+    if (!timestampsSupported_) {
+        profilerCerr() << "timestamps are not supported on the graphics queue, only cpu scopes are recorded"
+                       << std::endl;
+    }
+
+    recreate(frameNum);
+}
+
+Profiler::~Profiler() {
+    destroySlots();
+}
+
+void Profiler::recreate(uint32_t frameNum) {
+    destroySlots();
+
+    slots_.resize(frameNum);
+    if (!timestampsSupported_) return;
+
+    for (auto &slot : slots_) {
+        VkQueryPoolCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        createInfo.queryCount = MAX_GPU_SCOPES_PER_FRAME * 2;
+
+        if (vkCreateQueryPool(device_->vkDevice(), &createInfo, nullptr, &slot.queryPool) != VK_SUCCESS) {
+            profilerCerr() << "failed to create timestamp query pool" << std::endl;
+            slot.queryPool = VK_NULL_HANDLE;
+        }
+    }
+}
+
+void Profiler::destroySlots() {
+    for (auto &slot : slots_) {
+        if (slot.queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device_->vkDevice(), slot.queryPool, nullptr);
+    }
+    slots_.clear();
+    currentSlot_ = nullptr;
+}
+
+void Profiler::beginFrame(uint32_t frameIndex, std::shared_ptr<vk::CommandBuffer> commandBuffer) {
+    if (frameIndex >= slots_.size()) return;
+
+    FrameSlot &slot = slots_[frameIndex];
+    collectSlot(slot);
+
+    slot.cpuTime = Clock::now();
+    currentSlot_ = &slot;
+
+    if (enabled() && slot.queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer->vkCommandBuffer(), slot.queryPool, 0, MAX_GPU_SCOPES_PER_FRAME * 2);
+    } else {
+        // nothing may be written to a pool that was not reset this frame
+        currentSlot_ = nullptr;
+    }
+}
+
+uint32_t Profiler::beginGpuScope(std::shared_ptr<vk::CommandBuffer> commandBuffer, const std::string &name) {
+    if (currentSlot_ == nullptr || !enabled()) return INVALID_SCOPE;
+    if (currentSlot_->queryCount + 2 > MAX_GPU_SCOPES_PER_FRAME * 2) return INVALID_SCOPE;
+
+    uint32_t scope = currentSlot_->scopes.size();
+    currentSlot_->scopes.push_back({name, currentSlot_->queryCount});
+    currentSlot_->queryCount += 2;
+
+    vkCmdWriteTimestamp2(commandBuffer->vkCommandBuffer(), VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
+                         currentSlot_->queryPool, currentSlot_->scopes[scope].query);
+    return scope;
+}
+
+void Profiler::endGpuScope(std::shared_ptr<vk::CommandBuffer> commandBuffer, uint32_t scope) {
+    if (currentSlot_ == nullptr || scope >= currentSlot_->scopes.size()) return;
+
+    vkCmdWriteTimestamp2(commandBuffer->vkCommandBuffer(), VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                         currentSlot_->queryPool, currentSlot_->scopes[scope].query + 1);
+}
+
+void Profiler::collectSlot(FrameSlot &slot) {
+    if (slot.queryCount == 0) return;
+
+    // value and availability per query, the frame fence has signaled so nothing is waited on
+    std::vector<uint64_t> results(slot.queryCount * 2);
+    VkResult result = vkGetQueryPoolResults(device_->vkDevice(), slot.queryPool, 0, slot.queryCount,
+                                            results.size() * sizeof(uint64_t), results.data(),
+                                            2 * sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    if (result == VK_SUCCESS || result == VK_NOT_READY) {
+        uint64_t frameOrigin = UINT64_MAX;
+        for (auto &scope : slot.scopes) {
+            if (results[scope.query * 2 + 1] != 0) frameOrigin = std::min(frameOrigin, results[scope.query * 2]);
+        }
+
+        for (auto &scope : slot.scopes) {
+            uint64_t begin = results[scope.query * 2];
+            uint64_t end = results[(scope.query + 1) * 2];
+            bool available = results[scope.query * 2 + 1] != 0 && results[(scope.query + 1) * 2 + 1] != 0;
+            if (!available || end < begin) continue;
+
+            double durationNs = (end - begin) * timestampPeriodNs_;
+            pushSample(scope.name, true, static_cast<float>(durationNs * 1e-6));
+
+            if (traceCapture_.load(std::memory_order_relaxed)) {
+                // gpu clocks are not calibrated against the cpu, the frame is anchored at its recording start
+                double frameUs = std::chrono::duration<double, std::micro>(slot.cpuTime - epoch_).count();
+                pushTraceEvent({scope.name, true, 0, frameUs + (begin - frameOrigin) * timestampPeriodNs_ * 1e-3,
+                                durationNs * 1e-3});
+            }
+        }
+    }
+
+    slot.scopes.clear();
+    slot.queryCount = 0;
+}
+
+void Profiler::recordCpuScope(const char *name, Clock::time_point begin, Clock::time_point end) {
+    double durationUs = std::chrono::duration<double, std::micro>(end - begin).count();
+    pushSample(name, false, static_cast<float>(durationUs * 1e-3));
+
+    if (traceCapture_.load(std::memory_order_relaxed)) {
+        uint32_t thread = static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        pushTraceEvent({name, false, thread, std::chrono::duration<double, std::micro>(begin - epoch_).count(),
+                        durationUs});
+    }
+}
+
+void Profiler::ScopeHistory::push(float ms) {
+    samples[head] = ms;
+    head = (head + 1) % HISTORY_SIZE;
+    count = std::min(count + 1, HISTORY_SIZE);
+}
+
+void Profiler::pushSample(const std::string &name, bool gpu, float ms) {
+    std::unique_lock<std::mutex> lck(mutex_);
+    histories_[std::make_pair(gpu, name)].push(ms);
+}
+
+void Profiler::pushTraceEvent(TraceEvent &&event) {
+    std::unique_lock<std::mutex> lck(mutex_);
+    if (traceEvents_.size() >= MAX_TRACE_EVENTS) traceEvents_.pop_front();
+    traceEvents_.push_back(std::move(event));
+}
+
+std::vector<ProfilerScopeStats> Profiler::stats() {
+    std::unique_lock<std::mutex> lck(mutex_);
+
+    std::vector<ProfilerScopeStats> result;
+    result.reserve(histories_.size());
+
+    std::vector<float> sorted;
+    for (const auto &[key, history] : histories_) {
+        if (history.count == 0) continue;
+
+        sorted.assign(history.samples.begin(), history.samples.begin() + history.count);
+        std::sort(sorted.begin(), sorted.end());
+
+        float sum = 0.0f;
+        for (float sample : sorted) sum += sample;
+
+        auto percentile = [&sorted](float p) {
+            return sorted[std::min<size_t>(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+        };
+        result.push_back({key.second, key.first, history.count, sum / history.count, percentile(0.95f),
+                          percentile(0.99f)});
+    }
+    return result;
+}
+
+bool Profiler::dumpChromeTrace(const std::string &path) {
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+    if (!out.is_open()) {
+        profilerCerr() << "cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lck(mutex_);
+
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    for (const auto &event : traceEvents_) {
+        out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":" << (event.gpu ? 1 : 0)
+            << ",\"tid\":" << event.thread << ",\"ts\":" << event.beginUs << ",\"dur\":" << event.durationUs << "}";
+    }
+    out << "\n]}\n";
+
+    profilerCout() << "wrote " << traceEvents_.size() << " trace events to " << path << std::endl;
+    return out.good();
+}
+
+bool Profiler::enabled() {
+    return enabled_.load(std::memory_order_relaxed);
+}
+
+void Profiler::setEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::setTraceCapture(bool capture) {
+    traceCapture_.store(capture, std::memory_order_relaxed);
+    if (capture) {
+        std::unique_lock<std::mutex> lck(mutex_);
+        traceEvents_.clear();
+    }
+}
+
+ProfilerCpuScope::ProfilerCpuScope(const char *name) : name_(name) {
+    auto framework = Renderer::instance().framework();
+    if (framework == nullptr) return;
+    auto profiler = framework->profiler();
+    if (profiler == nullptr || !profiler->enabled()) return;
+
+    profiler_ = profiler;
+    begin_ = Profiler::Clock::now();
+}
+
+ProfilerCpuScope::~ProfilerCpuScope() {
+    if (profiler_ != nullptr) profiler_->recordCpuScope(name_, begin_, Profiler::Clock::now());
+}
+
+ProfilerGpuScope::ProfilerGpuScope(std::shared_ptr<vk::CommandBuffer> commandBuffer, const std::string &name)
+    : commandBuffer_(commandBuffer) {
+    auto framework = Renderer::instance().framework();
+    if (framework == nullptr) return;
+    auto profiler = framework->profiler();
+    if (profiler == nullptr || !profiler->enabled()) return;
+
+    profiler_ = profiler;
+    scope_ = profiler_->beginGpuScope(commandBuffer_, name);
+}
+
+ProfilerGpuScope::~ProfilerGpuScope() {
+    if (profiler_ != nullptr && scope_ != Profiler::INVALID_SCOPE) profiler_->endGpuScope(commandBuffer_, scope_);
+}
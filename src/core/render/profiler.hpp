@@ -0,0 +1,128 @@
+#pragma once
+
+#include "common/singleton.hpp"
+#include "core/all_extern.hpp"
+#include "core/vulkan/all_core_vulkan.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ProfilerScopeStats {
+    std::string name;
+    bool gpu;
+    uint32_t sampleCount;
+    float avgMs;
+    float p95Ms;
+    float p99Ms;
+};
+
+// gpu timestamp scopes on a per-frame query pool ring plus cpu wall clock scopes,
+// both feed rolling per-scope statistics and an optional chrome trace capture
+class Profiler : public SharedObject<Profiler> {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    constexpr static uint32_t MAX_GPU_SCOPES_PER_FRAME = 128;
+    constexpr static uint32_t HISTORY_SIZE = 256;
+    constexpr static size_t MAX_TRACE_EVENTS = 1 << 18;
+    constexpr static uint32_t INVALID_SCOPE = ~0u;
+
+    Profiler(std::shared_ptr<vk::Device> device, std::shared_ptr<vk::PhysicalDevice> physicalDevice, uint32_t frameNum);
+    ~Profiler();
+
+    // the swapchain image count may change on recreate, the caller guarantees the device is idle
+    void recreate(uint32_t frameNum);
+
+    // called once the frame's fence has signaled, collects what the slot measured last time and resets its queries
+    void beginFrame(uint32_t frameIndex, std::shared_ptr<vk::CommandBuffer> commandBuffer);
+
+    uint32_t beginGpuScope(std::shared_ptr<vk::CommandBuffer> commandBuffer, const std::string &name);
+    void endGpuScope(std::shared_ptr<vk::CommandBuffer> commandBuffer, uint32_t scope);
+
+    void recordCpuScope(const char *name, Clock::time_point begin, Clock::time_point end);
+
+    std::vector<ProfilerScopeStats> stats();
+    bool dumpChromeTrace(const std::string &path);
+
+    bool enabled();
+    void setEnabled(bool enabled);
+    void setTraceCapture(bool capture);
+
+  private:
+    struct GpuScope {
+        std::string name;
+        uint32_t query;
+    };
+
+    struct FrameSlot {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        uint32_t queryCount = 0;
+        std::vector<GpuScope> scopes;
+        Clock::time_point cpuTime;
+    };
+
+    struct ScopeHistory {
+        std::array<float, HISTORY_SIZE> samples{};
+        uint32_t head = 0;
+        uint32_t count = 0;
+
+        void push(float ms);
+    };
+
+    struct TraceEvent {
+        std::string name;
+        bool gpu;
+        uint32_t thread;
+        double beginUs;
+        double durationUs;
+    };
+
+    void destroySlots();
+    void collectSlot(FrameSlot &slot);
+    void pushSample(const std::string &name, bool gpu, float ms);
+    void pushTraceEvent(TraceEvent &&event);
+
+    std::shared_ptr<vk::Device> device_;
+    bool timestampsSupported_ = false;
+    double timestampPeriodNs_ = 1.0;
+
+    std::vector<FrameSlot> slots_;
+    FrameSlot *currentSlot_ = nullptr;
+
+    std::atomic<bool> enabled_ = false;
+    std::atomic<bool> traceCapture_ = false;
+    Clock::time_point epoch_;
+
+    std::mutex mutex_;
+    std::map<std::pair<bool, std::string>, ScopeHistory> histories_; // (gpu, name)
+    std::deque<TraceEvent> traceEvents_;
+};
+
+// records the enclosing block as a cpu scope, close to free while profiling is off
+class ProfilerCpuScope {
+  public:
+    ProfilerCpuScope(const char *name);
+    ~ProfilerCpuScope();
+
+  private:
+    std::shared_ptr<Profiler> profiler_;
+    const char *name_;
+    Profiler::Clock::time_point begin_;
+};
+
+class ProfilerGpuScope {
+  public:
+    ProfilerGpuScope(std::shared_ptr<vk::CommandBuffer> commandBuffer, const std::string &name);
+    ~ProfilerGpuScope();
+
+  private:
+    std::shared_ptr<Profiler> profiler_;
+    std::shared_ptr<vk::CommandBuffer> commandBuffer_;
+    uint32_t scope_ = Profiler::INVALID_SCOPE;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+// two triangles (0 1 2) (2 3 0) per quad of four consecutive vertices, indices needs room for (vertexCount + 3) / 4 * 6
+template <typename V>
+void fillQuadIndices(V *indices, size_t vertexCount) {
+    for (size_t i = 0, k = 0; i < vertexCount; i += 4, k += 6) {
+        indices[k + 0] = static_cast<V>(i + 0);
+        indices[k + 1] = static_cast<V>(i + 1);
+        indices[k + 2] = static_cast<V>(i + 2);
+        indices[k + 3] = static_cast<V>(i + 2);
+        indices[k + 4] = static_cast<V>(i + 3);
+        indices[k + 5] = static_cast<V>(i + 0);
+    }
+}
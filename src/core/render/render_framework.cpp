@@ -4,14 +4,17 @@
 #include "core/render/buffers.hpp"
 #include "core/render/chunks.hpp"
 #include "core/render/entities.hpp"
+#include "core/render/frame_pacer.hpp"
 #include "core/render/hdr_composite_pass.hpp"
 #include "core/render/modules/ui_module.hpp"
 #include "core/render/pipeline.hpp"
+#include "core/render/profiler.hpp"
 #include "core/render/renderer.hpp"
 #include "core/render/streamline_context.hpp"
 #include "core/render/textures.hpp"
 #include "core/render/world.hpp"
 
+#include <array>
 #include <iostream>
 #include <random>
 
@@ -39,7 +42,9 @@ FrameworkContext::FrameworkContext(std::shared_ptr<Framework> framework, uint32_
       uploadCommandBuffer(framework->uploadCommandBuffers_[frameIndex]),
       overlayCommandBuffer(framework->overlayCommandBuffers_[frameIndex]),
       worldCommandBuffer(framework->worldCommandBuffers_[frameIndex]),
-      fuseCommandBuffer(framework->fuseCommandBuffers_[frameIndex]) {}
+      fuseCommandBuffer(framework->fuseCommandBuffers_[frameIndex]),
+      worldComputeCommandBuffer(framework->worldComputeCommandBuffers_[frameIndex]),
+      worldTailCommandBuffer(framework->worldTailCommandBuffers_[frameIndex]) {}
 
 FrameworkContext::~FrameworkContext() {
 #ifdef DEBUG
@@ -228,6 +233,8 @@ void Framework::init(GLFWwindow *window) {
     gc_ = GarbageCollector::create(shared_from_this());
 
     uint32_t imageCount = swapchain_->imageCount();
+    profiler_ = Profiler::create(device_, physicalDevice_, imageCount);
+    pacer_ = FramePacer::create(device_, physicalDevice_, imageCount);
 
     // create command buffer for each context
     for (int i = 0; i < imageCount; i++) {
@@ -235,8 +242,10 @@ void Framework::init(GLFWwindow *window) {
         overlayCommandBuffers_.emplace_back(vk::CommandBuffer::create(device_, mainCommandPool_));
         worldCommandBuffers_.emplace_back(vk::CommandBuffer::create(device_, mainCommandPool_));
         fuseCommandBuffers_.emplace_back(vk::CommandBuffer::create(device_, mainCommandPool_));
+        worldComputeCommandBuffers_.emplace_back(vk::CommandBuffer::create(device_, asyncCommandPool_));
+        worldTailCommandBuffers_.emplace_back(vk::CommandBuffer::create(device_, mainCommandPool_));
     }
-    worldAsyncCommandBuffer_ = vk::CommandBuffer::create(device_, asyncCommandPool_);
+    if (device_->hasTimelineSemaphore()) worldComputeTimeline_ = vk::Semaphore::create(device_, uint64_t{0});
 
     for (int i = 0; i < imageCount; i++) { commandFinishedFences_.push_back(vk::Fence::create(device_, true)); }
 
@@ -256,6 +265,8 @@ Framework::~Framework() {
 void Framework::acquireContext() {
     if (!running_) return;
 
+    ProfilerCpuScope profilerScope("Framework::acquireContext");
+
     // Streamline: advance frame token and sleep at the very top of the frame.
     // Per NVIDIA QA checklist: "slReflexSleep is called regardless of Reflex Low Latency mode state."
     // SL handles the mode internally — always call sleep when Reflex is available.
@@ -266,6 +277,9 @@ void Framework::acquireContext() {
         }
     }
 
+    // frames in flight and, without Reflex, latency pacing; the fence wait below rarely blocks after it
+    pacer_->pace();
+
     std::shared_ptr<FrameworkContext> lastContext;
     if (currentContext_) lastContext = currentContext_;
     VkResult result;
@@ -314,6 +328,13 @@ void Framework::acquireContext() {
     currentContext_->worldCommandBuffer->begin();
     currentContext_->overlayCommandBuffer->begin();
     currentContext_->fuseCommandBuffer->begin();
+    currentContext_->worldComputeCommandBuffer->begin();
+    currentContext_->worldTailCommandBuffer->begin();
+    currentContext_->worldComputeRecorded = false;
+
+    // the upload command buffer is the first one submitted, so the query reset precedes every scope
+    profiler_->beginFrame(currentContext_->frameIndex, currentContext_->uploadCommandBuffer);
+    pacer_->beginFrame(currentContext_->frameIndex, currentContext_->uploadCommandBuffer);
 
     auto pipelineContext = pipeline_->acquirePipelineContext(currentContext_);
     std::shared_ptr<UIModuleContext> lastUIContext =
@@ -324,9 +345,9 @@ void Framework::acquireContext() {
     gc_->clear();
     Renderer::instance().buffers()->resetFrame();
     Renderer::instance().textures()->resetFrame();
-    Renderer::instance().world()->resetFrame();
     Renderer::instance().world()->chunks()->resetFrame();
     Renderer::instance().world()->entities()->resetFrame();
+    Renderer::instance().world()->resetFrame();
 
     static int frames = 0;
     static auto lastTime = std::chrono::high_resolution_clock::now();
@@ -349,6 +370,8 @@ void Framework::acquireContext() {
 void Framework::submitCommand() {
     if (!running_) return;
 
+    ProfilerCpuScope profilerScope("Framework::submitCommand");
+
     // PCL: simulation phase ends, render phase begins
 #ifdef _WIN32
     StreamlineContext::pclSetMarker(sl::PCLMarker::eSimulationEnd);
@@ -356,20 +379,36 @@ void Framework::submitCommand() {
 
     Renderer::instance().framework()->safeAcquireCurrentContext(); // ensure context is non nullptr
 
-    Renderer::instance().textures()->performQueuedUpload();
-    Renderer::instance().buffers()->performQueuedUpload();
-    Renderer::instance().buffers()->buildAndUploadOverlayUniformBuffer();
+    Renderer::instance().textures()->flushBindings();
+    {
+        ProfilerGpuScope profilerScope(currentContext_->uploadCommandBuffer, "upload");
+        Renderer::instance().textures()->performQueuedUpload();
+        Renderer::instance().buffers()->performQueuedUpload();
+        Renderer::instance().world()->entities()->performQueuedExpansion();
+        Renderer::instance().buffers()->buildAndUploadOverlayUniformBuffer();
+    }
 
     auto pipelineContext = pipeline_->acquirePipelineContext(currentContext_);
     if (Renderer::instance().world()->shouldRender()) pipelineContext->worldPipelineContext->render();
     pipelineContext->uiModuleContext->end();
 
-    currentContext_->fuseFinal();
+    {
+        ProfilerGpuScope profilerScope(currentContext_->fuseCommandBuffer, "fuse");
+        currentContext_->fuseFinal();
+    }
+    pacer_->endFrame(currentContext_->fuseCommandBuffer);
 
     currentContext_->uploadCommandBuffer->end();
     currentContext_->worldCommandBuffer->end();
     currentContext_->overlayCommandBuffer->end();
     currentContext_->fuseCommandBuffer->end();
+    currentContext_->worldComputeCommandBuffer->end();
+    currentContext_->worldTailCommandBuffer->end();
+
+    if (currentContext_->worldComputeRecorded) {
+        submitWithWorldCompute();
+        return;
+    }
 
     std::vector<VkSemaphore> waitSemaphores = {currentContext_->imageAcquiredSemaphore->vkSemaphore()};
     std::vector<VkPipelineStageFlags> waitStageMasks = {VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
@@ -377,12 +416,26 @@ void Framework::submitCommand() {
     std::vector<VkCommandBuffer> commandbuffers = {
         currentContext_->uploadCommandBuffer->vkCommandBuffer(),
         currentContext_->worldCommandBuffer->vkCommandBuffer(),
+        currentContext_->worldTailCommandBuffer->vkCommandBuffer(),
         currentContext_->overlayCommandBuffer->vkCommandBuffer(),
         currentContext_->fuseCommandBuffer->vkCommandBuffer(),
     };
 
+    // the binary semaphore ignores its value
+    std::vector<uint64_t> signalValues = {0};
+    uint64_t frameValue = pacer_->submitFrame();
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+    if (pacer_->timeline() != nullptr) {
+        signalSemaphores.push_back(pacer_->timeline()->vkSemaphore());
+        signalValues.push_back(frameValue);
+        timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineSubmitInfo.signalSemaphoreValueCount = signalValues.size();
+        timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+    }
+
     VkSubmitInfo vkSubmitInfo = {};
     vkSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (pacer_->timeline() != nullptr) vkSubmitInfo.pNext = &timelineSubmitInfo;
     vkSubmitInfo.waitSemaphoreCount = waitSemaphores.size();
     vkSubmitInfo.pWaitSemaphores = waitSemaphores.data();
     vkSubmitInfo.pWaitDstStageMask = waitStageMasks.data();
@@ -404,9 +457,103 @@ void Framework::submitCommand() {
 #endif
 }
 
+// The world pipeline was split around the modules it scheduled on the secondary queue, the timeline orders the three
+// parts while the overlay runs on the main queue next to the async modules:
+//   main:      upload, world head            -> signal head
+//   secondary: wait head, world compute      -> signal compute
+//   main:      overlay; wait compute, world tail, fuse -> commandProcessedSemaphore, fence
+void Framework::submitWithWorldCompute() {
+    uint64_t headValue = ++worldComputeTimelineValue_;
+    uint64_t computeValue = ++worldComputeTimelineValue_;
+
+    auto commandBufferInfo = [](std::shared_ptr<vk::CommandBuffer> commandBuffer) {
+        VkCommandBufferSubmitInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+        info.commandBuffer = commandBuffer->vkCommandBuffer();
+        return info;
+    };
+    auto semaphoreInfo = [](std::shared_ptr<vk::Semaphore> semaphore, uint64_t value) {
+        VkSemaphoreSubmitInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        info.semaphore = semaphore->vkSemaphore();
+        info.value = value;
+        info.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        return info;
+    };
+
+    std::vector<VkCommandBufferSubmitInfo> headCommandBuffers = {
+        commandBufferInfo(currentContext_->uploadCommandBuffer),
+        commandBufferInfo(currentContext_->worldCommandBuffer),
+    };
+    VkSemaphoreSubmitInfo headWait = semaphoreInfo(currentContext_->imageAcquiredSemaphore, 0);
+    VkSemaphoreSubmitInfo headSignal = semaphoreInfo(worldComputeTimeline_, headValue);
+
+    VkCommandBufferSubmitInfo computeCommandBuffer = commandBufferInfo(currentContext_->worldComputeCommandBuffer);
+    VkSemaphoreSubmitInfo computeSignal = semaphoreInfo(worldComputeTimeline_, computeValue);
+
+    VkCommandBufferSubmitInfo overlayCommandBuffer = commandBufferInfo(currentContext_->overlayCommandBuffer);
+
+    std::vector<VkCommandBufferSubmitInfo> tailCommandBuffers = {
+        commandBufferInfo(currentContext_->worldTailCommandBuffer),
+        commandBufferInfo(currentContext_->fuseCommandBuffer),
+    };
+    VkSemaphoreSubmitInfo tailWait = semaphoreInfo(worldComputeTimeline_, computeValue);
+    std::vector<VkSemaphoreSubmitInfo> tailSignals = {
+        semaphoreInfo(currentContext_->commandProcessedSemaphore, 0),
+    };
+    uint64_t frameValue = pacer_->submitFrame();
+    if (pacer_->timeline() != nullptr) tailSignals.push_back(semaphoreInfo(pacer_->timeline(), frameValue));
+
+    VkSubmitInfo2 headSubmit{};
+    headSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    headSubmit.waitSemaphoreInfoCount = 1;
+    headSubmit.pWaitSemaphoreInfos = &headWait;
+    headSubmit.commandBufferInfoCount = headCommandBuffers.size();
+    headSubmit.pCommandBufferInfos = headCommandBuffers.data();
+    headSubmit.signalSemaphoreInfoCount = 1;
+    headSubmit.pSignalSemaphoreInfos = &headSignal;
+
+    VkSubmitInfo2 computeSubmit{};
+    computeSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    computeSubmit.waitSemaphoreInfoCount = 1;
+    computeSubmit.pWaitSemaphoreInfos = &headSignal;
+    computeSubmit.commandBufferInfoCount = 1;
+    computeSubmit.pCommandBufferInfos = &computeCommandBuffer;
+    computeSubmit.signalSemaphoreInfoCount = 1;
+    computeSubmit.pSignalSemaphoreInfos = &computeSignal;
+
+    std::array<VkSubmitInfo2, 2> mainSubmits{};
+    mainSubmits[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    mainSubmits[0].commandBufferInfoCount = 1;
+    mainSubmits[0].pCommandBufferInfos = &overlayCommandBuffer;
+    mainSubmits[1].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    mainSubmits[1].waitSemaphoreInfoCount = 1;
+    mainSubmits[1].pWaitSemaphoreInfos = &tailWait;
+    mainSubmits[1].commandBufferInfoCount = tailCommandBuffers.size();
+    mainSubmits[1].pCommandBufferInfos = tailCommandBuffers.data();
+    mainSubmits[1].signalSemaphoreInfoCount = tailSignals.size();
+    mainSubmits[1].pSignalSemaphoreInfos = tailSignals.data();
+
+    // the tail waits for the secondary queue, so the fence covers all three parts
+    std::shared_ptr<vk::Fence> fence = currentContext_->commandFinishedFence;
+    vkResetFences(device_->vkDevice(), 1, &fence->vkFence());
+
+#ifdef _WIN32
+    StreamlineContext::pclSetMarker(sl::PCLMarker::eRenderSubmitStart);
+#endif
+    vkQueueSubmit2(device_->mainVkQueue(), 1, &headSubmit, VK_NULL_HANDLE);
+    vkQueueSubmit2(device_->secondaryQueue(), 1, &computeSubmit, VK_NULL_HANDLE);
+    vkQueueSubmit2(device_->mainVkQueue(), mainSubmits.size(), mainSubmits.data(), fence->vkFence());
+#ifdef _WIN32
+    StreamlineContext::pclSetMarker(sl::PCLMarker::eRenderSubmitEnd);
+#endif
+}
+
 void Framework::present() {
     if (!running_) return;
 
+    ProfilerCpuScope profilerScope("Framework::present");
+
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
@@ -462,6 +609,8 @@ void Framework::recreate() {
     overlayCommandBuffers_.clear();
     worldCommandBuffers_.clear();
     fuseCommandBuffers_.clear();
+    worldComputeCommandBuffers_.clear();
+    worldTailCommandBuffers_.clear();
     commandFinishedFences_.clear();
     commandProcessedSemaphores_.clear();
 
@@ -475,6 +624,8 @@ void Framework::recreate() {
         overlayCommandBuffers_.emplace_back(vk::CommandBuffer::create(device_, mainCommandPool_));
         worldCommandBuffers_.emplace_back(vk::CommandBuffer::create(device_, mainCommandPool_));
         fuseCommandBuffers_.emplace_back(vk::CommandBuffer::create(device_, mainCommandPool_));
+        worldComputeCommandBuffers_.emplace_back(vk::CommandBuffer::create(device_, asyncCommandPool_));
+        worldTailCommandBuffers_.emplace_back(vk::CommandBuffer::create(device_, mainCommandPool_));
     }
 
     // create fence for each context
@@ -485,6 +636,9 @@ void Framework::recreate() {
 
     for (int i = 0; i < size; i++) { contexts_.push_back(FrameworkContext::create(shared_from_this(), i)); }
 
+    profiler_->recreate(size);
+    pacer_->recreate(size);
+
     pipeline_->recreate(shared_from_this());
 
     Renderer::instance().textures()->bindAllTextures();
@@ -866,8 +1020,15 @@ std::shared_ptr<vk::CommandPool> Framework::asyncCommandPool() {
     return asyncCommandPool_;
 }
 
-std::shared_ptr<vk::CommandBuffer> Framework::worldAsyncCommandBuffer() {
-    return worldAsyncCommandBuffer_;
+std::shared_ptr<vk::CommandBuffer> Framework::worldAsyncCommandBuffer(uint32_t index) {
+    while (worldAsyncCommandBuffers_.size() <= index) {
+        worldAsyncCommandBuffers_.push_back(vk::CommandBuffer::create(device_, asyncCommandPool_));
+    }
+    return worldAsyncCommandBuffers_[index];
+}
+
+std::shared_ptr<vk::Semaphore> Framework::worldComputeTimeline() {
+    return worldComputeTimeline_;
 }
 
 std::vector<std::shared_ptr<vk::Semaphore>> &Framework::commandProcessedSemaphores() {
@@ -896,6 +1057,10 @@ std::shared_ptr<Pipeline> Framework::pipeline() {
     return pipeline_;
 }
 
+std::shared_ptr<Profiler> Framework::profiler() {
+    return profiler_;
+}
+
 GarbageCollector &Framework::gc() {
     return *gc_;
 }
@@ -11,6 +11,8 @@
 #include <mutex>
 
 class Framework;
+class FramePacer;
+class Profiler;
 class UIModule;
 struct UIModuleContext;
 
@@ -51,6 +53,11 @@ struct FrameworkContext : public SharedObject<FrameworkContext> {
     std::shared_ptr<vk::CommandBuffer> worldCommandBuffer;
     std::shared_ptr<vk::CommandBuffer> fuseCommandBuffer;
 
+    // world modules scheduled on the secondary queue, and the main queue part of the world pipeline after them
+    std::shared_ptr<vk::CommandBuffer> worldComputeCommandBuffer;
+    std::shared_ptr<vk::CommandBuffer> worldTailCommandBuffer;
+    bool worldComputeRecorded = false;
+
     FrameworkContext(std::shared_ptr<Framework> framework, uint32_t frame_index);
     ~FrameworkContext();
 
@@ -90,7 +97,11 @@ class Framework : public SharedObject<Framework> {
     std::shared_ptr<vk::CommandPool> mainCommandPool();
     std::shared_ptr<vk::CommandPool> asyncCommandPool();
 
-    std::shared_ptr<vk::CommandBuffer> worldAsyncCommandBuffer();
+    // command buffers of the chunk build batches on the secondary queue, one per batch in flight, the pool grows up
+    // to the highest index asked for
+    std::shared_ptr<vk::CommandBuffer> worldAsyncCommandBuffer(uint32_t index);
+    // nullptr if the device lacks timeline semaphores, async compute is off then
+    std::shared_ptr<vk::Semaphore> worldComputeTimeline();
 
     std::vector<std::shared_ptr<vk::Semaphore>> &commandProcessedSemaphores();
     std::vector<std::shared_ptr<vk::Fence>> &commandFinishedFences();
@@ -98,12 +109,14 @@ class Framework : public SharedObject<Framework> {
     std::shared_ptr<FrameworkContext> safeAcquireCurrentContext();
 
     std::shared_ptr<Pipeline> pipeline();
+    std::shared_ptr<Profiler> profiler();
 
     GarbageCollector &gc();
 
   private:
     std::shared_ptr<vk::Semaphore> acquireSemaphore();
     void recycleSemaphore(std::shared_ptr<vk::Semaphore> semaphore);
+    void submitWithWorldCompute();
 
   private:
     std::shared_ptr<vk::Instance> instance_;
@@ -119,7 +132,12 @@ class Framework : public SharedObject<Framework> {
     std::vector<std::shared_ptr<vk::CommandBuffer>> overlayCommandBuffers_;
     std::vector<std::shared_ptr<vk::CommandBuffer>> worldCommandBuffers_;
     std::vector<std::shared_ptr<vk::CommandBuffer>> fuseCommandBuffers_;
-    std::shared_ptr<vk::CommandBuffer> worldAsyncCommandBuffer_;
+    std::vector<std::shared_ptr<vk::CommandBuffer>> worldComputeCommandBuffers_;
+    std::vector<std::shared_ptr<vk::CommandBuffer>> worldTailCommandBuffers_;
+    std::vector<std::shared_ptr<vk::CommandBuffer>> worldAsyncCommandBuffers_;
+
+    std::shared_ptr<vk::Semaphore> worldComputeTimeline_;
+    uint64_t worldComputeTimelineValue_ = 0;
 
     std::shared_ptr<Pipeline> pipeline_;
 
@@ -138,6 +156,8 @@ class Framework : public SharedObject<Framework> {
     bool running_ = true;
 
     std::shared_ptr<GarbageCollector> gc_;
+    std::shared_ptr<Profiler> profiler_;
+    std::shared_ptr<FramePacer> pacer_;
 };
 
 template <typename T>
@@ -8,6 +8,7 @@
 std::filesystem::path Renderer::folderPath{};
 Options Renderer::options{};
 float Renderer::preExposure = 1.0f;
+BounceStats Renderer::bounceStats{};
 
 Renderer::Renderer(GLFWwindow *window)
     : framework_(Framework::create(window)),
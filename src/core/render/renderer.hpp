@@ -28,6 +28,10 @@ struct Options {
     bool reflexEnabled = false;     // NVIDIA Reflex low-latency mode (VK_NV_low_latency2)
     bool reflexBoost = false;       // Reflex Boost — raise GPU clocks during latency-sensitive work
     bool vrrMode = false;           // VRR frame cap: 3600*Hz/(Hz+3600) via Reflex frameLimitUs
+    bool transientImageAliasing = true; // Share memory between world pipeline images with disjoint lifetimes
+    bool asyncCompute = false;      // Run compute-only world modules on the secondary queue, overlapping the overlay
+    uint32_t framesInFlight = 3;    // 2-4 frames the CPU may run ahead of the GPU, never more than swapchain images
+    bool latencyPacing = false;     // Start each frame just in time for the GPU when Reflex is not in use
     bool needRecreate = false;
 
     uint32_t chunkBuildingBatchSize = 6;
@@ -95,6 +99,41 @@ struct Options {
     bool restirSpatialEnabled = false;    // Enable spatial reuse compute pass
     bool restirBounceEnabled = false;     // Enable ReSTIR on indirect bounces (1-3)
 
+    // TLAS instance selection, distances in chunks
+    uint32_t tlasCullRadius = 0;          // Drop chunk sections beyond this distance, 0 = keep every loaded section
+    uint32_t tlasShellRadius = 8;         // Sections this close are kept in any direction (reflections, shadows)
+    bool tlasCullBehindCamera = false;    // Drop sections outside the shell that lie entirely behind the camera
+    uint32_t tlasFarMaskDistance = 0;     // Sections beyond get FAR_WORLD_MASK and are skipped by deep GI, 0 = off
+
+    // Distant chunk LOD, distances in chunks
+    bool chunkLodEnabled = false;         // Build voxel proxies for distant sections queued from now on and trace them
+    uint32_t chunkLodDistance = 16;       // Sections beyond trace their proxy instead of the full geometry
+    uint32_t chunkLodHysteresis = 2;      // A section switches back once closer than chunkLodDistance minus this
+    uint32_t chunkLodCellSize = 2;        // Proxy voxel edge in blocks [1, 2, 4, 8]
+
+    bool chunkGreedyMerge = false;        // Trace merged block faces for solid geometry of sections queued from now on
+
+    // Region BLAS merging, distances in chunks
+    bool chunkRegionMerge = false;        // Trace stable far sections through one BLAS per cube of 4x4x4 sections
+    uint32_t chunkRegionDistance = 12;    // Regions beyond this merge, they split again once 2 chunks closer
+
+    // Sky cube map
+    uint32_t skyFacesPerFrame = 2;        // Faces re-rendered per frame while the sky drifts [1 - 6]
+    float skyFaceBlend = 0.5f;            // Weight of a re-rendered face over the one it replaces while drifting
+    bool skyCubeMapLowRes = false;        // 128 texel faces with mips for rough reflections instead of 512
+
+    // Variable rate tracing, rates per 8x8 tile from the last frame's noise, motion and depth
+    uint32_t variableRateTracing = 0;     // 0 = every pixel, 1 = checkerboard for calm tiles, 2 = also quarter rate
+    float variableRateThreshold = 0.25f;  // Tile importance below which it is checkerboarded, quarter rate below 1/4
+
+    // Adaptive bounces, the bounce limit drops below rayBounces while the trace overruns its targets
+    bool adaptiveBounces = false;
+    float bounceTargetMs = 0.0f;          // GPU time of the trace to stay under, 0 = no time target
+    float bounceRayBudget = 0.0f;         // Bounce rays per pixel to stay under, 0 = no ray budget
+    float bounceThroughputCutoff = 0.0f;  // Dimmer paths play Russian roulette from the first bounce, 0 = off
+    float bounceRoughnessCutoff = 0.5f;   // Roughness from which a path counts as rough
+    uint32_t roughPathBounces = 0;        // Bounce limit of paths that met a rough surface, 0 = no limit
+
     float perBlockIntensity[50] = {       // Per-block intensity multiplier, indexed by LightTypeId
         1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
         1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
@@ -129,6 +168,14 @@ struct Options {
     int blockLightMode[50] = {};         // Per-block light mode: 0=Auto, 1=ForceAreaLight, 2=ForceEmissive
 };
 
+// What RayTracingModule measured of the bounce loop with Options::adaptiveBounces
+struct BounceStats {
+    uint32_t bounceLimit = 0;     // max bounces the trace runs with
+    float traceMs = 0.0f;         // GPU time of the trace
+    float raysPerPixel = 0.0f;    // bounce rays per pixel
+    float cutPathFraction = 0.0f; // of the pixels, paths ended early by the throughput and roughness cutoffs
+};
+
 class Renderer : public Singleton<Renderer> {
     friend class Singleton<Renderer>;
 
@@ -136,6 +183,7 @@ class Renderer : public Singleton<Renderer> {
     static std::filesystem::path folderPath;
     static Options options;
     static float preExposure;  // Set by tone mapping, read by RT + DLSS (1-frame delay)
+    static BounceStats bounceStats; // Set by ray tracing a few frames behind, read by the options screen
 
     ~Renderer();
 
@@ -5,6 +5,18 @@
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define MCVR_ALPHA_SSE2
+#    include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#    define MCVR_ALPHA_NEON
+#    include <arm_neon.h>
+#endif
+
 std::ostream &texturesCout() {
     return std::cout << "[Textures] ";
 }
@@ -13,10 +25,196 @@ std::ostream &texturesCerr() {
     return std::cerr << "[Textures] ";
 }
 
-Textures::Textures(std::shared_ptr<Framework> framework) {}
+// copy the alpha byte of count RGBA8 texels into a tightly packed single-channel row
+// whether two copies write texels in common, copies to other mip levels never do
+static bool uploadsOverlap(const VkBufferImageCopy &a, const VkBufferImageCopy &b) {
+    return a.imageSubresource.mipLevel == b.imageSubresource.mipLevel &&
+           a.imageOffset.x < b.imageOffset.x + (int32_t)b.imageExtent.width &&
+           b.imageOffset.x < a.imageOffset.x + (int32_t)a.imageExtent.width &&
+           a.imageOffset.y < b.imageOffset.y + (int32_t)b.imageExtent.height &&
+           b.imageOffset.y < a.imageOffset.y + (int32_t)a.imageExtent.height;
+}
+
+static void extractAlphaRow(const uint8_t *rgba, uint8_t *alpha, uint32_t count) {
+    uint32_t i = 0;
+#if defined(MCVR_ALPHA_SSE2)
+    for (; i + 16 <= count; i += 16) {
+        const __m128i *src = reinterpret_cast<const __m128i *>(rgba + i * 4);
+        __m128i a0 = _mm_srli_epi32(_mm_loadu_si128(src + 0), 24);
+        __m128i a1 = _mm_srli_epi32(_mm_loadu_si128(src + 1), 24);
+        __m128i a2 = _mm_srli_epi32(_mm_loadu_si128(src + 2), 24);
+        __m128i a3 = _mm_srli_epi32(_mm_loadu_si128(src + 3), 24);
+        // every lane is in [0, 255], so the saturating packs are exact
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(a2, a3));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(alpha + i), packed);
+    }
+#elif defined(MCVR_ALPHA_NEON)
+    for (; i + 16 <= count; i += 16) { vst1q_u8(alpha + i, vld4q_u8(rgba + i * 4).val[3]); }
+#endif
+    for (; i < count; i++) { alpha[i] = rgba[i * 4 + 3]; }
+}
+
+// widen [minAlpha, maxAlpha] to cover count single-channel texels
+static void accumulateAlphaRange(const uint8_t *alpha, uint32_t count, uint8_t &minAlpha, uint8_t &maxAlpha) {
+    uint32_t i = 0;
+#if defined(MCVR_ALPHA_SSE2)
+    if (count >= 16) {
+        __m128i vMin = _mm_set1_epi8(static_cast<char>(minAlpha));
+        __m128i vMax = _mm_set1_epi8(static_cast<char>(maxAlpha));
+        for (; i + 16 <= count; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(alpha + i));
+            vMin = _mm_min_epu8(vMin, v);
+            vMax = _mm_max_epu8(vMax, v);
+        }
+        alignas(16) uint8_t lanes[2][16];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes[0]), vMin);
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes[1]), vMax);
+        for (int lane = 0; lane < 16; lane++) {
+            minAlpha = std::min(minAlpha, lanes[0][lane]);
+            maxAlpha = std::max(maxAlpha, lanes[1][lane]);
+        }
+    }
+#elif defined(MCVR_ALPHA_NEON)
+    if (count >= 16) {
+        uint8x16_t vMin = vdupq_n_u8(minAlpha);
+        uint8x16_t vMax = vdupq_n_u8(maxAlpha);
+        for (; i + 16 <= count; i += 16) {
+            uint8x16_t v = vld1q_u8(alpha + i);
+            vMin = vminq_u8(vMin, v);
+            vMax = vmaxq_u8(vMax, v);
+        }
+        minAlpha = vminvq_u8(vMin);
+        maxAlpha = vmaxvq_u8(vMax);
+    }
+#endif
+    for (; i < count; i++) {
+        minAlpha = std::min(minAlpha, alpha[i]);
+        maxAlpha = std::max(maxAlpha, alpha[i]);
+    }
+}
+
+void Textures::TextureAlphaData::resize(uint32_t width, uint32_t height) {
+    this->width = width;
+    this->height = height;
+    alpha.assign((size_t)width * height, 255);
+    uploadedWords = (width + 63) / 64;
+    uploaded.assign((size_t)uploadedWords * height, 0);
+
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    tileMinAlpha.assign((size_t)tilesX * tilesY, 255);
+    tileMaxAlpha.assign((size_t)tilesX * tilesY, 0);
+    uploadedTiles = 0;
+    opaqueTiles = 0;
+    tilesWithOpaqueTexel = 0;
+}
+
+bool Textures::TextureAlphaData::updateTiles(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1) {
+    bool newTexels = false;
+    for (uint32_t y = y0; y < y1; y++) {
+        uint64_t *row = uploaded.data() + (size_t)y * uploadedWords;
+        for (uint32_t x = x0; x < x1;) {
+            uint32_t bit = x % 64;
+            uint32_t count = std::min(64 - bit, x1 - x);
+            uint64_t bits = (count == 64 ? ~0ull : ((1ull << count) - 1)) << bit;
+            if ((row[x / 64] & bits) != bits) newTexels = true;
+            row[x / 64] |= bits;
+            x += count;
+        }
+    }
+
+    static_assert(64 % TILE_SIZE == 0, "a tile row has to lie in one word of the uploaded bits");
+    constexpr uint64_t tileRowBits = (1ull << TILE_SIZE) - 1;
+    for (uint32_t tileY = y0 / TILE_SIZE; tileY < (y1 + TILE_SIZE - 1) / TILE_SIZE; tileY++) {
+        for (uint32_t tileX = x0 / TILE_SIZE; tileX < (x1 + TILE_SIZE - 1) / TILE_SIZE; tileX++) {
+            uint32_t beginX = tileX * TILE_SIZE;
+            uint32_t beginY = tileY * TILE_SIZE;
+            uint32_t endX = std::min(beginX + TILE_SIZE, width);
+            uint32_t endY = std::min(beginY + TILE_SIZE, height);
+            uint64_t fullRow = tileRowBits >> (TILE_SIZE - (endX - beginX));
+
+            uint8_t minAlpha = 255, maxAlpha = 0;
+            bool any = false;
+            for (uint32_t y = beginY; y < endY; y++) {
+                const uint8_t *alphaRow = alpha.data() + (size_t)y * width;
+                uint64_t bits = (uploaded[(size_t)y * uploadedWords + beginX / 64] >> (beginX % 64)) & fullRow;
+                if (bits == fullRow) {
+                    accumulateAlphaRange(alphaRow + beginX, endX - beginX, minAlpha, maxAlpha);
+                } else {
+                    // texels never uploaded hold no alpha of the texture, they do not count
+                    for (; bits != 0; bits &= bits - 1) {
+                        uint8_t texel = alphaRow[beginX + std::countr_zero(bits)];
+                        minAlpha = std::min(minAlpha, texel);
+                        maxAlpha = std::max(maxAlpha, texel);
+                    }
+                }
+                any = any || bits != 0;
+            }
+
+            size_t tile = (size_t)tileY * tilesX + tileX;
+            bool wasAny = tileMaxAlpha[tile] >= tileMinAlpha[tile];
+            uploadedTiles += any - wasAny;
+            opaqueTiles += (any && minAlpha == 255) - (wasAny && tileMinAlpha[tile] == 255);
+            tilesWithOpaqueTexel += (maxAlpha == 255) - (tileMaxAlpha[tile] == 255);
+            tileMinAlpha[tile] = minAlpha;
+            tileMaxAlpha[tile] = maxAlpha;
+        }
+    }
+    return newTexels;
+}
+
+void Textures::TextureAlphaData::copyRegion(const TextureAlphaData &source, VkRect2D rect) {
+    for (uint32_t row = 0; row < rect.extent.height; row++) {
+        size_t offset = (size_t)(rect.offset.y + row) * width + rect.offset.x;
+        std::memcpy(alpha.data() + offset, source.alpha.data() + offset, rect.extent.width);
+    }
+    updateTiles(rect.offset.x, rect.offset.y, rect.offset.x + rect.extent.width, rect.offset.y + rect.extent.height);
+}
+
+void Textures::TextureAlphaData::alphaRange(
+    uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint8_t &minAlpha, uint8_t &maxAlpha) const {
+    minAlpha = 255;
+    maxAlpha = 0;
+    for (uint32_t tileY = y0 / TILE_SIZE; tileY <= y1 / TILE_SIZE; tileY++) {
+        for (uint32_t tileX = x0 / TILE_SIZE; tileX <= x1 / TILE_SIZE; tileX++) {
+            size_t tile = (size_t)tileY * tilesX + tileX;
+            minAlpha = std::min(minAlpha, tileMinAlpha[tile]);
+            maxAlpha = std::max(maxAlpha, tileMaxAlpha[tile]);
+        }
+    }
+}
+
+bool Textures::TextureAlphaData::uvAlphaRange(glm::vec2 uvMin,
+                                              glm::vec2 uvMax,
+                                              uint8_t &minAlpha,
+                                              uint8_t &maxAlpha) const {
+    if (!(uvMin.x >= 0.0f && uvMin.y >= 0.0f && uvMax.x < 1.0f && uvMax.y < 1.0f)) return false;
+    alphaRange(static_cast<uint32_t>(uvMin.x * width), static_cast<uint32_t>(uvMin.y * height),
+               static_cast<uint32_t>(uvMax.x * width), static_cast<uint32_t>(uvMax.y * height), minAlpha, maxAlpha);
+    return true;
+}
+
+Textures::AlphaClass Textures::TextureAlphaData::alphaClass() const {
+    if (opaqueTiles == uploadedTiles) return AlphaClass::FULLY_OPAQUE;
+    // no fully opaque texel at all, e.g. water, same meaning as the class pushed from java
+    if (tilesWithOpaqueTexel == 0) return AlphaClass::FULLY_TRANSPARENT;
+    return AlphaClass::MIXED;
+}
+
+Textures::Textures(std::shared_ptr<Framework> framework) {
+    stagingRing_ =
+        TextureStagingRing::create(framework->vma(), framework->device(), framework->swapchain()->imageCount());
+    uploadQueue_ = std::make_shared<std::map<uint32_t, std::vector<TextureUploadRegion>>>();
+}
 
 void Textures::reset() {
+    std::unique_lock<std::recursive_mutex> lck(mutex_);
+
     textures_.clear();
+    // the cached samplers go with the textures, a texture initialized after the reset acquires a new one
+    samplers.clear();
+    samplerCache_.clear();
+    pendingBindings_.clear();
     textureAlphaClass_.clear();
     textureAlphaData_.clear();
     nextID = 0;
@@ -25,13 +223,12 @@ void Textures::reset() {
 void Textures::resetFrame() {
     auto framework = Renderer::instance().framework();
 
+    std::unique_lock<std::recursive_mutex> lck(mutex_);
+
     framework->gc().collect(uploadQueue_);
-    uploadQueue_ = std::make_shared<std::map<uint32_t, std::vector<VkBufferImageCopy>>>();
+    uploadQueue_ = std::make_shared<std::map<uint32_t, std::vector<TextureUploadRegion>>>();
 
-    for (auto &entry : caches_) {
-        auto &cache = entry.second;
-        cache->reset();
-    }
+    stagingRing_->reset(framework->safeAcquireCurrentContext()->frameIndex);
 }
 
 uint32_t Textures::allocateTexture() {
@@ -64,16 +261,16 @@ void Textures::initializeTexture(uint32_t id, uint32_t maxLevel, uint32_t width,
         texturesCerr() << "The given texture id: " << id << " is not allocated for sampler" << std::endl;
         exit(EXIT_FAILURE);
     }
-    framework->gc().collect(samplers[id]);
-    samplers[id] =
-        vk::Sampler::create(device, VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+    samplers[id] = acquireSampler(VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT);
+
+    // the new image starts without contents, the next mip 0 upload publishes alpha data under a new revision even
+    // if the size did not change. Snapshots taken before keep the old data
+    textureAlphaData_.erase(id);
 
-    Renderer::instance().framework()->pipeline()->bindTexture(samplers[id], textures_[id], id);
+    pendingBindings_.insert(id);
 }
 
 void Textures::setSamplingMode(uint32_t id, VkFilter samplingMode, VkSamplerMipmapMode mipmapMode) {
-    auto device = Renderer::instance().framework()->device();
-
     std::unique_lock<std::recursive_mutex> lck(mutex_);
 
     auto samplerIter = samplers.find(id);
@@ -81,20 +278,14 @@ void Textures::setSamplingMode(uint32_t id, VkFilter samplingMode, VkSamplerMipm
         texturesCerr() << "The given texture id: " << id << " is not allocated for sampler" << std::endl;
         exit(EXIT_FAILURE);
     }
-    if (samplers[id]->vkSamplingMode() != samplingMode) {
-        VkSamplerAddressMode addressMode = samplers[id]->vkAddressMode();
-
-        auto framework = Renderer::instance().framework();
-        framework->gc().collect(samplers[id]);
-        samplers[id] = vk::Sampler::create(device, samplingMode, mipmapMode, addressMode);
-    }
+    auto sampler = acquireSampler(samplingMode, mipmapMode, samplers[id]->vkAddressMode());
+    if (sampler == samplers[id]) return;
 
-    Renderer::instance().framework()->pipeline()->bindTexture(samplers[id], textures_[id], id);
+    samplers[id] = sampler;
+    pendingBindings_.insert(id);
 }
 
 void Textures::setAddressMode(uint32_t id, VkSamplerAddressMode addressMode) {
-    auto device = Renderer::instance().framework()->device();
-
     std::unique_lock<std::recursive_mutex> lck(mutex_);
 
     auto samplerIter = samplers.find(id);
@@ -102,16 +293,11 @@ void Textures::setAddressMode(uint32_t id, VkSamplerAddressMode addressMode) {
         texturesCerr() << "The given texture id: " << id << " is not allocated for sampler" << std::endl;
         exit(EXIT_FAILURE);
     }
-    if (samplers[id]->vkAddressMode() != addressMode) {
-        VkFilter samplingMode = samplers[id]->vkSamplingMode();
-        VkSamplerMipmapMode mipmapMode = samplers[id]->vkMipmapMode();
+    auto sampler = acquireSampler(samplers[id]->vkSamplingMode(), samplers[id]->vkMipmapMode(), addressMode);
+    if (sampler == samplers[id]) return;
 
-        auto framework = Renderer::instance().framework();
-        framework->gc().collect(samplers[id]);
-        samplers[id] = vk::Sampler::create(device, samplingMode, mipmapMode, addressMode);
-    }
-
-    Renderer::instance().framework()->pipeline()->bindTexture(samplers[id], textures_[id], id);
+    samplers[id] = sampler;
+    pendingBindings_.insert(id);
 }
 
 void Textures::queueUpload(uint8_t *srcPointer,
@@ -125,93 +311,168 @@ void Textures::queueUpload(uint8_t *srcPointer,
                            uint32_t width,
                            uint32_t height,
                            uint32_t level) {
-    std::unique_lock<std::recursive_mutex> lck(mutex_);
-
     auto framework = Renderer::instance().framework();
 
-    auto device = Renderer::instance().framework()->device();
-    auto vma = Renderer::instance().framework()->vma();
-    auto dstTextureIter = textures_.find(dstId);
-    if (dstTextureIter == textures_.end()) {
-        texturesCerr() << "The dstID " << dstId << " is not registered yet!" << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    auto dstTexture = (*dstTextureIter).second;
-
-    auto cacheIter = caches_.find(dstId);
-    if (cacheIter == caches_.end()) {
-        cacheIter = caches_
-                        .emplace(std::make_pair(
-                            dstId, ImageBufferCache::create(vma, device, framework->swapchain()->imageCount())))
-                        .first;
+    std::shared_ptr<vk::DeviceLocalImage> dstTexture;
+    {
+        std::unique_lock<std::recursive_mutex> lck(mutex_);
+        auto dstTextureIter = textures_.find(dstId);
+        if (dstTextureIter == textures_.end()) {
+            texturesCerr() << "The dstID " << dstId << " is not registered yet!" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        dstTexture = (*dstTextureIter).second;
     }
 
-    auto cache = cacheIter->second;
-    size_t offset = cache->append(srcPointer, srcSizeInBytes);
-
     auto format = dstTexture->vkFormat();
     uint32_t bytePerPixel = vk::formatToByte(format);
 
+    if (width == 0 || height == 0) return;
+    size_t srcEnd = ((size_t)(srcOffsetY + height - 1) * srcRowPixels + srcOffsetX + width) * bytePerPixel;
+    if (srcEnd > srcSizeInBytes) {
+        texturesCerr() << "The upload region of texture " << dstId << " exceeds its source data" << std::endl;
+        return;
+    }
+    const uint8_t *src = srcPointer + ((size_t)srcOffsetY * srcRowPixels + srcOffsetX) * bytePerPixel;
+
+#ifdef MCVR_ENABLE_OMM
+    // Extract alpha channel for OMM baking (mip 0 only, RGBA formats = 4 bpp). Done before taking the lock, only
+    // publishing the extracted region needs it
+    VkRect2D alphaRect = {};
+    std::vector<uint8_t> alpha;
+    uint32_t texW = dstTexture->width();
+    uint32_t texH = dstTexture->height();
+    if (level == 0 && bytePerPixel == 4 && dstOffsetX >= 0 && dstOffsetY >= 0 && (uint32_t)dstOffsetX < texW &&
+        (uint32_t)dstOffsetY < texH) {
+        alphaRect.offset = {dstOffsetX, dstOffsetY};
+        alphaRect.extent = {std::min(width, texW - dstOffsetX), std::min(height, texH - dstOffsetY)};
+        alpha.resize((size_t)alphaRect.extent.width * alphaRect.extent.height);
+        for (uint32_t row = 0; row < alphaRect.extent.height; ++row) {
+            extractAlphaRow(src + (size_t)row * srcRowPixels * 4, alpha.data() + (size_t)row * alphaRect.extent.width,
+                            alphaRect.extent.width);
+        }
+    }
+#endif
+
+    std::unique_lock<std::recursive_mutex> lck(mutex_);
+
+    // only the uploaded rectangle is staged, tightly packed
+    size_t rowBytes = (size_t)width * bytePerPixel;
+    auto staging =
+        stagingRing_->allocate(framework->safeAcquireCurrentContext()->frameIndex, rowBytes * height);
+    if (srcRowPixels == width) {
+        std::memcpy(staging.mappedPtr, src, rowBytes * height);
+    } else {
+        for (uint32_t row = 0; row < height; row++) {
+            std::memcpy(staging.mappedPtr + row * rowBytes, src + (size_t)row * srcRowPixels * bytePerPixel,
+                        rowBytes);
+        }
+    }
+
     VkBufferImageCopy region = {};
-    region.bufferRowLength = srcRowPixels;
-    region.bufferOffset = offset + srcOffsetY * srcRowPixels * bytePerPixel + srcOffsetX * bytePerPixel;
+    region.bufferOffset = staging.offset;
+    region.bufferRowLength = width;
     region.imageSubresource = vk::wholeColorSubresourceLayers;
     region.imageSubresource.mipLevel = level;
     region.imageExtent = {width, height, 1};
     region.imageOffset = {dstOffsetX, dstOffsetY, 0};
 
-    auto dstTextureUploadQueueIter = uploadQueue_->find(dstId);
-    if (dstTextureUploadQueueIter == uploadQueue_->end()) {
-        dstTextureUploadQueueIter = uploadQueue_->emplace(dstId, std::vector<VkBufferImageCopy>{}).first;
-    }
-    dstTextureUploadQueueIter->second.emplace_back(region);
+    // queued uploads this one overwrites completely are dropped, animated sprites re-upload the same rectangle a lot.
+    // Partially overlapped ones stay, performQueuedUpload copies them in order
+    auto &regions = (*uploadQueue_)[dstId];
+    std::erase_if(regions, [&region](const TextureUploadRegion &queued) {
+        const VkBufferImageCopy &covered = queued.region;
+        return covered.imageSubresource.mipLevel == region.imageSubresource.mipLevel &&
+               covered.imageOffset.x >= region.imageOffset.x && covered.imageOffset.y >= region.imageOffset.y &&
+               (int64_t)covered.imageOffset.x + covered.imageExtent.width <=
+                   (int64_t)region.imageOffset.x + region.imageExtent.width &&
+               (int64_t)covered.imageOffset.y + covered.imageExtent.height <=
+                   (int64_t)region.imageOffset.y + region.imageExtent.height;
+    });
+    regions.push_back({staging.buffer, region});
 
 #ifdef MCVR_ENABLE_OMM
-    // Extract alpha channel for OMM baking (mip 0 only, RGBA formats = 4 bpp)
-    if (level == 0 && bytePerPixel == 4) {
-        uint32_t texW = dstTexture->width();
-        uint32_t texH = dstTexture->height();
-
-        auto it = textureAlphaData_.find(dstId);
-        if (it != textureAlphaData_.end()) {
-            // Re-upload: alpha data is overwritten below, no special handling needed
+    // a texture initialized again meanwhile dropped its alpha data, the extracted region belongs to the old image
+    auto currentIter = textures_.find(dstId);
+    if (!alpha.empty() && currentIter != textures_.end() && currentIter->second == dstTexture) {
+        publishAlpha(dstId, texW, texH, alphaRect, alpha.data());
+    }
+#endif
+}
+
+void Textures::publishAlpha(uint32_t id, uint32_t texW, uint32_t texH, VkRect2D rect, const uint8_t *alpha) {
+    // chunk build workers read the published data without the lock, so it is only written while nobody holds a
+    // snapshot of it. Otherwise the spare buffer catches up on the regions it missed and is published instead.
+    // Snapshots are only taken under the lock, none can appear meanwhile
+    auto &buffers = textureAlphaData_[id];
+    bool changed = false;
+    if (buffers.published == nullptr || buffers.published->width != texW || buffers.published->height != texH) {
+        buffers = {};
+        buffers.published = std::make_shared<TextureAlphaData>();
+        buffers.published->resize(texW, texH);
+        changed = true;
+    } else if (buffers.published.use_count() > 1) {
+        std::shared_ptr<TextureAlphaData> next;
+        if (buffers.spare != nullptr && buffers.spare.use_count() == 1) {
+            next = std::move(buffers.spare);
+            for (const VkRect2D &missing : buffers.spareMissing) next->copyRegion(*buffers.published, missing);
+            next->revision = buffers.published->revision;
         } else {
-            TextureAlphaData &data = textureAlphaData_[dstId];
-            data.width = texW;
-            data.height = texH;
-            data.alpha.resize(texW * texH, 255);
-            data.animated = false;
-            it = textureAlphaData_.find(dstId);
+            // snapshots of both buffers are still read, only then the whole texture is copied
+            next = std::make_shared<TextureAlphaData>(*buffers.published);
         }
-
-        TextureAlphaData &data = it->second;
-        // Copy alpha channel from the uploaded RGBA region
-        for (uint32_t row = 0; row < height; ++row) {
-            uint32_t srcRow = srcOffsetY + row;
-            uint32_t dstRow = dstOffsetY + row;
-            if (dstRow >= texH) break;
-            for (uint32_t col = 0; col < width; ++col) {
-                uint32_t srcCol = srcOffsetX + col;
-                uint32_t dstCol = dstOffsetX + col;
-                if (dstCol >= texW) break;
-                size_t srcIdx = (srcRow * srcRowPixels + srcCol) * 4 + 3; // alpha byte
-                data.alpha[dstRow * texW + dstCol] = srcPointer[srcIdx];
-            }
+        buffers.spare = std::move(buffers.published);
+        buffers.spareMissing.clear();
+        buffers.published = std::move(next);
+    }
+    TextureAlphaData &data = *buffers.published;
+
+    // Animated textures re-upload the same frames over and over, only alpha that differs from what bakes may have
+    // used invalidates them
+    uint32_t x0 = rect.offset.x, y0 = rect.offset.y;
+    for (uint32_t row = 0; row < rect.extent.height; ++row) {
+        uint8_t *dst = data.alpha.data() + (size_t)(y0 + row) * texW + x0;
+        const uint8_t *extracted = alpha + (size_t)row * rect.extent.width;
+        if (std::memcmp(dst, extracted, rect.extent.width) != 0) {
+            std::memcpy(dst, extracted, rect.extent.width);
+            changed = true;
         }
     }
-#endif
+    if (data.updateTiles(x0, y0, x0 + rect.extent.width, y0 + rect.extent.height)) changed = true;
+    if (!changed) return;
+    data.revision = ++nextAlphaRevision_;
+
+    // the spare buffer misses this region now, a region it already misses covers repeated uploads of a sprite
+    if (buffers.spare == nullptr) return;
+    bool covered = std::any_of(buffers.spareMissing.begin(), buffers.spareMissing.end(), [&rect](const VkRect2D &r) {
+        return r.offset.x <= rect.offset.x && r.offset.y <= rect.offset.y &&
+               r.offset.x + r.extent.width >= rect.offset.x + rect.extent.width &&
+               r.offset.y + r.extent.height >= rect.offset.y + rect.extent.height;
+    });
+    if (covered) return;
+    buffers.spareMissing.push_back(rect);
+    if (buffers.spareMissing.size() > AlphaBuffers::MAX_SPARE_MISSING) {
+        // catching up would cost more than the copy made without a spare
+        buffers.spare = nullptr;
+        buffers.spareMissing.clear();
+    }
 }
 
 void Textures::performQueuedUpload() {
     std::unique_lock<std::recursive_mutex> lck(mutex_);
 
-    std::shared_ptr<vk::CommandBuffer> cmdBuffer =
-        Renderer::instance().framework()->safeAcquireCurrentContext()->uploadCommandBuffer;
+    if (uploadQueue_->empty()) return;
+
+    auto context = Renderer::instance().framework()->safeAcquireCurrentContext();
+    std::shared_ptr<vk::CommandBuffer> cmdBuffer = context->uploadCommandBuffer;
 
     auto physicalDevice = Renderer::instance().framework()->physicalDevice();
     auto mainQueueIndex = physicalDevice->mainQueueIndex();
 
+    stagingRing_->flush(context->frameIndex);
+
     std::vector<vk::CommandBuffer::ImageMemoryBarrier> uploadPreImageBarriers, uploadPostImageBarriers;
+    std::vector<std::shared_ptr<vk::DeviceLocalImage>> uploadTextures;
 
     for (auto &entry : *uploadQueue_) {
         auto &textureId = entry.first;
@@ -221,6 +482,8 @@ void Textures::performQueuedUpload() {
             exit(EXIT_FAILURE);
         }
         auto texture = textureIter->second;
+        uploadTextures.push_back(texture);
+
         uploadPreImageBarriers.push_back({
             .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
             .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
@@ -253,46 +516,60 @@ void Textures::performQueuedUpload() {
 
     cmdBuffer->barriersBufferImage({}, uploadPreImageBarriers);
 
-    for (auto &entry : *uploadQueue_) {
-        auto &textureId = entry.first;
-        auto &regions = entry.second;
+    // one copy per texture and staging block, a block is only chained when a frame outgrows the ring slot. The regions
+    // of a copy must not overlap and are written in no particular order, so a region overlapping an earlier one
+    // starts another copy behind a barrier
+    std::vector<VkBufferImageCopy> regions;
+    std::vector<VkBufferImageCopy> sinceBarrier;
+    for (int i = 0; auto &entry : *uploadQueue_) {
+        auto &queued = entry.second;
+        auto texture = uploadTextures[i++];
+        sinceBarrier.clear();
+
+        auto overlapsCopied = [&sinceBarrier](const VkBufferImageCopy &region) {
+            return std::any_of(sinceBarrier.begin(), sinceBarrier.end(),
+                               [&region](const VkBufferImageCopy &copied) { return uploadsOverlap(copied, region); });
+        };
+
+        for (size_t begin = 0; begin < queued.size();) {
+            if (overlapsCopied(queued[begin].region)) {
+                cmdBuffer->barriersBufferImage(
+                    {}, {{
+                            .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                            .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                            .dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                            .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            .srcQueueFamilyIndex = mainQueueIndex,
+                            .dstQueueFamilyIndex = mainQueueIndex,
+                            .image = texture,
+                            .subresourceRange = vk::wholeColorSubresourceRange,
+                        }});
+                sinceBarrier.clear();
+            }
 
-        auto textureIter = textures_.find(textureId);
-        if (textureIter == textures_.end()) {
-            texturesCerr() << "The textureId " << textureId << " is not registered yet!" << std::endl;
-            exit(EXIT_FAILURE);
-        }
-        auto texture = textureIter->second;
+            VkBuffer buffer = queued[begin].buffer;
+            regions.clear();
+            size_t end = begin;
+            for (; end < queued.size() && queued[end].buffer == buffer && !overlapsCopied(queued[end].region); end++) {
+                regions.push_back(queued[end].region);
+                sinceBarrier.push_back(queued[end].region);
+            }
 
-        auto cacheIter = caches_.find(textureId);
-        if (cacheIter == caches_.end()) { continue; }
-        auto cache = cacheIter->second;
-
-        vkCmdCopyBufferToImage(cmdBuffer->vkCommandBuffer(), cache->vkBuffer(), texture->vkImage(),
-                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data());
-
-        cmdBuffer->barriersBufferImage(
-            {}, {{
-                    .srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                    .srcAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                    .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
-                                    VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                    .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
-                    .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                    .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                    .srcQueueFamilyIndex = mainQueueIndex,
-                    .dstQueueFamilyIndex = mainQueueIndex,
-                    .image = texture,
-                    .subresourceRange = vk::wholeColorSubresourceRange,
-                }});
+            vkCmdCopyBufferToImage(cmdBuffer->vkCommandBuffer(), buffer, texture->vkImage(),
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data());
+            begin = end;
+        }
     }
 
     cmdBuffer->barriersBufferImage({}, uploadPostImageBarriers);
+
+    // everything is recorded, later uploads of this frame start a new batch
+    uploadQueue_->clear();
 }
 
 void Textures::bindAllTextures() {
-    auto device = Renderer::instance().framework()->device();
-
     std::unique_lock<std::recursive_mutex> lck(mutex_);
 
     for (const auto &[id, texture] : textures_) {
@@ -300,16 +577,53 @@ void Textures::bindAllTextures() {
             continue; // only allocated, but not initialized yet
         }
 
-        Renderer::instance().framework()->pipeline()->bindTexture(samplers[id], texture, id);
+        pendingBindings_.insert(id);
     }
 }
 
+void Textures::flushBindings() {
+    auto pipeline = Renderer::instance().framework()->pipeline();
+
+    std::unique_lock<std::recursive_mutex> lck(mutex_);
+
+    if (pendingBindings_.empty()) return;
+
+    // a texture touched several times this frame is bound once with its final sampler and image
+    for (uint32_t id : pendingBindings_) {
+        auto textureIter = textures_.find(id);
+        if (textureIter == textures_.end() || textureIter->second == nullptr) continue;
+
+        pipeline->bindTexture(samplers[id], textureIter->second, id);
+    }
+    pendingBindings_.clear();
+
+    pipeline->flushTextureBindings();
+}
+
+std::shared_ptr<vk::Sampler>
+Textures::acquireSampler(VkFilter samplingMode, VkSamplerMipmapMode mipmapMode, VkSamplerAddressMode addressMode) {
+    auto &sampler = samplerCache_[std::make_tuple(samplingMode, mipmapMode, addressMode)];
+    if (sampler == nullptr) {
+        sampler = vk::Sampler::create(Renderer::instance().framework()->device(), samplingMode, mipmapMode,
+                                      addressMode);
+    }
+    return sampler;
+}
+
 void Textures::setTextureAlphaClass(uint32_t id, AlphaClass alphaClass) {
     std::unique_lock<std::recursive_mutex> lck(mutex_);
     textureAlphaClass_[id] = alphaClass;
 }
 
 Textures::AlphaClass Textures::getTextureAlphaClass(uint32_t id) const {
+    std::unique_lock<std::recursive_mutex> lck(mutex_);
+
+    // classified from the uploaded texels when they were captured, so re-uploads are reflected
+    auto dataIter = textureAlphaData_.find(id);
+    if (dataIter != textureAlphaData_.end() && dataIter->second.published->uploadedTiles > 0) {
+        return dataIter->second.published->alphaClass();
+    }
+
     auto it = textureAlphaClass_.find(id);
     if (it != textureAlphaClass_.end()) {
         return it->second;
@@ -318,64 +632,60 @@ Textures::AlphaClass Textures::getTextureAlphaClass(uint32_t id) const {
     return AlphaClass::MIXED;
 }
 
-const Textures::TextureAlphaData *Textures::getTextureAlphaData(uint32_t id) const {
+std::shared_ptr<const Textures::TextureAlphaData> Textures::getTextureAlphaData(uint32_t id) const {
+    std::unique_lock<std::recursive_mutex> lck(mutex_);
+
     auto it = textureAlphaData_.find(id);
     if (it != textureAlphaData_.end()) {
-        return &it->second;
+        return it->second.published;
     }
     return nullptr;
 }
 
-ImageBufferCache::ImageBufferCache(std::shared_ptr<vk::VMA> vma, std::shared_ptr<vk::Device> device, uint32_t frameNum)
+TextureStagingRing::TextureStagingRing(std::shared_ptr<vk::VMA> vma,
+                                       std::shared_ptr<vk::Device> device,
+                                       uint32_t frameNum)
     : vma_(vma), device_(device) {
-    capacities_.resize(frameNum);
-    bases_.resize(frameNum);
-    caches_.resize(frameNum);
-
-    for (int i = 0; i < frameNum; i++) {
-        caches_[i] = vk::HostVisibleBuffer::create(vma_, device_, BASE_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-        capacities_[i] = BASE_SIZE;
-        bases_[i] = 0;
-    }
+    slots_.resize(frameNum);
 }
 
-ImageBufferCache::~ImageBufferCache() {
-#ifdef DEBUG
-// std::cout << "ImageBufferCache deconstructed" << std::endl;
-#endif
-}
-
-size_t ImageBufferCache::append(void *src, size_t size) {
-    if (bases_[current_] + size >= capacities_[current_]) {
-        size_t newCapacity = capacities_[current_] * 2;
-
-        while (newCapacity < bases_[current_] + size) { newCapacity *= 2; }
+TextureStagingRing::Allocation TextureStagingRing::allocate(uint32_t frameIndex, size_t size) {
+    auto &slot = slots_[frameIndex];
 
-        auto newCache = vk::HostVisibleBuffer::create(vma_, device_, newCapacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-
-        std::memcpy(newCache->mappedPtr(), caches_[current_]->mappedPtr(), bases_[current_]);
-
-        auto framework = Renderer::instance().framework();
-        framework->gc().collect(caches_[current_]);
-        caches_[current_] = newCache;
-        capacities_[current_] = newCapacity;
+    size_t offset = slot.empty() ? 0 : (slot.back().head + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (slot.empty() || offset + size > slot.back().buffer->size()) {
+        size_t capacity = slot.empty() ? BASE_SIZE : slot.back().buffer->size() * 2;
+        while (capacity < size) capacity *= 2;
+        slot.push_back({vk::HostVisibleBuffer::create(vma_, device_, capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT), 0});
+        offset = 0;
     }
 
-    size_t ret = bases_[current_];
-    std::memcpy(static_cast<uint8_t *>(caches_[current_]->mappedPtr()) + bases_[current_], src, size);
-    bases_[current_] = (bases_[current_] + size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
-    return ret;
+    auto &block = slot.back();
+    block.head = offset + size;
+    return {
+        .buffer = block.buffer->vkBuffer(),
+        .offset = offset,
+        .mappedPtr = static_cast<uint8_t *>(block.buffer->mappedPtr()) + offset,
+    };
 }
 
-void ImageBufferCache::flush() {
-    caches_[current_]->flush();
+void TextureStagingRing::flush(uint32_t frameIndex) {
+    for (auto &block : slots_[frameIndex]) {
+        if (block.head > 0) block.buffer->flush();
+    }
 }
 
-VkBuffer &ImageBufferCache::vkBuffer() {
-    return caches_[current_]->vkBuffer();
-}
+void TextureStagingRing::reset(uint32_t frameIndex) {
+    auto &slot = slots_[frameIndex];
+    if (slot.size() > 1) {
+        // merge the chained blocks into one that fits the whole frame next time
+        size_t capacity = 0;
+        for (auto &block : slot) capacity += block.buffer->size();
 
-void ImageBufferCache::reset() {
-    current_ = (current_ + 1) % caches_.size();
-    bases_[current_] = 0;
-}
\ No newline at end of file
+        auto framework = Renderer::instance().framework();
+        for (auto &block : slot) framework->gc().collect(block.buffer);
+        slot.clear();
+        slot.push_back({vk::HostVisibleBuffer::create(vma_, device_, capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT), 0});
+    }
+    for (auto &block : slot) block.head = 0;
+}
@@ -7,10 +7,17 @@
 #include <functional>
 #include <map>
 #include <mutex>
+#include <set>
+#include <tuple>
 
 class Framework;
 
-class ImageBufferCache;
+class TextureStagingRing;
+
+struct TextureUploadRegion {
+    VkBuffer buffer;
+    VkBufferImageCopy region;
+};
 
 class Textures : public SharedObject<Textures> {
   public:
@@ -18,10 +25,41 @@ class Textures : public SharedObject<Textures> {
     enum class AlphaClass : int32_t { FULLY_OPAQUE = 0, FULLY_TRANSPARENT = 1, MIXED = 2 };
 
     struct TextureAlphaData {
+        constexpr static uint32_t TILE_SIZE = 16;
+        constexpr static float ALPHA_CUTOFF = 0.05f; // texels below are cut out, the OMM bake uses the same cutoff
+
         std::vector<uint8_t> alpha; // single-channel, 1 byte per texel
         uint32_t width = 0;
         uint32_t height = 0;
         bool animated = false; // true if re-uploaded (animation frame change)
+        uint64_t revision = 0; // new whenever the texture is (re)allocated or the alpha of its mip 0 changes
+
+        // a bit per texel, set once the texel was uploaded, rows of uploadedWords words
+        std::vector<uint64_t> uploaded;
+        uint32_t uploadedWords = 0;
+
+        // alpha range of the uploaded texels of every TILE_SIZE x TILE_SIZE tile, lets OMM baking skip uniform
+        // regions. A tile without uploaded texels has the empty range [255, 0]
+        uint32_t tilesX = 0;
+        uint32_t tilesY = 0;
+        std::vector<uint8_t> tileMinAlpha;
+        std::vector<uint8_t> tileMaxAlpha;
+        uint32_t uploadedTiles = 0;        // tiles with at least one uploaded texel
+        uint32_t opaqueTiles = 0;          // of those, tiles with every uploaded texel at 255
+        uint32_t tilesWithOpaqueTexel = 0; // tiles with at least one uploaded texel at 255
+
+        void resize(uint32_t width, uint32_t height);
+        // the texel rectangle [x0, x1) x [y0, y1) was uploaded, recompute the tiles overlapping it. True if some of
+        // its texels had not been uploaded before
+        bool updateTiles(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1);
+        // takes over the texels of the uploaded rectangle from source, which has the same size
+        void copyRegion(const TextureAlphaData &source, VkRect2D rect);
+        // conservative alpha range of the inclusive texel rectangle, taken from the tiles it touches
+        void alphaRange(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint8_t &minAlpha, uint8_t &maxAlpha) const;
+        // alphaRange of the texels under the uv rectangle, false for wrapped or degenerate coordinates
+        bool uvAlphaRange(glm::vec2 uvMin, glm::vec2 uvMax, uint8_t &minAlpha, uint8_t &maxAlpha) const;
+        // of the uploaded texels, only meaningful with uploadedTiles > 0
+        AlphaClass alphaClass() const;
     };
 
     Textures(std::shared_ptr<Framework> framework);
@@ -45,45 +83,75 @@ class Textures : public SharedObject<Textures> {
                      uint32_t level);
     void performQueuedUpload();
     void bindAllTextures();
+    // push texture bindings changed since the last flush to the pipeline, once per frame
+    void flushBindings();
 
     void setTextureAlphaClass(uint32_t id, AlphaClass alphaClass);
     AlphaClass getTextureAlphaClass(uint32_t id) const;
 
-    const TextureAlphaData *getTextureAlphaData(uint32_t id) const;
+    // a snapshot, later uploads publish a new one instead of writing to the data a chunk build worker reads
+    std::shared_ptr<const TextureAlphaData> getTextureAlphaData(uint32_t id) const;
 
   private:
+    // the published and spare alpha data of a texture, the spare one becomes the published one when a build worker
+    // still reads the published one on an upload, so only the missed regions are copied and not the whole texture
+    struct AlphaBuffers {
+        constexpr static size_t MAX_SPARE_MISSING = 64;
+
+        std::shared_ptr<TextureAlphaData> published;
+        std::shared_ptr<TextureAlphaData> spare;
+        std::vector<VkRect2D> spareMissing; // regions written to the published data since spare was last in sync
+    };
+
+    std::shared_ptr<vk::Sampler>
+    acquireSampler(VkFilter samplingMode, VkSamplerMipmapMode mipmapMode, VkSamplerAddressMode addressMode);
+    // the extracted alpha of the rectangle of a mip 0 upload, tightly packed. Called with the lock held
+    void publishAlpha(uint32_t id, uint32_t texW, uint32_t texH, VkRect2D rect, const uint8_t *alpha);
+
     std::map<uint32_t, std::shared_ptr<vk::DeviceLocalImage>> textures_;
     std::map<uint32_t, std::shared_ptr<vk::Sampler>> samplers;
+    // samplers are shared between textures, anisotropy is always disabled in vk::Sampler so it is not part of the key
+    std::map<std::tuple<VkFilter, VkSamplerMipmapMode, VkSamplerAddressMode>, std::shared_ptr<vk::Sampler>>
+        samplerCache_;
+    std::set<uint32_t> pendingBindings_;
     uint32_t nextID = 0;
-    std::recursive_mutex mutex_;
+    mutable std::recursive_mutex mutex_;
 
-    std::map<uint32_t, std::shared_ptr<ImageBufferCache>> caches_;
-    std::shared_ptr<std::map<uint32_t, std::vector<VkBufferImageCopy>>> uploadQueue_;
+    std::shared_ptr<TextureStagingRing> stagingRing_;
+    std::shared_ptr<std::map<uint32_t, std::vector<TextureUploadRegion>>> uploadQueue_;
 
     std::map<uint32_t, AlphaClass> textureAlphaClass_;
-    std::map<uint32_t, TextureAlphaData> textureAlphaData_;
+    std::map<uint32_t, AlphaBuffers> textureAlphaData_;
+    uint64_t nextAlphaRevision_ = 0;
 };
 
-class ImageBufferCache : public SharedObject<ImageBufferCache> {
+// staging memory shared by all texture uploads, one slot per frame in flight,
+// a slot chains another block when a frame outgrows it and is merged back into a single block on reset
+class TextureStagingRing : public SharedObject<TextureStagingRing> {
   public:
-    constexpr static size_t BASE_SIZE = 16 * 1024; // 1KB
-    constexpr static size_t ALIGNMENT = 4;
+    constexpr static size_t BASE_SIZE = 1024 * 1024;
+    constexpr static size_t ALIGNMENT = 16; // multiple of every texel size, as required for bufferOffset
 
-    ImageBufferCache(std::shared_ptr<vk::VMA> vma, std::shared_ptr<vk::Device> device, uint32_t frameNum);
-    ~ImageBufferCache();
+    struct Allocation {
+        VkBuffer buffer;
+        size_t offset;
+        uint8_t *mappedPtr;
+    };
 
-    size_t append(void *src, size_t size);
-    void flush();
-    void reset();
+    TextureStagingRing(std::shared_ptr<vk::VMA> vma, std::shared_ptr<vk::Device> device, uint32_t frameNum);
 
-    VkBuffer &vkBuffer();
+    Allocation allocate(uint32_t frameIndex, size_t size);
+    void flush(uint32_t frameIndex);
+    void reset(uint32_t frameIndex);
 
   private:
+    struct Block {
+        std::shared_ptr<vk::HostVisibleBuffer> buffer;
+        size_t head = 0;
+    };
+
     std::shared_ptr<vk::VMA> vma_;
     std::shared_ptr<vk::Device> device_;
 
-    uint32_t current_ = 0;
-    std::vector<size_t> capacities_;
-    std::vector<size_t> bases_;
-    std::vector<std::shared_ptr<vk::HostVisibleBuffer>> caches_;
-};
\ No newline at end of file
+    std::vector<std::vector<Block>> slots_;
+};
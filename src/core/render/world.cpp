@@ -1,17 +1,33 @@
 #include "core/render/world.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
+#include <iostream>
 
 #include "core/render/buffers.hpp"
+#include "core/render/build_trace.hpp"
 #include "core/render/chunks.hpp"
 #include "core/render/entities.hpp"
 #include "core/render/render_framework.hpp"
 #include "core/render/renderer.hpp"
 
 World::World(std::shared_ptr<Framework> framework)
-    : chunks_(Chunks::create(framework)), entities_(Entities::create(framework)) {}
+    : chunks_(Chunks::create(framework)),
+      entities_(Entities::create(framework)),
+      buildTraceRecorder_(BuildTraceRecorder::create()) {}
 
-void World::resetFrame() {}
+void World::resetFrame() {
+    if (buildTraceRecorder_->recording()) buildTraceRecorder_->recordFrame(cameraPos_);
+
+    std::unique_lock<std::mutex> lck(buildTraceReplayMutex_);
+    if (buildTraceReplayer_ == nullptr) return;
+
+    WorldBuildTraceTarget target;
+    if (!buildTraceReplayer_->replayFrame(target)) {
+        lastBuildTraceReplayReport_ = buildTraceReplayer_->report().format();
+        buildTraceReplayer_ = nullptr;
+        std::cout << "[BuildTrace] replay finished\n" << lastBuildTraceReplayReport_ << std::flush;
+    }
+}
 
 bool &World::shouldRender() {
     return shouldRenderWorld_;
@@ -25,6 +41,25 @@ std::shared_ptr<Entities> World::entities() {
     return entities_;
 }
 
+std::shared_ptr<BuildTraceRecorder> World::buildTraceRecorder() {
+    return buildTraceRecorder_;
+}
+
+bool World::startBuildTraceReplay(const std::string &path) {
+    auto replayer = BuildTraceReplayer::create();
+    if (!replayer->open(path)) return false;
+
+    std::unique_lock<std::mutex> lck(buildTraceReplayMutex_);
+    buildTraceReplayer_ = replayer;
+    return true;
+}
+
+std::string World::buildTraceReplayReport() {
+    std::unique_lock<std::mutex> lck(buildTraceReplayMutex_);
+    if (buildTraceReplayer_ != nullptr) return buildTraceReplayer_->report().format();
+    return lastBuildTraceReplayReport_;
+}
+
 void World::setCameraPos(glm::dvec3 cameraPos) {
     cameraPos_ = cameraPos;
 }
@@ -35,5 +70,6 @@ glm::dvec3 World::getCameraPos() {
 
 void World::close() {
     shouldRenderWorld_ = false;
+    buildTraceRecorder_->stop();
     chunks_->close();
 }
\ No newline at end of file
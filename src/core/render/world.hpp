@@ -7,11 +7,15 @@
 
 #include <condition_variable>
 #include <future>
+#include <mutex>
+#include <string>
 #include <thread>
 
 class Framework;
 class Chunks;
 class Entities;
+class BuildTraceRecorder;
+class BuildTraceReplayer;
 
 class World : public SharedObject<World> {
   public:
@@ -63,11 +67,18 @@ class World : public SharedObject<World> {
 
     World(std::shared_ptr<Framework> framework);
 
+    // called after Chunks and Entities started their frame, so replayed builds land in the current batches
     void resetFrame();
     bool &shouldRender();
 
     std::shared_ptr<Chunks> chunks();
     std::shared_ptr<Entities> entities();
+    std::shared_ptr<BuildTraceRecorder> buildTraceRecorder();
+
+    // feeds a recorded build trace into this world, one recorded frame per rendered frame
+    bool startBuildTraceReplay(const std::string &path);
+    // report of the running replay, or of the last finished one
+    std::string buildTraceReplayReport();
 
     void setCameraPos(glm::dvec3 cameraPos);
     glm::dvec3 getCameraPos();
@@ -78,6 +89,11 @@ class World : public SharedObject<World> {
     std::shared_ptr<Chunks> chunks_;
     std::shared_ptr<Entities> entities_;
 
+    std::shared_ptr<BuildTraceRecorder> buildTraceRecorder_;
+    std::mutex buildTraceReplayMutex_;
+    std::shared_ptr<BuildTraceReplayer> buildTraceReplayer_;
+    std::string lastBuildTraceReplayReport_;
+
     glm::dvec3 cameraPos_ = {0, 0, 0};
 
     bool shouldRenderWorld_;
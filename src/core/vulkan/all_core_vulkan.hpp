@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/vulkan/barrier.hpp"
 #include "core/vulkan/buffer.hpp"
 #include "core/vulkan/command.hpp"
 #include "core/vulkan/descriptor.hpp"
@@ -85,6 +85,12 @@ vk::BLASBuilder::BLASGeometryBuilder &vk::BLASBuilder::BLASGeometryBuilder::defi
     return *this;
 }
 
+vk::BLASBuilder::BLASGeometryBuilder &
+vk::BLASBuilder::BLASGeometryBuilder::defineGeometryTransform(VkDeviceAddress transformAddress) {
+    geometries.back().geometry.triangles.transformData.deviceAddress = transformAddress;
+    return *this;
+}
+
 std::shared_ptr<vk::BLASBuilder> vk::BLASBuilder::BLASGeometryBuilder::endGeometries() {
     return parent.shared_from_this();
 }
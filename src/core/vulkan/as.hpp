@@ -105,6 +105,8 @@ class BLASBuilder : public SharedObject<BLASBuilder> {
             uint32_t usageCountsCount);
 
         BLASGeometryBuilder &definePlaceholderGeometry();
+        // places the last defined geometry with the VkTransformMatrixKHR at transformAddress
+        BLASGeometryBuilder &defineGeometryTransform(VkDeviceAddress transformAddress);
 
         std::shared_ptr<BLASBuilder> endGeometries();
     };
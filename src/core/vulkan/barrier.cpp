@@ -0,0 +1,163 @@
+#include "core/vulkan/barrier.hpp"
+
+#include "core/vulkan/buffer.hpp"
+#include "core/vulkan/image.hpp"
+
+namespace {
+
+constexpr VkAccessFlags2 WRITE_ACCESS =
+    VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT |
+    VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+} // namespace
+
+vk::BarrierTracker::BarrierTracker(std::shared_ptr<CommandBuffer> commandBuffer, uint32_t queueFamilyIndex)
+    : commandBuffer_(commandBuffer), queueFamilyIndex_(queueFamilyIndex) {}
+
+vk::BarrierTracker &vk::BarrierTracker::external(std::shared_ptr<DeviceLocalImage> image,
+                                                 VkPipelineStageFlags2 stageMask,
+                                                 VkAccessFlags2 accessMask) {
+    states_[image.get()] = {
+        .writeStages = stageMask,
+        .writeAccess = accessMask & WRITE_ACCESS,
+    };
+    return *this;
+}
+
+vk::BarrierTracker &vk::BarrierTracker::external(std::shared_ptr<Buffer> buffer,
+                                                 VkPipelineStageFlags2 stageMask,
+                                                 VkAccessFlags2 accessMask) {
+    states_[buffer.get()] = {
+        .writeStages = stageMask,
+        .writeAccess = accessMask & WRITE_ACCESS,
+    };
+    return *this;
+}
+
+vk::BarrierTracker &vk::BarrierTracker::use(std::shared_ptr<DeviceLocalImage> image,
+                                            ResourceAccess access,
+                                            VkImageSubresourceRange subresourceRange) {
+    auto it = states_.find(image.get());
+    if (it == states_.end()) {
+        it = states_.emplace(image.get(), unknownState(image->imageLayout() == VK_IMAGE_LAYOUT_UNDEFINED)).first;
+    }
+
+    bool layoutChange = image->imageLayout() != access.layout;
+    // a second transition or write in the same pass has to wait for the first one
+    if (it->second.pendingBarrier >= 0 && (layoutChange || (access.accessMask & WRITE_ACCESS))) flush();
+
+    CommandBuffer::MemoryBarrier masks{};
+    if (transition(it->second, access, layoutChange, masks)) {
+        if (it->second.pendingBarrier >= 0) {
+            auto &pending = imageBarriers_[it->second.pendingBarrier];
+            pending.dstStageMask |= masks.dstStageMask;
+            pending.dstAccessMask |= masks.dstAccessMask;
+        } else {
+            it->second.pendingBarrier = static_cast<int>(imageBarriers_.size());
+            imageBarriers_.push_back({
+                .srcStageMask = masks.srcStageMask,
+                .srcAccessMask = masks.srcAccessMask,
+                .dstStageMask = masks.dstStageMask,
+                .dstAccessMask = masks.dstAccessMask,
+                .oldLayout = image->imageLayout(),
+                .newLayout = access.layout,
+                .srcQueueFamilyIndex = queueFamilyIndex_,
+                .dstQueueFamilyIndex = queueFamilyIndex_,
+                .image = image,
+                .subresourceRange = subresourceRange,
+            });
+        }
+    }
+    image->imageLayout() = access.layout;
+    return *this;
+}
+
+vk::BarrierTracker &vk::BarrierTracker::use(std::shared_ptr<Buffer> buffer, ResourceAccess access) {
+    auto it = states_.find(buffer.get());
+    if (it == states_.end()) it = states_.emplace(buffer.get(), unknownState(false)).first;
+
+    if (it->second.pendingBarrier >= 0 && (access.accessMask & WRITE_ACCESS)) flush();
+
+    CommandBuffer::MemoryBarrier masks{};
+    if (transition(it->second, access, false, masks)) {
+        if (it->second.pendingBarrier >= 0) {
+            auto &pending = bufferBarriers_[it->second.pendingBarrier];
+            pending.dstStageMask |= masks.dstStageMask;
+            pending.dstAccessMask |= masks.dstAccessMask;
+        } else {
+            it->second.pendingBarrier = static_cast<int>(bufferBarriers_.size());
+            bufferBarriers_.push_back({
+                .srcStageMask = masks.srcStageMask,
+                .srcAccessMask = masks.srcAccessMask,
+                .dstStageMask = masks.dstStageMask,
+                .dstAccessMask = masks.dstAccessMask,
+                .srcQueueFamilyIndex = queueFamilyIndex_,
+                .dstQueueFamilyIndex = queueFamilyIndex_,
+                .buffer = buffer,
+            });
+        }
+    }
+    return *this;
+}
+
+void vk::BarrierTracker::flush() {
+    if (bufferBarriers_.empty() && imageBarriers_.empty()) return;
+
+    commandBuffer_->barriersBufferImage(std::move(bufferBarriers_), std::move(imageBarriers_));
+    bufferBarriers_.clear();
+    imageBarriers_.clear();
+    for (auto &[resource, state] : states_) state.pendingBarrier = -1;
+}
+
+vk::BarrierTracker::State vk::BarrierTracker::unknownState(bool undefinedLayout) {
+    // an undefined image has no contents anyone could still be writing
+    if (undefinedLayout) return {};
+    return {
+        .writeStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .writeAccess = VK_ACCESS_2_MEMORY_WRITE_BIT,
+    };
+}
+
+bool vk::BarrierTracker::transition(State &state,
+                                    ResourceAccess access,
+                                    bool layoutChange,
+                                    CommandBuffer::MemoryBarrier &barrier) {
+    bool writes = (access.accessMask & WRITE_ACCESS) != 0;
+
+    if (layoutChange || writes) {
+        // write after write or read: wait for all of them, only the write has anything to flush
+        barrier = {
+            .srcStageMask = state.writeStages | state.readStages,
+            .srcAccessMask = state.writeAccess,
+            .dstStageMask = access.stageMask,
+            .dstAccessMask = access.accessMask,
+        };
+        bool needed = layoutChange || barrier.srcStageMask != 0;
+
+        // a layout transition is a write made visible to the pass that asked for it
+        int pendingBarrier = state.pendingBarrier;
+        state = {
+            .writeStages = access.stageMask,
+            .writeAccess = access.accessMask & WRITE_ACCESS,
+            .readStages = writes ? 0 : access.stageMask,
+            .visibleStages = writes ? 0 : access.stageMask,
+            .pendingBarrier = pendingBarrier,
+        };
+        return needed;
+    }
+
+    // read after write: only stages the write has not been made visible to yet
+    VkPipelineStageFlags2 missingStages = access.stageMask & ~state.visibleStages;
+    state.readStages |= access.stageMask;
+    state.visibleStages |= access.stageMask;
+    if (state.writeStages == 0 || missingStages == 0) return false;
+
+    barrier = {
+        .srcStageMask = state.writeStages,
+        .srcAccessMask = state.writeAccess,
+        .dstStageMask = missingStages,
+        .dstAccessMask = access.accessMask,
+    };
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "core/all_extern.hpp"
+#include "core/vulkan/command.hpp"
+#include "core/vulkan/image.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace vk {
+class Buffer;
+
+// How a pass uses an image or buffer: the stages touching it, with which accesses and, for images, in which layout.
+struct ResourceAccess {
+    VkPipelineStageFlags2 stageMask;
+    VkAccessFlags2 accessMask;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+// Turns the accesses a module declares for each of its passes into barriers. The last write and the reads since then
+// are remembered per resource, a pass only waits for the stages that actually touched a resource before it and only
+// flushes their writes. The barriers of one pass go out together in a single vkCmdPipelineBarrier2 on flush().
+//
+// State lives as long as the tracker, modules that still write their own barriers are not seen. A resource first met
+// in use() is assumed to have been written by any earlier command, external() tells what the earlier module did.
+class BarrierTracker {
+  public:
+    BarrierTracker(std::shared_ptr<CommandBuffer> commandBuffer, uint32_t queueFamilyIndex);
+
+    // the resource was last accessed outside of the tracker, by an earlier module or by a render pass doing its own
+    // layout transitions; a zero stage mask means nothing is pending on it. Images keep their current imageLayout()
+    BarrierTracker &external(std::shared_ptr<DeviceLocalImage> image,
+                             VkPipelineStageFlags2 stageMask,
+                             VkAccessFlags2 accessMask);
+    BarrierTracker &external(std::shared_ptr<Buffer> buffer,
+                             VkPipelineStageFlags2 stageMask,
+                             VkAccessFlags2 accessMask);
+
+    // the next pass accesses the resource like this, the image layout is updated right away
+    BarrierTracker &use(std::shared_ptr<DeviceLocalImage> image,
+                        ResourceAccess access,
+                        VkImageSubresourceRange subresourceRange = wholeColorSubresourceRange);
+    BarrierTracker &use(std::shared_ptr<Buffer> buffer, ResourceAccess access);
+
+    // records the barriers queued since the last flush, nothing if no access needed one
+    void flush();
+
+  private:
+    struct State {
+        VkPipelineStageFlags2 writeStages = 0; // last write or layout transition
+        VkAccessFlags2 writeAccess = 0;
+        VkPipelineStageFlags2 readStages = 0;    // reads since then
+        VkPipelineStageFlags2 visibleStages = 0; // stages the last write is visible to
+        int pendingBarrier = -1;                 // index into the queued barriers of this resource
+    };
+
+    static State unknownState(bool undefinedLayout);
+    // fills src and dst masks and moves the state past the access, false if no barrier is needed
+    static bool
+    transition(State &state, ResourceAccess access, bool layoutChange, CommandBuffer::MemoryBarrier &barrier);
+
+    std::shared_ptr<CommandBuffer> commandBuffer_;
+    uint32_t queueFamilyIndex_;
+
+    std::unordered_map<const void *, State> states_;
+    std::vector<CommandBuffer::BufferMemoryBarrier> bufferBarriers_;
+    std::vector<CommandBuffer::ImageMemoryBarrier> imageBarriers_;
+};
+}; // namespace vk
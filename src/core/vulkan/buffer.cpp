@@ -19,38 +19,22 @@ vk::HostVisibleBuffer::HostVisibleBuffer(std::shared_ptr<VMA> vma,
                                          std::shared_ptr<Device> device,
                                          size_t size,
                                          VkBufferUsageFlags usage)
-    : vma_(vma), device_(device), size_(size), bufferUsage_(usage) {
-    VkBufferCreateInfo bufferInfo = {};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size_;
-    bufferInfo.usage = usage;
-
-    VmaAllocationCreateInfo allocationInfo = {};
-    allocationInfo.usage = VMA_MEMORY_USAGE_AUTO;
-    allocationInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
-
-    // if (bufferUsage_ & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-    //     allocationInfo.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
-    // }
-
-    if (vmaCreateBuffer(vma_->allocator(), &bufferInfo, &allocationInfo, &buffer_, &allocation_, &allocationInfo_) !=
-        VK_SUCCESS) {
-        bufferCerr() << "failed to create staging buffer" << std::endl;
-    }
-    mappedPtr_ = allocationInfo_.pMappedData;
-
-    if (bufferUsage_ & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-        VkBufferDeviceAddressInfo deviceAddressInfo{.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-                                                    .buffer = buffer_};
-        bufferAddress_ = vkGetBufferDeviceAddress(device_->vkDevice(), &deviceAddressInfo);
-    }
-}
+    : HostVisibleBuffer(vma, device, size, usage, 1, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT) {}
 
 vk::HostVisibleBuffer::HostVisibleBuffer(std::shared_ptr<VMA> vma,
                                          std::shared_ptr<Device> device,
                                          size_t size,
                                          VkBufferUsageFlags usage,
                                          VkDeviceSize minAlignment)
+    : HostVisibleBuffer(
+          vma, device, size, usage, minAlignment, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT) {}
+
+vk::HostVisibleBuffer::HostVisibleBuffer(std::shared_ptr<VMA> vma,
+                                         std::shared_ptr<Device> device,
+                                         size_t size,
+                                         VkBufferUsageFlags usage,
+                                         VkDeviceSize minAlignment,
+                                         VmaAllocationCreateFlags hostAccess)
     : vma_(vma), device_(device), size_(size), bufferUsage_(usage) {
     VkBufferCreateInfo bufferInfo = {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -59,7 +43,7 @@ vk::HostVisibleBuffer::HostVisibleBuffer(std::shared_ptr<VMA> vma,
 
     VmaAllocationCreateInfo allocationInfo = {};
     allocationInfo.usage = VMA_MEMORY_USAGE_AUTO;
-    allocationInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    allocationInfo.flags = hostAccess | VMA_ALLOCATION_CREATE_MAPPED_BIT;
 
     // if (bufferUsage_ & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
     //     allocationInfo.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
@@ -318,6 +302,11 @@ void vk::DeviceLocalBuffer::uploadToStagingBuffer(void *src) {
 }
 
 void vk::DeviceLocalBuffer::uploadToStagingBuffer(void *src, size_t size, size_t offset) {
+    if (boundStagingBuffer_ != nullptr) {
+        boundStagingBuffer_->uploadToBuffer(src, size, boundStagingOffset_ + offset);
+        return;
+    }
+
     if (!persistStaging_) {
         if (stagingBuffer_ != VK_NULL_HANDLE || stagingAllocation_ != VK_NULL_HANDLE || mappedPtr_ != nullptr) {
             bufferCerr() << "if not persist staging, the staging buffer should not exist!" << std::endl;
@@ -353,10 +342,26 @@ void vk::DeviceLocalBuffer::uploadToStagingBuffer(void *src, size_t size, size_t
 }
 
 void vk::DeviceLocalBuffer::flushStagingBuffer() {
+    if (boundStagingBuffer_ != nullptr) { return; }
     if (!persistStaging_) { return; }
     vmaFlushAllocation(vma_->allocator(), stagingAllocation_, 0, size_);
 }
 
+void vk::DeviceLocalBuffer::bindStagingBuffer(std::shared_ptr<HostVisibleBuffer> stagingBuffer, size_t offset) {
+    if (persistStaging_) {
+        bufferCerr() << "a buffer with its own staging buffer cannot be bound to an external one!" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (offset + size_ > stagingBuffer->size()) {
+        bufferCerr() << "bound staging region exceeds the external staging buffer" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    boundStagingBuffer_ = stagingBuffer;
+    boundStagingOffset_ = offset;
+    mappedPtr_ = static_cast<char *>(stagingBuffer->mappedPtr()) + offset;
+}
+
 void vk::DeviceLocalBuffer::downloadFromBuffer(VkCommandBuffer cmdBuffer) {
     downloadFromBuffer(cmdBuffer, size_, 0, 0);
 }
@@ -374,6 +379,12 @@ void vk::DeviceLocalBuffer::uploadToBuffer(VkCommandBuffer cmdBuffer) {
 }
 
 void vk::DeviceLocalBuffer::uploadToBuffer(VkCommandBuffer cmdBuffer, size_t size, size_t srcOffset, size_t dstOffset) {
+    if (boundStagingBuffer_ != nullptr) {
+        VkBufferCopy copyRegion = {boundStagingOffset_ + srcOffset, dstOffset, size};
+        vkCmdCopyBuffer(cmdBuffer, boundStagingBuffer_->vkBuffer(), buffer_, 1, &copyRegion);
+        return;
+    }
+
     VkBufferCopy copyRegion = {srcOffset, dstOffset, size};
     vkCmdCopyBuffer(cmdBuffer, stagingBuffer_, buffer_, 1, &copyRegion);
 }
@@ -394,6 +405,7 @@ size_t vk::DeviceLocalBuffer::size() {
 }
 
 VkBuffer &vk::DeviceLocalBuffer::vkStagingBuffer() {
+    if (boundStagingBuffer_ != nullptr) { return boundStagingBuffer_->vkBuffer(); }
     return stagingBuffer_;
 }
 
@@ -17,6 +17,15 @@ class HostVisibleBuffer : public Buffer, public SharedObject<HostVisibleBuffer>
   public:
     HostVisibleBuffer(std::shared_ptr<VMA> vma, std::shared_ptr<Device> device, size_t size, VkBufferUsageFlags usage);
     HostVisibleBuffer(std::shared_ptr<VMA> vma, std::shared_ptr<Device> device, size_t size, VkBufferUsageFlags usage, VkDeviceSize minAlignment);
+    // hostAccess is VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, the default, for memory the CPU only writes
+    // and VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT for memory it also reads, which is cached but may need a flush
+    // after writing and an invalidate before reading
+    HostVisibleBuffer(std::shared_ptr<VMA> vma,
+                      std::shared_ptr<Device> device,
+                      size_t size,
+                      VkBufferUsageFlags usage,
+                      VkDeviceSize minAlignment,
+                      VmaAllocationCreateFlags hostAccess);
     ~HostVisibleBuffer();
 
     void downloadFromBuffer();
@@ -80,6 +89,10 @@ class DeviceLocalBuffer : public Buffer, public SharedObject<DeviceLocalBuffer>
     void uploadToStagingBuffer(void *src, size_t size, size_t offset);
     void flushStagingBuffer();
 
+    // use a region of an externally filled host visible buffer as the upload source instead of an own staging buffer,
+    // the region is kept alive by this buffer
+    void bindStagingBuffer(std::shared_ptr<HostVisibleBuffer> stagingBuffer, size_t offset);
+
     void downloadFromBuffer(VkCommandBuffer cmdBuffer);
     void downloadFromBuffer(VkCommandBuffer cmdBuffer, size_t size, size_t srcOffset, size_t dstOffset);
 
@@ -109,6 +122,8 @@ class DeviceLocalBuffer : public Buffer, public SharedObject<DeviceLocalBuffer>
     VkBuffer stagingBuffer_ = VK_NULL_HANDLE;
     VmaAllocation stagingAllocation_ = VK_NULL_HANDLE;
     VmaAllocationInfo stagingAllocationInfo_;
+    std::shared_ptr<HostVisibleBuffer> boundStagingBuffer_ = nullptr;
+    size_t boundStagingOffset_ = 0;
     VkBuffer buffer_ = VK_NULL_HANDLE;
     VmaAllocation allocation_ = VK_NULL_HANDLE;
     VmaAllocationInfo allocationInfo_;
@@ -90,6 +90,60 @@ std::shared_ptr<vk::DescriptorTable> vk::DescriptorTable::bindSamplerImage(std::
     return shared_from_this();
 }
 
+std::shared_ptr<vk::DescriptorTable> vk::DescriptorTable::queueSamplerImage(std::shared_ptr<Sampler> sampler,
+                                                                            std::shared_ptr<Image> image,
+                                                                            VkImageLayout layout,
+                                                                            uint32_t set,
+                                                                            uint32_t binding,
+                                                                            uint32_t index,
+                                                                            uint32_t viewIndex) {
+    VkDescriptorImageInfo &descriptorImageInfo = queuedImageWrites_[std::make_tuple(set, binding, index)];
+    descriptorImageInfo.sampler = sampler->vkSamper();
+    descriptorImageInfo.imageView = image->vkImageView(viewIndex);
+    descriptorImageInfo.imageLayout = layout;
+
+    return shared_from_this();
+}
+
+void vk::DescriptorTable::flushQueuedWrites() {
+    if (queuedImageWrites_.empty()) return;
+
+    std::vector<VkDescriptorImageInfo> descriptorImageInfos;
+    descriptorImageInfos.reserve(queuedImageWrites_.size());
+    std::vector<VkWriteDescriptorSet> writeDescriptorSets;
+
+    uint32_t lastSet = 0, lastBinding = 0, lastIndex = 0;
+    for (const auto &[key, descriptorImageInfo] : queuedImageWrites_) {
+        auto [set, binding, index] = key;
+
+        // consecutive array elements of the same binding collapse into one write
+        bool contiguous = !writeDescriptorSets.empty() && set == lastSet && binding == lastBinding &&
+                          index == lastIndex + 1;
+        descriptorImageInfos.push_back(descriptorImageInfo);
+        if (contiguous) {
+            writeDescriptorSets.back().descriptorCount++;
+        } else {
+            VkWriteDescriptorSet &writeDescriptorSet = writeDescriptorSets.emplace_back();
+            writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSet.dstSet = table_[set];
+            writeDescriptorSet.descriptorCount = 1;
+            writeDescriptorSet.descriptorType = tableTypes_[set][binding];
+            writeDescriptorSet.dstBinding = binding;
+            writeDescriptorSet.dstArrayElement = index;
+            // descriptorImageInfos is reserved up front, so the pointer stays valid
+            writeDescriptorSet.pImageInfo = &descriptorImageInfos.back();
+        }
+
+        lastSet = set;
+        lastBinding = binding;
+        lastIndex = index;
+    }
+
+    vkUpdateDescriptorSets(device_->vkDevice(), writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
+
+    queuedImageWrites_.clear();
+}
+
 std::shared_ptr<vk::DescriptorTable> vk::DescriptorTable::bindImageForShader(std::shared_ptr<Image> image,
                                                                              uint32_t set,
                                                                              uint32_t binding,
@@ -2,6 +2,8 @@
 
 #include "core/all_extern.hpp"
 
+#include <map>
+#include <tuple>
 #include <vector>
 
 namespace vk {
@@ -40,6 +42,16 @@ class DescriptorTable : public SharedObject<DescriptorTable> {
                                                       uint32_t binding,
                                                       uint32_t index,
                                                       uint32_t viewIndex = 0);
+    // deferred variant of bindSamplerImage, later writes to the same element replace earlier ones
+    std::shared_ptr<DescriptorTable> queueSamplerImage(std::shared_ptr<Sampler> sampler,
+                                                       std::shared_ptr<Image> image,
+                                                       VkImageLayout layout,
+                                                       uint32_t set,
+                                                       uint32_t binding,
+                                                       uint32_t index,
+                                                       uint32_t viewIndex = 0);
+    // submit all queued writes with a single vkUpdateDescriptorSets
+    void flushQueuedWrites();
     std::shared_ptr<DescriptorTable>
     bindImageForShader(std::shared_ptr<Image> image, uint32_t set, uint32_t binding, uint32_t viewIndex = 0);
     std::shared_ptr<DescriptorTable> bindSamplerImageForShader(std::shared_ptr<Sampler> sampler,
@@ -65,6 +77,9 @@ class DescriptorTable : public SharedObject<DescriptorTable> {
     std::vector<std::vector<VkDescriptorType>> tableTypes_;
     VkPipelineLayout pipelineLayout_ = VK_NULL_HANDLE;
     std::vector<VkPushConstantRange> pushConstantRanges_;
+
+    // (set, binding, array element) -> image info, ordered so adjacent elements can share one write
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, VkDescriptorImageInfo> queuedImageWrites_;
 };
 
 class DescriptorTableBuilder {
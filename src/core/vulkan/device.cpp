@@ -235,6 +235,8 @@ vk::Device::Device(std::shared_ptr<Instance> instance,
     vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind =
         supportedVulkan12.descriptorBindingStorageBufferUpdateAfterBind;
     vulkan12Features.shaderFloat16 = supportedVulkan12.shaderFloat16;
+    vulkan12Features.timelineSemaphore = supportedVulkan12.timelineSemaphore;
+    timelineSemaphoreSupported_ = supportedVulkan12.timelineSemaphore == VK_TRUE;
 
     VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures = {};
     accelerationStructureFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
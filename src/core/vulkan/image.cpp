@@ -6,6 +6,7 @@
 #include "core/vulkan/device.hpp"
 #include "core/vulkan/vma.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <sstream>
@@ -232,28 +233,65 @@ vk::DeviceLocalImage::DeviceLocalImage(std::shared_ptr<Device> device,
     }
 
     // image
-    VkImageCreateInfo imageInfo = {};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.flags = imageCreateFlags;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.format = format_;
-    imageInfo.extent = {width_, height_, 1};
-    imageInfo.mipLevels = mipLevels;
-    imageInfo.arrayLayers = layer_;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | usage_;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo_.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo_.flags = imageCreateFlags;
+    imageInfo_.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo_.format = format_;
+    imageInfo_.extent = {width_, height_, 1};
+    imageInfo_.mipLevels = mipLevels;
+    imageInfo_.arrayLayers = layer_;
+    imageInfo_.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | usage_;
+    imageInfo_.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo_.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageLayout_ = VK_IMAGE_LAYOUT_UNDEFINED;
 
+    DeferredImageMemory *deferredMemory = DeferredImageMemory::current_;
+    if (deferredMemory != nullptr && !persistStaging_ && allocationFlags_ == 0 &&
+        vmaUsage_ == VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE) {
+        if (vkCreateImage(device_->vkDevice(), &imageInfo_, nullptr, &image_) != VK_SUCCESS) {
+            imageCerr() << "failed to create image" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        deferredMemory_ = deferredMemory;
+        deferredMemory_->pending_.push_back(this);
+        return;
+    }
+
+    bindDedicated();
+}
+
+void vk::DeviceLocalImage::bindDedicated() {
+    if (image_ != VK_NULL_HANDLE) {
+        // created unbound, VMA picks the memory together with a fresh image
+        vkDestroyImage(device_->vkDevice(), image_, nullptr);
+        image_ = VK_NULL_HANDLE;
+    }
+
     VmaAllocationCreateInfo allocationInfo{};
     allocationInfo.flags = allocationFlags_;
-    allocationInfo.usage = vmaUsage;
-    if (vmaCreateImage(vma_->allocator(), &imageInfo, &allocationInfo, &image_, &allocation_, &allocationInfo_) !=
+    allocationInfo.usage = vmaUsage_;
+    if (vmaCreateImage(vma_->allocator(), &imageInfo_, &allocationInfo, &image_, &allocation_, &allocationInfo_) !=
         VK_SUCCESS) {
         imageCerr() << "failed to create image" << std::endl;
         exit(EXIT_FAILURE);
     }
+    deferredMemory_ = nullptr;
+
+    createDefaultView();
+}
 
+void vk::DeviceLocalImage::bindAliased(std::shared_ptr<AliasedImageMemory> memory) {
+    if (vmaBindImageMemory(vma_->allocator(), memory->allocation(), image_) != VK_SUCCESS) {
+        imageCerr() << "failed to bind aliased image memory" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    aliasedMemory_ = memory;
+    deferredMemory_ = nullptr;
+
+    createDefaultView();
+}
+
+void vk::DeviceLocalImage::createDefaultView() {
     VkImageViewCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     createInfo.image = image_;
@@ -276,9 +314,19 @@ vk::DeviceLocalImage::DeviceLocalImage(std::shared_ptr<Device> device,
 }
 
 vk::DeviceLocalImage::~DeviceLocalImage() {
+    if (deferredMemory_ != nullptr) {
+        auto &pending = deferredMemory_->pending_;
+        pending.erase(std::remove(pending.begin(), pending.end(), this), pending.end());
+    }
+
     for (int i = 0; i < imageViews_.size(); i++) { vkDestroyImageView(device_->vkDevice(), imageViews_[i], nullptr); }
     vmaDestroyBuffer(vma_->allocator(), stagingBuffer_, stagingAllocation_);
-    vmaDestroyImage(vma_->allocator(), image_, allocation_);
+    if (allocation_ != VK_NULL_HANDLE) {
+        vmaDestroyImage(vma_->allocator(), image_, allocation_);
+    } else {
+        // aliased or never bound, the shared memory is released with the last image holding it
+        vkDestroyImage(device_->vkDevice(), image_, nullptr);
+    }
 
 #ifdef DEBUG
     imageCout() << "device local image deconstructed" << std::endl;
@@ -384,6 +432,16 @@ VkImageLayout &vk::DeviceLocalImage::imageLayout() {
     return imageLayout_;
 }
 
+bool vk::DeviceLocalImage::bound() {
+    return deferredMemory_ == nullptr;
+}
+
+VkMemoryRequirements vk::DeviceLocalImage::memoryRequirements() {
+    VkMemoryRequirements requirements{};
+    vkGetImageMemoryRequirements(device_->vkDevice(), image_, &requirements);
+    return requirements;
+}
+
 void *vk::DeviceLocalImage::mappedPtr() {
     return mappedPtr_;
 }
@@ -397,6 +455,87 @@ void vk::DeviceLocalImage::addImageView(VkImageViewCreateInfo info) {
     imageViews_.push_back(vkImageView);
 }
 
+vk::AliasedImageMemory::AliasedImageMemory(std::shared_ptr<VMA> vma, VmaAllocation allocation, VkDeviceSize size)
+    : vma_(vma), allocation_(allocation), size_(size) {}
+
+vk::AliasedImageMemory::~AliasedImageMemory() {
+    vmaFreeMemory(vma_->allocator(), allocation_);
+}
+
+VmaAllocation vk::AliasedImageMemory::allocation() {
+    return allocation_;
+}
+
+VkDeviceSize vk::AliasedImageMemory::size() {
+    return size_;
+}
+
+thread_local vk::DeferredImageMemory *vk::DeferredImageMemory::current_ = nullptr;
+
+vk::DeferredImageMemory::DeferredImageMemory(std::shared_ptr<VMA> vma) : vma_(vma), previous_(current_) {
+    current_ = this;
+}
+
+vk::DeferredImageMemory::~DeferredImageMemory() {
+    finish();
+}
+
+bool vk::DeferredImageMemory::deferred(const std::shared_ptr<DeviceLocalImage> &image) {
+    return image != nullptr && image->deferredMemory_ == this;
+}
+
+void vk::DeferredImageMemory::alias(const std::shared_ptr<DeviceLocalImage> &image, uint32_t group) {
+    if (!deferred(image)) return;
+    groups_[group].push_back(image.get());
+}
+
+void vk::DeferredImageMemory::finish() {
+    if (finished_) return;
+    finished_ = true;
+    current_ = previous_;
+
+    for (auto &[group, images] : groups_) {
+        // images destroyed since they were grouped are no longer pending
+        std::erase_if(images, [this](DeviceLocalImage *image) {
+            return std::find(pending_.begin(), pending_.end(), image) == pending_.end();
+        });
+        if (images.size() < 2) continue;
+
+        VkMemoryRequirements requirements{.size = 0, .alignment = 1, .memoryTypeBits = ~0u};
+        for (auto image : images) {
+            VkMemoryRequirements imageRequirements = image->memoryRequirements();
+            requirements.size = std::max(requirements.size, imageRequirements.size);
+            requirements.alignment = std::max(requirements.alignment, imageRequirements.alignment);
+            requirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+        }
+
+        VmaAllocationCreateInfo allocationInfo{};
+        allocationInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        if (requirements.memoryTypeBits == 0 ||
+            vmaAllocateMemory(vma_->allocator(), &requirements, &allocationInfo, &allocation, nullptr) != VK_SUCCESS) {
+            imageCerr() << "failed to allocate aliased image memory, falling back to dedicated images" << std::endl;
+            continue;
+        }
+
+        auto memory = AliasedImageMemory::create(vma_, allocation, requirements.size);
+        for (auto image : images) {
+            savedBytes_ += image->memoryRequirements().size;
+            image->bindAliased(memory);
+            pending_.erase(std::remove(pending_.begin(), pending_.end(), image), pending_.end());
+        }
+        savedBytes_ -= requirements.size;
+    }
+
+    for (auto image : pending_) image->bindDedicated();
+    pending_.clear();
+    groups_.clear();
+}
+
+VkDeviceSize vk::DeferredImageMemory::savedBytes() {
+    return savedBytes_;
+}
+
 vk::Sampler::Sampler(std::shared_ptr<Device> device)
     : Sampler(device, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT) {}
 
@@ -2,6 +2,7 @@
 
 #include "core/all_extern.hpp"
 
+#include <map>
 #include <vector>
 
 namespace vk {
@@ -101,7 +102,26 @@ class SwapchainImage : public Image, public SharedObject<SwapchainImage> {
     std::vector<VkImageView> imageViews_{1};
 };
 
+class DeferredImageMemory;
+
+// one device memory allocation shared by images whose uses never overlap within a frame
+class AliasedImageMemory : public SharedObject<AliasedImageMemory> {
+  public:
+    AliasedImageMemory(std::shared_ptr<VMA> vma, VmaAllocation allocation, VkDeviceSize size);
+    ~AliasedImageMemory();
+
+    VmaAllocation allocation();
+    VkDeviceSize size();
+
+  private:
+    std::shared_ptr<VMA> vma_;
+    VmaAllocation allocation_;
+    VkDeviceSize size_;
+};
+
 class DeviceLocalImage : public Image, public SharedObject<DeviceLocalImage> {
+    friend DeferredImageMemory;
+
   public:
     DeviceLocalImage(std::shared_ptr<Device> device,
                      std::shared_ptr<VMA> vma,
@@ -167,7 +187,15 @@ class DeviceLocalImage : public Image, public SharedObject<DeviceLocalImage> {
 
     void addImageView(VkImageViewCreateInfo info);
 
+    // false while the image waits inside a DeferredImageMemory, it then has neither memory nor views
+    bool bound();
+    VkMemoryRequirements memoryRequirements();
+
   private:
+    void bindDedicated();
+    void bindAliased(std::shared_ptr<AliasedImageMemory> memory);
+    void createDefaultView();
+
     std::shared_ptr<Device> device_;
     std::shared_ptr<VMA> vma_;
 
@@ -187,10 +215,46 @@ class DeviceLocalImage : public Image, public SharedObject<DeviceLocalImage> {
     VkImage image_ = VK_NULL_HANDLE;
     VmaAllocation allocation_ = VK_NULL_HANDLE;
     VmaAllocationInfo allocationInfo_;
+    VkImageCreateInfo imageInfo_{};
+    DeferredImageMemory *deferredMemory_ = nullptr;
+    std::shared_ptr<AliasedImageMemory> aliasedMemory_;
 
     std::vector<VkImageView> imageViews_{1};
 };
 
+// While alive, plain device-local images (no staging, default allocation flags) created on this thread are left
+// without memory so that it can be placed once all of them are known. finish() binds every aliased group into one
+// shared allocation and gives all other images their own, exactly as if they had been created outside the scope.
+class DeferredImageMemory {
+  public:
+    DeferredImageMemory(std::shared_ptr<VMA> vma);
+    ~DeferredImageMemory();
+
+    DeferredImageMemory(const DeferredImageMemory &) = delete;
+    DeferredImageMemory &operator=(const DeferredImageMemory &) = delete;
+
+    bool deferred(const std::shared_ptr<DeviceLocalImage> &image);
+    // images of one group share an allocation, the caller guarantees their uses never overlap and that the group's
+    // memory type bits intersect
+    void alias(const std::shared_ptr<DeviceLocalImage> &image, uint32_t group);
+    void finish();
+
+    // device memory the aliased groups saved over one allocation per image
+    VkDeviceSize savedBytes();
+
+  private:
+    friend DeviceLocalImage;
+
+    static thread_local DeferredImageMemory *current_;
+
+    std::shared_ptr<VMA> vma_;
+    DeferredImageMemory *previous_;
+    bool finished_ = false;
+    std::vector<DeviceLocalImage *> pending_;
+    std::map<uint32_t, std::vector<DeviceLocalImage *>> groups_;
+    VkDeviceSize savedBytes_ = 0;
+};
+
 class Sampler : public SharedObject<Sampler> {
   public:
     Sampler(std::shared_ptr<Device> device);
@@ -9,6 +9,19 @@ vk::Semaphore::Semaphore(std::shared_ptr<Device> device) : device_(device) {
     vkCreateSemaphore(device_->vkDevice(), &semaphoreInfo, nullptr, &semaphore_);
 }
 
+vk::Semaphore::Semaphore(std::shared_ptr<Device> device, uint64_t initialValue) : device_(device), timeline_(true) {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = initialValue;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    vkCreateSemaphore(device_->vkDevice(), &semaphoreInfo, nullptr, &semaphore_);
+}
+
 vk::Semaphore::~Semaphore() {
     vkDestroySemaphore(device_->vkDevice(), semaphore_, nullptr);
 }
@@ -17,6 +30,10 @@ VkSemaphore &vk::Semaphore::vkSemaphore() {
     return semaphore_;
 }
 
+bool vk::Semaphore::isTimeline() {
+    return timeline_;
+}
+
 vk::Fence::Fence(std::shared_ptr<Device> device) : Fence(device, false) {}
 
 vk::Fence::Fence(std::shared_ptr<Device> device, bool signaled) : device_(device) {
@@ -8,14 +8,18 @@ class Device;
 class Semaphore : public SharedObject<Semaphore> {
   public:
     Semaphore(std::shared_ptr<Device> device);
+    // timeline semaphore starting at initialValue
+    Semaphore(std::shared_ptr<Device> device, uint64_t initialValue);
     ~Semaphore();
 
     VkSemaphore& vkSemaphore();
+    bool isTimeline();
 
   private:
     std::shared_ptr<Device> device_;
 
     VkSemaphore semaphore_;
+    bool timeline_ = false;
 };
 
 class Fence : public SharedObject<Fence> {
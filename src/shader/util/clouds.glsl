@@ -603,7 +603,7 @@ CloudSegmentResult integrateCloudSegment(vec3 ro, vec3 rd, float tMin, float tMa
     vec3 lightRadiance = cloudMainLightRadiance(skyUBO, toLight);
 
     // Ambient fill from sky cubemap.
-    vec3 skyAmbient = texture(skyFull, vec3(0.0, 1.0, 0.0)).rgb * skyUBO.envSky.x;
+    vec3 skyAmbient = textureLod(skyFull, vec3(0.0, 1.0, 0.0), 0.0).rgb * skyUBO.envSky.x;
     skyAmbient = max(skyAmbient, vec3(0.0));
 
     float ambientStrength = max(skyUBO.cloudLighting.y, 0.0);
@@ -0,0 +1,20 @@
+#ifndef VARIABLE_RATE_GLSL
+#define VARIABLE_RATE_GLSL
+
+// Whether world.rgen traces the pixel this frame, vrt_reconstruct.comp fills in the others from their traced
+// neighbours. Every 2x2 block has a traced pixel and the last row and column are always traced, so a skipped pixel
+// always has one in reach. frame is the module's frame counter, the pattern shifts every frame so the temporal
+// accumulation downstream still sees every pixel.
+bool vrtTraced(ivec2 pixel, ivec2 size, uint rate, uint frame) {
+    if (rate == TRACING_RATE_FULL) return true;
+    if (pixel.x == size.x - 1 || pixel.y == size.y - 1) return true;
+
+    if (rate == TRACING_RATE_HALF) return ((uint(pixel.x + pixel.y) + frame) & 1u) == 0u;
+
+    // diagonal pairs first, so two frames in a row cover the block like a checkerboard
+    const uint QUARTER_ORDER[4] = uint[](0u, 3u, 1u, 2u);
+    uint index = uint(pixel.x & 1) | (uint(pixel.y & 1) << 1);
+    return index == QUARTER_ORDER[frame & 3u];
+}
+
+#endif
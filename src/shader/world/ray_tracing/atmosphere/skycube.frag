@@ -14,7 +14,8 @@ layout(set = 1, binding = 1) uniform SkyUniform {
 layout(set = 0, binding = 0) uniform sampler2D transLUT;
 
 layout(push_constant) uniform Push {
-    int face; // 0..5
+    int face;    // 0..5
+    float blend; // weight over what the face held, see Atmosphere::selectCubeFaces
 }
 pc;
 
@@ -137,5 +138,5 @@ void main() {
     vec3 ro = vec3(0.0, skyUBO.Rg + cameraHeight + 70, 0.0); // camera height mapped to radius (+70 for negative y)
 
     vec3 L = integrateSingleScattering(ro, rd, false) + integrateSingleScattering(ro, rd, true);
-    outColor = vec4(L, 1.0);
+    outColor = vec4(L, pc.blend);
 }